@@ -1,4 +1,6 @@
 import * as vscode from 'vscode';
+import * as path from 'path';
+import { TextDecoder } from 'util';
 
 // Type definitions matching the native module
 export interface MemberInfo {
@@ -10,6 +12,30 @@ export interface MemberInfo {
     isBitfield: boolean;
     bitfieldWidth: number;
     bitfieldOffset: number;
+    // Atomic, lock, or annotated [[clang::annotate("structsight::shared")]]
+    isThreadShared: boolean;
+    // [[no_unique_address]]; size is 0 when the member takes no storage
+    isNoUniqueAddress: boolean;
+    // Padding bytes inside the member's own type, at every level and in
+    // every array element
+    nestedPadding: number;
+    // Record-typed members: the record's members and padding, at offsets
+    // within the member (within its first element for arrays)
+    children?: MemberInfo[];
+    padding?: PaddingInfo[];
+}
+
+// A base class subobject at the offset Clang placed it. size counts the
+// base's data bytes (0 for an empty base), so a derived class's members
+// may start inside the base's tail padding.
+export interface BaseInfo {
+    name: string;
+    offset: number;
+    size: number;
+    alignment: number;
+    isVirtual: boolean;
+    isEmpty: boolean;
+    isPrimary: boolean;
 }
 
 export interface PaddingInfo {
@@ -18,17 +44,90 @@ export interface PaddingInfo {
     reason: string;
 }
 
+// One vtable entry; index counts from the address point the vptr holds
+export interface VTableSlot {
+    index: number;
+    kind: 'function' | 'completeDtor' | 'deletingDtor' | 'unusedFunction' |
+        'offsetToTop' | 'rtti' | 'vcallOffset' | 'vbaseOffset';
+    name: string;
+    // Set when the slot holds a thunk: the this/return adjustment it makes
+    thunk?: string;
+}
+
+export interface VPointerInfo {
+    offset: number;
+    subobject: string;
+    slots: VTableSlot[];
+}
+
+export interface VirtualBaseInfo {
+    name: string;
+    offset: number;
+    // Itanium: vbase offset entry, in bytes from the address point;
+    // Microsoft: vbtable index
+    offsetSlot: number;
+}
+
 export interface VTableInfo {
     pointerOffset: number;
     virtualFunctions: string[];
     hasVirtualBase: boolean;
+    vptrs: VPointerInfo[];
+    virtualBases: VirtualBaseInfo[];
+    // Microsoft ABI only
+    vbptrOffset?: number;
 }
 
+export type OptimizationKind =
+    'reorder' | 'cacheLineSplit' | 'hotColdSplit' | 'falseSharing' | 'coAccess' | 'aosToSoa' |
+    'devirtualize' | 'packFlags' | 'narrowTypes' | 'nestedReorder' | 'arrayStride';
+
 export interface Optimization {
+    kind: OptimizationKind;
     description: string;
     bytesSaved: number;
     suggestedOrder: string[];
-    confidence: number;
+    membersMoved: number;
+    // hotColdSplit only: suggestedOrder is the hot part, these move out of line
+    coldMembers?: string[];
+    // hotColdSplit and coAccess: estimated cache lines touched per access
+    linesPerAccessBefore?: number;
+    linesPerAccessAfter?: number;
+    // falseSharing only: members that need a cache line of their own
+    contendedMembers?: string[];
+    // aosToSoa only: members the array loops read, and bytes fetched per
+    // iteration as an array of structs (before) and a struct of arrays (after)
+    loopMembers?: string[];
+    bytesPerIterationBefore?: number;
+    bytesPerIterationAfter?: number;
+    // devirtualize only: methods to mark final; empty means the class
+    finalMethods?: string[];
+    // packFlags only: members to declare as bitfields, and their widths;
+    // suggestedOrder is the member order with them packed together
+    bitfieldMembers?: string[];
+    bitfieldWidths?: number[];
+    // narrowTypes only: members to narrow and the integer type for each (an
+    // enum member's is its enum's new underlying type)
+    narrowedMembers?: string[];
+    narrowedTypes?: string[];
+    // nestedReorder only: the member holding the nested record and the
+    // record's qualified name; suggestedOrder is the record's new order
+    nestedMember?: string;
+    nestedType?: string;
+}
+
+// How elements fall on cache lines and pages in an array starting on a
+// line (page) boundary
+export interface ArrayStride {
+    elementsPerLine: number;
+    elementsPerPage: number;     // 4 KiB
+    elementsPerHugePage: number; // 2 MiB
+    linesPerElement: number;     // Cache lines one element touches, on average
+    lineStraddle: number;        // Fraction of elements crossing a cache line boundary
+    pageStraddle: number;
+    hugePageStraddle: number;
+    shrinkSize: number;          // Largest smaller sizeof touching no extra lines; 0 = none needed
+    alignedSize: number;         // sizeof under the alignas that does the same; 0 = none needed
 }
 
 export interface StructLayout {
@@ -37,36 +136,566 @@ export interface StructLayout {
     totalSize: number;
     alignment: number;
     usefulSize: number;
+    // sizeof without tail padding; where a derived class's members can start
+    dataSize: number;
+    // Padding inside members' own types; padding plus this is all waste
+    nestedPadding: number;
+    arrayStride: ArrayStride;
     isPolymorphic: boolean;
     isStandardLayout: boolean;
     members: MemberInfo[];
+    // Direct non-virtual bases, then every virtual base
+    bases: BaseInfo[];
     padding: PaddingInfo[];
     vtable: VTableInfo;
     optimizations: Optimization[];
+    // Set on specializations of a class template: the template's qualified
+    // name, and the padding bytes beyond its least-padded instantiation
+    templateName?: string;
+    templatePaddingExcess?: number;
+}
+
+// Where a native analysis spent its time (milliseconds) and how much
+// work it did; returned when a query sets `stats: true`
+export interface AnalysisStats {
+    totalMs: number;
+    preambleMs: number;
+    parseMs: number;
+    traversalMs: number;
+    layoutMs: number;
+    accessMs: number;
+    conversionMs: number;
+    recordsVisited: number;
+    recordsReported: number;
+    astBytes: number;
+    layoutCacheHit: boolean;
+    preambleReused: boolean;
+    astReused: boolean;
 }
 
 export interface AnalysisResult {
     success: boolean;
     errorMessage: string;
     layouts: StructLayout[];
+    cancelled?: boolean;
+    stats?: AnalysisStats;
+}
+
+// Reader for the buffer the native side builds when a request sets
+// `binary: true` (see native/src/binary_encoder.h for the format).
+// Records are decoded only when a field is read, and each distinct string
+// only once, so a scan with thousands of layouts costs one ArrayBuffer
+// until something looks at it.
+const BINARY_MAGIC = 0x42535353;
+const BINARY_VERSION = 11;
+const HEADER_SIZE = 48;
+const LAYOUT_RECORD_SIZE = 200;
+const MEMBER_RECORD_SIZE = 72;
+const PADDING_RECORD_SIZE = 24;
+const BASE_RECORD_SIZE = 32;
+const OPTIMIZATION_RECORD_SIZE = 128;
+const VPTR_RECORD_SIZE = 24;
+const VTABLE_SLOT_RECORD_SIZE = 24;
+const VIRTUAL_BASE_RECORD_SIZE = 24;
+
+const align8 = (value: number) => (value + 7) & ~7;
+
+class BinaryLayoutReader {
+    readonly view: DataView;
+    readonly layoutCount: number;
+    private readonly layoutBase: number;
+    private readonly memberBase: number;
+    private readonly paddingBase: number;
+    private readonly baseBase: number;
+    private readonly optimizationBase: number;
+    private readonly vptrBase: number;
+    private readonly slotBase: number;
+    private readonly virtualBaseBase: number;
+    private readonly refBase: number;
+    private readonly stringOffsetBase: number;
+    private readonly stringDataBase: number;
+    private readonly strings: (string | undefined)[];
+    private readonly utf8 = new TextDecoder('utf-8');
+
+    constructor(buffer: ArrayBuffer) {
+        this.view = new DataView(buffer);
+        if (buffer.byteLength < HEADER_SIZE || this.view.getUint32(0, true) !== BINARY_MAGIC) {
+            throw new Error('Not a StructSight layout buffer');
+        }
+        if (this.view.getUint32(4, true) !== BINARY_VERSION) {
+            throw new Error('Unsupported StructSight layout buffer version');
+        }
+
+        this.layoutCount = this.view.getUint32(8, true);
+        const memberCount = this.view.getUint32(12, true);
+        const paddingCount = this.view.getUint32(16, true);
+        const optimizationCount = this.view.getUint32(20, true);
+        const refCount = this.view.getUint32(24, true);
+        const stringCount = this.view.getUint32(28, true);
+        const vptrCount = this.view.getUint32(32, true);
+        const slotCount = this.view.getUint32(36, true);
+        const virtualBaseCount = this.view.getUint32(40, true);
+        const baseCount = this.view.getUint32(44, true);
+
+        this.layoutBase = HEADER_SIZE;
+        this.memberBase = this.layoutBase + this.layoutCount * LAYOUT_RECORD_SIZE;
+        this.paddingBase = this.memberBase + memberCount * MEMBER_RECORD_SIZE;
+        this.baseBase = this.paddingBase + paddingCount * PADDING_RECORD_SIZE;
+        this.optimizationBase = this.baseBase + baseCount * BASE_RECORD_SIZE;
+        this.vptrBase = this.optimizationBase + optimizationCount * OPTIMIZATION_RECORD_SIZE;
+        this.slotBase = this.vptrBase + vptrCount * VPTR_RECORD_SIZE;
+        this.virtualBaseBase = this.slotBase + slotCount * VTABLE_SLOT_RECORD_SIZE;
+        this.refBase = this.virtualBaseBase + virtualBaseCount * VIRTUAL_BASE_RECORD_SIZE;
+        this.stringOffsetBase = this.refBase + align8(refCount * 4);
+        this.stringDataBase = this.stringOffsetBase + (stringCount + 1) * 4;
+        this.strings = new Array(stringCount);
+    }
+
+    f64(offset: number): number {
+        return this.view.getFloat64(offset, true);
+    }
+
+    u32(offset: number): number {
+        return this.view.getUint32(offset, true);
+    }
+
+    string(index: number): string {
+        let value = this.strings[index];
+        if (value === undefined) {
+            const start = this.u32(this.stringOffsetBase + index * 4);
+            const end = this.u32(this.stringOffsetBase + index * 4 + 4);
+            value = this.utf8.decode(
+                new Uint8Array(this.view.buffer, this.stringDataBase + start, end - start)
+            );
+            this.strings[index] = value;
+        }
+        return value;
+    }
+
+    stringList(first: number, count: number): string[] {
+        const list: string[] = new Array(count);
+        for (let i = 0; i < count; i++) {
+            list[i] = this.string(this.u32(this.refBase + (first + i) * 4));
+        }
+        return list;
+    }
+
+    // Plain numbers stored among the string references (bitfield widths)
+    numberList(first: number, count: number): number[] {
+        const list: number[] = new Array(count);
+        for (let i = 0; i < count; i++) {
+            list[i] = this.u32(this.refBase + (first + i) * 4);
+        }
+        return list;
+    }
+
+    layoutOffset(index: number): number {
+        return this.layoutBase + index * LAYOUT_RECORD_SIZE;
+    }
+
+    memberOffset(index: number): number {
+        return this.memberBase + index * MEMBER_RECORD_SIZE;
+    }
+
+    paddingOffset(index: number): number {
+        return this.paddingBase + index * PADDING_RECORD_SIZE;
+    }
+
+    baseOffset(index: number): number {
+        return this.baseBase + index * BASE_RECORD_SIZE;
+    }
+
+    optimizationOffset(index: number): number {
+        return this.optimizationBase + index * OPTIMIZATION_RECORD_SIZE;
+    }
+
+    vptrOffset(index: number): number {
+        return this.vptrBase + index * VPTR_RECORD_SIZE;
+    }
+
+    slotOffset(index: number): number {
+        return this.slotBase + index * VTABLE_SLOT_RECORD_SIZE;
+    }
+
+    virtualBaseOffset(index: number): number {
+        return this.virtualBaseBase + index * VIRTUAL_BASE_RECORD_SIZE;
+    }
+}
+
+class MemberView implements MemberInfo {
+    constructor(private readonly reader: BinaryLayoutReader, private readonly at: number) {}
+
+    get offset() { return this.reader.f64(this.at); }
+    get size() { return this.reader.f64(this.at + 8); }
+    get alignment() { return this.reader.f64(this.at + 16); }
+    get nestedPadding() { return this.reader.f64(this.at + 24); }
+    get name() { return this.reader.string(this.reader.u32(this.at + 32)); }
+    get type() { return this.reader.string(this.reader.u32(this.at + 36)); }
+    get isBitfield() { return (this.reader.u32(this.at + 40) & 1) !== 0; }
+    get bitfieldWidth() { return this.reader.u32(this.at + 44); }
+    get bitfieldOffset() { return this.reader.u32(this.at + 48); }
+    get isThreadShared() { return (this.reader.u32(this.at + 40) & 2) !== 0; }
+    get isNoUniqueAddress() { return (this.reader.u32(this.at + 40) & 4) !== 0; }
+
+    get children(): MemberInfo[] {
+        const first = this.reader.u32(this.at + 52);
+        const count = this.reader.u32(this.at + 56);
+        return Array.from({ length: count }, (_, i) =>
+            new MemberView(this.reader, this.reader.memberOffset(first + i)));
+    }
+
+    get padding(): PaddingInfo[] {
+        const first = this.reader.u32(this.at + 60);
+        const count = this.reader.u32(this.at + 64);
+        return Array.from({ length: count }, (_, i) =>
+            new PaddingView(this.reader, this.reader.paddingOffset(first + i)));
+    }
+}
+
+class BaseView implements BaseInfo {
+    constructor(private readonly reader: BinaryLayoutReader, private readonly at: number) {}
+
+    get offset() { return this.reader.f64(this.at); }
+    get size() { return this.reader.f64(this.at + 8); }
+    get alignment() { return this.reader.f64(this.at + 16); }
+    get name() { return this.reader.string(this.reader.u32(this.at + 24)); }
+    get isVirtual() { return (this.reader.u32(this.at + 28) & 1) !== 0; }
+    get isEmpty() { return (this.reader.u32(this.at + 28) & 2) !== 0; }
+    get isPrimary() { return (this.reader.u32(this.at + 28) & 4) !== 0; }
+}
+
+class PaddingView implements PaddingInfo {
+    constructor(private readonly reader: BinaryLayoutReader, private readonly at: number) {}
+
+    get offset() { return this.reader.f64(this.at); }
+    get size() { return this.reader.f64(this.at + 8); }
+    get reason() { return this.reader.string(this.reader.u32(this.at + 16)); }
+}
+
+class OptimizationView implements Optimization {
+    constructor(private readonly reader: BinaryLayoutReader, private readonly at: number) {}
+
+    get bytesSaved() { return this.reader.f64(this.at); }
+    get linesPerAccessBefore() { return this.reader.f64(this.at + 8); }
+    get linesPerAccessAfter() { return this.reader.f64(this.at + 16); }
+    get bytesPerIterationBefore() { return this.reader.f64(this.at + 24); }
+    get bytesPerIterationAfter() { return this.reader.f64(this.at + 32); }
+    get kind() { return this.reader.string(this.reader.u32(this.at + 40)) as OptimizationKind; }
+    get description() { return this.reader.string(this.reader.u32(this.at + 44)); }
+    get membersMoved() { return this.reader.u32(this.at + 48); }
+    get suggestedOrder() {
+        return this.reader.stringList(this.reader.u32(this.at + 52), this.reader.u32(this.at + 56));
+    }
+    get coldMembers() {
+        return this.reader.stringList(this.reader.u32(this.at + 60), this.reader.u32(this.at + 64));
+    }
+    get contendedMembers() {
+        return this.reader.stringList(this.reader.u32(this.at + 68), this.reader.u32(this.at + 72));
+    }
+    get loopMembers() {
+        return this.reader.stringList(this.reader.u32(this.at + 76), this.reader.u32(this.at + 80));
+    }
+    get finalMethods() {
+        return this.reader.stringList(this.reader.u32(this.at + 84), this.reader.u32(this.at + 88));
+    }
+    get bitfieldMembers() {
+        return this.reader.stringList(this.reader.u32(this.at + 92), this.reader.u32(this.at + 96));
+    }
+    get bitfieldWidths() {
+        return this.reader.numberList(this.reader.u32(this.at + 100), this.reader.u32(this.at + 96));
+    }
+    get narrowedMembers() {
+        return this.reader.stringList(this.reader.u32(this.at + 104), this.reader.u32(this.at + 108));
+    }
+    get narrowedTypes() {
+        return this.reader.stringList(this.reader.u32(this.at + 112), this.reader.u32(this.at + 116));
+    }
+    get nestedMember() { return this.reader.string(this.reader.u32(this.at + 120)); }
+    get nestedType() { return this.reader.string(this.reader.u32(this.at + 124)); }
+}
+
+// vtables are small and rarely looked at, so they are decoded in one go
+function readVTable(reader: BinaryLayoutReader, at: number): VTableInfo {
+    const vptrs: VPointerInfo[] = [];
+    const firstVptr = reader.u32(at + 172);
+    const vptrCount = reader.u32(at + 176);
+    for (let i = 0; i < vptrCount; i++) {
+        const v = reader.vptrOffset(firstVptr + i);
+        const slots: VTableSlot[] = [];
+        const firstSlot = reader.u32(v + 12);
+        const slotCount = reader.u32(v + 16);
+        for (let j = 0; j < slotCount; j++) {
+            const s = reader.slotOffset(firstSlot + j);
+            const thunk = reader.string(reader.u32(s + 16));
+            slots.push({
+                index: reader.f64(s),
+                kind: reader.string(reader.u32(s + 8)) as VTableSlot['kind'],
+                name: reader.string(reader.u32(s + 12)),
+                ...(thunk ? { thunk } : {})
+            });
+        }
+        vptrs.push({ offset: reader.f64(v), subobject: reader.string(reader.u32(v + 8)), slots });
+    }
+
+    const virtualBases: VirtualBaseInfo[] = [];
+    const firstBase = reader.u32(at + 180);
+    const baseCount = reader.u32(at + 184);
+    for (let i = 0; i < baseCount; i++) {
+        const b = reader.virtualBaseOffset(firstBase + i);
+        virtualBases.push({
+            name: reader.string(reader.u32(b + 16)),
+            offset: reader.f64(b),
+            offsetSlot: reader.f64(b + 8)
+        });
+    }
+
+    const vbptrOffset = reader.f64(at + 32);
+    return {
+        pointerOffset: reader.f64(at + 24),
+        hasVirtualBase: (reader.u32(at + 136) & 4) !== 0,
+        virtualFunctions: reader.stringList(reader.u32(at + 164), reader.u32(at + 168)),
+        vptrs,
+        virtualBases,
+        ...(vbptrOffset >= 0 ? { vbptrOffset } : {})
+    };
+}
+
+class LayoutView implements StructLayout {
+    private memberCache?: MemberInfo[];
+    private paddingCache?: PaddingInfo[];
+    private baseCache?: BaseInfo[];
+    private optimizationCache?: Optimization[];
+    private vtableCache?: VTableInfo;
+
+    constructor(private readonly reader: BinaryLayoutReader, private readonly at: number) {}
+
+    get totalSize() { return this.reader.f64(this.at); }
+    get alignment() { return this.reader.f64(this.at + 8); }
+    get usefulSize() { return this.reader.f64(this.at + 16); }
+    get dataSize() { return this.reader.f64(this.at + 40); }
+    get nestedPadding() { return this.members.reduce((sum, m) => sum + m.nestedPadding, 0); }
+    get templatePaddingExcess() { return this.templateName ? this.reader.f64(this.at + 48) : undefined; }
+    get arrayStride(): ArrayStride {
+        const f64 = (offset: number) => this.reader.f64(this.at + offset);
+        return {
+            elementsPerLine: f64(56),
+            elementsPerPage: f64(64),
+            elementsPerHugePage: f64(72),
+            linesPerElement: f64(80),
+            lineStraddle: f64(88),
+            pageStraddle: f64(96),
+            hugePageStraddle: f64(104),
+            shrinkSize: f64(112),
+            alignedSize: f64(120)
+        };
+    }
+    get name() { return this.reader.string(this.reader.u32(this.at + 128)); }
+    get qualifiedName() { return this.reader.string(this.reader.u32(this.at + 132)); }
+    get isPolymorphic() { return (this.reader.u32(this.at + 136) & 1) !== 0; }
+    get isStandardLayout() { return (this.reader.u32(this.at + 136) & 2) !== 0; }
+    get templateName() { return this.reader.string(this.reader.u32(this.at + 196)) || undefined; }
+
+    get vtable(): VTableInfo {
+        return this.vtableCache ??= readVTable(this.reader, this.at);
+    }
+
+    get members(): MemberInfo[] {
+        return this.memberCache ??= this.range(140, (i) =>
+            new MemberView(this.reader, this.reader.memberOffset(i)));
+    }
+
+    get padding(): PaddingInfo[] {
+        return this.paddingCache ??= this.range(148, (i) =>
+            new PaddingView(this.reader, this.reader.paddingOffset(i)));
+    }
+
+    get bases(): BaseInfo[] {
+        return this.baseCache ??= this.range(188, (i) =>
+            new BaseView(this.reader, this.reader.baseOffset(i)));
+    }
+
+    get optimizations(): Optimization[] {
+        return this.optimizationCache ??= this.range(156, (i) =>
+            new OptimizationView(this.reader, this.reader.optimizationOffset(i)));
+    }
+
+    // Reads a (first, count) pair at `field` and builds one view per record
+    private range<T>(field: number, make: (index: number) => T): T[] {
+        const first = this.reader.u32(this.at + field);
+        const count = this.reader.u32(this.at + field + 4);
+        const items: T[] = new Array(count);
+        for (let i = 0; i < count; i++) {
+            items[i] = make(first + i);
+        }
+        return items;
+    }
+}
+
+// Turn a `layoutBuffer` from the native module into layouts. Only a
+// small view object is created per layout up front.
+export function decodeLayouts(buffer: ArrayBuffer): StructLayout[] {
+    const reader = new BinaryLayoutReader(buffer);
+    const layouts: StructLayout[] = new Array(reader.layoutCount);
+    for (let i = 0; i < reader.layoutCount; i++) {
+        layouts[i] = new LayoutView(reader, reader.layoutOffset(i));
+    }
+    return layouts;
+}
+
+interface NativeRequest {
+    sourceCode: string;
+    filePath: string;
+    structName?: string;
+    architecture: string;
+    compiler: string;
+    compileFlags?: string[];
+    templateInstantiations?: boolean;
+    profilePath?: string;
+    cacheLineSize?: number;
+    binary?: boolean;
+}
+
+interface NativeQueryOptions {
+    line?: number;
+    column?: number;
+    templateInstantiations?: boolean;
+    profilePath?: string;
+    cacheLineSize?: number;
+    stats?: boolean;
+}
+
+interface NativeAnalysisHandle {
+    promise: Promise<AnalysisResult>;
+    cancel(): void;
+}
+
+interface SessionUpdateResult {
+    success: boolean;
+    errorMessage: string;
+    cancelled: boolean;
+    reparsed: boolean;
+    version: number;
+}
+
+interface NativeSession {
+    update(request: NativeRequest, version: number): {
+        promise: Promise<SessionUpdateResult>;
+        cancel(): void;
+    };
+    query(structName: string, options?: NativeQueryOptions): NativeAnalysisHandle;
+    close(): void;
+}
+
+export interface ProjectScanResult {
+    success: boolean;
+    errorMessage: string;
+    cancelled: boolean;
+    filesScanned: number;
+    failedFiles: string[];
+    layouts: StructLayout[];
+}
+
+// A record or member as one target lays it out
+export interface TargetPlacement {
+    present: boolean;
+    offset?: number;    // Members only
+    bitOffset?: number; // Bitfields: first bit within the byte at offset
+    size: number;
+    alignment: number;
+}
+
+export interface MatrixRecord {
+    qualifiedName: string;
+    diverges: boolean;
+    targets: TargetPlacement[]; // By target index
+    members: {
+        name: string;
+        diverges: boolean;
+        targets: TargetPlacement[];
+    }[];
+}
+
+export interface TargetMatrixResult {
+    success: boolean;
+    errorMessage: string;
+    cancelled: boolean;
+    targets: string[];      // Normalized triples
+    targetErrors: string[]; // By target index; empty = analyzed
+    records: MatrixRecord[];
+}
+
+// How one container holds a record; sizes come from the file's own
+// libstdc++ headers when `measured`, otherwise from a model of them, and
+// heap blocks are rounded to glibc malloc chunks
+export interface ContainerFootprint {
+    container: string;             // 'std::vector', 'std::list', ...
+    nodeType: string;              // Type allocated per node or block; '' for vector and unique_ptr
+    objectSize: number;            // sizeof the container, or of the pointer (per element)
+    nodeSize: number;              // What one allocation holds
+    allocationSize: number;        // Its malloc chunk
+    elementsPerAllocation: number; // 0 = one buffer for all elements
+    projectedBytes: number;        // For elementCount elements
+    bytesPerElement: number;
+    measured: boolean;
 }
 
+export interface FootprintResult {
+    success: boolean;
+    errorMessage: string;
+    cancelled: boolean;
+    qualifiedName: string;
+    elementSize: number;
+    elementAlignment: number;
+    elementCount: number;
+    keyType: string;
+    containers: ContainerFootprint[];
+}
+
+// With `binary: true` the native side sends layoutBuffer instead of layouts
+type NativeProjectScanResult = Omit<ProjectScanResult, 'layouts'> & {
+    layouts?: StructLayout[];
+    layoutBuffer?: ArrayBuffer;
+};
+
 interface NativeModule {
-    analyze(request: {
-        sourceCode: string;
-        filePath: string;
-        structName?: string;
+    analyze(request: NativeRequest): AnalysisResult;
+    analyzeAsync(request: NativeRequest): NativeAnalysisHandle;
+    openSession(): NativeSession;
+    setCacheDirectory(directory: string): void;
+    scanProject(request: {
+        compileCommandsPath: string;
         architecture: string;
         compiler: string;
-        compileFlags?: string[];
-    }): AnalysisResult;
+        threadCount?: number;
+        templateInstantiations?: boolean;
+        profilePath?: string;
+        cacheLineSize?: number;
+        binary?: boolean;
+    }): { promise: Promise<NativeProjectScanResult>; cancel(): void };
+    analyzeTargets(request: NativeRequest & {
+        targets: string[];
+        threadCount?: number;
+    }): { promise: Promise<TargetMatrixResult>; cancel(): void };
+    estimateFootprint(request: NativeRequest & {
+        keyType?: string;
+        elementCount?: number;
+    }): { promise: Promise<FootprintResult>; cancel(): void };
 }
 
-export class Analyzer {
+export class Analyzer implements vscode.Disposable {
     private native: NativeModule | null = null;
     private cache: Map<string, AnalysisResult> = new Map();
 
-    constructor() {
+    // One native session per open document; holds its AST between edits
+    private sessions: Map<string, NativeSession> = new Map();
+
+    // storageDirectory holds the persistent layout cache, which outlives
+    // this window and is shared with every other one; timings are written
+    // to log when structsight.logTimings is on
+    constructor(
+        private readonly storageDirectory?: string,
+        private readonly log?: vscode.OutputChannel
+    ) {
         try {
             // Load native module
             this.native = require('structsight-native');
@@ -76,11 +705,28 @@ export class Analyzer {
             );
             console.error('Native module load error:', error);
         }
+
+        this.applyCacheSetting();
+    }
+
+    applyCacheSetting(): void {
+        if (!this.native || !this.storageDirectory) {
+            return;
+        }
+
+        const enabled = vscode.workspace
+            .getConfiguration('structsight')
+            .get<boolean>('persistentCache', true);
+        this.native.setCacheDirectory(
+            enabled ? path.join(this.storageDirectory, 'layout-cache') : ''
+        );
     }
 
     async analyze(
         document: vscode.TextDocument,
-        structName: string = ''
+        structName: string = '',
+        token?: vscode.CancellationToken,
+        position?: vscode.Position
     ): Promise<AnalysisResult> {
         if (!this.native) {
             return {
@@ -94,17 +740,31 @@ export class Analyzer {
         const config = vscode.workspace.getConfiguration('structsight');
         const architecture = config.get<string>('architecture', 'x64');
         const compiler = config.get<string>('compiler', 'clang');
+        const cacheLineSize = config.get<number>('cacheLineSize', 64);
+        const templateInstantiations = config.get<boolean>('templateInstantiations', false);
+        const logTimings = this.log !== undefined && config.get<boolean>('logTimings', false);
+        const profilePath = this.getProfilePath();
 
         // Create cache key
-        const cacheKey = `${document.uri.toString()}-${structName}-${architecture}-${compiler}`;
+        const target = position ? `${position.line}:${position.character}` : structName;
+        const cacheKey = `${document.uri.toString()}@${document.version}-${target}-${architecture}-${compiler}-${cacheLineSize}-${templateInstantiations}-${profilePath ?? ''}`;
 
         // Check cache
         if (this.cache.has(cacheKey)) {
             return this.cache.get(cacheKey)!;
         }
 
+        if (token?.isCancellationRequested) {
+            return {
+                success: false,
+                errorMessage: 'Analysis cancelled',
+                layouts: [],
+                cancelled: true
+            };
+        }
+
         // Prepare analysis request
-        const request = {
+        const request: NativeRequest = {
             sourceCode: document.getText(),
             filePath: document.uri.fsPath,
             structName,
@@ -113,8 +773,43 @@ export class Analyzer {
             compileFlags: this.getCompileFlags(document)
         };
 
+        let subscription: vscode.Disposable | undefined;
+        const start = Date.now();
+
         try {
-            const result = this.native.analyze(request);
+            // Reparses on a native worker thread only if the document version
+            // changed; hover, code actions and the webview share that parse
+            const session = this.getSession(document);
+            const update = session.update(request, document.version);
+            subscription = token?.onCancellationRequested(() => update.cancel());
+
+            const status = await update.promise;
+            if (!status.success) {
+                return {
+                    success: false,
+                    errorMessage: status.errorMessage,
+                    layouts: [],
+                    cancelled: status.cancelled
+                };
+            }
+
+            // A position pins the exact record; a bare name matches the first one found.
+            // Cancelling stops this query only, so later ones at the same version still run
+            subscription?.dispose();
+            const query = session.query(structName, {
+                ...(position ? { line: position.line + 1, column: position.character + 1 } : {}),
+                templateInstantiations,
+                profilePath,
+                cacheLineSize,
+                stats: logTimings
+            });
+            subscription = token?.onCancellationRequested(() => query.cancel());
+            const result = await query.promise;
+
+            if (result.stats) {
+                this.logStats(document, position ? `${position.line + 1}:${position.character + 1}` : structName,
+                    result.stats, Date.now() - start);
+            }
 
             // Cache successful results
             if (result.success) {
@@ -133,7 +828,45 @@ export class Analyzer {
                 errorMessage: `Analysis failed: ${errorMsg}`,
                 layouts: []
             };
+        } finally {
+            subscription?.dispose();
+        }
+    }
+
+    // One line per analysis; `elapsedMs` is what the caller waited, so the
+    // gap to totalMs + conversionMs is time spent queued or in the session update
+    private logStats(document: vscode.TextDocument, target: string, stats: AnalysisStats, elapsedMs: number): void {
+        const ms = (value: number) => value.toFixed(1);
+        const phases = stats.layoutCacheHit
+            ? 'layout cache hit'
+            : [
+                stats.astReused
+                    ? 'AST reused'
+                    : `preamble ${ms(stats.preambleMs)}${stats.preambleReused ? ' (reused)' : ''}, parse ${ms(stats.parseMs)}`,
+                `traversal ${ms(stats.traversalMs)}`,
+                `layout ${ms(stats.layoutMs)}`,
+                `accesses ${ms(stats.accessMs)}`
+            ].join(', ');
+
+        this.log!.appendLine(
+            `[timing] ${path.basename(document.uri.fsPath)} ${target || '*'}: ` +
+            `${ms(elapsedMs)} ms (native ${ms(stats.totalMs)}, conversion ${ms(stats.conversionMs)}; ${phases}); ` +
+            `${stats.recordsReported}/${stats.recordsVisited} records` +
+            (stats.astBytes > 0 ? `, AST ${(stats.astBytes / (1024 * 1024)).toFixed(1)} MB` : '')
+        );
+    }
+
+    // Field access profile for hot/cold split suggestions; relative paths
+    // are taken from the first workspace folder
+    private getProfilePath(): string | undefined {
+        const setting = vscode.workspace
+            .getConfiguration('structsight')
+            .get<string>('profilePath', '');
+        if (!setting) {
+            return undefined;
         }
+        const folder = vscode.workspace.workspaceFolders?.[0];
+        return folder ? path.resolve(folder.uri.fsPath, setting) : setting;
     }
 
     private getCompileFlags(document: vscode.TextDocument): string[] {
@@ -152,7 +885,151 @@ export class Analyzer {
         return flags;
     }
 
+    async scanProject(
+        compileCommandsPath: string,
+        token?: vscode.CancellationToken
+    ): Promise<ProjectScanResult> {
+        if (!this.native) {
+            return {
+                success: false,
+                errorMessage: 'Native module not loaded',
+                cancelled: false,
+                filesScanned: 0,
+                failedFiles: [],
+                layouts: []
+            };
+        }
+
+        const config = vscode.workspace.getConfiguration('structsight');
+
+        // Every TU in the database is analyzed in parallel on the native side.
+        // Scans return thousands of layouts, so they come back as one buffer.
+        const handle = this.native.scanProject({
+            compileCommandsPath,
+            architecture: config.get<string>('architecture', 'x64'),
+            compiler: config.get<string>('compiler', 'clang'),
+            templateInstantiations: config.get<boolean>('templateInstantiations', false),
+            profilePath: this.getProfilePath(),
+            cacheLineSize: config.get<number>('cacheLineSize', 64),
+            binary: true
+        });
+        const subscription = token?.onCancellationRequested(() => handle.cancel());
+
+        try {
+            const { layoutBuffer, layouts, ...rest } = await handle.promise;
+            return {
+                ...rest,
+                layouts: layoutBuffer ? decodeLayouts(layoutBuffer) : layouts ?? []
+            };
+        } finally {
+            subscription?.dispose();
+        }
+    }
+
+    // Lay the document out for every triple in structsight.targets at once
+    async analyzeTargets(
+        document: vscode.TextDocument,
+        structName: string = '',
+        token?: vscode.CancellationToken
+    ): Promise<TargetMatrixResult> {
+        const config = vscode.workspace.getConfiguration('structsight');
+        const targets = config.get<string[]>('targets', []);
+        if (!this.native || targets.length === 0) {
+            return {
+                success: false,
+                errorMessage: this.native ? 'No targets configured (structsight.targets)' : 'Native module not loaded',
+                cancelled: false,
+                targets,
+                targetErrors: [],
+                records: []
+            };
+        }
+
+        const handle = this.native.analyzeTargets({
+            sourceCode: document.getText(),
+            filePath: document.uri.fsPath,
+            structName,
+            architecture: config.get<string>('architecture', 'x64'),
+            compiler: config.get<string>('compiler', 'clang'),
+            compileFlags: this.getCompileFlags(document),
+            templateInstantiations: config.get<boolean>('templateInstantiations', false),
+            cacheLineSize: config.get<number>('cacheLineSize', 64),
+            targets
+        });
+        const subscription = token?.onCancellationRequested(() => handle.cancel());
+
+        try {
+            return await handle.promise;
+        } finally {
+            subscription?.dispose();
+        }
+    }
+
+    // Per-element footprint of one record in the standard containers
+    async estimateFootprint(
+        document: vscode.TextDocument,
+        structName: string,
+        token?: vscode.CancellationToken
+    ): Promise<FootprintResult> {
+        const config = vscode.workspace.getConfiguration('structsight');
+        if (!this.native) {
+            return {
+                success: false,
+                errorMessage: 'Native module not loaded',
+                cancelled: false,
+                qualifiedName: '',
+                elementSize: 0,
+                elementAlignment: 0,
+                elementCount: 0,
+                keyType: '',
+                containers: []
+            };
+        }
+
+        const handle = this.native.estimateFootprint({
+            sourceCode: document.getText(),
+            filePath: document.uri.fsPath,
+            structName,
+            architecture: config.get<string>('architecture', 'x64'),
+            compiler: config.get<string>('compiler', 'clang'),
+            compileFlags: this.getCompileFlags(document),
+            keyType: config.get<string>('footprintKeyType', 'std::size_t'),
+            elementCount: config.get<number>('footprintElementCount', 1000)
+        });
+        const subscription = token?.onCancellationRequested(() => handle.cancel());
+
+        try {
+            return await handle.promise;
+        } finally {
+            subscription?.dispose();
+        }
+    }
+
+    private getSession(document: vscode.TextDocument): NativeSession {
+        const key = document.uri.toString();
+        let session = this.sessions.get(key);
+        if (!session) {
+            session = this.native!.openSession();
+            this.sessions.set(key, session);
+        }
+        return session;
+    }
+
+    closeDocument(document: vscode.TextDocument): void {
+        const key = document.uri.toString();
+        this.sessions.get(key)?.close();
+        this.sessions.delete(key);
+    }
+
     clearCache(): void {
         this.cache.clear();
     }
+
+    dispose(): void {
+        for (const session of this.sessions.values()) {
+            session.close();
+        }
+        this.sessions.clear();
+        this.cache.clear();
+    }
 }
@@ -2,12 +2,30 @@ import * as vscode from 'vscode';
 import { HoverProvider } from './hoverProvider';
 import { WebviewProvider } from './webviewProvider';
 import { RefactoringProvider } from './refactoring';
+import { Analyzer, FootprintResult, ProjectScanResult, StructLayout, TargetMatrixResult, TargetPlacement } from './analyzer';
 
 export function activate(context: vscode.ExtensionContext) {
     console.log('StructSight extension is now active');
 
+    const outputChannel = vscode.window.createOutputChannel('StructSight');
+    context.subscriptions.push(outputChannel);
+
+    // Shared by all providers so they reuse one parse per document version
+    const analyzer = new Analyzer(context.globalStorageUri.fsPath, outputChannel);
+    context.subscriptions.push(analyzer);
+    context.subscriptions.push(
+        vscode.workspace.onDidCloseTextDocument(document => analyzer.closeDocument(document))
+    );
+    context.subscriptions.push(
+        vscode.workspace.onDidChangeConfiguration(event => {
+            if (event.affectsConfiguration('structsight.persistentCache')) {
+                analyzer.applyCacheSetting();
+            }
+        })
+    );
+
     // Register hover provider for C/C++ files
-    const hoverProvider = new HoverProvider(context);
+    const hoverProvider = new HoverProvider(context, analyzer);
     context.subscriptions.push(
         vscode.languages.registerHoverProvider(
             ['cpp', 'c'],
@@ -16,7 +34,7 @@ export function activate(context: vscode.ExtensionContext) {
     );
 
     // Register webview provider
-    const webviewProvider = new WebviewProvider(context);
+    const webviewProvider = new WebviewProvider(context, analyzer);
 
     // Register commands
     context.subscriptions.push(
@@ -54,8 +72,108 @@ export function activate(context: vscode.ExtensionContext) {
         })
     );
 
+    context.subscriptions.push(
+        vscode.commands.registerCommand('structsight.scanProject', async () => {
+            const compileCommands = await findCompileCommands();
+            if (!compileCommands) {
+                vscode.window.showErrorMessage('No compile_commands.json found in the workspace');
+                return;
+            }
+
+            await vscode.window.withProgress(
+                {
+                    location: vscode.ProgressLocation.Notification,
+                    title: 'StructSight: Scanning project layouts',
+                    cancellable: true
+                },
+                async (_progress, token) => {
+                    const result = await analyzer.scanProject(compileCommands, token);
+                    if (!result.success) {
+                        if (!result.cancelled) {
+                            vscode.window.showErrorMessage(`Project scan failed: ${result.errorMessage}`);
+                        }
+                        return;
+                    }
+                    reportProjectScan(outputChannel, result);
+                }
+            );
+        })
+    );
+
+    context.subscriptions.push(
+        vscode.commands.registerCommand('structsight.compareTargets', async () => {
+            const editor = vscode.window.activeTextEditor;
+            if (!editor) {
+                vscode.window.showErrorMessage('No active editor');
+                return;
+            }
+
+            // The selected or hovered-over record, or every record in the file
+            const selection = editor.selection;
+            const structName = editor.document.getText(selection) ||
+                getWordAtPosition(editor.document, selection.active);
+
+            await vscode.window.withProgress(
+                {
+                    location: vscode.ProgressLocation.Notification,
+                    title: 'StructSight: Comparing layouts across targets',
+                    cancellable: true
+                },
+                async (_progress, token) => {
+                    let result = await analyzer.analyzeTargets(editor.document, structName, token);
+                    if (result.success && result.records.length === 0 && structName) {
+                        result = await analyzer.analyzeTargets(editor.document, '', token);
+                    }
+                    if (!result.success) {
+                        if (!result.cancelled) {
+                            vscode.window.showErrorMessage(`Target comparison failed: ${result.errorMessage}`);
+                        }
+                        return;
+                    }
+                    reportTargetMatrix(outputChannel, result);
+                }
+            );
+        })
+    );
+
+    context.subscriptions.push(
+        vscode.commands.registerCommand('structsight.estimateFootprint', async () => {
+            const editor = vscode.window.activeTextEditor;
+            if (!editor) {
+                vscode.window.showErrorMessage('No active editor');
+                return;
+            }
+
+            const selection = editor.selection;
+            const structName = editor.document.getText(selection) ||
+                getWordAtPosition(editor.document, selection.active);
+            if (!structName) {
+                vscode.window.showErrorMessage('Select or place the cursor on a struct name');
+                return;
+            }
+
+            await vscode.window.withProgress(
+                {
+                    location: vscode.ProgressLocation.Notification,
+                    title: `StructSight: Estimating container footprint of ${structName}`,
+                    cancellable: true
+                },
+                async (_progress, token) => {
+                    const result = await analyzer.estimateFootprint(editor.document, structName, token);
+                    if (!result.success) {
+                        if (!result.cancelled) {
+                            vscode.window.showErrorMessage(`Footprint estimate failed: ${result.errorMessage}`);
+                        }
+                        return;
+                    }
+                    reportFootprint(outputChannel, result);
+                }
+            );
+        })
+    );
+
     // Register refactoring provider
-    const refactoringProvider = new RefactoringProvider();
+    const refactoringProvider = new RefactoringProvider(analyzer);
     context.subscriptions.push(
         vscode.languages.registerCodeActionsProvider(
             ['cpp', 'c'],
@@ -67,6 +185,145 @@ export function activate(context: vscode.ExtensionContext) {
     );
 }
 
+async function findCompileCommands(): Promise<string | undefined> {
+    const configured = vscode.workspace
+        .getConfiguration('structsight')
+        .get<string>('compileCommandsPath', '');
+    if (configured) {
+        return configured;
+    }
+
+    const found = await vscode.workspace.findFiles('**/compile_commands.json', '**/node_modules/**', 1);
+    return found.length > 0 ? found[0].fsPath : undefined;
+}
+
+function reportProjectScan(channel: vscode.OutputChannel, result: ProjectScanResult): void {
+    const paddingOf = (layout: StructLayout) =>
+        layout.padding.reduce((sum, p) => sum + p.size, 0);
+
+    // Worst offenders first; template instantiations are listed by template below
+    const layouts = result.layouts
+        .filter(layout => !layout.templateName)
+        .sort((a, b) => paddingOf(b) - paddingOf(a));
+    const instantiations = new Map<string, StructLayout[]>();
+    for (const layout of result.layouts) {
+        if (layout.templateName) {
+            const group = instantiations.get(layout.templateName) ?? [];
+            group.push(layout);
+            instantiations.set(layout.templateName, group);
+        }
+    }
+
+    channel.clear();
+    channel.appendLine(
+        `Scanned ${result.filesScanned} translation units, ${result.layouts.length} records` +
+        (result.failedFiles.length > 0 ? `, ${result.failedFiles.length} failed` : '')
+    );
+    channel.appendLine('');
+    channel.appendLine('padding  size  record');
+
+    for (const layout of layouts) {
+        channel.appendLine(
+            `${paddingOf(layout).toString().padStart(7)}  ${layout.totalSize.toString().padStart(4)}  ${layout.qualifiedName}`
+        );
+    }
+
+    for (const [templateName, group] of instantiations) {
+        channel.appendLine('');
+        channel.appendLine(`template ${templateName} (${group.length} instantiations)`);
+        group.sort((a, b) => paddingOf(b) - paddingOf(a));
+        for (const layout of group) {
+            const excess = layout.templatePaddingExcess ? `  +${layout.templatePaddingExcess} padding` : '';
+            channel.appendLine(
+                `${paddingOf(layout).toString().padStart(7)}  ${layout.totalSize.toString().padStart(4)}  ${layout.qualifiedName}${excess}`
+            );
+        }
+    }
+
+    for (const file of result.failedFiles) {
+        channel.appendLine(`failed: ${file}`);
+    }
+
+    channel.show(true);
+}
+
+function reportTargetMatrix(channel: vscode.OutputChannel, result: TargetMatrixResult): void {
+    const divergent = result.records.filter(record => record.diverges).length;
+    const column = 14;
+    const nameWidth = Math.max(
+        24,
+        ...result.records.map(record => record.qualifiedName.length + 2),
+        ...result.records.flatMap(record => record.members.map(member => member.name.length + 4))
+    );
+    const cells = (placements: TargetPlacement[], format: (placement: TargetPlacement) => string) =>
+        placements.map(placement => (placement.present ? format(placement) : '-').padStart(column)).join('');
+    const memberCell = (placement: TargetPlacement) =>
+        `${placement.offset}${placement.bitOffset ? `.${placement.bitOffset}` : ''}:${placement.size}`;
+
+    channel.clear();
+    channel.appendLine(`${result.records.length} records across ${result.targets.length} targets, ${divergent} differ`);
+    result.targets.forEach((target, index) => {
+        const error = result.targetErrors[index];
+        channel.appendLine(`  [${index}] ${target}${error ? `  failed: ${error}` : ''}`);
+    });
+    channel.appendLine('');
+    channel.appendLine(
+        'record / member (size/align, offset:size)'.padEnd(nameWidth) +
+        result.targets.map((_, index) => `[${index}]`.padStart(column)).join('')
+    );
+
+    // Records that differ first; ≠ marks what differs
+    const records = [...result.records].sort((a, b) => Number(b.diverges) - Number(a.diverges));
+    for (const record of records) {
+        channel.appendLine(
+            `${record.diverges ? '≠ ' : '  '}${record.qualifiedName}`.padEnd(nameWidth) +
+            cells(record.targets, placement => `${placement.size}/${placement.alignment}`)
+        );
+        for (const member of record.members) {
+            channel.appendLine(
+                `  ${member.diverges ? '≠ ' : '  '}${member.name || '(unnamed)'}`.padEnd(nameWidth) +
+                cells(member.targets, memberCell)
+            );
+        }
+    }
+
+    channel.show(true);
+}
+
+function reportFootprint(channel: vscode.OutputChannel, result: FootprintResult): void {
+    const nameWidth = Math.max(32, ...result.containers.map(footprint => footprint.container.length + 2));
+    const formatBytes = (bytes: number) =>
+        bytes >= 1 << 20 ? `${(bytes / (1 << 20)).toFixed(1)} MiB` :
+        bytes >= 1 << 10 ? `${(bytes / (1 << 10)).toFixed(1)} KiB` : `${bytes} B`;
+
+    channel.clear();
+    channel.appendLine(
+        `${result.qualifiedName}: ${result.elementSize} bytes, align ${result.elementAlignment}; ` +
+        `${result.elementCount} elements, map keys ${result.keyType}`
+    );
+    channel.appendLine('');
+    channel.appendLine(
+        'container'.padEnd(nameWidth) + 'node'.padStart(8) + 'malloc'.padStart(8) +
+        'per element'.padStart(14) + 'projected'.padStart(14)
+    );
+
+    // Cheapest first; * marks sizes modeled rather than read from the headers
+    const containers = [...result.containers].sort((a, b) => a.projectedBytes - b.projectedBytes);
+    for (const footprint of containers) {
+        channel.appendLine(
+            `${footprint.measured ? '  ' : '* '}${footprint.container}`.padEnd(nameWidth) +
+            String(footprint.nodeSize).padStart(8) + String(footprint.allocationSize).padStart(8) +
+            footprint.bytesPerElement.toFixed(1).padStart(14) + formatBytes(footprint.projectedBytes).padStart(14)
+        );
+    }
+    if (containers.some(footprint => !footprint.measured)) {
+        channel.appendLine('');
+        channel.appendLine('* modeled on libstdc++ (the file\'s headers could not be probed)');
+    }
+
+    channel.show(true);
+}
+
 function getWordAtPosition(document: vscode.TextDocument, position: vscode.Position): string {
     const range = document.getWordRangeAtPosition(position);
     return range ? document.getText(range) : '';
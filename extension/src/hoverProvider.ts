@@ -4,8 +4,8 @@ import { Analyzer } from './analyzer';
 export class HoverProvider implements vscode.HoverProvider {
     private analyzer: Analyzer;
 
-    constructor(context: vscode.ExtensionContext) {
-        this.analyzer = new Analyzer();
+    constructor(context: vscode.ExtensionContext, analyzer: Analyzer) {
+        this.analyzer = analyzer;
     }
 
     async provideHover(
@@ -37,9 +37,9 @@ export class HoverProvider implements vscode.HoverProvider {
 
         try {
             // Analyze the struct
-            const result = await this.analyzer.analyze(document, word);
+            const result = await this.analyzer.analyze(document, word, token, range.start);
 
-            if (!result.success || result.layouts.length === 0) {
+            if (token.isCancellationRequested || !result.success || result.layouts.length === 0) {
                 return undefined;
             }
 
@@ -53,15 +53,36 @@ export class HoverProvider implements vscode.HoverProvider {
             markdown.appendMarkdown(`**Size:** ${layout.totalSize} bytes  \n`);
             markdown.appendMarkdown(`**Alignment:** ${layout.alignment} bytes  \n`);
 
-            if (layout.padding.length > 0) {
+            const nestedPadding = layout.nestedPadding ?? 0;
+            if (layout.padding.length > 0 || nestedPadding > 0) {
                 const totalPadding = layout.padding.reduce((sum, p) => sum + p.size, 0);
-                markdown.appendMarkdown(`**Padding:** ${totalPadding} bytes (${((totalPadding / layout.totalSize) * 100).toFixed(1)}%)  \n`);
+                const nested = nestedPadding > 0 ? ` (${totalPadding + nestedPadding} including nested members)` : '';
+                markdown.appendMarkdown(`**Padding:** ${totalPadding} bytes (${((totalPadding / layout.totalSize) * 100).toFixed(1)}%)${nested}  \n`);
             }
 
             if (layout.isPolymorphic) {
                 markdown.appendMarkdown(`**Polymorphic:** Yes (has vtable)  \n`);
             }
 
+            // Only records big enough to be looked up one at a time get this
+            const stride = layout.arrayStride;
+            if (stride && layout.optimizations.some(o => o.kind === 'arrayStride')) {
+                markdown.appendMarkdown(
+                    `**In arrays:** ${stride.linesPerElement.toFixed(2)} cache lines per element, ` +
+                    `${(stride.lineStraddle * 100).toFixed(0)}% straddle a line  \n`
+                );
+            }
+
+            // Hovering a class template lists every instantiation found
+            const instantiations = result.layouts.filter(l => l.templateName && l.templateName === layout.templateName);
+            if (instantiations.length > 1) {
+                markdown.appendMarkdown(`\n**Instantiations of ${layout.templateName}:**  \n`);
+                for (const l of instantiations) {
+                    const excess = l.templatePaddingExcess ? ` ⚠️ +${l.templatePaddingExcess} bytes padding` : '';
+                    markdown.appendMarkdown(`- \`${l.name}\`: ${l.totalSize} bytes${excess}  \n`);
+                }
+            }
+
             // Show optimization hints
             if (layout.optimizations.length > 0) {
                 const opt = layout.optimizations[0];
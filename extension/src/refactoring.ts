@@ -8,8 +8,8 @@ export class RefactoringProvider implements vscode.CodeActionProvider {
 
     private analyzer: Analyzer;
 
-    constructor() {
-        this.analyzer = new Analyzer();
+    constructor(analyzer: Analyzer) {
+        this.analyzer = analyzer;
     }
 
     async provideCodeActions(
@@ -35,24 +35,97 @@ export class RefactoringProvider implements vscode.CodeActionProvider {
         }
 
         try {
-            const result = await this.analyzer.analyze(document, word);
+            const result = await this.analyzer.analyze(document, word, token, wordRange.start);
 
-            if (!result.success || result.layouts.length === 0) {
+            if (token.isCancellationRequested || !result.success || result.layouts.length === 0) {
                 return actions;
             }
 
             const layout = result.layouts[0];
 
+            // An edit would land in the template and change every instantiation
+            if (layout.templateName) {
+                return actions;
+            }
+
             // Create code actions for each optimization
             for (const opt of layout.optimizations) {
-                if (opt.suggestedOrder.length > 0 && opt.bytesSaved > 0) {
+                if (opt.kind === 'coAccess') {
                     const action = new vscode.CodeAction(
-                        `Reorder members to save ${opt.bytesSaved} bytes`,
+                        'Reorder members to keep fields used together on one cache line',
                         vscode.CodeActionKind.RefactorRewrite
                     );
 
                     action.edit = await this.createReorderEdit(document, layout, opt);
-                    action.isPreferred = opt.confidence > 0.9;
+
+                    actions.push(action);
+                } else if (opt.kind === 'packFlags' && opt.bitfieldMembers?.length) {
+                    const action = new vscode.CodeAction(
+                        `Pack ${opt.bitfieldMembers.length} flags into bitfields (save ${opt.bytesSaved} bytes)`,
+                        vscode.CodeActionKind.RefactorRewrite
+                    );
+
+                    action.edit = await this.createReorderEdit(document, layout, opt);
+
+                    actions.push(action);
+                } else if (opt.kind === 'nestedReorder' && opt.nestedType) {
+                    // The edit goes to the nested record's own definition
+                    const nestedName = opt.nestedType.split('::').pop() ?? opt.nestedType;
+                    const action = new vscode.CodeAction(
+                        `Reorder ${nestedName}'s members to save ${opt.bytesSaved} bytes in ${layout.name}`,
+                        vscode.CodeActionKind.RefactorRewrite
+                    );
+
+                    action.edit = await this.createReorderEdit(document, { ...layout, name: nestedName }, opt);
+
+                    actions.push(action);
+                } else if (opt.kind === 'narrowTypes') {
+                    // Type changes reach beyond the struct (an enum's other
+                    // users, the code storing into the members); the webview
+                    // lists them instead
+                    continue;
+                } else if (opt.suggestedOrder.length > 0 && (opt.bytesSaved > 0 || opt.kind === 'reorder')) {
+                    // A reorder that saves nothing still shrinks the data size
+                    // derived classes build on
+                    const action = new vscode.CodeAction(
+                        opt.bytesSaved > 0
+                            ? `Reorder members to save ${opt.bytesSaved} bytes`
+                            : `Reorder members to free tail padding for derived classes`,
+                        vscode.CodeActionKind.RefactorRewrite
+                    );
+
+                    action.edit = await this.createReorderEdit(document, layout, opt);
+                    action.isPreferred = opt.kind === 'reorder';
+
+                    actions.push(action);
+                } else if (opt.kind === 'aosToSoa') {
+                    const action = new vscode.CodeAction(
+                        `Generate structure-of-arrays form (${layout.name}SoA)`,
+                        vscode.CodeActionKind.RefactorRewrite
+                    );
+
+                    action.edit = this.createSoaEdit(document, layout);
+
+                    actions.push(action);
+                } else if (opt.kind === 'falseSharing' && opt.contendedMembers?.length) {
+                    const action = new vscode.CodeAction(
+                        `Align ${opt.contendedMembers.join(', ')} to cache lines`,
+                        vscode.CodeActionKind.RefactorRewrite
+                    );
+
+                    action.edit = this.createAlignEdit(document, layout, opt.contendedMembers);
+
+                    actions.push(action);
+                } else if (opt.kind === 'devirtualize') {
+                    const methods = opt.finalMethods ?? [];
+                    const action = new vscode.CodeAction(
+                        methods.length > 0
+                            ? `Mark ${methods.join(', ')} final`
+                            : `Mark ${layout.name} final`,
+                        vscode.CodeActionKind.RefactorRewrite
+                    );
+
+                    action.edit = this.createFinalEdit(document, layout, methods);
 
                     actions.push(action);
                 }
@@ -65,6 +138,194 @@ export class RefactoringProvider implements vscode.CodeActionProvider {
         return actions;
     }
 
+    // Insert `<Name>SoA` after the struct: one std::vector per member, plus
+    // size() and resize() so loops can be moved over member by member
+    private createSoaEdit(
+        document: vscode.TextDocument,
+        layout: StructLayout
+    ): vscode.WorkspaceEdit {
+        const edit = new vscode.WorkspaceEdit();
+
+        const text = document.getText();
+        const structRegex = new RegExp(
+            `(struct|class)\\s+${layout.name}\\s*\\{([^}]+)\\};?`,
+            'gs'
+        );
+
+        const match = structRegex.exec(text);
+        const members = layout.members.filter(m => m.name.length > 0);
+        if (!match || members.length === 0) {
+            return edit;
+        }
+
+        // C arrays can't be vector elements; std::array can
+        const elementType = (type: string) => {
+            const array = /^(.*?)\s*\[(\d+)\]$/.exec(type);
+            return array ? `std::array<${array[1]}, ${array[2]}>` : type;
+        };
+
+        const name = `${layout.name}SoA`;
+        const first = members[0].name;
+        const lines = [
+            '',
+            '',
+            `// Structure-of-arrays form of ${layout.name}: element i is made of`,
+            `// ${members.map(m => `${m.name}[i]`).join(', ')}`,
+            `struct ${name} {`,
+            ...members.map(m => `    std::vector<${elementType(m.type)}> ${m.name};`),
+            '',
+            `    std::size_t size() const { return ${first}.size(); }`,
+            '',
+            '    void resize(std::size_t count) {',
+            ...members.map(m => `        ${m.name}.resize(count);`),
+            '    }',
+            '};'
+        ];
+
+        const end = document.positionAt(match.index + match[0].length);
+        edit.insert(document.uri, end, lines.join('\n'));
+
+        return edit;
+    }
+
+    // Add `final` after the class name, or after each method's parameter
+    // list and cv/ref/noexcept qualifiers. Methods are signatures such as
+    // "draw(int) const", so only the overload they name is marked.
+    private createFinalEdit(
+        document: vscode.TextDocument,
+        layout: StructLayout,
+        methods: string[]
+    ): vscode.WorkspaceEdit {
+        const edit = new vscode.WorkspaceEdit();
+
+        const text = document.getText();
+        const headRegex = new RegExp(`\\b(struct|class)\\s+${layout.name}\\b(?=\\s*[:{])`, 'g');
+        const head = headRegex.exec(text);
+        if (!head) {
+            return edit;
+        }
+
+        const headEnd = head.index + head[0].length;
+        if (methods.length === 0) {
+            edit.insert(document.uri, document.positionAt(headEnd), ' final');
+            return edit;
+        }
+
+        for (const method of methods) {
+            const signature = /^([~\w]+)\((.*)\)((?:\s*(?:const|volatile|&&|&))*)$/.exec(method);
+            if (!signature) {
+                continue;
+            }
+            const [, name, parameters, qualifiers] = signature;
+            const methodRegex = new RegExp(
+                `\\b${name}\\s*\\(((?:[^()]|\\([^()]*\\))*)\\)` +
+                '((?:\\s*(?:const|volatile|&&|&|noexcept(?:\\([^)]*\\))?))*)',
+                'g'
+            );
+            methodRegex.lastIndex = headEnd;
+            let match: RegExpExecArray | null;
+            while ((match = methodRegex.exec(text)) !== null) {
+                if (this.sameParameters(match[1], parameters) &&
+                    this.sameQualifiers(match[2], qualifiers)) {
+                    break;
+                }
+            }
+            if (!match || /^\s*(override\s+)?final\b/.test(text.slice(methodRegex.lastIndex))) {
+                continue;
+            }
+            edit.insert(document.uri, document.positionAt(methodRegex.lastIndex), ' final');
+        }
+
+        return edit;
+    }
+
+    // Whether a declaration's parameter list has the types Clang printed:
+    // each declared parameter, spaces removed, is the type followed by
+    // nothing, a name, or a name and a default argument
+    private sameParameters(declared: string, types: string): boolean {
+        const split = (list: string) => {
+            const parts: string[] = [];
+            let depth = 0;
+            let current = '';
+            for (const ch of list) {
+                if (ch === ',' && depth === 0) {
+                    parts.push(current);
+                    current = '';
+                    continue;
+                }
+                depth += '<(['.includes(ch) ? 1 : ')>]'.includes(ch) ? -1 : 0;
+                current += ch;
+            }
+            parts.push(current);
+            return parts.map(part => part.replace(/\s+/g, '')).filter(part => part.length > 0);
+        };
+
+        const wanted = split(types).filter(type => type !== 'void');
+        const found = split(declared.replace(/=[^,]*/g, '')).filter(type => type !== 'void');
+        if (wanted.length !== found.length) {
+            return false;
+        }
+        return wanted.every((type, i) => {
+            if (!found[i].startsWith(type)) {
+                return false;
+            }
+            const rest = found[i].slice(type.length);
+            return rest === '' || (/^[A-Za-z_]\w*$/.test(rest) &&
+                !['int', 'long', 'short', 'char', 'double', 'const', 'volatile'].includes(rest));
+        });
+    }
+
+    private sameQualifiers(declared: string, wanted: string): boolean {
+        const normalize = (qualifiers: string) => qualifiers
+            .replace(/noexcept(\([^)]*\))?/g, '')
+            .split(/\s+|(?=&)/)
+            .filter(q => q.length > 0)
+            .sort()
+            .join(' ');
+        return normalize(declared) === normalize(wanted);
+    }
+
+    // Put alignas(<cache line size>) in front of each member's declaration.
+    // The literal size is used rather than
+    // std::hardware_destructive_interference_size, whose value is fixed
+    // per compiler and which GCC warns about using in headers.
+    private createAlignEdit(
+        document: vscode.TextDocument,
+        layout: StructLayout,
+        members: string[]
+    ): vscode.WorkspaceEdit {
+        const edit = new vscode.WorkspaceEdit();
+
+        const text = document.getText();
+        const structRegex = new RegExp(
+            `(struct|class)\\s+${layout.name}\\s*\\{([^}]+)\\}`,
+            'gs'
+        );
+
+        const match = structRegex.exec(text);
+        if (!match) {
+            return edit;
+        }
+
+        const bodyText = match[2];
+        const bodyStart = match.index + match[0].length - bodyText.length - 1;
+        const lineSize = vscode.workspace
+            .getConfiguration('structsight')
+            .get<number>('cacheLineSize', 64);
+
+        for (const memberName of members) {
+            const memberRegex = new RegExp(`^([ \\t]*)[^;\\n]*\\b${memberName}\\b[^;\\n]*;`, 'm');
+            const memberMatch = memberRegex.exec(bodyText);
+            if (!memberMatch || memberMatch[0].includes('alignas')) {
+                continue;
+            }
+            const position = document.positionAt(bodyStart + memberMatch.index + memberMatch[1].length);
+            edit.insert(document.uri, position, `alignas(${lineSize}) `);
+        }
+
+        return edit;
+    }
+
     private async createReorderEdit(
         document: vscode.TextDocument,
         layout: StructLayout,
@@ -87,9 +348,9 @@ export class RefactoringProvider implements vscode.CodeActionProvider {
         const bodyText = match[2];
         const bodyStart = match.index + match[1].length + layout.name.length + 2;
 
-        // Extract member declarations
+        // Extract member declarations, bitfields included
         const memberLines = new Map<string, string>();
-        const memberRegex = /^\s*(.+?\s+)(\w+)\s*;/gm;
+        const memberRegex = /^\s*(.+?\s+)(\w+)\s*(:\s*\d+\s*)?;/gm;
 
         let memberMatch;
         while ((memberMatch = memberRegex.exec(bodyText)) !== null) {
@@ -98,6 +359,16 @@ export class RefactoringProvider implements vscode.CodeActionProvider {
             memberLines.set(memberName, fullLine);
         }
 
+        // packFlags: declare the listed members with their bit widths
+        const bitfieldMembers = optimization.bitfieldMembers ?? [];
+        const bitfieldWidths = optimization.bitfieldWidths ?? [];
+        bitfieldMembers.forEach((memberName, i) => {
+            const line = memberLines.get(memberName);
+            if (line && i < bitfieldWidths.length) {
+                memberLines.set(memberName, line.replace(/\s*;$/, ` : ${bitfieldWidths[i]};`));
+            }
+        });
+
         // Build new body with reordered members
         const reorderedLines: string[] = [];
         for (const memberName of optimization.suggestedOrder) {
@@ -1,13 +1,13 @@
 import * as vscode from 'vscode';
-import { Analyzer, StructLayout } from './analyzer';
+import { Analyzer, MemberInfo, StructLayout } from './analyzer';
 import * as path from 'path';
 
 export class WebviewProvider {
     private panel: vscode.WebviewPanel | undefined;
     private analyzer: Analyzer;
 
-    constructor(private context: vscode.ExtensionContext) {
-        this.analyzer = new Analyzer();
+    constructor(private context: vscode.ExtensionContext, analyzer: Analyzer) {
+        this.analyzer = analyzer;
     }
 
     async showLayout(document: vscode.TextDocument, structName: string): Promise<void> {
@@ -299,7 +299,7 @@ export class WebviewProvider {
             </div>
         </div>
         
-        ${layouts.map(layout => this.renderLayout(layout, cacheLineSize)).join('')}
+        ${layouts.map((layout, i) => this.renderTemplateHeader(layouts, i) + this.renderLayout(layout, cacheLineSize)).join('')}
     </div>
     
     <script>
@@ -320,9 +320,21 @@ export class WebviewProvider {
 </html>`;
     }
 
+    // Instantiations of one template come out of the native side together;
+    // head each run with the template and how many instantiations it has
+    private renderTemplateHeader(layouts: StructLayout[], index: number): string {
+        const templateName = layouts[index].templateName;
+        if (!templateName || layouts[index - 1]?.templateName === templateName) {
+            return '';
+        }
+        const count = layouts.filter(l => l.templateName === templateName).length;
+        return `<h2>template ${templateName} (${count} instantiation${count === 1 ? '' : 's'})</h2>`;
+    }
+
     private renderLayout(layout: StructLayout, cacheLineSize: number): string {
         const paddingBytes = layout.padding.reduce((sum, p) => p.size + sum, 0);
         const paddingPercent = ((paddingBytes / layout.totalSize) * 100).toFixed(1);
+        const nestedPadding = layout.nestedPadding ?? 0;
 
         return `
         <div class="struct-section">
@@ -341,10 +353,29 @@ export class WebviewProvider {
                         <div class="stat-label">Padding</div>
                         <div class="stat-value">${paddingBytes} bytes (${paddingPercent}%)</div>
                     </div>
+                    ${layout.arrayStride ? `
+                    <div class="stat">
+                        <div class="stat-label">In Arrays</div>
+                        <div class="stat-value">${layout.arrayStride.linesPerElement.toFixed(2)} lines/element, ${(layout.arrayStride.lineStraddle * 100).toFixed(0)}% straddle</div>
+                    </div>
+                    <div class="stat">
+                        <div class="stat-label">Per 4 KiB / 2 MiB Page</div>
+                        <div class="stat-value">${layout.arrayStride.elementsPerPage.toFixed(1)} / ${layout.arrayStride.elementsPerHugePage.toFixed(0)}</div>
+                    </div>` : ''}
+                    ${nestedPadding > 0 ? `
+                    <div class="stat">
+                        <div class="stat-label">Nested Padding</div>
+                        <div class="stat-value">${nestedPadding} bytes</div>
+                    </div>` : ''}
                     <div class="stat">
                         <div class="stat-label">Useful Size</div>
                         <div class="stat-value">${layout.usefulSize} bytes</div>
                     </div>
+                    ${layout.templatePaddingExcess ? `
+                    <div class="stat">
+                        <div class="stat-label">⚠️ Padding vs. ${layout.templateName}</div>
+                        <div class="stat-value">+${layout.templatePaddingExcess} bytes</div>
+                    </div>` : ''}
                 </div>
             </div>
             
@@ -363,7 +394,12 @@ export class WebviewProvider {
     }
 
     private renderMemoryMap(layout: StructLayout, cacheLineSize: number): string {
-        const items: Array<{ type: 'member' | 'padding', offset: number, data: any }> = [];
+        const items: Array<{ type: 'base' | 'member' | 'padding', offset: number, data: any }> = [];
+
+        // Add base subobjects; empty ones take no bytes but still show where they sit
+        (layout.bases ?? []).forEach(b => {
+            items.push({ type: 'base', offset: b.offset, data: b });
+        });
 
         // Add members
         layout.members.forEach(m => {
@@ -391,16 +427,30 @@ export class WebviewProvider {
                 </div>`;
             }
 
-            if (item.type === 'member') {
+            if (item.type === 'base') {
+                const b = item.data;
+                const tags = [b.isVirtual ? 'virtual' : '', b.isEmpty ? 'empty' : '', b.isPrimary ? 'primary' : '']
+                    .filter(tag => tag).join(', ');
+                html += `<div class="member-row">
+                    <div class="offset">+${b.offset}</div>
+                    <div class="size-indicator">${b.size}B</div>
+                    <div class="member-info">
+                        <div class="member-name">base ${b.name}</div>
+                        <div class="member-type">${tags}</div>
+                    </div>
+                </div>`;
+                lastOffset = Math.max(lastOffset, b.offset + b.size);
+            } else if (item.type === 'member') {
                 const m = item.data;
                 html += `<div class="member-row">
                     <div class="offset">+${m.offset}</div>
                     <div class="size-indicator">${m.size}B</div>
                     <div class="member-info">
                         <div class="member-name">${m.name}</div>
-                        <div class="member-type">${m.type}</div>
+                        <div class="member-type">${m.type}${m.nestedPadding ? ` &mdash; ${m.nestedPadding}B padding inside` : ''}</div>
                     </div>
                 </div>`;
+                html += this.renderNestedMembers(m, m.offset, 1);
                 lastOffset = m.offset + m.size;
             } else {
                 const p = item.data;
@@ -419,15 +469,72 @@ export class WebviewProvider {
         return html;
     }
 
+    // The members and padding of a record-typed member, indented under it
+    // at offsets within the outer struct (the first element for arrays)
+    private renderNestedMembers(member: MemberInfo, base: number, depth: number): string {
+        const items: Array<{ offset: number, html: string }> = [];
+        const indent = `style="margin-left: ${depth * 20}px;"`;
+
+        (member.children ?? []).forEach(c => {
+            items.push({
+                offset: c.offset,
+                html: `<div class="member-row" ${indent}>
+                    <div class="offset">+${base + c.offset}</div>
+                    <div class="size-indicator">${c.size}B</div>
+                    <div class="member-info">
+                        <div class="member-name">${member.name}.${c.name}</div>
+                        <div class="member-type">${c.type}</div>
+                    </div>
+                </div>` + this.renderNestedMembers(c, base + c.offset, depth + 1)
+            });
+        });
+
+        (member.padding ?? []).forEach(p => {
+            items.push({
+                offset: p.offset,
+                html: `<div class="padding-row" ${indent}>
+                    <div class="offset">+${base + p.offset}</div>
+                    <div class="size-indicator">${p.size}B</div>
+                    <div class="member-info">
+                        <div class="member-name">⚠️ Padding in ${member.name}</div>
+                        <div class="member-type">${p.reason}</div>
+                    </div>
+                </div>`
+            });
+        });
+
+        items.sort((a, b) => a.offset - b.offset);
+        return items.map(item => item.html).join('');
+    }
+
     private renderVTable(layout: StructLayout): string {
+        const vtable = layout.vtable;
         return `
         <div class="vtable-info">
             <h4>🔗 Virtual Table</h4>
-            <p><strong>VTable Pointer Offset:</strong> ${layout.vtable.pointerOffset}</p>
-            <p><strong>Virtual Functions (${layout.vtable.virtualFunctions.length}):</strong></p>
+            <p><strong>VTable Pointer Offset:</strong> ${vtable.pointerOffset}</p>
+            <p><strong>Virtual Functions (${vtable.virtualFunctions.length}):</strong></p>
             <ul>
-                ${layout.vtable.virtualFunctions.map(f => `<li>${f}</li>`).join('')}
+                ${vtable.virtualFunctions.map(f => `<li>${f}</li>`).join('')}
             </ul>
+            ${(vtable.vptrs ?? []).map(vptr => `
+                <p><strong>vptr at +${vptr.offset}</strong> (${vptr.subobject})</p>
+                <ol start="0" style="font-size: 11px;">
+                    ${vptr.slots.filter(slot => slot.index >= 0).map(slot =>
+                        `<li>${slot.name}${slot.thunk ? ` <em>(thunk: ${slot.thunk})</em>` : ''}</li>`
+                    ).join('')}
+                </ol>
+            `).join('')}
+            ${vtable.vbptrOffset !== undefined ?
+                `<p><strong>vbptr at +${vtable.vbptrOffset}</strong></p>` : ''}
+            ${(vtable.virtualBases ?? []).length > 0 ? `
+                <p><strong>Virtual Bases:</strong></p>
+                <ul>
+                    ${vtable.virtualBases.map(base =>
+                        `<li>${base.name} at +${base.offset}</li>`
+                    ).join('')}
+                </ul>
+            ` : ''}
         </div>
         `;
     }
@@ -445,9 +552,41 @@ export class WebviewProvider {
                             Apply Reordering
                          </button>`
                 : ''}
-                    ${opt.confidence < 1.0 ?
+                    ${opt.membersMoved > 0 ?
+                `<div style="font-size: 11px; color: var(--vscode-descriptionForeground);">
+                            Moves ${opt.membersMoved} of ${layout.members.length} members
+                         </div>`
+                : ''}
+                    ${opt.kind === 'aosToSoa' ?
+                `<div style="font-size: 11px; color: var(--vscode-descriptionForeground);">
+                            Loops read ${opt.loopMembers?.join(', ')} &mdash;
+                            ${opt.bytesPerIterationBefore?.toFixed(0)} → ${opt.bytesPerIterationAfter?.toFixed(0)} bytes per iteration
+                         </div>`
+                : ''}
+                    ${opt.kind === 'packFlags' && opt.bitfieldMembers ?
+                `<div style="font-size: 11px; color: var(--vscode-descriptionForeground);">
+                            Bitfields: ${opt.bitfieldMembers.map((m, i) => `${m} : ${opt.bitfieldWidths?.[i]}`).join(', ')}
+                         </div>`
+                : ''}
+                    ${opt.kind === 'nestedReorder' && opt.nestedType ?
+                `<div style="font-size: 11px; color: var(--vscode-descriptionForeground);">
+                            ${opt.nestedType} (in ${opt.nestedMember}): ${opt.suggestedOrder.join(', ')}
+                         </div>`
+                : ''}
+                    ${opt.kind === 'narrowTypes' && opt.narrowedMembers ?
+                `<div style="font-size: 11px; color: var(--vscode-descriptionForeground);">
+                            Narrow: ${opt.narrowedMembers.map((m, i) => `${m} → ${opt.narrowedTypes?.[i]}`).join(', ')}
+                         </div>`
+                : ''}
+                    ${opt.kind === 'coAccess' ?
+                `<div style="font-size: 11px; color: var(--vscode-descriptionForeground);">
+                            ${opt.linesPerAccessBefore?.toFixed(2)} → ${opt.linesPerAccessAfter?.toFixed(2)} cache lines per access
+                         </div>`
+                : ''}
+                    ${opt.kind === 'hotColdSplit' && opt.coldMembers ?
                 `<div style="font-size: 11px; color: var(--vscode-descriptionForeground);">
-                            Confidence: ${(opt.confidence * 100).toFixed0()}%
+                            Cold: ${opt.coldMembers.join(', ')} &mdash;
+                            ${opt.linesPerAccessBefore?.toFixed(2)} → ${opt.linesPerAccessAfter?.toFixed(2)} cache lines per access
                          </div>`
                 : ''}
                 </div>
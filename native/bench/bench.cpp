@@ -0,0 +1,344 @@
+// structsight_bench - latency and throughput of the layout engine.
+// Times cold and warm Analyzer::Analyze, LayoutCalculator on its own and
+// the binary encoding of results over synthetic fixtures (1, 100 and
+// 10,000 structs, a 500-field record, heavy STL includes, deep template
+// instantiation), plus any source files given on the command line.
+// The JS side of result conversion (LayoutToJS) is timed by bench.js.
+
+#include "types.h"
+#include "analyzer.h"
+#include "binary_encoder.h"
+#include "layout_calculator.h"
+#include "session.h"
+#include <clang/AST/DeclTemplate.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace structsight;
+
+namespace {
+
+struct Fixture {
+    std::string name;
+    std::string source;
+    bool template_instantiations = false;
+    std::string path = "bench.cpp";
+};
+
+struct Options {
+    unsigned iterations = 5;
+    std::string filter;
+    std::vector<std::string> files;
+};
+
+// One member type per line of a generated record, cycled so every record
+// has some padding for the calculator and reorder search to work on
+const char* const kMemberTypes[] = {
+    "char", "double", "short", "int*", "bool", "long long", "float", "unsigned char",
+};
+
+std::string GenerateRecords(unsigned count, unsigned fields) {
+    std::string source;
+    for (unsigned i = 0; i < count; i++) {
+        source += "struct Record" + std::to_string(i) + " {\n";
+        for (unsigned f = 0; f < fields; f++) {
+            source += "    ";
+            source += kMemberTypes[(i + f) % 8];
+            source += " field" + std::to_string(f) + ";\n";
+        }
+        source += "};\n";
+    }
+    return source;
+}
+
+std::vector<Fixture> SyntheticFixtures() {
+    std::vector<Fixture> fixtures;
+    fixtures.push_back({"1 struct", GenerateRecords(1, 8)});
+    fixtures.push_back({"100 structs", GenerateRecords(100, 8)});
+    fixtures.push_back({"10000 structs", GenerateRecords(10000, 8)});
+    fixtures.push_back({"500-field record", GenerateRecords(1, 500)});
+
+    fixtures.push_back({"STL includes", R"(
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+struct Session {
+    std::string id;
+    bool active;
+    std::vector<int> history;
+    std::mutex lock;
+    std::optional<double> score;
+    std::unordered_map<std::string, std::shared_ptr<Session>> peers;
+    char state;
+    std::function<void()> on_close;
+    std::variant<int, std::string> payload;
+};
+
+struct Registry {
+    std::map<int, Session*> by_id;
+    short generation;
+    std::vector<std::unique_ptr<Session>> owned;
+};
+)"});
+
+    fixtures.push_back({"deep templates", R"(
+template <int N>
+struct Chain {
+    Chain<N - 1> inner;
+    char tag;
+    long long weight;
+};
+
+template <>
+struct Chain<0> {
+    int leaf;
+};
+
+template <typename T, typename U>
+struct Node {
+    T key;
+    U value;
+    Node* next;
+};
+
+template <typename... Ts>
+struct Tuple;
+
+template <>
+struct Tuple<> {};
+
+template <typename T, typename... Ts>
+struct Tuple<T, Ts...> : Tuple<Ts...> {
+    T head;
+};
+
+Chain<200> chain;
+Node<char, double> a;
+Node<int, char> b;
+Node<double, short> c;
+Tuple<char, double, int, short, char, long long, bool, float> tuple;
+)", true});
+
+    return fixtures;
+}
+
+AnalysisRequest MakeRequest(const Fixture& fixture) {
+    AnalysisRequest request;
+    request.source_code = fixture.source;
+    request.file_path = fixture.path;
+    request.architecture = Architecture::X64;
+    request.compiler = Compiler::Clang;
+    request.include_template_instantiations = fixture.template_instantiations;
+    return request;
+}
+
+// Runs `body` `iterations` times (after `warmup` untimed runs) and
+// returns the duration of each timed run in milliseconds
+std::vector<double> Time(unsigned warmup, unsigned iterations, const std::function<void()>& body) {
+    for (unsigned i = 0; i < warmup; i++) {
+        body();
+    }
+    std::vector<double> samples;
+    for (unsigned i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return samples;
+}
+
+void Report(const std::string& fixture, const char* measurement, std::vector<double> samples,
+            size_t records) {
+    std::sort(samples.begin(), samples.end());
+    double median = samples[samples.size() / 2];
+    double records_per_second = median > 0 ? records / (median / 1000.0) : 0;
+    llvm::outs() << llvm::format("%-18s %-22s %10.3f %10.3f %12.0f\n", fixture.c_str(),
+                                 measurement, median, samples.front(), records_per_second);
+}
+
+// Top-level record definitions and class template specializations by the
+// names the analyzer gives them, so LayoutCalculator can be rerun on
+// layouts without going through the visitor
+std::map<std::string, const clang::RecordDecl*> FindRecords(clang::ASTContext& context) {
+    std::map<std::string, const clang::RecordDecl*> records;
+    for (const clang::Decl* decl : context.getTranslationUnitDecl()->decls()) {
+        const auto* record = llvm::dyn_cast<clang::RecordDecl>(decl);
+        if (record && record->isCompleteDefinition() && !record->isDependentType()) {
+            records.emplace(record->getQualifiedNameAsString(), record);
+        }
+        
+        // Implicit instantiations hang off their template, not the TU
+        const auto* class_template = llvm::dyn_cast<clang::ClassTemplateDecl>(decl);
+        if (!class_template) {
+            continue;
+        }
+        for (const auto* specialization : class_template->specializations()) {
+            if (!specialization->isCompleteDefinition()) {
+                continue;
+            }
+            std::string name;
+            llvm::raw_string_ostream stream(name);
+            specialization->getNameForDiagnostic(stream, context.getPrintingPolicy(), true);
+            records.emplace(stream.str(), specialization);
+        }
+    }
+    return records;
+}
+
+void RunFixture(const Fixture& fixture, const Options& options, const std::string& cache_directory) {
+    AnalysisRequest request = MakeRequest(fixture);
+
+    // The big fixtures take seconds per parse; fewer runs keep the suite usable
+    unsigned iterations = fixture.source.size() > (1u << 20) ? std::min(options.iterations, 3u)
+                                                             : options.iterations;
+
+    AnalysisResult result = Analyzer().Analyze(request);
+    if (!result.success) {
+        llvm::errs() << "structsight_bench: " << fixture.name << ": " << result.error_message << "\n";
+        return;
+    }
+    size_t records = result.layouts.size();
+
+    // No caches: every call parses the whole file, headers included
+    Report(fixture.name, "Analyze cold", Time(0, iterations, [&] {
+        Analyzer().Analyze(request);
+    }), records);
+
+    // Preamble reused: only the code below the #include block is parsed
+    PreambleCache preambles;
+    Analyzer preamble_analyzer(&preambles);
+    Report(fixture.name, "Analyze warm preamble", Time(1, iterations, [&] {
+        preamble_analyzer.Analyze(request);
+    }), records);
+
+    // What a hover costs while the document is unchanged
+    Session session(&preambles);
+    bool reparsed = false;
+    session.Update(request, 1, reparsed);
+    Report(fixture.name, "Session query", Time(1, iterations, [&] {
+        session.Query(request);
+    }), records);
+
+    // Persistent cache hit: header stamps checked, payload decoded, no Clang
+    LayoutCache layout_cache(cache_directory);
+    Analyzer cached_analyzer(nullptr, &layout_cache);
+    Report(fixture.name, "Analyze layout cache", Time(1, iterations, [&] {
+        cached_analyzer.Analyze(request);
+    }), records);
+
+    // LayoutCalculator alone, on the layouts of an already parsed unit
+    Analyzer parser;
+    AnalysisResult parse_result;
+    std::unique_ptr<ParsedUnit> unit = parser.Parse(request, parse_result);
+    if (unit) {
+        clang::ASTContext& context = unit->GetASTContext();
+        std::map<std::string, const clang::RecordDecl*> decls = FindRecords(context);
+        std::vector<std::pair<StructLayout, const clang::RecordDecl*>> inputs;
+        for (const auto& layout : result.layouts) {
+            auto it = decls.find(layout.qualified_name);
+            if (it != decls.end()) {
+                inputs.emplace_back(layout, it->second);
+                inputs.back().first.padding.clear();
+                inputs.back().first.optimizations.clear();
+            }
+        }
+
+        LayoutCalculator calculator(request.compiler, request.architecture, request.cache_line_size);
+        Report(fixture.name, "LayoutCalculator", Time(1, iterations, [&] {
+            for (const auto& input : inputs) {
+                StructLayout layout = input.first;
+                calculator.CalculatePadding(layout, context, input.second);
+                calculator.CalculateArrayStride(layout);
+                calculator.GenerateOptimizations(layout, context, input.second);
+            }
+        }), inputs.size());
+    }
+
+    // The native half of handing results to JS with `binary: true`
+    Report(fixture.name, "BinaryEncoder", Time(1, iterations, [&] {
+        BinaryEncoder::Encode(result.layouts);
+    }), records);
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--iterations=", 0) == 0) {
+            options.iterations = static_cast<unsigned>(std::strtoul(arg.c_str() + 13, nullptr, 10));
+            if (options.iterations == 0) {
+                return false;
+            }
+        } else if (arg.rfind("--filter=", 0) == 0) {
+            options.filter = arg.substr(9);
+        } else if (!arg.empty() && arg[0] == '-') {
+            return false;
+        } else {
+            options.files.push_back(arg);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        llvm::errs() << "Usage: structsight_bench [--iterations=<n>] [--filter=<fixture>] [file...]\n";
+        return 2;
+    }
+
+    std::vector<Fixture> fixtures = SyntheticFixtures();
+
+    // Real sources, analyzed as-is without extra flags
+    for (const auto& file : options.files) {
+        auto buffer = llvm::MemoryBuffer::getFile(file);
+        if (!buffer) {
+            llvm::errs() << "structsight_bench: " << file << ": " << buffer.getError().message() << "\n";
+            return 1;
+        }
+        Fixture fixture;
+        fixture.name = llvm::sys::path::filename(file).str();
+        fixture.source = (*buffer)->getBuffer().str();
+        fixture.path = file;
+        fixtures.push_back(std::move(fixture));
+    }
+
+    llvm::SmallString<128> cache_directory;
+    if (llvm::sys::fs::createUniqueDirectory("structsight-bench", cache_directory)) {
+        llvm::errs() << "structsight_bench: can't create a cache directory\n";
+        return 1;
+    }
+
+    llvm::outs() << llvm::format("%-18s %-22s %10s %10s %12s\n", "fixture", "measurement",
+                                 "median ms", "min ms", "records/s");
+    for (const auto& fixture : fixtures) {
+        if (fixture.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        RunFixture(fixture, options, cache_directory.str().str());
+        llvm::outs().flush();
+    }
+
+    llvm::sys::fs::remove_directories(cache_directory);
+    return 0;
+}
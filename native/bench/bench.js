@@ -0,0 +1,73 @@
+// Times the JS side of handing results over: the same session query
+// returned as objects (LayoutToJS) and as one binary buffer. The native
+// analysis is identical in both, so the difference is the conversion.
+// Run `structsight_bench` for the native measurements.
+const native = require('../../native/build/Release/structsight_native.node');
+
+const iterations = Number(process.argv[2] ?? 10);
+
+const memberTypes = ['char', 'double', 'short', 'int*', 'bool', 'long long', 'float', 'unsigned char'];
+
+function generateRecords(count, fields) {
+    let source = '';
+    for (let i = 0; i < count; i++) {
+        source += `struct Record${i} {\n`;
+        for (let f = 0; f < fields; f++) {
+            source += `    ${memberTypes[(i + f) % 8]} field${f};\n`;
+        }
+        source += '};\n';
+    }
+    return source;
+}
+
+const fixtures = [
+    ['1 struct', generateRecords(1, 8)],
+    ['100 structs', generateRecords(100, 8)],
+    ['10000 structs', generateRecords(10000, 8)],
+    ['500-field record', generateRecords(1, 500)]
+];
+
+async function median(run) {
+    await run(); // Warm-up
+    const samples = [];
+    for (let i = 0; i < iterations; i++) {
+        const start = process.hrtime.bigint();
+        await run();
+        samples.push(Number(process.hrtime.bigint() - start) / 1e6);
+    }
+    samples.sort((a, b) => a - b);
+    return samples[Math.floor(samples.length / 2)];
+}
+
+async function main() {
+    console.log(`${'fixture'.padEnd(18)} ${'objects ms'.padStart(11)} ${'binary ms'.padStart(11)} ${'LayoutToJS ms'.padStart(14)}`);
+
+    for (const [name, sourceCode] of fixtures) {
+        const session = native.openSession();
+        const update = session.update({
+            sourceCode,
+            filePath: 'bench.cpp',
+            architecture: 'x64',
+            compiler: 'clang',
+            compileFlags: []
+        }, 1);
+        const status = await update.promise;
+        if (!status.success) {
+            throw new Error(`${name}: ${status.errorMessage}`);
+        }
+
+        const objects = await median(() => session.query(''));
+        const binary = await median(() => session.query('', { binary: true }));
+        session.close();
+
+        console.log(
+            `${name.padEnd(18)} ${objects.toFixed(3).padStart(11)} ${binary.toFixed(3).padStart(11)} ` +
+            `${(objects - binary).toFixed(3).padStart(14)}`
+        );
+    }
+}
+
+main().catch(error => {
+    console.error('✗ Benchmark error:', error);
+    process.exit(1);
+});
@@ -0,0 +1,349 @@
+#include "access_analyzer.h"
+#include <clang/AST/Attr.h>
+#include <clang/AST/DeclTemplate.h>
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace structsight {
+
+namespace {
+
+// Roughly how many iterations a loop is assumed to run
+const double kLoopWeight = 8;
+const unsigned kMaxLoopDepth = 3;
+
+// A function naming more fields than this (a serializer, operator==)
+// says nothing about which ones belong together; its pairs are skipped
+const size_t kMaxSiteFields = 64;
+
+class AccessVisitor : public clang::RecursiveASTVisitor<AccessVisitor> {
+public:
+    using Base = clang::RecursiveASTVisitor<AccessVisitor>;
+    
+    using VirtualCallMap = std::unordered_map<const clang::CXXRecordDecl*,
+                                              std::map<const clang::CXXMethodDecl*, VirtualCalls>>;
+    
+    AccessVisitor(
+        clang::ASTContext& context,
+        std::unordered_map<const clang::RecordDecl*, FieldAccessGraph>& graphs,
+        VirtualCallMap& virtual_calls,
+        std::unordered_set<const clang::CXXRecordDecl*>& derived_from,
+        std::unordered_set<const clang::CXXMethodDecl*>& overridden
+    ) : context_(context), graphs_(graphs), virtual_calls_(virtual_calls),
+        derived_from_(derived_from), overridden_(overridden), function_depth_(0) {}
+    
+    bool TraverseDecl(clang::Decl* decl) {
+        if (!decl) {
+            return true;
+        }
+        
+        if (!llvm::isa<clang::TranslationUnitDecl>(decl)) {
+            const clang::SourceManager& sm = context_.getSourceManager();
+            clang::SourceLocation loc = decl->getLocation();
+            if (loc.isValid() && sm.isInSystemHeader(sm.getExpansionLoc(loc))) {
+                return true;
+            }
+        }
+        
+        const auto* function = llvm::dyn_cast<clang::FunctionDecl>(decl);
+        if (!function || !function->doesThisDeclarationHaveABody()) {
+            return Base::TraverseDecl(decl);
+        }
+        if (function->isDependentContext()) {
+            return true; // Template patterns; members aren't resolved yet
+        }
+        
+        // Each function body is one site; local classes nest
+        Accesses outer;
+        std::swap(outer, current_);
+        std::vector<Loop> outer_loops;
+        std::swap(outer_loops, loops_);
+        function_depth_++;
+        
+        bool result = Base::TraverseDecl(decl);
+        Flush();
+        
+        function_depth_--;
+        std::swap(outer_loops, loops_);
+        std::swap(outer, current_);
+        return result;
+    }
+    
+    bool TraverseForStmt(clang::ForStmt* stmt) {
+        return InLoop(nullptr, [&] { return Base::TraverseForStmt(stmt); });
+    }
+    
+    bool TraverseCXXForRangeStmt(clang::CXXForRangeStmt* stmt) {
+        return InLoop(stmt->getLoopVariable(), [&] { return Base::TraverseCXXForRangeStmt(stmt); });
+    }
+    
+    bool TraverseWhileStmt(clang::WhileStmt* stmt) {
+        return InLoop(nullptr, [&] { return Base::TraverseWhileStmt(stmt); });
+    }
+    
+    bool TraverseDoStmt(clang::DoStmt* stmt) {
+        return InLoop(nullptr, [&] { return Base::TraverseDoStmt(stmt); });
+    }
+    
+    bool VisitMemberExpr(clang::MemberExpr* expr) {
+        if (function_depth_ == 0) {
+            return true; // Default member initializers and the like
+        }
+        
+        const auto* field = llvm::dyn_cast<clang::FieldDecl>(expr->getMemberDecl());
+        if (!field) {
+            return true;
+        }
+        
+        const clang::RecordDecl* record = field->getParent()->getCanonicalDecl();
+        double weight = CurrentWeight();
+        current_[record][field->getFieldIndex()] += weight;
+        
+        // Counted for the innermost loop only
+        if (!loops_.empty() && IsElementAccess(expr->getBase())) {
+            loops_.back().elements[record][field->getFieldIndex()] += weight;
+        }
+        return true;
+    }
+    
+    bool VisitCXXMemberCallExpr(clang::CXXMemberCallExpr* expr) {
+        const clang::CXXMethodDecl* method = expr->getMethodDecl();
+        const clang::CXXRecordDecl* record = expr->getRecordDecl();
+        if (function_depth_ == 0 || !method || !method->isVirtual() || !record) {
+            return true;
+        }
+        if (method->hasAttr<clang::FinalAttr>() || record->hasAttr<clang::FinalAttr>()) {
+            return true;
+        }
+        
+        // Base::f() is a direct call
+        const auto* callee = llvm::dyn_cast<clang::MemberExpr>(expr->getCallee()->IgnoreParens());
+        if (callee && callee->hasQualifier()) {
+            return true;
+        }
+        
+        // So is a call on an object (not a reference) whose type is known
+        const clang::Expr* object = expr->getImplicitObjectArgument()->IgnoreParenImpCasts();
+        if (callee && !callee->isArrow()) {
+            if (const auto* ref = llvm::dyn_cast<clang::DeclRefExpr>(object)) {
+                if (!ref->getDecl()->getType()->isReferenceType()) {
+                    return true;
+                }
+            } else if (object->isPRValue()) {
+                return true;
+            }
+        }
+        
+        VirtualCalls& calls = virtual_calls_[record->getCanonicalDecl()][method->getCanonicalDecl()];
+        calls.sites++;
+        calls.in_loops += loops_.empty() ? 0 : 1;
+        calls.weight += CurrentWeight();
+        return true;
+    }
+    
+    bool VisitCXXRecordDecl(clang::CXXRecordDecl* decl) {
+        if (!decl->isThisDeclarationADefinition()) {
+            return true;
+        }
+        for (const auto& base : decl->bases()) {
+            if (const auto* base_decl = base.getType()->getAsCXXRecordDecl()) {
+                derived_from_.insert(base_decl->getCanonicalDecl());
+            }
+        }
+        return true;
+    }
+    
+    bool VisitCXXMethodDecl(clang::CXXMethodDecl* decl) {
+        for (const clang::CXXMethodDecl* overridden : decl->overridden_methods()) {
+            overridden_.insert(overridden->getCanonicalDecl());
+        }
+        return true;
+    }
+    
+    bool VisitVarDecl(clang::VarDecl* decl) {
+        CountArrayUse(decl->getType());
+        return true;
+    }
+    
+    bool VisitFieldDecl(clang::FieldDecl* decl) {
+        CountArrayUse(decl->getType());
+        return true;
+    }
+    
+    bool VisitCXXNewExpr(clang::CXXNewExpr* expr) {
+        if (expr->isArray()) {
+            if (const auto* record = expr->getAllocatedType()->getAsRecordDecl()) {
+                graphs_[record->getCanonicalDecl()].array_uses++;
+            }
+        }
+        return true;
+    }
+    
+private:
+    // Record -> field index -> weighted accesses
+    using Accesses = std::map<const clang::RecordDecl*, std::map<uint32_t, double>>;
+    
+    struct Loop {
+        const clang::VarDecl* element; // Range-for variable, if any
+        Accesses elements;             // Accesses through an element
+    };
+    
+    clang::ASTContext& context_;
+    std::unordered_map<const clang::RecordDecl*, FieldAccessGraph>& graphs_;
+    VirtualCallMap& virtual_calls_;
+    std::unordered_set<const clang::CXXRecordDecl*>& derived_from_;
+    std::unordered_set<const clang::CXXMethodDecl*>& overridden_;
+    Accesses current_;
+    std::vector<Loop> loops_;
+    unsigned function_depth_;
+    
+    double CurrentWeight() const {
+        unsigned depth = static_cast<unsigned>(loops_.size());
+        return std::pow(kLoopWeight, std::min(depth, kMaxLoopDepth));
+    }
+    
+    template <typename Traverse>
+    bool InLoop(const clang::VarDecl* element, Traverse traverse) {
+        loops_.push_back({element, {}});
+        bool result = traverse();
+        
+        for (const auto& record : loops_.back().elements) {
+            AccessSite site;
+            site.weight = 0;
+            for (const auto& field : record.second) {
+                site.fields.push_back(field.first);
+                site.weight += field.second;
+            }
+            graphs_[record.first].element_loops.push_back(std::move(site));
+        }
+        loops_.pop_back();
+        return result;
+    }
+    
+    // arr[i].x, v[i].x, it->x, (*it).x, or a range-for variable's .x
+    bool IsElementAccess(const clang::Expr* base) const {
+        base = base->IgnoreParenImpCasts();
+        if (llvm::isa<clang::ArraySubscriptExpr>(base)) {
+            return true;
+        }
+        if (const auto* call = llvm::dyn_cast<clang::CXXOperatorCallExpr>(base)) {
+            clang::OverloadedOperatorKind op = call->getOperator();
+            return op == clang::OO_Subscript || op == clang::OO_Arrow || op == clang::OO_Star;
+        }
+        if (const auto* ref = llvm::dyn_cast<clang::DeclRefExpr>(base)) {
+            for (const auto& loop : loops_) {
+                if (loop.element && ref->getDecl() == loop.element) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+    
+    void CountArrayUse(clang::QualType type) {
+        clang::QualType canonical = type.getNonReferenceType().getCanonicalType();
+        const clang::Type* element = nullptr;
+        if (const auto* array = llvm::dyn_cast<clang::ArrayType>(canonical)) {
+            element = array->getElementType().getTypePtr();
+        } else if (const auto* specialization =
+                       llvm::dyn_cast_or_null<clang::ClassTemplateSpecializationDecl>(
+                           canonical->getAsRecordDecl())) {
+            llvm::StringRef name = specialization->getName();
+            if (specialization->isInStdNamespace() &&
+                (name == "vector" || name == "array" || name == "deque" || name == "span") &&
+                specialization->getTemplateArgs().size() > 0 &&
+                specialization->getTemplateArgs()[0].getKind() == clang::TemplateArgument::Type) {
+                element = specialization->getTemplateArgs()[0].getAsType().getTypePtr();
+            }
+        }
+        
+        if (element) {
+            if (const auto* record = element->getAsRecordDecl()) {
+                graphs_[record->getCanonicalDecl()].array_uses++;
+            }
+        }
+    }
+    
+    void Flush() {
+        for (const auto& record : current_) {
+            FieldAccessGraph& graph = graphs_[record.first];
+            AccessSite site;
+            site.weight = 0;
+            
+            for (const auto& field : record.second) {
+                if (graph.field_weights.size() <= field.first) {
+                    graph.field_weights.resize(field.first + 1, 0);
+                }
+                graph.field_weights[field.first] += field.second;
+                site.fields.push_back(field.first);
+                site.weight += field.second;
+            }
+            
+            if (record.second.size() <= kMaxSiteFields) {
+                for (auto a = record.second.begin(); a != record.second.end(); ++a) {
+                    for (auto b = std::next(a); b != record.second.end(); ++b) {
+                        graph.edges[{a->first, b->first}] += std::min(a->second, b->second);
+                    }
+                }
+            }
+            
+            graph.sites.push_back(std::move(site));
+        }
+        current_.clear();
+    }
+};
+
+} // namespace
+
+AccessAnalyzer::AccessAnalyzer(clang::ASTContext& context)
+    : context_(context), analyzed_(false) {}
+
+AccessAnalyzer::~AccessAnalyzer() = default;
+
+const FieldAccessGraph* AccessAnalyzer::GetGraph(const clang::RecordDecl* record) {
+    EnsureAnalyzed();
+    
+    auto it = graphs_.find(record->getCanonicalDecl());
+    return it != graphs_.end() ? &it->second : nullptr;
+}
+
+const std::map<const clang::CXXMethodDecl*, VirtualCalls>* AccessAnalyzer::GetVirtualCalls(
+    const clang::CXXRecordDecl* record
+) {
+    EnsureAnalyzed();
+    
+    auto it = virtual_calls_.find(record->getCanonicalDecl());
+    return it != virtual_calls_.end() ? &it->second : nullptr;
+}
+
+bool AccessAnalyzer::HasDerivedClass(const clang::CXXRecordDecl* record) {
+    EnsureAnalyzed();
+    return derived_from_.count(record->getCanonicalDecl()) > 0;
+}
+
+bool AccessAnalyzer::IsOverridden(const clang::CXXMethodDecl* method) {
+    EnsureAnalyzed();
+    return overridden_.count(method->getCanonicalDecl()) > 0;
+}
+
+double AccessAnalyzer::GetWalkMilliseconds() const {
+    return walk_ms_;
+}
+
+void AccessAnalyzer::EnsureAnalyzed() {
+    if (!analyzed_) {
+        auto start = std::chrono::steady_clock::now();
+        Analyze();
+        walk_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        analyzed_ = true;
+    }
+}
+
+void AccessAnalyzer::Analyze() {
+    AccessVisitor visitor(context_, graphs_, virtual_calls_, derived_from_, overridden_);
+    visitor.TraverseDecl(context_.getTranslationUnitDecl());
+}
+
+} // namespace structsight
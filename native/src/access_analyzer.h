@@ -0,0 +1,102 @@
+#ifndef STRUCTSIGHT_ACCESS_ANALYZER_H
+#define STRUCTSIGHT_ACCESS_ANALYZER_H
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <clang/AST/DeclCXX.h>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace structsight {
+
+// One function body's use of a record: the fields it names and how often,
+// with accesses inside loops weighted up
+struct AccessSite {
+    std::vector<uint32_t> fields; // Field indices, ascending
+    double weight;                // Sum of the fields' weighted accesses
+};
+
+// Which fields of a record are used, and used together, by the code in
+// one translation unit
+struct FieldAccessGraph {
+    std::vector<double> field_weights;  // By field index; unused trailing fields may be missing
+    std::map<std::pair<uint32_t, uint32_t>, double> edges; // Co-access weight, first < second
+    std::vector<AccessSite> sites;
+    
+    // Loops that step through an array or container of the record: one
+    // site per loop with the fields read through its elements (arr[i].x,
+    // v[i].x, it->x, or the variable of a range-for)
+    std::vector<AccessSite> element_loops;
+    
+    // Declarations of arrays and containers of the record: T[N], new T[n],
+    // std::vector<T>, std::array<T, N>, std::deque<T>, std::span<T>
+    uint32_t array_uses = 0;
+};
+
+// Calls to one virtual method that the compiler has to dispatch through
+// the vtable: made through a pointer or reference, unqualified, and with
+// neither the method nor the static class final
+struct VirtualCalls {
+    uint32_t sites = 0;    // Call expressions
+    uint32_t in_loops = 0; // Of which inside a loop
+    double weight = 0;     // Sum of loop-weighted calls
+};
+
+// Builds a FieldAccessGraph per record from the MemberExpr nodes in every
+// function body outside system headers. An access nested in n loops counts
+// kLoopWeight^n (n capped at 3); two fields named in the same function are
+// co-accessed with the smaller of their weights. Dependent template code
+// is skipped, so only accesses the compiler has resolved are counted.
+//
+// The same walk records dynamically dispatched calls, keyed by the static
+// class of the object they are made through, and which classes and
+// methods something in the translation unit derives from or overrides.
+//
+// The walk happens on the first GetGraph call, so translation units whose
+// records never need it don't pay for it, and a ParsedUnit keeps its
+// analyzer so later queries on the same AST reuse the walk.
+class AccessAnalyzer {
+public:
+    explicit AccessAnalyzer(clang::ASTContext& context);
+    ~AccessAnalyzer();
+
+    // Null if no function in the translation unit touches the record
+    const FieldAccessGraph* GetGraph(const clang::RecordDecl* record);
+
+    // Virtual calls made through `record`, by method (canonical decl);
+    // null if there are none
+    const std::map<const clang::CXXMethodDecl*, VirtualCalls>* GetVirtualCalls(
+        const clang::CXXRecordDecl* record);
+
+    // Whether some class in the translation unit has `record` as a base
+    bool HasDerivedClass(const clang::CXXRecordDecl* record);
+
+    // Whether some class in the translation unit overrides `method`
+    bool IsOverridden(const clang::CXXMethodDecl* method);
+
+    // Wall-clock time the walk took; 0 until it has run
+    double GetWalkMilliseconds() const;
+
+private:
+    clang::ASTContext& context_;
+    bool analyzed_;
+    double walk_ms_ = 0;
+    std::unordered_map<const clang::RecordDecl*, FieldAccessGraph> graphs_; // By canonical decl
+    
+    // By canonical decl
+    std::unordered_map<const clang::CXXRecordDecl*,
+                       std::map<const clang::CXXMethodDecl*, VirtualCalls>> virtual_calls_;
+    std::unordered_set<const clang::CXXRecordDecl*> derived_from_;
+    std::unordered_set<const clang::CXXMethodDecl*> overridden_;
+
+    void EnsureAnalyzed();
+    void Analyze();
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_ACCESS_ANALYZER_H
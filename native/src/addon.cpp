@@ -1,10 +1,87 @@
 #include <napi.h>
 #include "types.h"
 #include "analyzer.h"
+#include "session.h"
+#include "project_scanner.h"
+#include "target_matrix.h"
+#include "container_footprint.h"
+#include "binary_encoder.h"
+#include "field_profile.h"
+#include <cstring>
 #include <memory>
+#include <stdexcept>
 
 namespace structsight {
 
+// Load the field access profile named by `profilePath`, if any
+std::shared_ptr<const FieldProfile> ParseProfile(const Napi::Object& obj) {
+    if (!obj.Has("profilePath")) {
+        return nullptr;
+    }
+    std::string path = obj.Get("profilePath").As<Napi::String>().Utf8Value();
+    if (path.empty()) {
+        return nullptr;
+    }
+    
+    std::string error;
+    std::shared_ptr<const FieldProfile> profile = FieldProfile::Load(path, error);
+    if (!profile) {
+        throw std::runtime_error("Invalid field profile: " + error);
+    }
+    return profile;
+}
+
+// Read `cacheLineSize`, if set; must be a power of two
+uint32_t ParseCacheLineSize(const Napi::Object& obj, uint32_t fallback) {
+    if (!obj.Has("cacheLineSize")) {
+        return fallback;
+    }
+    uint32_t size = obj.Get("cacheLineSize").As<Napi::Number>().Uint32Value();
+    if (size == 0 || (size & (size - 1)) != 0) {
+        throw std::runtime_error("cacheLineSize must be a power of two");
+    }
+    return size;
+}
+
+// Read the optional record-selection fields shared by analyze() and
+// Session.query(): line/column target and file filters
+void ParseQueryOptions(const Napi::Object& obj, AnalysisRequest& req) {
+    if (obj.Has("line") && obj.Has("column")) {
+        req.target_line = obj.Get("line").As<Napi::Number>().Uint32Value();
+        req.target_column = obj.Get("column").As<Napi::Number>().Uint32Value();
+    }
+    
+    if (obj.Has("includeSystemHeaders")) {
+        req.include_system_headers = obj.Get("includeSystemHeaders").As<Napi::Boolean>().Value();
+    }
+    
+    if (obj.Has("templateInstantiations")) {
+        req.include_template_instantiations = obj.Get("templateInstantiations").ToBoolean().Value();
+    }
+    
+    if (obj.Has("pathFilter")) {
+        Napi::Array filter = obj.Get("pathFilter").As<Napi::Array>();
+        for (uint32_t i = 0; i < filter.Length(); i++) {
+            req.path_filter.push_back(filter.Get(i).As<Napi::String>().Utf8Value());
+        }
+    }
+    
+    if (obj.Has("profilePath")) {
+        req.profile = ParseProfile(obj);
+    }
+    
+    req.cache_line_size = ParseCacheLineSize(obj, req.cache_line_size);
+    
+    if (obj.Has("stats")) {
+        req.collect_stats = obj.Get("stats").ToBoolean().Value();
+    }
+}
+
+// Whether the caller asked for layouts as one binary buffer
+bool WantsBinary(const Napi::Object& obj) {
+    return obj.Has("binary") && obj.Get("binary").ToBoolean().Value();
+}
+
 // Convert JS object to AnalysisRequest
 AnalysisRequest ParseRequest(const Napi::Object& obj) {
     AnalysisRequest req;
@@ -40,9 +117,98 @@ AnalysisRequest ParseRequest(const Napi::Object& obj) {
         }
     }
     
+    ParseQueryOptions(obj, req);
+    
     return req;
 }
 
+// Convert JS object to ProjectScanRequest
+ProjectScanRequest ParseProjectScanRequest(const Napi::Object& obj) {
+    ProjectScanRequest req;
+    
+    req.compile_commands_path = obj.Get("compileCommandsPath").As<Napi::String>().Utf8Value();
+    
+    std::string arch = obj.Get("architecture").As<Napi::String>().Utf8Value();
+    req.architecture = (arch == "x86") ? Architecture::X86 : Architecture::X64;
+    
+    std::string compiler = obj.Get("compiler").As<Napi::String>().Utf8Value();
+    if (compiler == "gcc") {
+        req.compiler = Compiler::GCC;
+    } else if (compiler == "msvc") {
+        req.compiler = Compiler::MSVC;
+    } else {
+        req.compiler = Compiler::Clang;
+    }
+    
+    if (obj.Has("threadCount")) {
+        req.thread_count = obj.Get("threadCount").As<Napi::Number>().Uint32Value();
+    }
+    
+    if (obj.Has("pathFilter")) {
+        Napi::Array filter = obj.Get("pathFilter").As<Napi::Array>();
+        for (uint32_t i = 0; i < filter.Length(); i++) {
+            req.path_filter.push_back(filter.Get(i).As<Napi::String>().Utf8Value());
+        }
+    }
+    
+    if (obj.Has("includeSystemHeaders")) {
+        req.include_system_headers = obj.Get("includeSystemHeaders").As<Napi::Boolean>().Value();
+    }
+    
+    if (obj.Has("templateInstantiations")) {
+        req.include_template_instantiations = obj.Get("templateInstantiations").ToBoolean().Value();
+    }
+    
+    req.profile = ParseProfile(obj);
+    req.cache_line_size = ParseCacheLineSize(obj, req.cache_line_size);
+    
+    return req;
+}
+
+// Convert JS object to TargetMatrixRequest: the fields of analyze() plus
+// targets (triples) and threadCount
+TargetMatrixRequest ParseTargetMatrixRequest(const Napi::Object& obj) {
+    TargetMatrixRequest req;
+    req.analysis = ParseRequest(obj);
+    
+    Napi::Array targets = obj.Get("targets").As<Napi::Array>();
+    for (uint32_t i = 0; i < targets.Length(); i++) {
+        req.targets.push_back(targets.Get(i).As<Napi::String>().Utf8Value());
+    }
+    
+    if (obj.Has("threadCount")) {
+        req.thread_count = obj.Get("threadCount").As<Napi::Number>().Uint32Value();
+    }
+    
+    return req;
+}
+
+// Convert JS object to FootprintRequest: the fields of analyze() plus
+// keyType and elementCount
+FootprintRequest ParseFootprintRequest(const Napi::Object& obj) {
+    FootprintRequest req;
+    req.analysis = ParseRequest(obj);
+    
+    if (obj.Has("keyType")) {
+        req.key_type = obj.Get("keyType").As<Napi::String>().Utf8Value();
+    }
+    
+    if (obj.Has("elementCount")) {
+        req.element_count = static_cast<uint64_t>(obj.Get("elementCount").As<Napi::Number>().Int64Value());
+    }
+    
+    return req;
+}
+
+// Convert PaddingInfo to JS object
+Napi::Object PaddingToJS(const Napi::Env& env, const PaddingInfo& padding) {
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("offset", Napi::Number::New(env, padding.offset));
+    obj.Set("size", Napi::Number::New(env, padding.size));
+    obj.Set("reason", padding.reason);
+    return obj;
+}
+
 // Convert MemberInfo to JS object
 Napi::Object MemberToJS(const Napi::Env& env, const MemberInfo& member) {
     Napi::Object obj = Napi::Object::New(env);
@@ -54,15 +220,36 @@ Napi::Object MemberToJS(const Napi::Env& env, const MemberInfo& member) {
     obj.Set("isBitfield", Napi::Boolean::New(env, member.is_bitfield));
     obj.Set("bitfieldWidth", Napi::Number::New(env, member.bitfield_width));
     obj.Set("bitfieldOffset", Napi::Number::New(env, member.bitfield_offset));
+    obj.Set("isThreadShared", Napi::Boolean::New(env, member.is_thread_shared));
+    obj.Set("isNoUniqueAddress", Napi::Boolean::New(env, member.is_no_unique_address));
+    obj.Set("nestedPadding", Napi::Number::New(env, member.nested_padding));
+    
+    // The layout of a record-typed member, offsets within the member
+    if (!member.children.empty()) {
+        Napi::Array children = Napi::Array::New(env, member.children.size());
+        for (size_t i = 0; i < member.children.size(); i++) {
+            children.Set(i, MemberToJS(env, member.children[i]));
+        }
+        Napi::Array padding = Napi::Array::New(env, member.padding.size());
+        for (size_t i = 0; i < member.padding.size(); i++) {
+            padding.Set(i, PaddingToJS(env, member.padding[i]));
+        }
+        obj.Set("children", children);
+        obj.Set("padding", padding);
+    }
     return obj;
 }
 
-// Convert PaddingInfo to JS object
-Napi::Object PaddingToJS(const Napi::Env& env, const PaddingInfo& padding) {
+// Convert BaseInfo to JS object
+Napi::Object BaseToJS(const Napi::Env& env, const BaseInfo& base) {
     Napi::Object obj = Napi::Object::New(env);
-    obj.Set("offset", Napi::Number::New(env, padding.offset));
-    obj.Set("size", Napi::Number::New(env, padding.size));
-    obj.Set("reason", padding.reason);
+    obj.Set("name", base.name);
+    obj.Set("offset", Napi::Number::New(env, base.offset));
+    obj.Set("size", Napi::Number::New(env, base.size));
+    obj.Set("alignment", Napi::Number::New(env, base.alignment));
+    obj.Set("isVirtual", Napi::Boolean::New(env, base.is_virtual));
+    obj.Set("isEmpty", Napi::Boolean::New(env, base.is_empty));
+    obj.Set("isPrimary", Napi::Boolean::New(env, base.is_primary));
     return obj;
 }
 
@@ -78,15 +265,53 @@ Napi::Object VTableToJS(const Napi::Env& env, const VTableInfo& vtable) {
     }
     obj.Set("virtualFunctions", funcs);
     
+    Napi::Array vptrs = Napi::Array::New(env, vtable.vptrs.size());
+    for (size_t i = 0; i < vtable.vptrs.size(); i++) {
+        const VPointerInfo& vptr = vtable.vptrs[i];
+        Napi::Object vptr_obj = Napi::Object::New(env);
+        vptr_obj.Set("offset", Napi::Number::New(env, vptr.offset));
+        vptr_obj.Set("subobject", vptr.subobject);
+        
+        Napi::Array slots = Napi::Array::New(env, vptr.slots.size());
+        for (size_t j = 0; j < vptr.slots.size(); j++) {
+            Napi::Object slot = Napi::Object::New(env);
+            slot.Set("index", Napi::Number::New(env, static_cast<double>(vptr.slots[j].index)));
+            slot.Set("kind", vptr.slots[j].kind);
+            slot.Set("name", vptr.slots[j].name);
+            if (!vptr.slots[j].thunk.empty()) {
+                slot.Set("thunk", vptr.slots[j].thunk);
+            }
+            slots.Set(j, slot);
+        }
+        vptr_obj.Set("slots", slots);
+        vptrs.Set(i, vptr_obj);
+    }
+    obj.Set("vptrs", vptrs);
+    
+    Napi::Array bases = Napi::Array::New(env, vtable.virtual_bases.size());
+    for (size_t i = 0; i < vtable.virtual_bases.size(); i++) {
+        Napi::Object base = Napi::Object::New(env);
+        base.Set("name", vtable.virtual_bases[i].name);
+        base.Set("offset", Napi::Number::New(env, vtable.virtual_bases[i].offset));
+        base.Set("offsetSlot", Napi::Number::New(env, static_cast<double>(vtable.virtual_bases[i].offset_slot)));
+        bases.Set(i, base);
+    }
+    obj.Set("virtualBases", bases);
+    
+    if (vtable.vbptr_offset >= 0) {
+        obj.Set("vbptrOffset", Napi::Number::New(env, static_cast<double>(vtable.vbptr_offset)));
+    }
+    
     return obj;
 }
 
 // Convert Optimization to JS object
 Napi::Object OptimizationToJS(const Napi::Env& env, const StructLayout::Optimization& opt) {
     Napi::Object obj = Napi::Object::New(env);
+    obj.Set("kind", OptimizationKindName(opt.kind));
     obj.Set("description", opt.description);
     obj.Set("bytesSaved", Napi::Number::New(env, opt.bytes_saved));
-    obj.Set("confidence", Napi::Number::New(env, opt.confidence));
+    obj.Set("membersMoved", Napi::Number::New(env, opt.members_moved));
     
     Napi::Array order = Napi::Array::New(env, opt.suggested_order.size());
     for (size_t i = 0; i < opt.suggested_order.size(); i++) {
@@ -94,6 +319,76 @@ Napi::Object OptimizationToJS(const Napi::Env& env, const StructLayout::Optimiza
     }
     obj.Set("suggestedOrder", order);
     
+    if (opt.kind == OptimizationKind::HotColdSplit || opt.kind == OptimizationKind::CoAccess) {
+        obj.Set("linesPerAccessBefore", Napi::Number::New(env, opt.lines_per_access_before));
+        obj.Set("linesPerAccessAfter", Napi::Number::New(env, opt.lines_per_access_after));
+    }
+    
+    if (opt.kind == OptimizationKind::HotColdSplit) {
+        Napi::Array cold = Napi::Array::New(env, opt.cold_members.size());
+        for (size_t i = 0; i < opt.cold_members.size(); i++) {
+            cold.Set(i, opt.cold_members[i]);
+        }
+        obj.Set("coldMembers", cold);
+    }
+    
+    if (opt.kind == OptimizationKind::FalseSharing) {
+        Napi::Array contended = Napi::Array::New(env, opt.contended_members.size());
+        for (size_t i = 0; i < opt.contended_members.size(); i++) {
+            contended.Set(i, opt.contended_members[i]);
+        }
+        obj.Set("contendedMembers", contended);
+    }
+    
+    if (opt.kind == OptimizationKind::AosToSoa) {
+        Napi::Array loop = Napi::Array::New(env, opt.loop_members.size());
+        for (size_t i = 0; i < opt.loop_members.size(); i++) {
+            loop.Set(i, opt.loop_members[i]);
+        }
+        obj.Set("loopMembers", loop);
+        obj.Set("bytesPerIterationBefore", Napi::Number::New(env, opt.bytes_per_iteration_before));
+        obj.Set("bytesPerIterationAfter", Napi::Number::New(env, opt.bytes_per_iteration_after));
+    }
+    
+    if (opt.kind == OptimizationKind::Devirtualize) {
+        Napi::Array methods = Napi::Array::New(env, opt.final_methods.size());
+        for (size_t i = 0; i < opt.final_methods.size(); i++) {
+            methods.Set(i, opt.final_methods[i]);
+        }
+        obj.Set("finalMethods", methods);
+    }
+    
+    if (opt.kind == OptimizationKind::PackFlags) {
+        Napi::Array members = Napi::Array::New(env, opt.bitfield_members.size());
+        Napi::Array widths = Napi::Array::New(env, opt.bitfield_widths.size());
+        for (size_t i = 0; i < opt.bitfield_members.size(); i++) {
+            members.Set(i, opt.bitfield_members[i]);
+        }
+        for (size_t i = 0; i < opt.bitfield_widths.size(); i++) {
+            widths.Set(i, Napi::Number::New(env, opt.bitfield_widths[i]));
+        }
+        obj.Set("bitfieldMembers", members);
+        obj.Set("bitfieldWidths", widths);
+    }
+    
+    if (opt.kind == OptimizationKind::NarrowTypes) {
+        Napi::Array members = Napi::Array::New(env, opt.narrowed_members.size());
+        Napi::Array types = Napi::Array::New(env, opt.narrowed_types.size());
+        for (size_t i = 0; i < opt.narrowed_members.size(); i++) {
+            members.Set(i, opt.narrowed_members[i]);
+        }
+        for (size_t i = 0; i < opt.narrowed_types.size(); i++) {
+            types.Set(i, opt.narrowed_types[i]);
+        }
+        obj.Set("narrowedMembers", members);
+        obj.Set("narrowedTypes", types);
+    }
+    
+    if (opt.kind == OptimizationKind::NestedReorder) {
+        obj.Set("nestedMember", opt.nested_member);
+        obj.Set("nestedType", opt.nested_type);
+    }
+    
     return obj;
 }
 
@@ -106,6 +401,26 @@ Napi::Object LayoutToJS(const Napi::Env& env, const StructLayout& layout) {
     obj.Set("totalSize", Napi::Number::New(env, layout.total_size));
     obj.Set("alignment", Napi::Number::New(env, layout.alignment));
     obj.Set("usefulSize", Napi::Number::New(env, layout.useful_size));
+    obj.Set("dataSize", Napi::Number::New(env, layout.data_size));
+    obj.Set("nestedPadding", Napi::Number::New(env, layout.nested_padding));
+    
+    const ArrayStride& stride = layout.array_stride;
+    Napi::Object js_stride = Napi::Object::New(env);
+    js_stride.Set("elementsPerLine", Napi::Number::New(env, stride.elements_per_line));
+    js_stride.Set("elementsPerPage", Napi::Number::New(env, stride.elements_per_page));
+    js_stride.Set("elementsPerHugePage", Napi::Number::New(env, stride.elements_per_huge_page));
+    js_stride.Set("linesPerElement", Napi::Number::New(env, stride.lines_per_element));
+    js_stride.Set("lineStraddle", Napi::Number::New(env, stride.line_straddle));
+    js_stride.Set("pageStraddle", Napi::Number::New(env, stride.page_straddle));
+    js_stride.Set("hugePageStraddle", Napi::Number::New(env, stride.huge_page_straddle));
+    js_stride.Set("shrinkSize", Napi::Number::New(env, stride.shrink_size));
+    js_stride.Set("alignedSize", Napi::Number::New(env, stride.aligned_size));
+    obj.Set("arrayStride", js_stride);
+    
+    if (!layout.template_name.empty()) {
+        obj.Set("templateName", layout.template_name);
+        obj.Set("templatePaddingExcess", Napi::Number::New(env, layout.template_padding_excess));
+    }
     obj.Set("isPolymorphic", Napi::Boolean::New(env, layout.is_polymorphic));
     obj.Set("isStandardLayout", Napi::Boolean::New(env, layout.is_standard_layout));
     
@@ -116,6 +431,13 @@ Napi::Object LayoutToJS(const Napi::Env& env, const StructLayout& layout) {
     }
     obj.Set("members", members);
     
+    // Base subobjects
+    Napi::Array bases = Napi::Array::New(env, layout.bases.size());
+    for (size_t i = 0; i < layout.bases.size(); i++) {
+        bases.Set(i, BaseToJS(env, layout.bases[i]));
+    }
+    obj.Set("bases", bases);
+    
     // Padding
     Napi::Array padding = Napi::Array::New(env, layout.padding.size());
     for (size_t i = 0; i < layout.padding.size(); i++) {
@@ -136,6 +458,125 @@ Napi::Object LayoutToJS(const Napi::Env& env, const StructLayout& layout) {
     return obj;
 }
 
+// Set "layouts", or "layoutBuffer" when the layouts were encoded with
+// BinaryEncoder. The buffer is copied into a JS-owned ArrayBuffer: external
+// buffers are refused under Electron's V8 sandbox, and one memcpy is
+// negligible next to building an object per member.
+void SetLayouts(
+    const Napi::Env& env,
+    Napi::Object& js_result,
+    const std::vector<StructLayout>& layouts,
+    const std::vector<uint8_t>* encoded
+) {
+    if (encoded) {
+        Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, encoded->size());
+        if (!encoded->empty()) {
+            std::memcpy(buffer.Data(), encoded->data(), encoded->size());
+        }
+        js_result.Set("layoutBuffer", buffer);
+        return;
+    }
+    
+    Napi::Array js_layouts = Napi::Array::New(env, layouts.size());
+    for (size_t i = 0; i < layouts.size(); i++) {
+        js_layouts.Set(i, LayoutToJS(env, layouts[i]));
+    }
+    js_result.Set("layouts", js_layouts);
+}
+
+Napi::Object StatsToJS(const Napi::Env& env, const AnalysisStats& stats) {
+    Napi::Object js_stats = Napi::Object::New(env);
+    js_stats.Set("totalMs", Napi::Number::New(env, stats.total_ms));
+    js_stats.Set("preambleMs", Napi::Number::New(env, stats.preamble_ms));
+    js_stats.Set("parseMs", Napi::Number::New(env, stats.parse_ms));
+    js_stats.Set("traversalMs", Napi::Number::New(env, stats.traversal_ms));
+    js_stats.Set("layoutMs", Napi::Number::New(env, stats.layout_ms));
+    js_stats.Set("accessMs", Napi::Number::New(env, stats.access_ms));
+    js_stats.Set("conversionMs", Napi::Number::New(env, stats.conversion_ms));
+    js_stats.Set("recordsVisited", Napi::Number::New(env, stats.records_visited));
+    js_stats.Set("recordsReported", Napi::Number::New(env, stats.records_reported));
+    js_stats.Set("astBytes", Napi::Number::New(env, static_cast<double>(stats.ast_bytes)));
+    js_stats.Set("layoutCacheHit", Napi::Boolean::New(env, stats.layout_cache_hit));
+    js_stats.Set("preambleReused", Napi::Boolean::New(env, stats.preamble_reused));
+    js_stats.Set("astReused", Napi::Boolean::New(env, stats.ast_reused));
+    return js_stats;
+}
+
+// Convert AnalysisResult to JS object. With stats, conversionMs covers the
+// encoding (already in result.stats) plus building the JS values here.
+Napi::Object ResultToJS(
+    const Napi::Env& env,
+    const AnalysisResult& result,
+    const std::vector<uint8_t>* encoded = nullptr
+) {
+    auto start = std::chrono::steady_clock::now();
+    Napi::Object js_result = Napi::Object::New(env);
+    js_result.Set("success", Napi::Boolean::New(env, result.success));
+    js_result.Set("errorMessage", result.error_message);
+    js_result.Set("cancelled", Napi::Boolean::New(env, result.cancelled));
+    SetLayouts(env, js_result, result.layouts, encoded);
+    
+    if (result.stats) {
+        AnalysisStats stats = *result.stats;
+        stats.conversion_ms += MillisecondsSince(start);
+        js_result.Set("stats", StatsToJS(env, stats));
+    }
+    return js_result;
+}
+
+// BinaryEncoder::Encode, timed as conversion when stats were requested
+std::vector<uint8_t> EncodeResult(AnalysisResult& result) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> encoded = BinaryEncoder::Encode(result.layouts);
+    if (result.stats) {
+        result.stats->conversion_ms += MillisecondsSince(start);
+    }
+    return encoded;
+}
+
+// Runs Analyzer::Analyze on the libuv thread pool and settles a promise
+class AnalyzeWorker : public Napi::AsyncWorker {
+public:
+    AnalyzeWorker(Napi::Env env, AnalysisRequest request, bool binary)
+        : Napi::AsyncWorker(env),
+          request_(std::move(request)),
+          binary_(binary),
+          deferred_(Napi::Promise::Deferred::New(env)) {}
+    
+    Napi::Promise GetPromise() const {
+        return deferred_.Promise();
+    }
+    
+protected:
+    // Runs on a worker thread - must not touch any JS values
+    void Execute() override {
+        try {
+            Analyzer analyzer(&PreambleCache::Global(), &LayoutCache::Global());
+            result_ = analyzer.Analyze(request_);
+            if (binary_) {
+                encoded_ = EncodeResult(result_);
+            }
+        } catch (const std::exception& e) {
+            SetError(e.what());
+        }
+    }
+    
+    void OnOK() override {
+        deferred_.Resolve(ResultToJS(Env(), result_, binary_ ? &encoded_ : nullptr));
+    }
+    
+    void OnError(const Napi::Error& error) override {
+        deferred_.Reject(error.Value());
+    }
+    
+private:
+    AnalysisRequest request_;
+    bool binary_;
+    AnalysisResult result_;
+    std::vector<uint8_t> encoded_; // Built on the worker thread
+    Napi::Promise::Deferred deferred_;
+};
+
 // Main analysis function exposed to JavaScript
 Napi::Value Analyze(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
@@ -151,21 +592,145 @@ Napi::Value Analyze(const Napi::CallbackInfo& info) {
         AnalysisRequest request = ParseRequest(info[0].As<Napi::Object>());
         
         // Create analyzer and perform analysis
-        Analyzer analyzer;
+        Analyzer analyzer(&PreambleCache::Global(), &LayoutCache::Global());
         AnalysisResult result = analyzer.Analyze(request);
         
         // Convert result to JS
+        if (WantsBinary(info[0].As<Napi::Object>())) {
+            std::vector<uint8_t> encoded = EncodeResult(result);
+            return ResultToJS(env, result, &encoded);
+        }
+        return ResultToJS(env, result);
+        
+    } catch (const std::exception& e) {
+        Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+}
+
+// Non-blocking variant of Analyze.
+// Returns { promise, cancel }: the promise resolves with the same object
+// Analyze returns, and cancel() asks the worker to stop parsing early.
+Napi::Value AnalyzeAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected an object argument")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    try {
+        // JS values can only be read here, before handing off to the worker
+        Napi::Object options = info[0].As<Napi::Object>();
+        AnalysisRequest request = ParseRequest(options);
+        CancellationFlag cancellation = std::make_shared<std::atomic<bool>>(false);
+        request.cancellation = cancellation;
+        
+        auto* worker = new AnalyzeWorker(env, std::move(request), WantsBinary(options));
+        Napi::Promise promise = worker->GetPromise();
+        worker->Queue(); // The worker deletes itself once settled
+        
+        Napi::Object handle = Napi::Object::New(env);
+        handle.Set("promise", promise);
+        handle.Set("cancel", Napi::Function::New(env,
+            [cancellation](const Napi::CallbackInfo&) {
+                cancellation->store(true, std::memory_order_relaxed);
+            }, "cancel"));
+        
+        return handle;
+        
+    } catch (const std::exception& e) {
+        Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+}
+
+// Runs a whole-project scan on a libuv thread; the scan fans out further
+// onto its own thread pool
+class ProjectScanWorker : public Napi::AsyncWorker {
+public:
+    ProjectScanWorker(Napi::Env env, ProjectScanRequest request, bool binary)
+        : Napi::AsyncWorker(env),
+          request_(std::move(request)),
+          binary_(binary),
+          deferred_(Napi::Promise::Deferred::New(env)) {}
+    
+    Napi::Promise GetPromise() const {
+        return deferred_.Promise();
+    }
+    
+protected:
+    void Execute() override {
+        try {
+            ProjectScanner scanner(&LayoutCache::Global());
+            result_ = scanner.Scan(request_);
+            if (binary_) {
+                encoded_ = BinaryEncoder::Encode(result_.layouts);
+            }
+        } catch (const std::exception& e) {
+            SetError(e.what());
+        }
+    }
+    
+    void OnOK() override {
+        Napi::Env env = Env();
         Napi::Object js_result = Napi::Object::New(env);
-        js_result.Set("success", Napi::Boolean::New(env, result.success));
-        js_result.Set("errorMessage", result.error_message);
+        js_result.Set("success", Napi::Boolean::New(env, result_.success));
+        js_result.Set("errorMessage", result_.error_message);
+        js_result.Set("cancelled", Napi::Boolean::New(env, result_.cancelled));
+        js_result.Set("filesScanned", Napi::Number::New(env, result_.files_scanned));
         
-        Napi::Array layouts = Napi::Array::New(env, result.layouts.size());
-        for (size_t i = 0; i < result.layouts.size(); i++) {
-            layouts.Set(i, LayoutToJS(env, result.layouts[i]));
+        Napi::Array failed = Napi::Array::New(env, result_.failed_files.size());
+        for (size_t i = 0; i < result_.failed_files.size(); i++) {
+            failed.Set(i, result_.failed_files[i]);
         }
-        js_result.Set("layouts", layouts);
+        js_result.Set("failedFiles", failed);
+        SetLayouts(env, js_result, result_.layouts, binary_ ? &encoded_ : nullptr);
         
-        return js_result;
+        deferred_.Resolve(js_result);
+    }
+    
+    void OnError(const Napi::Error& error) override {
+        deferred_.Reject(error.Value());
+    }
+    
+private:
+    ProjectScanRequest request_;
+    bool binary_;
+    ProjectScanResult result_;
+    std::vector<uint8_t> encoded_;
+    Napi::Promise::Deferred deferred_;
+};
+
+// Scan every TU of a compile_commands.json. Returns { promise, cancel }.
+Napi::Value ScanProject(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected an object argument")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    try {
+        Napi::Object options = info[0].As<Napi::Object>();
+        ProjectScanRequest request = ParseProjectScanRequest(options);
+        CancellationFlag cancellation = std::make_shared<std::atomic<bool>>(false);
+        request.cancellation = cancellation;
+        
+        auto* worker = new ProjectScanWorker(env, std::move(request), WantsBinary(options));
+        Napi::Promise promise = worker->GetPromise();
+        worker->Queue();
+        
+        Napi::Object handle = Napi::Object::New(env);
+        handle.Set("promise", promise);
+        handle.Set("cancel", Napi::Function::New(env,
+            [cancellation](const Napi::CallbackInfo&) {
+                cancellation->store(true, std::memory_order_relaxed);
+            }, "cancel"));
+        
+        return handle;
         
     } catch (const std::exception& e) {
         Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
@@ -173,9 +738,484 @@ Napi::Value Analyze(const Napi::CallbackInfo& info) {
     }
 }
 
+Napi::Array PlacementsToJS(const Napi::Env& env, const std::vector<TargetPlacement>& placements, bool member) {
+    Napi::Array js_placements = Napi::Array::New(env, placements.size());
+    for (size_t i = 0; i < placements.size(); i++) {
+        const TargetPlacement& placement = placements[i];
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("present", Napi::Boolean::New(env, placement.present));
+        if (member) {
+            obj.Set("offset", Napi::Number::New(env, placement.offset));
+            obj.Set("bitOffset", Napi::Number::New(env, placement.bit_offset));
+        }
+        obj.Set("size", Napi::Number::New(env, placement.size));
+        obj.Set("alignment", Napi::Number::New(env, placement.alignment));
+        js_placements.Set(i, obj);
+    }
+    return js_placements;
+}
+
+// Lays one source out for several target triples on a libuv thread; the
+// targets fan out further onto their own thread pool
+class TargetMatrixWorker : public Napi::AsyncWorker {
+public:
+    TargetMatrixWorker(Napi::Env env, TargetMatrixRequest request)
+        : Napi::AsyncWorker(env),
+          request_(std::move(request)),
+          deferred_(Napi::Promise::Deferred::New(env)) {}
+    
+    Napi::Promise GetPromise() const {
+        return deferred_.Promise();
+    }
+    
+protected:
+    void Execute() override {
+        try {
+            TargetMatrix matrix(&LayoutCache::Global());
+            result_ = matrix.Analyze(request_);
+        } catch (const std::exception& e) {
+            SetError(e.what());
+        }
+    }
+    
+    void OnOK() override {
+        Napi::Env env = Env();
+        Napi::Object js_result = Napi::Object::New(env);
+        js_result.Set("success", Napi::Boolean::New(env, result_.success));
+        js_result.Set("errorMessage", result_.error_message);
+        js_result.Set("cancelled", Napi::Boolean::New(env, result_.cancelled));
+        
+        Napi::Array targets = Napi::Array::New(env, result_.targets.size());
+        Napi::Array target_errors = Napi::Array::New(env, result_.target_errors.size());
+        for (size_t i = 0; i < result_.targets.size(); i++) {
+            targets.Set(i, result_.targets[i]);
+            target_errors.Set(i, result_.target_errors[i]);
+        }
+        js_result.Set("targets", targets);
+        js_result.Set("targetErrors", target_errors);
+        
+        Napi::Array records = Napi::Array::New(env, result_.records.size());
+        for (size_t i = 0; i < result_.records.size(); i++) {
+            const MatrixRecord& record = result_.records[i];
+            Napi::Object js_record = Napi::Object::New(env);
+            js_record.Set("qualifiedName", record.qualified_name);
+            js_record.Set("diverges", Napi::Boolean::New(env, record.diverges));
+            js_record.Set("targets", PlacementsToJS(env, record.targets, false));
+            
+            Napi::Array members = Napi::Array::New(env, record.members.size());
+            for (size_t j = 0; j < record.members.size(); j++) {
+                const MatrixMember& member = record.members[j];
+                Napi::Object js_member = Napi::Object::New(env);
+                js_member.Set("name", member.name);
+                js_member.Set("diverges", Napi::Boolean::New(env, member.diverges));
+                js_member.Set("targets", PlacementsToJS(env, member.targets, true));
+                members.Set(j, js_member);
+            }
+            js_record.Set("members", members);
+            records.Set(i, js_record);
+        }
+        js_result.Set("records", records);
+        
+        deferred_.Resolve(js_result);
+    }
+    
+    void OnError(const Napi::Error& error) override {
+        deferred_.Reject(error.Value());
+    }
+    
+private:
+    TargetMatrixRequest request_;
+    TargetMatrixResult result_;
+    Napi::Promise::Deferred deferred_;
+};
+
+// Lay a source out for every triple in request.targets and line the
+// layouts up. Returns { promise, cancel }.
+Napi::Value AnalyzeTargets(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected an object argument")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    try {
+        TargetMatrixRequest request = ParseTargetMatrixRequest(info[0].As<Napi::Object>());
+        CancellationFlag cancellation = std::make_shared<std::atomic<bool>>(false);
+        request.analysis.cancellation = cancellation;
+        
+        auto* worker = new TargetMatrixWorker(env, std::move(request));
+        Napi::Promise promise = worker->GetPromise();
+        worker->Queue();
+        
+        Napi::Object handle = Napi::Object::New(env);
+        handle.Set("promise", promise);
+        handle.Set("cancel", Napi::Function::New(env,
+            [cancellation](const Napi::CallbackInfo&) {
+                cancellation->store(true, std::memory_order_relaxed);
+            }, "cancel"));
+        
+        return handle;
+        
+    } catch (const std::exception& e) {
+        Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+}
+
+// Estimates one record's container footprints on a libuv thread; the
+// record is parsed twice (its layout, then the library node probe)
+class FootprintWorker : public Napi::AsyncWorker {
+public:
+    FootprintWorker(Napi::Env env, FootprintRequest request)
+        : Napi::AsyncWorker(env),
+          request_(std::move(request)),
+          deferred_(Napi::Promise::Deferred::New(env)) {}
+    
+    Napi::Promise GetPromise() const {
+        return deferred_.Promise();
+    }
+    
+protected:
+    void Execute() override {
+        try {
+            ContainerFootprintEstimator estimator(&LayoutCache::Global());
+            result_ = estimator.Analyze(request_);
+        } catch (const std::exception& e) {
+            SetError(e.what());
+        }
+    }
+    
+    void OnOK() override {
+        Napi::Env env = Env();
+        Napi::Object js_result = Napi::Object::New(env);
+        js_result.Set("success", Napi::Boolean::New(env, result_.success));
+        js_result.Set("errorMessage", result_.error_message);
+        js_result.Set("cancelled", Napi::Boolean::New(env, result_.cancelled));
+        js_result.Set("qualifiedName", result_.qualified_name);
+        js_result.Set("elementSize", Napi::Number::New(env, result_.element_size));
+        js_result.Set("elementAlignment", Napi::Number::New(env, result_.element_alignment));
+        js_result.Set("elementCount", Napi::Number::New(env, result_.element_count));
+        js_result.Set("keyType", result_.key_type);
+        
+        Napi::Array containers = Napi::Array::New(env, result_.containers.size());
+        for (size_t i = 0; i < result_.containers.size(); i++) {
+            const ContainerFootprint& footprint = result_.containers[i];
+            Napi::Object obj = Napi::Object::New(env);
+            obj.Set("container", footprint.container);
+            obj.Set("nodeType", footprint.node_type);
+            obj.Set("objectSize", Napi::Number::New(env, footprint.object_size));
+            obj.Set("nodeSize", Napi::Number::New(env, footprint.node_size));
+            obj.Set("allocationSize", Napi::Number::New(env, footprint.allocation_size));
+            obj.Set("elementsPerAllocation", Napi::Number::New(env, footprint.elements_per_allocation));
+            obj.Set("projectedBytes", Napi::Number::New(env, footprint.projected_bytes));
+            obj.Set("bytesPerElement", Napi::Number::New(env, footprint.bytes_per_element));
+            obj.Set("measured", Napi::Boolean::New(env, footprint.measured));
+            containers.Set(i, obj);
+        }
+        js_result.Set("containers", containers);
+        
+        deferred_.Resolve(js_result);
+    }
+    
+    void OnError(const Napi::Error& error) override {
+        deferred_.Reject(error.Value());
+    }
+    
+private:
+    FootprintRequest request_;
+    FootprintResult result_;
+    Napi::Promise::Deferred deferred_;
+};
+
+// Estimate the per-element footprint of request.structName in the
+// standard containers for request.elementCount elements.
+// Returns { promise, cancel }.
+Napi::Value EstimateFootprint(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected an object argument")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    try {
+        FootprintRequest request = ParseFootprintRequest(info[0].As<Napi::Object>());
+        CancellationFlag cancellation = std::make_shared<std::atomic<bool>>(false);
+        request.analysis.cancellation = cancellation;
+        
+        auto* worker = new FootprintWorker(env, std::move(request));
+        Napi::Promise promise = worker->GetPromise();
+        worker->Queue();
+        
+        Napi::Object handle = Napi::Object::New(env);
+        handle.Set("promise", promise);
+        handle.Set("cancel", Napi::Function::New(env,
+            [cancellation](const Napi::CallbackInfo&) {
+                cancellation->store(true, std::memory_order_relaxed);
+            }, "cancel"));
+        
+        return handle;
+        
+    } catch (const std::exception& e) {
+        Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+}
+
+// Reparses a session's document on the libuv thread pool
+class SessionUpdateWorker : public Napi::AsyncWorker {
+public:
+    SessionUpdateWorker(
+        Napi::Env env,
+        std::shared_ptr<Session> session,
+        AnalysisRequest request,
+        int64_t version
+    ) : Napi::AsyncWorker(env),
+        session_(std::move(session)),
+        request_(std::move(request)),
+        version_(version),
+        reparsed_(false),
+        deferred_(Napi::Promise::Deferred::New(env)) {}
+    
+    Napi::Promise GetPromise() const {
+        return deferred_.Promise();
+    }
+    
+protected:
+    void Execute() override {
+        try {
+            result_ = session_->Update(request_, version_, reparsed_);
+        } catch (const std::exception& e) {
+            SetError(e.what());
+        }
+    }
+    
+    void OnOK() override {
+        Napi::Env env = Env();
+        Napi::Object js_result = Napi::Object::New(env);
+        js_result.Set("success", Napi::Boolean::New(env, result_.success));
+        js_result.Set("errorMessage", result_.error_message);
+        js_result.Set("cancelled", Napi::Boolean::New(env, result_.cancelled));
+        js_result.Set("reparsed", Napi::Boolean::New(env, reparsed_));
+        js_result.Set("version", Napi::Number::New(env, session_->GetVersion()));
+        deferred_.Resolve(js_result);
+    }
+    
+    void OnError(const Napi::Error& error) override {
+        deferred_.Reject(error.Value());
+    }
+    
+private:
+    std::shared_ptr<Session> session_;
+    AnalysisRequest request_;
+    int64_t version_;
+    bool reparsed_;
+    AnalysisResult result_;
+    Napi::Promise::Deferred deferred_;
+};
+
+// Answers a struct query against a session's AST on the libuv thread pool
+class SessionQueryWorker : public Napi::AsyncWorker {
+public:
+    SessionQueryWorker(
+        Napi::Env env,
+        std::shared_ptr<Session> session,
+        AnalysisRequest request,
+        bool binary
+    ) : Napi::AsyncWorker(env),
+        session_(std::move(session)),
+        request_(std::move(request)),
+        binary_(binary),
+        deferred_(Napi::Promise::Deferred::New(env)) {}
+    
+    Napi::Promise GetPromise() const {
+        return deferred_.Promise();
+    }
+    
+protected:
+    void Execute() override {
+        try {
+            result_ = session_->Query(request_);
+            if (binary_) {
+                encoded_ = EncodeResult(result_);
+            }
+        } catch (const std::exception& e) {
+            SetError(e.what());
+        }
+    }
+    
+    void OnOK() override {
+        deferred_.Resolve(ResultToJS(Env(), result_, binary_ ? &encoded_ : nullptr));
+    }
+    
+    void OnError(const Napi::Error& error) override {
+        deferred_.Reject(error.Value());
+    }
+    
+private:
+    std::shared_ptr<Session> session_;
+    AnalysisRequest request_;
+    bool binary_;
+    AnalysisResult result_;
+    std::vector<uint8_t> encoded_;
+    Napi::Promise::Deferred deferred_;
+};
+
+// JS handle for a Session: update(request, version), query(structName), close()
+class SessionWrap : public Napi::ObjectWrap<SessionWrap> {
+public:
+    static Napi::Function Define(Napi::Env env) {
+        return DefineClass(env, "Session", {
+            InstanceMethod("update", &SessionWrap::Update),
+            InstanceMethod("query", &SessionWrap::Query),
+            InstanceMethod("close", &SessionWrap::Close)
+        });
+    }
+    
+    explicit SessionWrap(const Napi::CallbackInfo& info)
+        : Napi::ObjectWrap<SessionWrap>(info),
+          session_(std::make_shared<Session>(&PreambleCache::Global(), &LayoutCache::Global())) {}
+    
+private:
+    // Workers hold their own reference, so close() never frees an AST in use
+    std::shared_ptr<Session> session_;
+    
+    bool CheckOpen(const Napi::Env& env) {
+        if (!session_) {
+            Napi::Error::New(env, "Session is closed").ThrowAsJavaScriptException();
+            return false;
+        }
+        return true;
+    }
+    
+    // Returns { promise, cancel } like analyzeAsync
+    Napi::Value Update(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        
+        if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsNumber()) {
+            Napi::TypeError::New(env, "Expected (request, version) arguments")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (!CheckOpen(env)) {
+            return env.Null();
+        }
+        
+        try {
+            AnalysisRequest request = ParseRequest(info[0].As<Napi::Object>());
+            int64_t version = info[1].As<Napi::Number>().Int64Value();
+            CancellationFlag cancellation = std::make_shared<std::atomic<bool>>(false);
+            request.cancellation = cancellation;
+            
+            auto* worker = new SessionUpdateWorker(env, session_, std::move(request), version);
+            Napi::Promise promise = worker->GetPromise();
+            worker->Queue();
+            
+            Napi::Object handle = Napi::Object::New(env);
+            handle.Set("promise", promise);
+            handle.Set("cancel", Napi::Function::New(env,
+                [cancellation](const Napi::CallbackInfo&) {
+                    cancellation->store(true, std::memory_order_relaxed);
+                }, "cancel"));
+            
+            return handle;
+            
+        } catch (const std::exception& e) {
+            Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+    
+    // query(structName, options?) where options may hold line/column, the
+    // file filters, profilePath, cacheLineSize, stats and binary. Returns
+    // { promise, cancel }: the promise resolves with the object analyze()
+    // returns, and cancel() stops this query only.
+    Napi::Value Query(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        
+        if (!CheckOpen(env)) {
+            return env.Null();
+        }
+        
+        AnalysisRequest request;
+        bool binary = false;
+        if (info.Length() > 0 && info[0].IsString()) {
+            request.struct_name = info[0].As<Napi::String>().Utf8Value();
+        }
+        if (info.Length() > 1 && info[1].IsObject()) {
+            try {
+                ParseQueryOptions(info[1].As<Napi::Object>(), request);
+            } catch (const std::exception& e) {
+                Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            binary = WantsBinary(info[1].As<Napi::Object>());
+        }
+        
+        CancellationFlag cancellation = std::make_shared<std::atomic<bool>>(false);
+        request.cancellation = cancellation;
+        
+        auto* worker = new SessionQueryWorker(env, session_, std::move(request), binary);
+        Napi::Promise promise = worker->GetPromise();
+        worker->Queue();
+        
+        Napi::Object handle = Napi::Object::New(env);
+        handle.Set("promise", promise);
+        handle.Set("cancel", Napi::Function::New(env,
+            [cancellation](const Napi::CallbackInfo&) {
+                cancellation->store(true, std::memory_order_relaxed);
+            }, "cancel"));
+        
+        return handle;
+    }
+    
+    Napi::Value Close(const Napi::CallbackInfo& info) {
+        if (session_) {
+            session_->Close();
+            session_.reset();
+        }
+        return info.Env().Undefined();
+    }
+};
+
+// setCacheDirectory(path): persist results under path, shared by every
+// process using the same directory. An empty path turns the cache off.
+Napi::Value SetCacheDirectory(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected a directory path")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    LayoutCache::Global().SetDirectory(info[0].As<Napi::String>().Utf8Value());
+    return env.Undefined();
+}
+
+// Open a persistent analysis session for one document
+Napi::Value OpenSession(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    Napi::FunctionReference* constructor = env.GetInstanceData<Napi::FunctionReference>();
+    return constructor->New({});
+}
+
 // Initialize the addon
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
     exports.Set("analyze", Napi::Function::New(env, Analyze));
+    exports.Set("analyzeAsync", Napi::Function::New(env, AnalyzeAsync));
+    exports.Set("scanProject", Napi::Function::New(env, ScanProject));
+    exports.Set("analyzeTargets", Napi::Function::New(env, AnalyzeTargets));
+    exports.Set("estimateFootprint", Napi::Function::New(env, EstimateFootprint));
+    exports.Set("setCacheDirectory", Napi::Function::New(env, SetCacheDirectory));
+    
+    Napi::Function session_class = SessionWrap::Define(env);
+    env.SetInstanceData(new Napi::FunctionReference(Napi::Persistent(session_class)));
+    exports.Set("Session", session_class);
+    exports.Set("openSession", Napi::Function::New(env, OpenSession));
     return exports;
 }
 
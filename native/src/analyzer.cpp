@@ -1,46 +1,261 @@
 #include "analyzer.h"
 #include "layout_calculator.h"
-#include <clang/Tooling/Tooling.h>
+#include "access_analyzer.h"
+#include "vtable_analyzer.h"
 #include <clang/Frontend/FrontendActions.h>
 #include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/AST/Attr.h>
+#include <clang/Basic/DiagnosticOptions.h>
 #include <clang/Frontend/CompilerInstance.h>
-#include <clang/Tooling/FixedCompilationDatabase.h>
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Frontend/Utils.h>
+#include <clang/Lex/PreprocessorOptions.h>
+#include <clang/Serialization/PCHContainerOperations.h>
+#include <llvm/Support/FileSystem.h>
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <unordered_map>
 
 namespace structsight {
 
-// AST Visitor to find and analyze record declarations
+// True once the caller has requested cancellation of this analysis
+static bool IsCancelled(const AnalysisRequest& request) {
+    return request.cancellation && request.cancellation->load(std::memory_order_relaxed);
+}
+
+// Directory holding Clang's builtin headers (stddef.h, the intrinsics
+// <atomic> and <immintrin.h> use). The driver looks for it next to argv[0],
+// which names no real install here, so it is passed as -resource-dir=
+// like ClangTool does. The build records the directory of the Clang it
+// links; without that it is found relative to the running executable.
+static const std::string& ResourceDirectory() {
+    static const std::string directory = [] {
+#ifdef STRUCTSIGHT_CLANG_RESOURCE_DIR
+        if (llvm::sys::fs::is_directory(STRUCTSIGHT_CLANG_RESOURCE_DIR)) {
+            return std::string(STRUCTSIGHT_CLANG_RESOURCE_DIR);
+        }
+#endif
+        static int anchor;
+        return clang::CompilerInvocation::GetResourcesPath("structsight", &anchor);
+    }();
+    return directory;
+}
+
+// Annotation for fields written by several threads that the type alone
+// doesn't reveal: [[clang::annotate("structsight::shared")]]
+static const char* const kSharedAnnotation = "structsight::shared";
+
+// Levels of nested members kept under a top-level member; deeper padding
+// is still counted in nested_padding
+static const unsigned kMaxNestingDepth = 4;
+
+// Whether a type holds state that different threads write: std atomics,
+// mutexes and other synchronization primitives, C11 _Atomic, pthread
+// locks, anything named like a spinlock, and records or arrays of these
+static bool IsThreadSharedType(clang::QualType type, unsigned depth = 0) {
+    if (depth > 4) {
+        return false;
+    }
+    
+    // Typedef names first, since pthread types are typedefs of plain structs
+    for (clang::QualType sugared = type; ; ) {
+        if (const auto* typedef_type = sugared->getAs<clang::TypedefType>()) {
+            llvm::StringRef name = typedef_type->getDecl()->getName();
+            if (name.startswith("pthread_mutex") || name.startswith("pthread_spinlock") ||
+                name.startswith("pthread_rwlock") || name.startswith("pthread_cond") ||
+                name.contains_insensitive("spinlock")) {
+                return true;
+            }
+            sugared = typedef_type->desugar();
+            continue;
+        }
+        break;
+    }
+    
+    clang::QualType canonical = type.getCanonicalType();
+    if (canonical->isAtomicType()) {
+        return true;
+    }
+    if (const auto* array = llvm::dyn_cast<clang::ConstantArrayType>(canonical)) {
+        return IsThreadSharedType(array->getElementType(), depth + 1);
+    }
+    
+    const auto* record = canonical->getAsRecordDecl();
+    if (!record) {
+        return false;
+    }
+    
+    llvm::StringRef name = record->getName();
+    if (record->isInStdNamespace()) {
+        static const llvm::StringRef kStdTypes[] = {
+            "atomic", "atomic_flag", "mutex", "recursive_mutex", "timed_mutex",
+            "recursive_timed_mutex", "shared_mutex", "shared_timed_mutex",
+            "condition_variable", "condition_variable_any", "counting_semaphore",
+            "latch", "barrier"
+        };
+        for (llvm::StringRef std_type : kStdTypes) {
+            if (name == std_type) {
+                return true;
+            }
+        }
+    }
+    if (name.contains_insensitive("spinlock") || name.contains_insensitive("spin_lock")) {
+        return true;
+    }
+    
+    // A wrapper such as a padded counter is shared if what it holds is
+    record = record->getDefinition();
+    if (!record || record->isInStdNamespace()) {
+        return false;
+    }
+    for (const auto* field : record->fields()) {
+        if (IsThreadSharedType(field->getType(), depth + 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool IsThreadShared(const clang::FieldDecl* field) {
+    for (const auto* annotation : field->specific_attrs<clang::AnnotateAttr>()) {
+        if (annotation->getAnnotation() == kSharedAnnotation) {
+            return true;
+        }
+    }
+    return IsThreadSharedType(field->getType());
+}
+
+// Drop children more than `depth` levels below `members`
+static void TrimNesting(std::vector<MemberInfo>& members, unsigned depth) {
+    for (auto& member : members) {
+        if (depth <= 1) {
+            member.children.clear();
+            member.padding.clear();
+        } else {
+            TrimNesting(member.children, depth - 1);
+        }
+    }
+}
+
+// Bytes of a base subobject that hold its data. A derived class may put
+// members in the rest of a non-POD base's sizeof (Itanium tail padding
+// reuse), and the base's own virtual bases live elsewhere in the object.
+static uint64_t BaseDataSize(const clang::ASTContext& context, const clang::CXXRecordDecl* base) {
+    if (base->isEmpty()) {
+        return 0;
+    }
+    const clang::ASTRecordLayout& layout = context.getASTRecordLayout(base);
+    return std::min(layout.getDataSize(), layout.getNonVirtualSize()).getQuantity();
+}
+
+// Qualified name of the template a concrete record comes from: the class
+// template it specializes (instantiated or explicitly specialized), or the
+// pattern of a member class of a class template specialization. Empty for
+// records that aren't specializations.
+static std::string TemplateName(const clang::RecordDecl* record) {
+    if (const auto* specialization = llvm::dyn_cast<clang::ClassTemplateSpecializationDecl>(record)) {
+        return specialization->getSpecializedTemplate()->getQualifiedNameAsString();
+    }
+    const auto* cxx_record = llvm::dyn_cast<clang::CXXRecordDecl>(record);
+    if (cxx_record && clang::isTemplateInstantiation(cxx_record->getTemplateSpecializationKind())) {
+        if (const clang::CXXRecordDecl* pattern = cxx_record->getInstantiatedFromMemberClass()) {
+            return pattern->getQualifiedNameAsString();
+        }
+    }
+    return std::string();
+}
+
+// Name of a record as reported, qualified or not; specializations are
+// named with their template arguments
+static std::string RecordName(
+    const clang::RecordDecl* record,
+    const clang::ASTContext& context,
+    bool qualified
+) {
+    const auto* specialization = llvm::dyn_cast<clang::ClassTemplateSpecializationDecl>(record);
+    if (!specialization) {
+        return qualified ? record->getQualifiedNameAsString() : record->getNameAsString();
+    }
+    std::string name;
+    llvm::raw_string_ostream stream(name);
+    specialization->getNameForDiagnostic(stream, context.getPrintingPolicy(), qualified);
+    return stream.str();
+}
+
+// AST Visitor to find and analyze record declarations.
+// Whole subtrees (e.g. namespace std) are skipped when they come from a
+// file the request excludes, and a targeted query stops at its first match.
 class StructVisitor : public clang::RecursiveASTVisitor<StructVisitor> {
 public:
     StructVisitor(
         clang::ASTContext& ctx,
         const AnalysisRequest& req,
-        std::vector<StructLayout>& results
-    ) : context_(ctx), request_(req), results_(results) {}
+        std::vector<StructLayout>& results,
+        AccessAnalyzer& accesses,
+        AnalysisStats* stats = nullptr
+    ) : context_(ctx), request_(req), results_(results), accesses_(accesses), stats_(stats),
+        found_target_(false), skipped_(false) {}
+    
+    // Whether claim_record declined any record
+    bool SkippedRecords() const { return skipped_; }
+    
+    bool TraverseDecl(clang::Decl* decl) {
+        // Returning false aborts the traversal
+        if (found_target_ || IsCancelled(request_)) {
+            return false;
+        }
+        
+        if (decl && !llvm::isa<clang::TranslationUnitDecl>(decl) && !ShouldTraverse(decl)) {
+            return true; // Skip this subtree, keep going with its siblings
+        }
+        
+        return clang::RecursiveASTVisitor<StructVisitor>::TraverseDecl(decl);
+    }
+    
+    // Implicit instantiations are walked from their template, so they are
+    // only reported when the template's file is
+    bool shouldVisitTemplateInstantiations() const {
+        return request_.include_template_instantiations;
+    }
     
     bool VisitRecordDecl(clang::RecordDecl* decl) {
-        // Skip incomplete and implicit declarations
-        if (!decl->isCompleteDefinition() || decl->isImplicit()) {
+        // Skip incomplete, implicit and uninstantiated template declarations
+        if (!decl->isCompleteDefinition() || decl->isImplicit() ||
+            decl->isInvalidDecl() || decl->isDependentType()) {
             return true;
         }
         
-        // Check if we're looking for a specific struct
-        if (!request_.struct_name.empty()) {
-            std::string name = decl->getNameAsString();
-            if (name != request_.struct_name) {
-                return true;
-            }
+        if (stats_) {
+            stats_->records_visited++;
+        }
+        
+        if (!MatchesTarget(decl)) {
+            return true;
+        }
+        
+        // Another analysis is already laying this record out
+        if (request_.claim_record && !request_.claim_record(RecordName(decl, context_, true))) {
+            skipped_ = true;
+            return true;
         }
         
         // Process this record
         try {
             Analyzer analyzer;
-            StructLayout layout = analyzer.ProcessRecord(decl, context_, request_);
+            StructLayout layout = analyzer.ProcessRecord(decl, context_, request_, &accesses_, stats_);
             results_.push_back(layout);
         } catch (const std::exception& e) {
             // Log error but continue visiting
         }
         
+        // A targeted query is done once its record is found; targeting a
+        // class template collects all of its specializations
+        if (IsTargeted() && TemplateName(decl).empty()) {
+            found_target_ = true;
+            return false;
+        }
+        
         return true;
     }
     
@@ -48,123 +263,473 @@ private:
     clang::ASTContext& context_;
     const AnalysisRequest& request_;
     std::vector<StructLayout>& results_;
+    AccessAnalyzer& accesses_;
+    AnalysisStats* stats_;
+    bool found_target_;
+    bool skipped_;
+    
+    // Per-file traversal decision, keyed by FileID
+    std::unordered_map<unsigned, bool> file_allowed_;
+    
+    bool IsTargeted() const {
+        return request_.target_line > 0 || !request_.struct_name.empty();
+    }
+    
+    bool ShouldTraverse(const clang::Decl* decl) {
+        const clang::SourceManager& sm = context_.getSourceManager();
+        clang::SourceLocation loc = sm.getExpansionLoc(decl->getLocation());
+        if (loc.isInvalid()) {
+            return true;
+        }
+        
+        clang::FileID file = sm.getFileID(loc);
+        auto cached = file_allowed_.find(file.getHashValue());
+        if (cached != file_allowed_.end()) {
+            return cached->second;
+        }
+        
+        bool allowed = IsFileAllowed(sm, file, loc);
+        file_allowed_.emplace(file.getHashValue(), allowed);
+        return allowed;
+    }
+    
+    bool IsFileAllowed(
+        const clang::SourceManager& sm,
+        clang::FileID file,
+        clang::SourceLocation loc
+    ) const {
+        if (file == sm.getMainFileID()) {
+            return true;
+        }
+        
+        // A location target can only be in the main file
+        if (request_.target_line > 0) {
+            return false;
+        }
+        
+        if (!request_.include_system_headers && sm.isInSystemHeader(loc)) {
+            return false;
+        }
+        
+        if (request_.path_filter.empty()) {
+            return true;
+        }
+        
+        std::string path;
+        if (const clang::FileEntry* entry = sm.getFileEntryForID(file)) {
+            path = entry->tryGetRealPathName().str();
+            if (path.empty()) {
+                path = entry->getName().str();
+            }
+        }
+        
+        for (const auto& prefix : request_.path_filter) {
+            if (llvm::StringRef(path).startswith(prefix)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    bool MatchesTarget(const clang::RecordDecl* decl) const {
+        if (request_.target_line > 0) {
+            return HeadContainsTarget(decl);
+        }
+        
+        // Check if we're looking for a specific struct
+        if (!request_.struct_name.empty()) {
+            return decl->getNameAsString() == request_.struct_name;
+        }
+        
+        return true;
+    }
+    
+    // True if the target position lies between "struct" and the end of the
+    // record's name, so hovering either the keyword or the name selects it
+    bool HeadContainsTarget(const clang::RecordDecl* decl) const {
+        const clang::SourceManager& sm = context_.getSourceManager();
+        clang::SourceLocation begin = sm.getExpansionLoc(decl->getBeginLoc());
+        clang::SourceLocation name = sm.getExpansionLoc(decl->getLocation());
+        
+        if (!sm.isWrittenInMainFile(begin) || !sm.isWrittenInMainFile(name)) {
+            return false;
+        }
+        
+        auto position = [&sm](clang::SourceLocation loc, unsigned extra_columns) {
+            return std::make_pair(
+                sm.getExpansionLineNumber(loc),
+                sm.getExpansionColumnNumber(loc) + extra_columns
+            );
+        };
+        
+        auto target = std::make_pair(
+            static_cast<unsigned>(request_.target_line),
+            static_cast<unsigned>(request_.target_column)
+        );
+        unsigned name_length = static_cast<unsigned>(decl->getName().size());
+        
+        return position(begin, 0) <= target && target <= position(name, name_length);
+    }
 };
 
-// AST Consumer to traverse the AST
-class StructConsumer : public clang::ASTConsumer {
+// AST Consumer that only watches for cancellation while parsing
+class ParseConsumer : public clang::ASTConsumer {
 public:
-    StructConsumer(
-        clang::ASTContext& ctx,
-        const AnalysisRequest& req,
-        std::vector<StructLayout>& results
-    ) : visitor_(ctx, req, results) {}
+    explicit ParseConsumer(const AnalysisRequest& req) : request_(req) {}
     
-    void HandleTranslationUnit(clang::ASTContext& context) override {
-        visitor_.TraverseDecl(context.getTranslationUnitDecl());
+    // Returning false makes the parser stop after the current top-level
+    // declaration, so a cancelled request doesn't pay for the rest of the TU
+    bool HandleTopLevelDecl(clang::DeclGroupRef /*group*/) override {
+        return !IsCancelled(request_);
     }
     
 private:
-    StructVisitor visitor_;
+    const AnalysisRequest& request_;
 };
 
 // Frontend Action to create the consumer
-class StructAction : public clang::ASTFrontendAction {
+class ParseAction : public clang::ASTFrontendAction {
 public:
-    StructAction(const AnalysisRequest& req, std::vector<StructLayout>& results)
-        : request_(req), results_(results) {}
+    explicit ParseAction(const AnalysisRequest& req) : request_(req) {}
     
     std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(
         clang::CompilerInstance& compiler,
         llvm::StringRef file
     ) override {
-        return std::make_unique<StructConsumer>(
-            compiler.getASTContext(),
-            request_,
-            results_
-        );
+        return std::make_unique<ParseConsumer>(request_);
     }
     
 private:
+    // Only read while Execute() runs; ParsedUnit outlives the request
     const AnalysisRequest& request_;
-    std::vector<StructLayout>& results_;
 };
 
+// ParsedUnit implementation
+
+ParsedUnit::~ParsedUnit() {
+    accesses_.reset(); // Refers into the AST
+    
+    // Tears down Sema and the ASTContext
+    if (action_) {
+        action_->EndSourceFile();
+    }
+}
+
+clang::ASTContext& ParsedUnit::GetASTContext() {
+    return compiler_->getASTContext();
+}
+
+const std::vector<std::string>& ParsedUnit::GetIncludedFiles() const {
+    return included_files_;
+}
+
+AccessAnalyzer& ParsedUnit::GetAccessAnalyzer() {
+    if (!accesses_) {
+        accesses_ = std::make_unique<AccessAnalyzer>(GetASTContext());
+    }
+    return *accesses_;
+}
+
 // Analyzer implementation
 
-Analyzer::Analyzer() = default;
+Analyzer::Analyzer(PreambleCache* preamble_cache, LayoutCache* layout_cache)
+    : preamble_cache_(preamble_cache), layout_cache_(layout_cache) {}
 Analyzer::~Analyzer() = default;
 
+std::vector<std::string> Analyzer::BuildCompileArgs(const AnalysisRequest& request) const {
+    std::vector<std::string> args = {"clang++", "-fsyntax-only", "-std=c++17"};
+    
+    // Add target or architecture flag
+    if (!request.target_triple.empty()) {
+        args.push_back("-target");
+        args.push_back(request.target_triple);
+    } else if (request.architecture == Architecture::X86) {
+        args.push_back("-m32");
+    } else {
+        args.push_back("-m64");
+    }
+    
+    // Add compiler-specific flags
+    switch (request.compiler) {
+        case Compiler::GCC:
+            args.push_back("-fno-ms-compatibility");
+            break;
+        case Compiler::MSVC:
+            args.push_back("-fms-compatibility");
+            args.push_back("-fms-extensions");
+            break;
+        case Compiler::Clang:
+        default:
+            break;
+    }
+    
+    // Add user-provided flags
+    args.insert(args.end(), request.compile_flags.begin(), request.compile_flags.end());
+    
+    // Unless they name a resource directory of their own
+    bool has_resource_dir = std::any_of(args.begin(), args.end(), [](const std::string& arg) {
+        return llvm::StringRef(arg).startswith("-resource-dir");
+    });
+    if (!has_resource_dir) {
+        args.push_back("-resource-dir=" + ResourceDirectory());
+    }
+    
+    return args;
+}
+
+std::shared_ptr<clang::CompilerInvocation> Analyzer::CreateInvocation(
+    const std::vector<std::string>& args,
+    const std::string& file_path,
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> vfs
+) {
+    std::vector<const char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(arg.c_str());
+    }
+    argv.push_back(file_path.c_str());
+    
+    llvm::IntrusiveRefCntPtr<clang::DiagnosticsEngine> diagnostics =
+        clang::CompilerInstance::createDiagnostics(
+            new clang::DiagnosticOptions(),
+            new clang::IgnoringDiagConsumer(),
+            true
+        );
+    
+    std::unique_ptr<clang::CompilerInvocation> invocation =
+        clang::createInvocationFromCommandLine(argv, diagnostics, vfs);
+    
+    // The driver adds -disable-free, which would leak every AST we build
+    if (invocation) {
+        invocation->getFrontendOpts().DisableFree = false;
+    }
+    
+    return std::shared_ptr<clang::CompilerInvocation>(std::move(invocation));
+}
+
 AnalysisResult Analyzer::Analyze(const AnalysisRequest& request) {
+    auto start = std::chrono::steady_clock::now();
     AnalysisResult result;
     result.success = false;
     
+    if (!AnalyzeCached(request, result)) {
+        std::unique_ptr<ParsedUnit> unit = Parse(request, result);
+        if (unit) {
+            result = AnalyzeUnit(*unit, request);
+            CacheResult(request, *unit, result);
+        }
+    }
+    
+    if (result.stats) {
+        result.stats->total_ms = MillisecondsSince(start);
+    }
+    return result;
+}
+
+bool Analyzer::AnalyzeCached(const AnalysisRequest& request, AnalysisResult& result) {
+    if (!layout_cache_ || !layout_cache_->IsEnabled()) {
+        return false;
+    }
+    
+    std::vector<StructLayout> layouts;
+    if (!layout_cache_->Lookup(LayoutCache::ComputeKey(request), layouts)) {
+        return false;
+    }
+    
+    result.success = true;
+    result.error_message.clear();
+    result.layouts = std::move(layouts);
+    if (request.collect_stats) {
+        result.stats.emplace();
+        result.stats->layout_cache_hit = true;
+        result.stats->records_reported = static_cast<uint32_t>(result.layouts.size());
+    }
+    return true;
+}
+
+void Analyzer::CacheResult(
+    const AnalysisRequest& request,
+    const ParsedUnit& unit,
+    const AnalysisResult& result
+) {
+    // A result missing records other analyses claimed isn't the request's
+    if (!layout_cache_ || !layout_cache_->IsEnabled() || !result.success || result.cancelled ||
+        result.records_skipped) {
+        return;
+    }
+    layout_cache_->Store(LayoutCache::ComputeKey(request), result.layouts, unit.GetIncludedFiles());
+}
+
+std::unique_ptr<ParsedUnit> Analyzer::Parse(
+    const AnalysisRequest& request,
+    AnalysisResult& result
+) {
+    result.success = false;
+    
+    if (IsCancelled(request)) {
+        result.cancelled = true;
+        result.error_message = "Analysis cancelled";
+        return nullptr;
+    }
+    
     try {
-        // Prepare compile flags
-        std::vector<std::string> args = {"-std=c++17"};
+        std::string file_path = request.file_path.empty() ? "input.cpp" : request.file_path;
+        std::vector<std::string> args = BuildCompileArgs(request);
+        
+        // Serve the unsaved buffer from memory, everything else from disk
+        llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> memory_fs(
+            new llvm::vfs::InMemoryFileSystem());
+        memory_fs->addFile(
+            file_path, 0, llvm::MemoryBuffer::getMemBufferCopy(request.source_code, file_path));
+        llvm::IntrusiveRefCntPtr<llvm::vfs::OverlayFileSystem> overlay_fs(
+            new llvm::vfs::OverlayFileSystem(llvm::vfs::getRealFileSystem()));
+        overlay_fs->pushOverlay(memory_fs);
+        llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> vfs = overlay_fs;
+        
+        std::shared_ptr<clang::CompilerInvocation> invocation =
+            CreateInvocation(args, file_path, vfs);
+        if (!invocation) {
+            result.error_message = "Invalid compile flags";
+            return nullptr;
+        }
+        
+        std::unique_ptr<llvm::MemoryBuffer> buffer =
+            llvm::MemoryBuffer::getMemBufferCopy(request.source_code, file_path);
+        
+        auto unit = std::make_unique<ParsedUnit>();
+        AnalysisStats& stats = unit->parse_stats_;
         
-        // Add architecture flag
-        if (request.architecture == Architecture::X86) {
-            args.push_back("-m32");
+        // Reuse the precompiled #include block when it is still valid
+        if (preamble_cache_) {
+            auto preamble_start = std::chrono::steady_clock::now();
+            std::string flags_key;
+            for (const auto& arg : args) {
+                flags_key += arg;
+                flags_key += '\0';
+            }
+            unit->preamble_ = preamble_cache_->Get(
+                file_path, flags_key, *invocation, *buffer, vfs, &unit->included_files_,
+                &stats.preamble_reused);
+            stats.preamble_ms = MillisecondsSince(preamble_start);
+        }
+        
+        if (unit->preamble_) {
+            // Also remaps the main file to `buffer`
+            unit->preamble_->AddImplicitPreamble(*invocation, vfs, buffer.get());
         } else {
-            args.push_back("-m64");
-        }
-        
-        // Add compiler-specific flags
-        switch (request.compiler) {
-            case Compiler::GCC:
-                args.push_back("-fno-ms-compatibility");
-                break;
-            case Compiler::MSVC:
-                args.push_back("-fms-compatibility");
-                args.push_back("-fms-extensions");
-                break;
-            case Compiler::Clang:
-            default:
-                break;
-        }
-        
-        // Add user-provided flags
-        args.insert(args.end(), request.compile_flags.begin(), request.compile_flags.end());
-        
-        // Create compilation database
-        auto comp_db = clang::tooling::FixedCompilationDatabase::loadFromCommandLine(
-            args.size(),
-            [&args]() {
-                std::vector<const char*> ptrs;
-                for (const auto& arg : args) {
-                    ptrs.push_back(arg.c_str());
-                }
-                return ptrs;
-            }().data()
-        );
+            invocation->getPreprocessorOpts().addRemappedFile(file_path, buffer.get());
+        }
+        
+        unit->compiler_ = std::make_unique<clang::CompilerInstance>(
+            std::make_shared<clang::PCHContainerOperations>());
+        clang::CompilerInstance& compiler = *unit->compiler_;
+        compiler.setInvocation(invocation);
+        compiler.createDiagnostics(new clang::IgnoringDiagConsumer(), true);
+        compiler.createFileManager(vfs);
+        
+        if (!compiler.createTarget()) {
+            result.error_message = "Unsupported target";
+            return nullptr;
+        }
+        
+        // Run the parse but leave the source file open, which keeps the
+        // AST alive until the ParsedUnit is destroyed
+        auto parse_start = std::chrono::steady_clock::now();
+        unit->action_ = std::make_unique<ParseAction>(request);
+        clang::FrontendInputFile input = compiler.getFrontendOpts().Inputs[0];
         
-        // Run the tool
+        // BeginSourceFile hands remapped buffers to the source manager,
+        // which frees them; until then they are ours
+        buffer.release();
+        if (!unit->action_->BeginSourceFile(compiler, input)) {
+            unit->action_.reset();
+            result.error_message = "Compilation failed";
+            return nullptr;
+        }
+        
+        if (llvm::Error error = unit->action_->Execute()) {
+            result.error_message = "Compilation failed: " + llvm::toString(std::move(error));
+            return nullptr;
+        }
+        stats.parse_ms = MillisecondsSince(parse_start);
+        
+        if (IsCancelled(request)) {
+            result.cancelled = true;
+            result.error_message = "Analysis cancelled";
+            return nullptr;
+        }
+        
+        if (compiler.getDiagnostics().hasErrorOccurred()) {
+            result.error_message = "Compilation failed";
+            return nullptr;
+        }
+        
+        // Headers read by the parse itself, on top of those in the preamble
+        const clang::SourceManager& sm = compiler.getSourceManager();
+        const clang::FileEntry* main_file = sm.getFileEntryForID(sm.getMainFileID());
+        for (auto it = sm.fileinfo_begin(); it != sm.fileinfo_end(); ++it) {
+            if (it->first != main_file) {
+                unit->included_files_.push_back(it->first->getName().str());
+            }
+        }
+        std::sort(unit->included_files_.begin(), unit->included_files_.end());
+        unit->included_files_.erase(
+            std::unique(unit->included_files_.begin(), unit->included_files_.end()),
+            unit->included_files_.end());
+        
+        return unit;
+        
+    } catch (const std::exception& e) {
+        result.error_message = std::string("Analysis error: ") + e.what();
+    }
+    
+    return nullptr;
+}
+
+AnalysisResult Analyzer::AnalyzeUnit(ParsedUnit& unit, const AnalysisRequest& request) {
+    AnalysisResult result;
+    result.success = false;
+    
+    try {
         std::vector<StructLayout> layouts;
-        clang::tooling::ClangTool tool(
-            *comp_db,
-            {request.file_path.empty() ? "input.cpp" : request.file_path}
-        );
+        clang::ASTContext& context = unit.GetASTContext();
+        AccessAnalyzer& accesses = unit.GetAccessAnalyzer();
         
-        // Map the source code as a virtual file
-        tool.mapVirtualFile(
-            request.file_path.empty() ? "input.cpp" : request.file_path,
-            request.source_code
-        );
+        // The parse is charged to the first analysis of the unit only
+        AnalysisStats* stats = nullptr;
+        if (request.collect_stats) {
+            stats = &result.stats.emplace();
+            if (unit.parse_reported_) {
+                stats->ast_reused = true;
+            } else {
+                *stats = unit.parse_stats_;
+                unit.parse_reported_ = true;
+            }
+        }
         
-        // Run analysis
-        int ret = tool.run(
-            clang::tooling::newFrontendActionFactory<StructAction>(
-                [&request, &layouts]() {
-                    return std::make_unique<StructAction>(request, layouts);
-                }
-            ).get()
-        );
+        auto traversal_start = std::chrono::steady_clock::now();
+        double access_ms_before = accesses.GetWalkMilliseconds();
+        StructVisitor visitor(context, request, layouts, accesses, stats);
+        visitor.TraverseDecl(context.getTranslationUnitDecl());
         
-        if (ret == 0) {
+        // The access walk runs lazily inside ProcessRecord, so it is
+        // taken out of both the layout and the traversal time
+        if (stats) {
+            stats->access_ms = accesses.GetWalkMilliseconds() - access_ms_before;
+            stats->layout_ms = std::max(0.0, stats->layout_ms - stats->access_ms);
+            stats->traversal_ms = std::max(
+                0.0, MillisecondsSince(traversal_start) - stats->layout_ms - stats->access_ms);
+            stats->records_reported = static_cast<uint32_t>(layouts.size());
+            stats->ast_bytes = context.getASTAllocatedMemory() + context.getSideTableAllocatedMemory();
+        }
+        
+        if (IsCancelled(request)) {
+            result.cancelled = true;
+            result.error_message = "Analysis cancelled";
+        } else {
+            CompareInstantiations(layouts);
             result.success = true;
+            result.records_skipped = visitor.SkippedRecords();
             result.layouts = std::move(layouts);
-        } else {
-            result.error_message = "Compilation failed";
         }
         
     } catch (const std::exception& e) {
@@ -174,16 +739,48 @@ AnalysisResult Analyzer::Analyze(const AnalysisRequest& request) {
     return result;
 }
 
+void Analyzer::CompareInstantiations(std::vector<StructLayout>& layouts) {
+    auto padding_bytes = [](const StructLayout& layout) {
+        uint64_t bytes = 0;
+        for (const auto& padding : layout.padding) {
+            bytes += padding.size;
+        }
+        return bytes;
+    };
+    
+    std::map<std::string, uint64_t> least_padding; // By template name
+    for (const auto& layout : layouts) {
+        if (layout.template_name.empty()) {
+            continue;
+        }
+        uint64_t bytes = padding_bytes(layout);
+        auto inserted = least_padding.emplace(layout.template_name, bytes);
+        if (!inserted.second) {
+            inserted.first->second = std::min(inserted.first->second, bytes);
+        }
+    }
+    
+    for (auto& layout : layouts) {
+        if (!layout.template_name.empty()) {
+            layout.template_padding_excess = padding_bytes(layout) - least_padding[layout.template_name];
+        }
+    }
+}
+
 StructLayout Analyzer::ProcessRecord(
     const clang::RecordDecl* record,
     clang::ASTContext& context,
-    const AnalysisRequest& request
+    const AnalysisRequest& request,
+    AccessAnalyzer* accesses,
+    AnalysisStats* stats
 ) {
+    auto start = std::chrono::steady_clock::now();
     StructLayout layout;
     
-    // Basic information
-    layout.name = record->getNameAsString();
-    layout.qualified_name = record->getQualifiedNameAsString();
+    // Basic information; specializations are named with their arguments
+    layout.name = RecordName(record, context, false);
+    layout.qualified_name = RecordName(record, context, true);
+    layout.template_name = TemplateName(record);
     
     // Get the layout from Clang's analysis
     const clang::ASTRecordLayout& ast_layout = context.getASTRecordLayout(record);
@@ -196,19 +793,8 @@ StructLayout Analyzer::ProcessRecord(
         layout.is_polymorphic = cxx_record->isPolymorphic();
         layout.is_standard_layout = cxx_record->isStandardLayout();
         
-        // Process virtual functions if polymorphic
-        if (layout.is_polymorphic) {
-            layout.vtable.pointer_offset = 0; // Usually at offset 0
-            layout.vtable.has_virtual_base = cxx_record->getNumVBases() > 0;
-            
-            for (auto method : cxx_record->methods()) {
-                if (method->isVirtual()) {
-                    layout.vtable.virtual_functions.push_back(
-                        method->getNameAsString()
-                    );
-                }
-            }
-        }
+        // vptrs, vtable slots and virtual bases, as the target ABI lays them out
+        VTableAnalyzer::Analyze(layout, cxx_record, context);
     } else {
         layout.is_polymorphic = false;
         layout.is_standard_layout = true;
@@ -218,13 +804,92 @@ StructLayout Analyzer::ProcessRecord(
     ExtractBasicLayout(layout, record, context);
     
     // Calculate padding using LayoutCalculator
-    LayoutCalculator calculator(request.compiler, request.architecture);
+    LayoutCalculator calculator(request.compiler, request.architecture, request.cache_line_size);
     calculator.CalculatePadding(layout, context, record);
-    calculator.GenerateOptimizations(layout);
+    calculator.CalculateArrayStride(layout);
     
+    // What nested structs, std::optional, std::pair and the like waste
+    // inside the members that hold them
+    std::unordered_map<const clang::RecordDecl*, StructLayout> expanded;
+    ExpandNestedMembers(layout.members, record, context, calculator, expanded);
+    for (const auto& member : layout.members) {
+        layout.nested_padding += member.nested_padding;
+    }
+    
+    const FieldAccessGraph* access_graph = nullptr;
+    if (accesses && !layout.members.empty()) {
+        access_graph = accesses->GetGraph(record);
+    }
+    calculator.GenerateOptimizations(layout, context, record, request.profile.get(), access_graph);
+    
+    const auto* cxx_record = llvm::dyn_cast<clang::CXXRecordDecl>(record);
+    if (accesses && cxx_record && layout.is_polymorphic) {
+        VTableAnalyzer::SuggestFinal(layout, cxx_record, *accesses);
+    }
+    
+    if (stats) {
+        stats->layout_ms += MillisecondsSince(start);
+    }
     return layout;
 }
 
+void Analyzer::ExpandNestedMembers(
+    std::vector<MemberInfo>& members,
+    const clang::RecordDecl* record,
+    clang::ASTContext& context,
+    LayoutCalculator& calculator,
+    std::unordered_map<const clang::RecordDecl*, StructLayout>& expanded
+) {
+    size_t index = 0;
+    for (const auto* field : record->fields()) {
+        if (index >= members.size()) {
+            break;
+        }
+        MemberInfo& member = members[index++];
+        
+        // An array of records holds one layout per element
+        clang::QualType element_type = context.getBaseElementType(field->getType());
+        const clang::RecordDecl* nested = element_type->getAsRecordDecl();
+        nested = nested ? nested->getDefinition() : nullptr;
+        if (!nested || nested->isInvalidDecl() || member.is_bitfield || member.size == 0) {
+            continue;
+        }
+        uint64_t element_size = context.getTypeSizeInChars(element_type).getQuantity();
+        if (element_size == 0) {
+            continue;
+        }
+        uint64_t elements = context.getTypeSizeInChars(field->getType()).getQuantity() / element_size;
+        
+        auto it = expanded.find(nested);
+        if (it == expanded.end()) {
+            StructLayout nested_layout;
+            nested_layout.total_size = element_size;
+            nested_layout.alignment = context.getTypeAlignInChars(element_type).getQuantity();
+            if (const auto* cxx_record = llvm::dyn_cast<clang::CXXRecordDecl>(nested)) {
+                VTableAnalyzer::Analyze(nested_layout, cxx_record, context);
+            }
+            ExtractBasicLayout(nested_layout, nested, context);
+            calculator.CalculatePadding(nested_layout, context, nested);
+            ExpandNestedMembers(nested_layout.members, nested, context, calculator, expanded);
+            
+            // Per element: its own padding and what its members hold
+            for (const auto& padding : nested_layout.padding) {
+                nested_layout.nested_padding += padding.size;
+            }
+            for (const auto& child : nested_layout.members) {
+                nested_layout.nested_padding += child.nested_padding;
+            }
+            it = expanded.emplace(nested, std::move(nested_layout)).first;
+        }
+        
+        const StructLayout& nested_layout = it->second;
+        member.children = nested_layout.members;
+        member.padding = nested_layout.padding;
+        member.nested_padding = nested_layout.nested_padding * elements;
+        TrimNesting(member.children, kMaxNestingDepth - 1);
+    }
+}
+
 void Analyzer::ExtractBasicLayout(
     StructLayout& layout,
     const clang::RecordDecl* record,
@@ -254,22 +919,84 @@ void Analyzer::ExtractBasicLayout(
             member.is_bitfield = true;
             member.bitfield_width = field->getBitWidthValue(context);
             member.bitfield_offset = offset_bits % 8;
+            
+            // The bytes its bits occupy; the declared type only decides the
+            // storage unit they're allocated from, and `unsigned x : 3` no
+            // more holds four bytes than its neighbours in the same unit do
+            member.size = member.bitfield_width == 0
+                ? 0
+                : (member.bitfield_offset + member.bitfield_width + 7) / 8;
         } else {
             member.is_bitfield = false;
             member.bitfield_width = 0;
             member.bitfield_offset = 0;
         }
         
+        member.is_thread_shared = IsThreadShared(field);
+        
+        // An empty member that needs no address of its own takes no bytes;
+        // others may share their tail padding with the next member
+        if (field->hasAttr<clang::NoUniqueAddressAttr>()) {
+            member.is_no_unique_address = true;
+            if (field->isZeroSize(context)) {
+                member.size = 0;
+            }
+        }
+        
         layout.members.push_back(member);
         field_index++;
     }
     
-    // Calculate useful size (without tail padding)
-    if (!layout.members.empty()) {
-        const auto& last_member = layout.members.back();
-        layout.useful_size = last_member.offset + last_member.size;
-    } else {
-        layout.useful_size = 0;
+    layout.data_size = ast_layout.getDataSize().getQuantity();
+    
+    const auto* cxx_record = llvm::dyn_cast<clang::CXXRecordDecl>(record);
+    if (cxx_record) {
+        auto add_base = [&](const clang::CXXBaseSpecifier& base, bool is_virtual) {
+            const auto* base_decl = base.getType()->getAsCXXRecordDecl();
+            if (!base_decl || !base_decl->hasDefinition()) {
+                return;
+            }
+            const clang::ASTRecordLayout& base_layout = context.getASTRecordLayout(base_decl);
+            
+            BaseInfo info;
+            info.name = base.getType().getAsString();
+            info.offset = (is_virtual ? ast_layout.getVBaseClassOffset(base_decl)
+                                      : ast_layout.getBaseClassOffset(base_decl)).getQuantity();
+            info.size = BaseDataSize(context, base_decl);
+            info.alignment = base_layout.getNonVirtualAlignment().getQuantity();
+            info.is_virtual = is_virtual;
+            info.is_empty = base_decl->isEmpty();
+            info.is_primary = ast_layout.getPrimaryBase() == base_decl &&
+                              ast_layout.isPrimaryBaseVirtual() == is_virtual;
+            layout.bases.push_back(info);
+        };
+        
+        for (const auto& base : cxx_record->bases()) {
+            if (!base.isVirtual()) {
+                add_base(base, false);
+            }
+        }
+        for (const auto& base : cxx_record->vbases()) {
+            add_base(base, true);
+        }
+    }
+    
+    // Calculate useful size (without tail padding): the end of the last
+    // member, base or vptr
+    layout.useful_size = 0;
+    for (const auto& member : layout.members) {
+        layout.useful_size = std::max(layout.useful_size, member.offset + member.size);
+    }
+    for (const auto& base : layout.bases) {
+        layout.useful_size = std::max(layout.useful_size, base.offset + base.size);
+    }
+    uint64_t pointer_size = context.getTargetInfo().getPointerWidth(0) / 8;
+    for (const auto& vptr : layout.vtable.vptrs) {
+        layout.useful_size = std::max(layout.useful_size, vptr.offset + pointer_size);
+    }
+    if (layout.vtable.vbptr_offset >= 0) {
+        layout.useful_size = std::max(
+            layout.useful_size, static_cast<uint64_t>(layout.vtable.vbptr_offset) + pointer_size);
     }
 }
 
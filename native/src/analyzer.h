@@ -2,38 +2,131 @@
 #define STRUCTSIGHT_ANALYZER_H
 
 #include "types.h"
-#include <clang/Tooling/Tooling.h>
+#include "preamble_cache.h"
+#include "layout_cache.h"
 #include <clang/AST/ASTContext.h>
 #include <clang/AST/RecordLayout.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Frontend/FrontendAction.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <unordered_map>
 
 namespace structsight {
 
+class StructVisitor;
+class AccessAnalyzer;
+class LayoutCalculator;
+
+// A parsed translation unit. The AST stays alive until this is destroyed,
+// so several queries can be answered without reparsing.
+class ParsedUnit {
+public:
+    ~ParsedUnit();
+    
+    clang::ASTContext& GetASTContext();
+    
+    // Every file other than the main one that the parse read
+    const std::vector<std::string>& GetIncludedFiles() const;
+    
+    // Field accesses in the unit's function bodies, walked on first use
+    AccessAnalyzer& GetAccessAnalyzer();
+    
+private:
+    friend class Analyzer;
+    
+    std::vector<std::string> included_files_;
+    std::unique_ptr<AccessAnalyzer> accesses_;
+    
+    // What the parse cost, reported with the first analysis of the unit
+    AnalysisStats parse_stats_;
+    bool parse_reported_ = false;
+    
+    // Keeps the in-memory PCH alive for as long as the AST refers to it
+    std::shared_ptr<const clang::PrecompiledPreamble> preamble_;
+    std::unique_ptr<clang::CompilerInstance> compiler_;
+    std::unique_ptr<clang::FrontendAction> action_;
+};
+
 class Analyzer {
 public:
-    Analyzer();
+    // preamble_cache is optional; when set, the #include block of each
+    // file is precompiled once and reused across calls.
+    // layout_cache is optional; when set and enabled, results are read from
+    // and written to it, and a hit skips Clang entirely.
+    explicit Analyzer(PreambleCache* preamble_cache = nullptr, LayoutCache* layout_cache = nullptr);
     ~Analyzer();
     
     // Main analysis entry point
     AnalysisResult Analyze(const AnalysisRequest& request);
     
+    // Answer request from the layout cache. Returns false on a miss or
+    // when there is no cache.
+    bool AnalyzeCached(const AnalysisRequest& request, AnalysisResult& result);
+    
+    // Save a successful result for `request` in the layout cache
+    void CacheResult(
+        const AnalysisRequest& request,
+        const ParsedUnit& unit,
+        const AnalysisResult& result
+    );
+    
+    // Parse request.source_code and keep the AST.
+    // Returns null and sets `result` on failure or cancellation.
+    std::unique_ptr<ParsedUnit> Parse(const AnalysisRequest& request, AnalysisResult& result);
+    
+    // Analyze the records of an already parsed unit
+    AnalysisResult AnalyzeUnit(ParsedUnit& unit, const AnalysisRequest& request);
+    
+    // Set template_padding_excess on every instantiation in `layouts`,
+    // relative to the least-padded instantiation of the same template
+    static void CompareInstantiations(std::vector<StructLayout>& layouts);
+    
 private:
-    // Helper to create compilation database
-    std::unique_ptr<clang::tooling::CompilationDatabase> 
-        CreateCompilationDatabase(const AnalysisRequest& request);
+    friend class StructVisitor;
+    
+    PreambleCache* preamble_cache_;
+    LayoutCache* layout_cache_;
+    
+    // Build the clang command line (without the input file) for a request
+    std::vector<std::string> BuildCompileArgs(const AnalysisRequest& request) const;
     
-    // Process a single record (struct/class)
+    // Helper to create the compiler invocation for a single file
+    std::shared_ptr<clang::CompilerInvocation> CreateInvocation(
+        const std::vector<std::string>& args,
+        const std::string& file_path,
+        llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> vfs
+    );
+    
+    // Process a single record (struct/class); accesses, if given, supplies
+    // the co-access graph from the translation unit's function bodies.
+    // stats, if given, accumulates the time spent in layout_ms.
     StructLayout ProcessRecord(
         const clang::RecordDecl* record,
         clang::ASTContext& context,
-        const AnalysisRequest& request
+        const AnalysisRequest& request,
+        AccessAnalyzer* accesses = nullptr,
+        AnalysisStats* stats = nullptr
     );
     
-    // Extract basic layout information
+    // Extract members and base subobjects at the offsets Clang assigned
     void ExtractBasicLayout(
         StructLayout& layout,
         const clang::RecordDecl* record,
         const clang::ASTContext& context
     );
+    
+    // Lay out the records that record-typed members of `record` hold as
+    // those members' children and padding, and total the padding inside
+    // each at every level. `expanded` keeps each record's layout so types
+    // that recur are laid out once.
+    void ExpandNestedMembers(
+        std::vector<MemberInfo>& members,
+        const clang::RecordDecl* record,
+        clang::ASTContext& context,
+        LayoutCalculator& calculator,
+        std::unordered_map<const clang::RecordDecl*, StructLayout>& expanded
+    );
 };
 
 } // namespace structsight
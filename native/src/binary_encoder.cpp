@@ -0,0 +1,664 @@
+#include "binary_encoder.h"
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace structsight {
+
+namespace {
+
+const size_t kHeaderSize = 48;
+
+// Layout flags
+const uint32_t kFlagPolymorphic = 1;
+const uint32_t kFlagStandardLayout = 2;
+const uint32_t kFlagVirtualBase = 4;
+
+// Member flags
+const uint32_t kFlagBitfield = 1;
+const uint32_t kFlagThreadShared = 2;
+const uint32_t kFlagNoUniqueAddress = 4;
+
+// Base flags
+const uint32_t kFlagVirtual = 1;
+const uint32_t kFlagEmpty = 2;
+const uint32_t kFlagPrimary = 4;
+
+size_t AlignTo8(size_t value) {
+    return (value + 7) & ~static_cast<size_t>(7);
+}
+
+// Members below `member` at every level
+uint32_t SubtreeSize(const MemberInfo& member) {
+    uint32_t size = static_cast<uint32_t>(member.children.size());
+    for (const auto& child : member.children) {
+        size += SubtreeSize(child);
+    }
+    return size;
+}
+
+// Nested members are read no deeper than this, and no more of them than
+// the header counts, so a malformed buffer whose child ranges loop fails
+// instead of recursing forever
+const unsigned kMaxDecodeDepth = 32;
+
+// Appends little-endian values regardless of host byte order
+class SectionWriter {
+public:
+    void U32(uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            bytes_.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void F64(uint64_t value) {
+        Double(static_cast<double>(value));
+    }
+
+    void Double(double number) {
+        uint64_t bits;
+        std::memcpy(&bits, &number, sizeof(bits));
+        for (int i = 0; i < 8; i++) {
+            bytes_.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+        }
+    }
+
+    void Bytes(const std::string& value) {
+        bytes_.insert(bytes_.end(), value.begin(), value.end());
+    }
+
+    void PadTo8() {
+        bytes_.resize(AlignTo8(bytes_.size()), 0);
+    }
+
+    const std::vector<uint8_t>& Data() const {
+        return bytes_;
+    }
+
+private:
+    std::vector<uint8_t> bytes_;
+};
+
+// Gives every distinct string one index
+class StringTable {
+public:
+    uint32_t Intern(const std::string& value) {
+        auto it = indices_.find(value);
+        if (it != indices_.end()) {
+            return it->second;
+        }
+        uint32_t index = static_cast<uint32_t>(strings_.size());
+        strings_.push_back(&indices_.emplace(value, index).first->first);
+        return index;
+    }
+
+    const std::vector<const std::string*>& Strings() const {
+        return strings_;
+    }
+
+private:
+    std::unordered_map<std::string, uint32_t> indices_;
+    std::vector<const std::string*> strings_; // Point into indices_ keys
+};
+
+// Bounds-checked little-endian reads; any read past the end marks the
+// reader as failed and returns 0
+class SectionReader {
+public:
+    SectionReader(const uint8_t* data, size_t size) : data_(data), size_(size), ok_(true) {}
+
+    uint32_t U32(size_t offset) {
+        if (!Check(offset, 4)) {
+            return 0;
+        }
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value |= static_cast<uint32_t>(data_[offset + i]) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t F64(size_t offset) {
+        return static_cast<uint64_t>(Double(offset));
+    }
+
+    double Double(size_t offset) {
+        if (!Check(offset, 8)) {
+            return 0;
+        }
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; i++) {
+            bits |= static_cast<uint64_t>(data_[offset + i]) << (8 * i);
+        }
+        double number;
+        std::memcpy(&number, &bits, sizeof(number));
+        return number;
+    }
+
+    std::string Bytes(size_t offset, size_t length) {
+        if (!Check(offset, length)) {
+            return std::string();
+        }
+        return std::string(reinterpret_cast<const char*>(data_ + offset), length);
+    }
+
+    bool Ok() const {
+        return ok_;
+    }
+
+    void Fail() {
+        ok_ = false;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    bool ok_;
+
+    bool Check(size_t offset, size_t length) {
+        if (offset > size_ || length > size_ - offset) {
+            ok_ = false;
+        }
+        return ok_;
+    }
+};
+
+// Fixed record sizes; must match what Encode writes
+const size_t kLayoutRecordSize = 200;
+const size_t kMemberRecordSize = 72;
+const size_t kPaddingRecordSize = 24;
+const size_t kBaseRecordSize = 32;
+const size_t kOptimizationRecordSize = 128;
+const size_t kVPointerRecordSize = 24;
+const size_t kVTableSlotRecordSize = 24;
+const size_t kVirtualBaseRecordSize = 24;
+
+} // namespace
+
+std::vector<uint8_t> BinaryEncoder::Encode(const std::vector<StructLayout>& layouts) {
+    StringTable strings;
+    SectionWriter layout_section;
+    SectionWriter member_section;
+    SectionWriter padding_section;
+    SectionWriter base_section;
+    SectionWriter optimization_section;
+    SectionWriter vptr_section;
+    SectionWriter slot_section;
+    SectionWriter vbase_section;
+    SectionWriter ref_section;
+
+    uint32_t member_count = 0;
+    uint32_t padding_count = 0;
+    uint32_t base_count = 0;
+    uint32_t optimization_count = 0;
+    uint32_t vptr_count = 0;
+    uint32_t slot_count = 0;
+    uint32_t vbase_count = 0;
+    uint32_t ref_count = 0;
+
+    // Every record puts its f64 fields first and is a multiple of 8 bytes,
+    // so the f64s stay 8-byte aligned
+    for (const auto& layout : layouts) {
+        uint32_t flags = 0;
+        if (layout.is_polymorphic) flags |= kFlagPolymorphic;
+        if (layout.is_standard_layout) flags |= kFlagStandardLayout;
+        if (layout.vtable.has_virtual_base) flags |= kFlagVirtualBase;
+
+        // f64 totalSize, alignment, usefulSize, vtable.pointerOffset,
+        //     vtable.vbptrOffset, dataSize, templatePaddingExcess,
+        //     arrayStride: elementsPerLine, elementsPerPage,
+        //     elementsPerHugePage, linesPerElement, lineStraddle,
+        //     pageStraddle, hugePageStraddle, shrinkSize, alignedSize
+        layout_section.F64(layout.total_size);
+        layout_section.F64(layout.alignment);
+        layout_section.F64(layout.useful_size);
+        layout_section.F64(layout.vtable.pointer_offset);
+        layout_section.Double(static_cast<double>(layout.vtable.vbptr_offset));
+        layout_section.F64(layout.data_size);
+        layout_section.F64(layout.template_padding_excess);
+        const ArrayStride& stride = layout.array_stride;
+        layout_section.Double(stride.elements_per_line);
+        layout_section.Double(stride.elements_per_page);
+        layout_section.Double(stride.elements_per_huge_page);
+        layout_section.Double(stride.lines_per_element);
+        layout_section.Double(stride.line_straddle);
+        layout_section.Double(stride.page_straddle);
+        layout_section.Double(stride.huge_page_straddle);
+        layout_section.F64(stride.shrink_size);
+        layout_section.F64(stride.aligned_size);
+        // u32 name, qualifiedName, flags
+        layout_section.U32(strings.Intern(layout.name));
+        layout_section.U32(strings.Intern(layout.qualified_name));
+        layout_section.U32(flags);
+        // u32 first/count pairs: members, padding, optimizations, virtual
+        // functions, vptrs, virtual bases, bases
+        layout_section.U32(member_count);
+        layout_section.U32(static_cast<uint32_t>(layout.members.size()));
+        layout_section.U32(padding_count);
+        layout_section.U32(static_cast<uint32_t>(layout.padding.size()));
+        layout_section.U32(optimization_count);
+        layout_section.U32(static_cast<uint32_t>(layout.optimizations.size()));
+        layout_section.U32(ref_count);
+        layout_section.U32(static_cast<uint32_t>(layout.vtable.virtual_functions.size()));
+        layout_section.U32(vptr_count);
+        layout_section.U32(static_cast<uint32_t>(layout.vtable.vptrs.size()));
+        layout_section.U32(vbase_count);
+        layout_section.U32(static_cast<uint32_t>(layout.vtable.virtual_bases.size()));
+        layout_section.U32(base_count);
+        layout_section.U32(static_cast<uint32_t>(layout.bases.size()));
+        // u32 templateName
+        layout_section.U32(strings.Intern(layout.template_name));
+
+        for (const auto& base : layout.bases) {
+            // f64 offset, size, alignment; u32 name, flags
+            base_section.F64(base.offset);
+            base_section.F64(base.size);
+            base_section.F64(base.alignment);
+            base_section.U32(strings.Intern(base.name));
+            base_section.U32((base.is_virtual ? kFlagVirtual : 0) |
+                             (base.is_empty ? kFlagEmpty : 0) |
+                             (base.is_primary ? kFlagPrimary : 0));
+            base_count++;
+        }
+
+        for (const auto& function : layout.vtable.virtual_functions) {
+            ref_section.U32(strings.Intern(function));
+            ref_count++;
+        }
+
+        for (const auto& vptr : layout.vtable.vptrs) {
+            // f64 offset; u32 subobject, first slot, slot count
+            vptr_section.F64(vptr.offset);
+            vptr_section.U32(strings.Intern(vptr.subobject));
+            vptr_section.U32(slot_count);
+            vptr_section.U32(static_cast<uint32_t>(vptr.slots.size()));
+            vptr_section.U32(0);
+            vptr_count++;
+
+            for (const auto& slot : vptr.slots) {
+                // f64 index (signed); u32 kind, name, thunk
+                slot_section.Double(static_cast<double>(slot.index));
+                slot_section.U32(strings.Intern(slot.kind));
+                slot_section.U32(strings.Intern(slot.name));
+                slot_section.U32(strings.Intern(slot.thunk));
+                slot_section.U32(0);
+                slot_count++;
+            }
+        }
+
+        for (const auto& vbase : layout.vtable.virtual_bases) {
+            // f64 offset, offsetSlot (signed); u32 name
+            vbase_section.F64(vbase.offset);
+            vbase_section.Double(static_cast<double>(vbase.offset_slot));
+            vbase_section.U32(strings.Intern(vbase.name));
+            vbase_section.U32(0);
+            vbase_count++;
+        }
+
+        auto write_padding = [&](const std::vector<PaddingInfo>& paddings) {
+            for (const auto& padding : paddings) {
+                // f64 offset, size; u32 reason
+                padding_section.F64(padding.offset);
+                padding_section.F64(padding.size);
+                padding_section.U32(strings.Intern(padding.reason));
+                padding_section.U32(0);
+                padding_count++;
+            }
+        };
+
+        // The record's own padding first; nested members' padding follows
+        write_padding(layout.padding);
+
+        // Siblings are written as one block, then each one's children block
+        // in turn, so every member's children are contiguous
+        std::function<void(const std::vector<MemberInfo>&)> write_members =
+            [&](const std::vector<MemberInfo>& members) {
+            uint32_t next_child = member_count + static_cast<uint32_t>(members.size());
+            for (const auto& member : members) {
+                // f64 offset, size, alignment, nestedPadding; u32 name, type,
+                // flags, bitfieldWidth, bitfieldOffset, then first/count
+                // pairs: children, padding
+                member_section.F64(member.offset);
+                member_section.F64(member.size);
+                member_section.F64(member.alignment);
+                member_section.F64(member.nested_padding);
+                member_section.U32(strings.Intern(member.name));
+                member_section.U32(strings.Intern(member.type));
+                member_section.U32((member.is_bitfield ? kFlagBitfield : 0) |
+                                   (member.is_thread_shared ? kFlagThreadShared : 0) |
+                                   (member.is_no_unique_address ? kFlagNoUniqueAddress : 0));
+                member_section.U32(member.bitfield_width);
+                member_section.U32(member.bitfield_offset);
+                member_section.U32(next_child);
+                member_section.U32(static_cast<uint32_t>(member.children.size()));
+                member_section.U32(padding_count);
+                member_section.U32(static_cast<uint32_t>(member.padding.size()));
+                member_section.U32(0);
+                write_padding(member.padding);
+                next_child += SubtreeSize(member);
+            }
+            member_count += static_cast<uint32_t>(members.size());
+            for (const auto& member : members) {
+                write_members(member.children);
+            }
+        };
+        write_members(layout.members);
+
+        for (const auto& opt : layout.optimizations) {
+            // f64 bytesSaved, linesPerAccessBefore, linesPerAccessAfter,
+            //     bytesPerIterationBefore, bytesPerIterationAfter;
+            // u32 kind, description, membersMoved, then first/count pairs:
+            //     suggested order, cold, contended and loop members, final
+            //     methods, bitfield members; u32 first of the bitfield widths
+            //     (stored in stringRefs as plain numbers, one per member);
+            //     first/count pairs: narrowed members, their types;
+            //     u32 nestedMember, nestedType
+            optimization_section.F64(opt.bytes_saved);
+            optimization_section.Double(opt.lines_per_access_before);
+            optimization_section.Double(opt.lines_per_access_after);
+            optimization_section.Double(opt.bytes_per_iteration_before);
+            optimization_section.Double(opt.bytes_per_iteration_after);
+            optimization_section.U32(strings.Intern(OptimizationKindName(opt.kind)));
+            optimization_section.U32(strings.Intern(opt.description));
+            optimization_section.U32(opt.members_moved);
+            for (const auto* list : {&opt.suggested_order, &opt.cold_members,
+                                     &opt.contended_members, &opt.loop_members,
+                                     &opt.final_methods, &opt.bitfield_members}) {
+                optimization_section.U32(ref_count);
+                optimization_section.U32(static_cast<uint32_t>(list->size()));
+                for (const auto& name : *list) {
+                    ref_section.U32(strings.Intern(name));
+                    ref_count++;
+                }
+            }
+            optimization_section.U32(ref_count);
+            for (size_t i = 0; i < opt.bitfield_members.size(); i++) {
+                ref_section.U32(i < opt.bitfield_widths.size() ? opt.bitfield_widths[i] : 0);
+                ref_count++;
+            }
+            for (const auto* list : {&opt.narrowed_members, &opt.narrowed_types}) {
+                optimization_section.U32(ref_count);
+                optimization_section.U32(static_cast<uint32_t>(list->size()));
+                for (const auto& name : *list) {
+                    ref_section.U32(strings.Intern(name));
+                    ref_count++;
+                }
+            }
+            optimization_section.U32(strings.Intern(opt.nested_member));
+            optimization_section.U32(strings.Intern(opt.nested_type));
+            optimization_count++;
+        }
+    }
+    ref_section.PadTo8();
+
+    SectionWriter string_section;
+    uint32_t string_offset = 0;
+    string_section.U32(string_offset);
+    for (const std::string* value : strings.Strings()) {
+        string_offset += static_cast<uint32_t>(value->size());
+        string_section.U32(string_offset);
+    }
+    for (const std::string* value : strings.Strings()) {
+        string_section.Bytes(*value);
+    }
+
+    SectionWriter header;
+    header.U32(kMagic);
+    header.U32(kVersion);
+    header.U32(static_cast<uint32_t>(layouts.size()));
+    header.U32(member_count);
+    header.U32(padding_count);
+    header.U32(optimization_count);
+    header.U32(ref_count);
+    header.U32(static_cast<uint32_t>(strings.Strings().size()));
+    header.U32(vptr_count);
+    header.U32(slot_count);
+    header.U32(vbase_count);
+    header.U32(base_count);
+
+    std::vector<uint8_t> buffer;
+    buffer.reserve(kHeaderSize +
+                   layout_section.Data().size() +
+                   member_section.Data().size() +
+                   padding_section.Data().size() +
+                   base_section.Data().size() +
+                   optimization_section.Data().size() +
+                   vptr_section.Data().size() +
+                   slot_section.Data().size() +
+                   vbase_section.Data().size() +
+                   ref_section.Data().size() +
+                   string_section.Data().size());
+
+    for (const SectionWriter* section : {&header, &layout_section, &member_section,
+                                         &padding_section, &base_section, &optimization_section,
+                                         &vptr_section, &slot_section, &vbase_section,
+                                         &ref_section, &string_section}) {
+        buffer.insert(buffer.end(), section->Data().begin(), section->Data().end());
+    }
+
+    return buffer;
+}
+
+bool BinaryEncoder::Decode(const uint8_t* data, size_t size, std::vector<StructLayout>& layouts) {
+    SectionReader reader(data, size);
+    
+    if (reader.U32(0) != kMagic || reader.U32(4) != kVersion) {
+        return false;
+    }
+    
+    uint64_t layout_count = reader.U32(8);
+    uint64_t member_count = reader.U32(12);
+    uint64_t padding_count = reader.U32(16);
+    uint64_t optimization_count = reader.U32(20);
+    uint64_t ref_count = reader.U32(24);
+    uint64_t string_count = reader.U32(28);
+    uint64_t vptr_count = reader.U32(32);
+    uint64_t slot_count = reader.U32(36);
+    uint64_t vbase_count = reader.U32(40);
+    uint64_t base_count = reader.U32(44);
+    
+    uint64_t layout_base = kHeaderSize;
+    uint64_t member_base = layout_base + layout_count * kLayoutRecordSize;
+    uint64_t padding_base = member_base + member_count * kMemberRecordSize;
+    uint64_t base_base = padding_base + padding_count * kPaddingRecordSize;
+    uint64_t optimization_base = base_base + base_count * kBaseRecordSize;
+    uint64_t vptr_base = optimization_base + optimization_count * kOptimizationRecordSize;
+    uint64_t slot_base = vptr_base + vptr_count * kVPointerRecordSize;
+    uint64_t vbase_base = slot_base + slot_count * kVTableSlotRecordSize;
+    uint64_t ref_base = vbase_base + vbase_count * kVirtualBaseRecordSize;
+    uint64_t string_offset_base = ref_base + AlignTo8(ref_count * 4);
+    uint64_t string_data_base = string_offset_base + (string_count + 1) * 4;
+    if (string_data_base > size) {
+        return false;
+    }
+    
+    std::vector<std::string> strings(string_count);
+    for (size_t i = 0; i < string_count; i++) {
+        uint32_t start = reader.U32(string_offset_base + i * 4);
+        uint32_t end = reader.U32(string_offset_base + i * 4 + 4);
+        if (end < start) {
+            return false;
+        }
+        strings[i] = reader.Bytes(string_data_base + start, end - start);
+    }
+    
+    auto string_at = [&](size_t offset) -> std::string {
+        uint32_t index = reader.U32(offset);
+        return index < strings.size() ? strings[index] : std::string();
+    };
+    auto string_list = [&](uint32_t first, uint32_t count) {
+        std::vector<std::string> list;
+        for (uint32_t i = 0; i < count && reader.Ok(); i++) {
+            list.push_back(string_at(ref_base + (static_cast<uint64_t>(first) + i) * 4));
+        }
+        return list;
+    };
+    
+    auto read_padding = [&](uint64_t first, uint32_t count, std::vector<PaddingInfo>& paddings) {
+        for (uint32_t i = 0; i < count && reader.Ok(); i++) {
+            size_t p = padding_base + (first + i) * kPaddingRecordSize;
+            PaddingInfo padding;
+            padding.offset = reader.F64(p);
+            padding.size = reader.F64(p + 8);
+            padding.reason = string_at(p + 16);
+            paddings.push_back(padding);
+        }
+    };
+    
+    uint64_t members_read = 0;
+    std::function<void(uint64_t, uint32_t, std::vector<MemberInfo>&, unsigned)> read_members =
+        [&](uint64_t first, uint32_t count, std::vector<MemberInfo>& members, unsigned depth) {
+        members_read += count;
+        if (depth > kMaxDecodeDepth || members_read > member_count) {
+            reader.Fail();
+            return;
+        }
+        for (uint32_t i = 0; i < count && reader.Ok(); i++) {
+            size_t m = member_base + (first + i) * kMemberRecordSize;
+            MemberInfo member;
+            member.offset = reader.F64(m);
+            member.size = reader.F64(m + 8);
+            member.alignment = reader.F64(m + 16);
+            member.nested_padding = reader.F64(m + 24);
+            member.name = string_at(m + 32);
+            member.type = string_at(m + 36);
+            uint32_t member_flags = reader.U32(m + 40);
+            member.is_bitfield = (member_flags & kFlagBitfield) != 0;
+            member.is_thread_shared = (member_flags & kFlagThreadShared) != 0;
+            member.is_no_unique_address = (member_flags & kFlagNoUniqueAddress) != 0;
+            member.bitfield_width = reader.U32(m + 44);
+            member.bitfield_offset = reader.U32(m + 48);
+            read_members(reader.U32(m + 52), reader.U32(m + 56), member.children, depth + 1);
+            read_padding(reader.U32(m + 60), reader.U32(m + 64), member.padding);
+            members.push_back(std::move(member));
+        }
+    };
+    
+    std::vector<StructLayout> decoded(layout_count);
+    for (size_t l = 0; l < layout_count && reader.Ok(); l++) {
+        StructLayout& layout = decoded[l];
+        size_t at = layout_base + l * kLayoutRecordSize;
+        
+        layout.total_size = reader.F64(at);
+        layout.alignment = reader.F64(at + 8);
+        layout.useful_size = reader.F64(at + 16);
+        layout.vtable.pointer_offset = reader.F64(at + 24);
+        layout.vtable.vbptr_offset = static_cast<int64_t>(reader.Double(at + 32));
+        layout.data_size = reader.F64(at + 40);
+        layout.template_padding_excess = reader.F64(at + 48);
+        ArrayStride& stride = layout.array_stride;
+        stride.elements_per_line = reader.Double(at + 56);
+        stride.elements_per_page = reader.Double(at + 64);
+        stride.elements_per_huge_page = reader.Double(at + 72);
+        stride.lines_per_element = reader.Double(at + 80);
+        stride.line_straddle = reader.Double(at + 88);
+        stride.page_straddle = reader.Double(at + 96);
+        stride.huge_page_straddle = reader.Double(at + 104);
+        stride.shrink_size = reader.F64(at + 112);
+        stride.aligned_size = reader.F64(at + 120);
+        layout.name = string_at(at + 128);
+        layout.qualified_name = string_at(at + 132);
+        layout.template_name = string_at(at + 196);
+        
+        uint32_t flags = reader.U32(at + 136);
+        layout.is_polymorphic = (flags & kFlagPolymorphic) != 0;
+        layout.is_standard_layout = (flags & kFlagStandardLayout) != 0;
+        layout.vtable.has_virtual_base = (flags & kFlagVirtualBase) != 0;
+        layout.vtable.virtual_functions = string_list(reader.U32(at + 164), reader.U32(at + 168));
+        
+        uint64_t first_vptr = reader.U32(at + 172);
+        uint32_t vptrs = reader.U32(at + 176);
+        for (uint32_t i = 0; i < vptrs && reader.Ok(); i++) {
+            size_t v = vptr_base + (first_vptr + i) * kVPointerRecordSize;
+            VPointerInfo vptr;
+            vptr.offset = reader.F64(v);
+            vptr.subobject = string_at(v + 8);
+            
+            uint64_t first_slot = reader.U32(v + 12);
+            uint32_t slots = reader.U32(v + 16);
+            for (uint32_t j = 0; j < slots && reader.Ok(); j++) {
+                size_t s = slot_base + (first_slot + j) * kVTableSlotRecordSize;
+                VTableSlot slot;
+                slot.index = static_cast<int64_t>(reader.Double(s));
+                slot.kind = string_at(s + 8);
+                slot.name = string_at(s + 12);
+                slot.thunk = string_at(s + 16);
+                vptr.slots.push_back(slot);
+            }
+            layout.vtable.vptrs.push_back(vptr);
+        }
+        
+        uint64_t first_vbase = reader.U32(at + 180);
+        uint32_t vbases = reader.U32(at + 184);
+        for (uint32_t i = 0; i < vbases && reader.Ok(); i++) {
+            size_t b = vbase_base + (first_vbase + i) * kVirtualBaseRecordSize;
+            VirtualBaseInfo vbase;
+            vbase.offset = reader.F64(b);
+            vbase.offset_slot = static_cast<int64_t>(reader.Double(b + 8));
+            vbase.name = string_at(b + 16);
+            layout.vtable.virtual_bases.push_back(vbase);
+        }
+        
+        uint64_t first_base = reader.U32(at + 188);
+        uint32_t bases = reader.U32(at + 192);
+        for (uint32_t i = 0; i < bases && reader.Ok(); i++) {
+            size_t b = base_base + (first_base + i) * kBaseRecordSize;
+            BaseInfo base;
+            base.offset = reader.F64(b);
+            base.size = reader.F64(b + 8);
+            base.alignment = reader.F64(b + 16);
+            base.name = string_at(b + 24);
+            uint32_t base_flags = reader.U32(b + 28);
+            base.is_virtual = (base_flags & kFlagVirtual) != 0;
+            base.is_empty = (base_flags & kFlagEmpty) != 0;
+            base.is_primary = (base_flags & kFlagPrimary) != 0;
+            layout.bases.push_back(base);
+        }
+        
+        read_members(reader.U32(at + 140), reader.U32(at + 144), layout.members, 0);
+        for (const auto& member : layout.members) {
+            layout.nested_padding += member.nested_padding;
+        }
+        read_padding(reader.U32(at + 148), reader.U32(at + 152), layout.padding);
+        
+        uint64_t first_optimization = reader.U32(at + 156);
+        uint32_t optimizations = reader.U32(at + 160);
+        for (uint32_t i = 0; i < optimizations && reader.Ok(); i++) {
+            size_t o = optimization_base + (first_optimization + i) * kOptimizationRecordSize;
+            StructLayout::Optimization opt;
+            opt.bytes_saved = reader.F64(o);
+            opt.lines_per_access_before = reader.Double(o + 8);
+            opt.lines_per_access_after = reader.Double(o + 16);
+            opt.bytes_per_iteration_before = reader.Double(o + 24);
+            opt.bytes_per_iteration_after = reader.Double(o + 32);
+            opt.kind = OptimizationKindFromName(string_at(o + 40));
+            opt.description = string_at(o + 44);
+            opt.members_moved = reader.U32(o + 48);
+            opt.suggested_order = string_list(reader.U32(o + 52), reader.U32(o + 56));
+            opt.cold_members = string_list(reader.U32(o + 60), reader.U32(o + 64));
+            opt.contended_members = string_list(reader.U32(o + 68), reader.U32(o + 72));
+            opt.loop_members = string_list(reader.U32(o + 76), reader.U32(o + 80));
+            opt.final_methods = string_list(reader.U32(o + 84), reader.U32(o + 88));
+            opt.bitfield_members = string_list(reader.U32(o + 92), reader.U32(o + 96));
+            uint64_t first_width = reader.U32(o + 100);
+            for (size_t i = 0; i < opt.bitfield_members.size() && reader.Ok(); i++) {
+                opt.bitfield_widths.push_back(reader.U32(ref_base + (first_width + i) * 4));
+            }
+            opt.narrowed_members = string_list(reader.U32(o + 104), reader.U32(o + 108));
+            opt.narrowed_types = string_list(reader.U32(o + 112), reader.U32(o + 116));
+            opt.nested_member = string_at(o + 120);
+            opt.nested_type = string_at(o + 124);
+            layout.optimizations.push_back(opt);
+        }
+    }
+    
+    if (!reader.Ok()) {
+        return false;
+    }
+    
+    layouts = std::move(decoded);
+    return true;
+}
+
+} // namespace structsight
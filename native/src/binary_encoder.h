@@ -0,0 +1,50 @@
+#ifndef STRUCTSIGHT_BINARY_ENCODER_H
+#define STRUCTSIGHT_BINARY_ENCODER_H
+
+#include "types.h"
+#include <cstdint>
+#include <vector>
+
+namespace structsight {
+
+// Packs layouts into one little-endian buffer so the addon can hand JS a
+// single ArrayBuffer instead of an object per member. The TS reader is
+// decodeLayouts() in extension/src/analyzer.ts; keep the two in sync.
+// The on-disk LayoutCache stores the same format.
+//
+// Header (48 bytes), all u32:
+//   magic, version, layoutCount, memberCount, paddingCount,
+//   optimizationCount, stringRefCount, stringCount,
+//   vptrCount, vtableSlotCount, virtualBaseCount, baseCount
+// Then, each section starting on an 8-byte boundary:
+//   layouts        200 bytes each
+//   members        72 bytes each (top-level members of a layout, then
+//                  each member's children, contiguously per parent)
+//   padding        24 bytes each
+//   bases          32 bytes each
+//   optimizations  128 bytes each
+//   vptrs          24 bytes each
+//   vtableSlots    24 bytes each
+//   virtualBases   24 bytes each
+//   stringRefs     u32 string indices (member lists, virtual functions),
+//                  and bitfield widths
+//   stringOffsets  u32 x (stringCount + 1) byte offsets into stringData
+//   stringData     UTF-8, every distinct string once
+//
+// Sizes and offsets are stored as f64, which is what JS numbers hold anyway.
+// Record fields are listed in binary_encoder.cpp.
+class BinaryEncoder {
+public:
+    static const uint32_t kMagic = 0x42535353;  // "SSSB"
+    static const uint32_t kVersion = 11;
+
+    static std::vector<uint8_t> Encode(const std::vector<StructLayout>& layouts);
+    
+    // Inverse of Encode. Returns false if the buffer is truncated, from
+    // another format version, or otherwise malformed.
+    static bool Decode(const uint8_t* data, size_t size, std::vector<StructLayout>& layouts);
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_BINARY_ENCODER_H
@@ -0,0 +1,469 @@
+// structsight - command-line front end for the layout engine.
+// Runs the same Analyzer/LayoutCalculator as the addon without Node.js and
+// writes JSON or CSV to stdout for use on build machines.
+
+#include "types.h"
+#include "analyzer.h"
+#include "project_scanner.h"
+#include "report_writer.h"
+#include "field_profile.h"
+#include "layout_baseline.h"
+#include "target_matrix.h"
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace structsight;
+
+namespace {
+
+struct Options {
+    std::vector<std::string> files;
+    std::vector<std::string> compile_flags;
+    std::string struct_name;
+    std::string format = "json";
+    std::string compile_commands;
+    std::string cache_dir;
+    std::string profile;
+    std::string baseline;       // Compare against this baseline file
+    std::string write_baseline; // Record a baseline in this file
+    std::vector<std::string> targets; // Target triples for a layout matrix
+    uint32_t cache_line_size = kDefaultCacheLineSize;
+    std::vector<std::string> path_filter;
+    bool system_headers = false;
+    bool template_instantiations = false;
+    Architecture architecture = Architecture::X64;
+    Compiler compiler = Compiler::Clang;
+    unsigned threads = 0;
+};
+
+void PrintUsage(llvm::raw_ostream& out) {
+    out << "Usage: structsight [options] <file>... [-- <compile flags>]\n"
+           "       structsight [options] -p <compile_commands.json | build dir>\n"
+           "\n"
+           "Options:\n"
+           "  --format=json|csv          Output format (default: json)\n"
+           "  --struct=<name>            Only report this struct/class\n"
+           "  --arch=x86|x64             Target architecture (default: x64)\n"
+           "  --compiler=gcc|clang|msvc  Layout rules (default: clang)\n"
+           "  --path=<prefix>            Only report records declared under prefix\n"
+           "                             (repeatable; default: all non-system files)\n"
+           "  --system-headers           Also report records from system headers\n"
+           "  --instantiations           Also report every implicit instantiation of\n"
+           "                             class templates, grouped by template\n"
+           "  -p <path>                  Scan every TU in a compilation database\n"
+           "  -j <n>                     Threads used with -p or --targets\n"
+           "                             (default: all cores)\n"
+           "  --cache-dir=<dir>          Reuse results stored in dir when the source,\n"
+           "                             flags and included headers are unchanged\n"
+           "  --cache-line=<bytes>       Target cache line size, a power of two\n"
+           "                             (default: 64; 128 for Apple M-series, POWER)\n"
+           "  --profile=<csv>            Field access counts (Type::field,samples);\n"
+           "                             enables hot/cold split suggestions\n"
+           "  --write-baseline=<file>    Record the layouts for this target in file\n"
+           "                             (entries for other targets are kept)\n"
+           "  --baseline=<file>          Report records whose layout changed since the\n"
+           "                             baseline; exit status 3 if any regressed\n"
+           "  --targets=<triple,...>     Lay the files out for each target triple in\n"
+           "                             parallel and report sizes and offsets side by\n"
+           "                             side, marking records that differ\n"
+           "  -h, --help                 Show this help\n";
+}
+
+// Accepts both "--name=value" and "--name value"
+bool TakeValue(
+    const std::string& arg,
+    const std::string& name,
+    int& index,
+    int argc,
+    char** argv,
+    std::string& value
+) {
+    if (arg == name) {
+        if (index + 1 >= argc) {
+            return false;
+        }
+        value = argv[++index];
+        return true;
+    }
+    if (arg.rfind(name + "=", 0) == 0) {
+        value = arg.substr(name.size() + 1);
+        return true;
+    }
+    return false;
+}
+
+// Returns false on a usage error
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        
+        if (arg == "--") {
+            options.compile_flags.assign(argv + i + 1, argv + argc);
+            break;
+        } else if (arg == "-h" || arg == "--help") {
+            PrintUsage(llvm::outs());
+            std::exit(0);
+        } else if (TakeValue(arg, "--format", i, argc, argv, value)) {
+            if (value != "json" && value != "csv") {
+                llvm::errs() << "structsight: unknown format '" << value << "'\n";
+                return false;
+            }
+            options.format = value;
+        } else if (TakeValue(arg, "--struct", i, argc, argv, value)) {
+            options.struct_name = value;
+        } else if (TakeValue(arg, "--arch", i, argc, argv, value)) {
+            options.architecture = (value == "x86") ? Architecture::X86 : Architecture::X64;
+        } else if (TakeValue(arg, "--compiler", i, argc, argv, value)) {
+            if (value == "gcc") {
+                options.compiler = Compiler::GCC;
+            } else if (value == "msvc") {
+                options.compiler = Compiler::MSVC;
+            } else {
+                options.compiler = Compiler::Clang;
+            }
+        } else if (TakeValue(arg, "--path", i, argc, argv, value)) {
+            options.path_filter.push_back(value);
+        } else if (arg == "--system-headers") {
+            options.system_headers = true;
+        } else if (arg == "--instantiations") {
+            options.template_instantiations = true;
+        } else if (TakeValue(arg, "-p", i, argc, argv, value)) {
+            options.compile_commands = value;
+        } else if (TakeValue(arg, "--cache-dir", i, argc, argv, value)) {
+            options.cache_dir = value;
+        } else if (TakeValue(arg, "--cache-line", i, argc, argv, value)) {
+            options.cache_line_size = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+            if (options.cache_line_size == 0 ||
+                (options.cache_line_size & (options.cache_line_size - 1)) != 0) {
+                llvm::errs() << "structsight: --cache-line must be a power of two\n";
+                return false;
+            }
+        } else if (TakeValue(arg, "--profile", i, argc, argv, value)) {
+            options.profile = value;
+        } else if (TakeValue(arg, "--baseline", i, argc, argv, value)) {
+            options.baseline = value;
+        } else if (TakeValue(arg, "--write-baseline", i, argc, argv, value)) {
+            options.write_baseline = value;
+        } else if (TakeValue(arg, "--targets", i, argc, argv, value)) {
+            llvm::SmallVector<llvm::StringRef, 8> triples;
+            llvm::StringRef(value).split(triples, ',', -1, false);
+            for (llvm::StringRef triple : triples) {
+                options.targets.push_back(triple.trim().str());
+            }
+        } else if (TakeValue(arg, "-j", i, argc, argv, value)) {
+            options.threads = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+        } else if (!arg.empty() && arg[0] == '-') {
+            llvm::errs() << "structsight: unknown option '" << arg << "'\n";
+            return false;
+        } else {
+            options.files.push_back(arg);
+        }
+    }
+    
+    if (!options.baseline.empty() && !options.write_baseline.empty()) {
+        llvm::errs() << "structsight: --baseline and --write-baseline are exclusive\n";
+        return false;
+    }
+    
+    if (!options.targets.empty() &&
+        (!options.compile_commands.empty() || !options.baseline.empty() || !options.write_baseline.empty())) {
+        llvm::errs() << "structsight: --targets takes files and can't be combined with -p or baselines\n";
+        return false;
+    }
+    
+    return !options.files.empty() || !options.compile_commands.empty();
+}
+
+// Baselines hold one entry per target, e.g. "x64-clang"
+std::string TargetName(const Options& options) {
+    std::string name = options.architecture == Architecture::X86 ? "x86" : "x64";
+    switch (options.compiler) {
+        case Compiler::GCC:
+            return name + "-gcc";
+        case Compiler::MSVC:
+            return name + "-msvc";
+        case Compiler::Clang:
+        default:
+            return name + "-clang";
+    }
+}
+
+bool ReadBaselineFile(const std::string& path, std::vector<BaselineTarget>& targets) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+        llvm::errs() << "structsight: " << path << ": " << buffer.getError().message() << "\n";
+        return false;
+    }
+    std::string error;
+    if (!LayoutBaseline::Read((*buffer)->getBuffer(), targets, error)) {
+        llvm::errs() << "structsight: " << path << ": " << error << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Replace this target's entry in the baseline file, keeping the others
+int WriteBaseline(const Options& options, const std::vector<StructLayout>& layouts) {
+    std::vector<BaselineTarget> targets;
+    if (llvm::sys::fs::exists(options.write_baseline) &&
+        !ReadBaselineFile(options.write_baseline, targets)) {
+        return 2;
+    }
+    
+    std::string target = TargetName(options);
+    targets.erase(std::remove_if(targets.begin(), targets.end(),
+        [&](const BaselineTarget& entry) { return entry.target == target; }), targets.end());
+    targets.push_back(LayoutBaseline::FromLayouts(layouts, target, options.cache_line_size));
+    std::sort(targets.begin(), targets.end(), [](const BaselineTarget& a, const BaselineTarget& b) {
+        return a.target < b.target;
+    });
+    
+    std::error_code ec;
+    llvm::raw_fd_ostream out(options.write_baseline, ec);
+    if (ec) {
+        llvm::errs() << "structsight: " << options.write_baseline << ": " << ec.message() << "\n";
+        return 2;
+    }
+    LayoutBaseline::Write(out, targets);
+    return 0;
+}
+
+int CompareBaseline(
+    const Options& options,
+    const std::vector<StructLayout>& layouts,
+    const std::vector<ReportError>& errors
+) {
+    std::vector<BaselineTarget> targets;
+    if (!ReadBaselineFile(options.baseline, targets)) {
+        return 2;
+    }
+    
+    std::string target = TargetName(options);
+    auto entry = std::find_if(targets.begin(), targets.end(),
+        [&](const BaselineTarget& candidate) { return candidate.target == target; });
+    if (entry == targets.end()) {
+        llvm::errs() << "structsight: " << options.baseline << " has no " << target << " entry\n";
+        return 2;
+    }
+    
+    std::vector<LayoutChange> changes = LayoutBaseline::Compare(
+        *entry, LayoutBaseline::FromLayouts(layouts, target, options.cache_line_size),
+        options.cache_line_size);
+    
+    if (options.format == "csv") {
+        ReportWriter::WriteChangesCSV(llvm::outs(), changes);
+        for (const auto& error : errors) {
+            llvm::errs() << "structsight: " << error.file << ": " << error.message << "\n";
+        }
+    } else {
+        ReportWriter::WriteChangesJSON(llvm::outs(), target, changes, errors);
+    }
+    
+    if (!errors.empty()) {
+        return 1;
+    }
+    bool regressed = std::any_of(changes.begin(), changes.end(),
+        [](const LayoutChange& change) { return change.IsRegression(); });
+    return regressed ? 3 : 0;
+}
+
+// --targets: every file laid out for each triple, merged into one matrix
+int WriteTargetMatrix(const Options& options, const std::shared_ptr<const FieldProfile>& profile) {
+    std::vector<std::string> targets;
+    for (const auto& triple : options.targets) {
+        AnalysisRequest normalized;
+        targets.push_back(TargetMatrix::ApplyTriple(triple, normalized) ? normalized.target_triple : triple);
+    }
+    
+    TargetMatrix matrix(&LayoutCache::Global());
+    std::vector<MatrixRecord> records;
+    std::set<std::string> seen;
+    std::vector<ReportError> errors;
+    
+    for (const auto& file : options.files) {
+        auto buffer = llvm::MemoryBuffer::getFile(file);
+        if (!buffer) {
+            errors.push_back({file, buffer.getError().message()});
+            continue;
+        }
+        
+        TargetMatrixRequest request;
+        request.analysis.source_code = (*buffer)->getBuffer().str();
+        request.analysis.file_path = file;
+        request.analysis.struct_name = options.struct_name;
+        request.analysis.compiler = options.compiler;
+        request.analysis.compile_flags = options.compile_flags;
+        request.analysis.path_filter = options.path_filter;
+        request.analysis.include_system_headers = options.system_headers;
+        request.analysis.include_template_instantiations = options.template_instantiations;
+        request.analysis.profile = profile;
+        request.analysis.cache_line_size = options.cache_line_size;
+        request.targets = options.targets;
+        request.thread_count = options.threads;
+        
+        TargetMatrixResult result = matrix.Analyze(request);
+        bool target_failed = false;
+        for (size_t i = 0; i < result.target_errors.size(); i++) {
+            if (!result.target_errors[i].empty()) {
+                errors.push_back({file, result.targets[i] + ": " + result.target_errors[i]});
+                target_failed = true;
+            }
+        }
+        if (!result.success) {
+            if (!target_failed) {
+                errors.push_back({file, result.error_message});
+            }
+            continue;
+        }
+        
+        // Headers shared between files yield the same records again
+        for (auto& record : result.records) {
+            if (seen.insert(record.qualified_name).second) {
+                records.push_back(std::move(record));
+            }
+        }
+    }
+    
+    std::sort(records.begin(), records.end(), [](const MatrixRecord& a, const MatrixRecord& b) {
+        return a.qualified_name < b.qualified_name;
+    });
+    
+    if (options.format == "csv") {
+        ReportWriter::WriteMatrixCSV(llvm::outs(), targets, records);
+        for (const auto& error : errors) {
+            llvm::errs() << "structsight: " << error.file << ": " << error.message << "\n";
+        }
+    } else {
+        ReportWriter::WriteMatrixJSON(llvm::outs(), targets, records, errors);
+    }
+    
+    return errors.empty() ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(llvm::errs());
+        return 2;
+    }
+    
+    std::vector<StructLayout> layouts;
+    std::vector<ReportError> errors;
+    
+    LayoutCache& layout_cache = LayoutCache::Global();
+    layout_cache.SetDirectory(options.cache_dir);
+    
+    std::shared_ptr<const FieldProfile> profile;
+    if (!options.profile.empty()) {
+        std::string error;
+        profile = FieldProfile::Load(options.profile, error);
+        if (!profile) {
+            llvm::errs() << "structsight: " << error << "\n";
+            return 2;
+        }
+    }
+    
+    if (!options.targets.empty()) {
+        return WriteTargetMatrix(options, profile);
+    }
+    
+    if (!options.compile_commands.empty()) {
+        ProjectScanRequest request;
+        request.compile_commands_path = options.compile_commands;
+        request.architecture = options.architecture;
+        request.compiler = options.compiler;
+        request.thread_count = options.threads;
+        request.path_filter = options.path_filter;
+        request.include_system_headers = options.system_headers;
+        request.include_template_instantiations = options.template_instantiations;
+        request.profile = profile;
+        request.cache_line_size = options.cache_line_size;
+        
+        ProjectScanner scanner(&layout_cache);
+        ProjectScanResult result = scanner.Scan(request);
+        if (!result.success) {
+            errors.push_back({options.compile_commands, result.error_message});
+        }
+        for (const auto& file : result.failed_files) {
+            errors.push_back({file, "Compilation failed"});
+        }
+        layouts = std::move(result.layouts);
+    }
+    
+    std::set<std::string> seen;
+    for (const auto& layout : layouts) {
+        seen.insert(layout.qualified_name);
+    }
+    
+    Analyzer analyzer(nullptr, &layout_cache);
+    for (const auto& file : options.files) {
+        auto buffer = llvm::MemoryBuffer::getFile(file);
+        if (!buffer) {
+            errors.push_back({file, buffer.getError().message()});
+            continue;
+        }
+        
+        AnalysisRequest request;
+        request.source_code = (*buffer)->getBuffer().str();
+        request.file_path = file;
+        request.struct_name = options.struct_name;
+        request.architecture = options.architecture;
+        request.compiler = options.compiler;
+        request.compile_flags = options.compile_flags;
+        request.path_filter = options.path_filter;
+        request.include_system_headers = options.system_headers;
+        request.include_template_instantiations = options.template_instantiations;
+        request.profile = profile;
+        request.cache_line_size = options.cache_line_size;
+        
+        AnalysisResult result = analyzer.Analyze(request);
+        if (!result.success) {
+            errors.push_back({file, result.error_message});
+            continue;
+        }
+        
+        // Headers shared between files yield the same records again
+        for (auto& layout : result.layouts) {
+            if (seen.insert(layout.qualified_name).second) {
+                layouts.push_back(std::move(layout));
+            }
+        }
+    }
+    
+    if (!options.write_baseline.empty()) {
+        // A baseline missing the records of a file that failed would make
+        // every later comparison report them as added
+        if (!errors.empty()) {
+            for (const auto& error : errors) {
+                llvm::errs() << "structsight: " << error.file << ": " << error.message << "\n";
+            }
+            return 1;
+        }
+        return WriteBaseline(options, layouts);
+    }
+    
+    if (!options.baseline.empty()) {
+        return CompareBaseline(options, layouts, errors);
+    }
+    
+    if (options.format == "csv") {
+        ReportWriter::WriteCSV(llvm::outs(), layouts);
+        for (const auto& error : errors) {
+            llvm::errs() << "structsight: " << error.file << ": " << error.message << "\n";
+        }
+    } else {
+        ReportWriter::WriteJSON(llvm::outs(), layouts, errors);
+    }
+    
+    return errors.empty() ? 0 : 1;
+}
@@ -0,0 +1,361 @@
+#include "container_footprint.h"
+#include "analyzer.h"
+#include <clang/AST/Decl.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Support/MathExtras.h>
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace structsight {
+
+namespace {
+
+const char* const kProbeNamespace = "structsight_footprint_probe";
+
+// glibc's mmap threshold (its default; it only rises as mmapped blocks
+// are freed) and the page size those blocks are rounded to
+const uint64_t kMmapThreshold = 128 * 1024;
+const uint64_t kPageSize = 4096;
+
+// libstdc++'s _GLIBCXX_DEQUE_BUF_SIZE: deque blocks hold 512 bytes of
+// elements, or one element if it is larger
+const uint64_t kDequeBlockBytes = 512;
+
+// sizeof the library types that hold the record, by probe variable name
+struct LibrarySizes {
+    uint64_t key_size = 0;
+    uint64_t key_alignment = 0;
+    uint64_t vector_size = 0;
+    uint64_t deque_size = 0;
+    uint64_t deque_block_elements = 0;
+    uint64_t list_size = 0;
+    uint64_t list_node = 0;
+    uint64_t map_size = 0;
+    uint64_t map_node = 0;
+    uint64_t unordered_map_size = 0;
+    uint64_t unordered_map_node = 0;
+    uint64_t unique_ptr_size = 0;
+    uint64_t shared_ptr_size = 0;
+    uint64_t make_shared_block = 0;
+    uint64_t shared_ptr_block = 0;
+};
+
+const std::pair<const char*, uint64_t LibrarySizes::*> kProbeVariables[] = {
+    {"key_size", &LibrarySizes::key_size},
+    {"key_alignment", &LibrarySizes::key_alignment},
+    {"vector_size", &LibrarySizes::vector_size},
+    {"deque_size", &LibrarySizes::deque_size},
+    {"deque_block_elements", &LibrarySizes::deque_block_elements},
+    {"list_size", &LibrarySizes::list_size},
+    {"list_node", &LibrarySizes::list_node},
+    {"map_size", &LibrarySizes::map_size},
+    {"map_node", &LibrarySizes::map_node},
+    {"unordered_map_size", &LibrarySizes::unordered_map_size},
+    {"unordered_map_node", &LibrarySizes::unordered_map_node},
+    {"unique_ptr_size", &LibrarySizes::unique_ptr_size},
+    {"shared_ptr_size", &LibrarySizes::shared_ptr_size},
+    {"make_shared_block", &LibrarySizes::make_shared_block},
+    {"shared_ptr_block", &LibrarySizes::shared_ptr_block},
+};
+
+uint64_t RoundUp(uint64_t value, uint64_t alignment) {
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+// Appended to the source: with libstdc++ headers, constexpr sizes of the
+// node types instantiated for `element`. Nothing is declared otherwise.
+std::string ProbeSource(const std::string& element, const std::string& key) {
+    std::string source = "\n#if __has_include(<deque>)\n"
+        "#include <deque>\n#include <list>\n#include <map>\n#include <memory>\n"
+        "#include <unordered_map>\n#include <vector>\n"
+        "#endif\n"
+        "#if defined(__GLIBCXX__)\n"
+        "namespace " + std::string(kProbeNamespace) + " {\n"
+        "using Element = ::" + element + ";\n"
+        "using Key = " + key + ";\n"
+        "using Value = std::pair<const Key, Element>;\n";
+
+    auto size = [&](const char* name, const std::string& expression) {
+        source += "constexpr unsigned long long " + std::string(name) + " = " + expression + ";\n";
+    };
+    size("key_size", "sizeof(Key)");
+    size("key_alignment", "alignof(Key)");
+    size("vector_size", "sizeof(std::vector<Element>)");
+    size("deque_size", "sizeof(std::deque<Element>)");
+    size("deque_block_elements", "std::__deque_buf_size(sizeof(Element))");
+    size("list_size", "sizeof(std::list<Element>)");
+    size("list_node", "sizeof(std::_List_node<Element>)");
+    size("map_size", "sizeof(std::map<Key, Element>)");
+    size("map_node", "sizeof(std::_Rb_tree_node<Value>)");
+    size("unordered_map_size", "sizeof(std::unordered_map<Key, Element>)");
+    size("unordered_map_node",
+         "sizeof(std::__detail::_Hash_node<Value, std::__cache_default<Key, std::hash<Key>>::value>)");
+    size("unique_ptr_size", "sizeof(std::unique_ptr<Element>)");
+    size("shared_ptr_size", "sizeof(std::shared_ptr<Element>)");
+    size("make_shared_block",
+         "sizeof(std::_Sp_counted_ptr_inplace<Element, std::allocator<Element>, std::__default_lock_policy>)");
+    size("shared_ptr_block", "sizeof(std::_Sp_counted_ptr<Element*, std::__default_lock_policy>)");
+
+    source += "}\n#endif\n";
+    return source;
+}
+
+// Reads the probe's constants back; false if it wasn't compiled in
+bool ReadProbe(clang::ASTContext& context, LibrarySizes& sizes) {
+    std::map<std::string, uint64_t> values;
+    for (const clang::Decl* decl : context.getTranslationUnitDecl()->decls()) {
+        const auto* probe = llvm::dyn_cast<clang::NamespaceDecl>(decl);
+        if (!probe || probe->getName() != kProbeNamespace) {
+            continue;
+        }
+        for (const clang::Decl* member : probe->decls()) {
+            const auto* var = llvm::dyn_cast<clang::VarDecl>(member);
+            const clang::APValue* value = var ? var->evaluateValue() : nullptr;
+            if (value && value->isInt()) {
+                values[var->getNameAsString()] = value->getInt().getZExtValue();
+            }
+        }
+    }
+
+    for (const auto& variable : kProbeVariables) {
+        auto it = values.find(variable.first);
+        if (it == values.end()) {
+            return false;
+        }
+        sizes.*variable.second = it->second;
+    }
+    return true;
+}
+
+// Size of the common key types, and whether libstdc++
+// caches their hash codes in the node (it doesn't for integers and
+// pointers, whose std::hash is "fast"). Other keys are taken to be
+// pointer-sized with a cached hash.
+void ModelKey(const std::string& key, uint64_t pointer_size, uint64_t& size, bool& hash_cached) {
+    static const std::map<std::string, uint64_t> kFixedSizes = {
+        {"char", 1}, {"signed char", 1}, {"unsigned char", 1}, {"bool", 1},
+        {"short", 2}, {"unsigned short", 2}, {"int", 4}, {"unsigned", 4}, {"unsigned int", 4},
+        {"long long", 8}, {"unsigned long long", 8},
+        {"std::int8_t", 1}, {"std::uint8_t", 1}, {"std::int16_t", 2}, {"std::uint16_t", 2},
+        {"std::int32_t", 4}, {"std::uint32_t", 4}, {"std::int64_t", 8}, {"std::uint64_t", 8},
+    };
+    auto it = kFixedSizes.find(key);
+    if (it != kFixedSizes.end()) {
+        size = it->second;
+        hash_cached = false;
+    } else if (key == "long" || key == "unsigned long" || key == "std::size_t" || key == "size_t" ||
+               key == "std::ptrdiff_t" || key == "std::intptr_t" || key == "std::uintptr_t" ||
+               (!key.empty() && key.back() == '*')) {
+        size = pointer_size;
+        hash_cached = false;
+    } else if (key == "std::string") {
+        size = 2 * pointer_size + 16; // Pointer, length and the 16-byte local buffer
+        hash_cached = true;
+    } else {
+        size = pointer_size;
+        hash_cached = true;
+    }
+}
+
+// libstdc++'s node and block layouts for a record of `size` bytes and
+// `alignment`: a node base of links, then the value at its alignment
+LibrarySizes ModelSizes(uint64_t size, uint64_t alignment, uint64_t pointer_size, const std::string& key) {
+    LibrarySizes sizes;
+    uint64_t p = pointer_size;
+    bool hash_cached = false;
+    ModelKey(key, p, sizes.key_size, hash_cached);
+    sizes.key_alignment = std::min(sizes.key_size, p);
+
+    uint64_t pair_alignment = std::max(sizes.key_alignment, alignment);
+    uint64_t pair_size = RoundUp(RoundUp(sizes.key_size, alignment) + size, pair_alignment);
+
+    sizes.vector_size = 3 * p;   // Begin, end, end of storage
+    sizes.deque_size = 10 * p;   // Map, map size, start and finish iterators
+    sizes.deque_block_elements = size < kDequeBlockBytes ? kDequeBlockBytes / size : 1;
+    sizes.list_size = 3 * p;     // Sentinel links and size
+    sizes.list_node = RoundUp(RoundUp(2 * p, alignment) + size, std::max(p, alignment));
+    sizes.map_size = 6 * p;      // Header node (color and three links) and count
+    sizes.map_node = RoundUp(RoundUp(4 * p, pair_alignment) + pair_size, std::max(p, pair_alignment));
+    sizes.unordered_map_size = 7 * p;
+    uint64_t hash_node = RoundUp(p, pair_alignment) + pair_size;
+    if (hash_cached) {
+        hash_node = RoundUp(hash_node, p) + p;
+    }
+    sizes.unordered_map_node = RoundUp(hash_node, std::max(p, pair_alignment));
+    sizes.unique_ptr_size = p;
+    sizes.shared_ptr_size = 2 * p;
+    // Control blocks: vptr and two 32-bit counts, then the object or pointer
+    sizes.make_shared_block = RoundUp(RoundUp(p + 8, alignment) + size, std::max(p, alignment));
+    sizes.shared_ptr_block = RoundUp(p + 8, p) + p;
+    return sizes;
+}
+
+// Bucket counts a default-constructed libstdc++ unordered_map grows
+// through as elements are inserted one at a time. _Prime_rehash_policy
+// rehashes once the size passes the bucket count (maximum load factor 1)
+// to _M_next_bkt(2 * buckets), the next entry of its __prime_list, and
+// starts from 13 buckets on the first insert.
+const uint64_t kBucketGrowth[] = {
+    13, 29, 59, 127, 257, 541, 1109, 2357, 5087, 10273, 20753, 42043, 85229,
+    172933, 351061, 712697, 1447153, 2938679, 5967347, 12117689, 24607243,
+    49969847, 101473717, 206062531, 418451333, 849749479, 1725587117,
+    3504151727ull, 8589934583ull, 25769803693ull, 68719476731ull,
+    206158430123ull, 412316860387ull, 1099511627689ull, 2199023255531ull,
+};
+
+// The bucket count libstdc++ ends up with after inserting `count`
+// elements without a reserve(): the first growth step at least `count`
+uint64_t BucketCount(uint64_t count) {
+    for (uint64_t buckets : kBucketGrowth) {
+        if (buckets >= count) {
+            return buckets;
+        }
+    }
+    return count;
+}
+
+// Unnamed, local and lambda records can't be spelled in the probe
+bool CanBeNamed(const std::string& qualified_name) {
+    return !qualified_name.empty() && qualified_name.find('(') == std::string::npos;
+}
+
+} // namespace
+
+ContainerFootprintEstimator::ContainerFootprintEstimator(LayoutCache* layout_cache)
+    : layout_cache_(layout_cache) {}
+
+uint64_t ContainerFootprintEstimator::MallocChunkSize(
+    uint64_t request,
+    uint64_t pointer_size,
+    uint64_t alignment
+) {
+    if (request == 0) {
+        return 0;
+    }
+    uint64_t minimum = RoundUp(4 * pointer_size, alignment);
+    uint64_t chunk = std::max(minimum, RoundUp(request + pointer_size, alignment));
+    if (request >= kMmapThreshold) {
+        return RoundUp(chunk + pointer_size, kPageSize);
+    }
+    return chunk;
+}
+
+FootprintResult ContainerFootprintEstimator::Analyze(const FootprintRequest& request) {
+    FootprintResult result;
+    result.element_count = request.element_count;
+    result.key_type = request.key_type;
+
+    const AnalysisRequest& analysis = request.analysis;
+    if (analysis.struct_name.empty() && analysis.target_line == 0) {
+        result.error_message = "No record given";
+        return result;
+    }
+
+    AnalysisResult layouts = Analyzer(nullptr, layout_cache_).Analyze(analysis);
+    if (!layouts.success) {
+        result.error_message = layouts.error_message;
+        result.cancelled = layouts.cancelled;
+        return result;
+    }
+    if (layouts.layouts.empty()) {
+        result.error_message = "Record not found";
+        return result;
+    }
+
+    const StructLayout& layout = layouts.layouts.front();
+    result.qualified_name = layout.qualified_name;
+    result.element_size = layout.total_size;
+    result.element_alignment = layout.alignment;
+    if (!CanBeNamed(layout.qualified_name)) {
+        result.error_message = "Unnamed records can't be named as container elements";
+        return result;
+    }
+
+    // The target decides the pointer size and glibc's chunk alignment
+    // (16 bytes on 64-bit targets and i386, two pointers elsewhere)
+    llvm::Triple triple(analysis.target_triple);
+    bool x86 = analysis.target_triple.empty() || triple.isX86();
+    uint64_t p = analysis.target_triple.empty()
+        ? (analysis.architecture == Architecture::X64 ? 8 : 4)
+        : (triple.isArch64Bit() ? 8 : 4);
+    uint64_t malloc_alignment = (p == 8 || x86) ? 16 : 2 * p;
+
+    // Reparse with the probe; its own preamble would never be reused
+    AnalysisRequest probe_request = analysis;
+    probe_request.source_code += ProbeSource(layout.qualified_name, request.key_type);
+    probe_request.collect_stats = false;
+    AnalysisResult probe_result;
+    std::unique_ptr<ParsedUnit> unit = Analyzer().Parse(probe_request, probe_result);
+    if (probe_result.cancelled) {
+        result.cancelled = true;
+        result.error_message = "Analysis cancelled";
+        return result;
+    }
+
+    LibrarySizes sizes;
+    bool measured = unit && ReadProbe(unit->GetASTContext(), sizes);
+    if (!measured) {
+        sizes = ModelSizes(layout.total_size, layout.alignment, p, request.key_type);
+    }
+
+    uint64_t n = request.element_count;
+    uint64_t s = layout.total_size;
+    auto chunk = [&](uint64_t bytes) { return MallocChunkSize(bytes, p, malloc_alignment); };
+    const std::string element = layout.qualified_name;
+    const std::string value = "std::pair<const " + request.key_type + ", " + element + ">";
+
+    auto add = [&](const std::string& container, const std::string& node_type, uint64_t object_size,
+                   uint64_t node_size, uint64_t elements_per_allocation, uint64_t heap_bytes,
+                   bool per_element_object) {
+        ContainerFootprint footprint;
+        footprint.container = container;
+        footprint.node_type = node_type;
+        footprint.object_size = object_size;
+        footprint.node_size = node_size;
+        footprint.allocation_size = chunk(node_size);
+        footprint.elements_per_allocation = elements_per_allocation;
+        footprint.projected_bytes = heap_bytes + (per_element_object ? n * object_size : object_size);
+        footprint.bytes_per_element = n > 0
+            ? static_cast<double>(footprint.projected_bytes - (per_element_object ? 0 : object_size)) / n
+            : 0;
+        footprint.measured = measured;
+        result.containers.push_back(std::move(footprint));
+    };
+
+    // push_back doubles the capacity, so N elements sit in a buffer of
+    // the next power of two
+    uint64_t capacity = n > 0 ? llvm::PowerOf2Ceil(n) : 0;
+    add("std::vector", "", sizes.vector_size, capacity * s, 0, chunk(capacity * s), false);
+
+    // A map of block pointers (at least 8, two spare) and N / E + 1 blocks
+    uint64_t block_elements = std::max<uint64_t>(sizes.deque_block_elements, 1);
+    uint64_t blocks = n / block_elements + 1;
+    uint64_t map_slots = std::max<uint64_t>(8, blocks + 2);
+    add("std::deque", element + "[" + std::to_string(block_elements) + "]", sizes.deque_size,
+        block_elements * s, block_elements,
+        chunk(map_slots * p) + blocks * chunk(block_elements * s), false);
+
+    add("std::list", "std::_List_node<" + element + ">", sizes.list_size, sizes.list_node, 1,
+        n * chunk(sizes.list_node), false);
+    add("std::map", "std::_Rb_tree_node<" + value + ">", sizes.map_size, sizes.map_node, 1,
+        n * chunk(sizes.map_node), false);
+
+    // One element needs no bucket array: it uses the single bucket inside
+    // the container
+    uint64_t bucket_bytes = n > 1 ? chunk(BucketCount(n) * p) : 0;
+    add("std::unordered_map", "std::__detail::_Hash_node<" + value + ">", sizes.unordered_map_size,
+        sizes.unordered_map_node, 1, n * chunk(sizes.unordered_map_node) + bucket_bytes, false);
+
+    add("std::unique_ptr", "", sizes.unique_ptr_size, s, 1, n * chunk(s), true);
+    add("std::shared_ptr (make_shared)", "std::_Sp_counted_ptr_inplace<" + element + ">",
+        sizes.shared_ptr_size, sizes.make_shared_block, 1, n * chunk(sizes.make_shared_block), true);
+    // shared_ptr<T>(new T): the object and a separate control block
+    add("std::shared_ptr (new)", "std::_Sp_counted_ptr<" + element + "*>", sizes.shared_ptr_size,
+        sizes.shared_ptr_block, 1, n * (chunk(s) + chunk(sizes.shared_ptr_block)), true);
+
+    result.success = true;
+    return result;
+}
+
+} // namespace structsight
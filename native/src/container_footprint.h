@@ -0,0 +1,38 @@
+#ifndef STRUCTSIGHT_CONTAINER_FOOTPRINT_H
+#define STRUCTSIGHT_CONTAINER_FOOTPRINT_H
+
+#include "types.h"
+#include "layout_cache.h"
+#include <string>
+#include <vector>
+
+namespace structsight {
+
+// Estimates what one record costs per element in std::vector, std::deque,
+// std::list, std::map, std::unordered_map, std::unique_ptr and
+// std::shared_ptr. The record is laid out as usual, then the source is
+// parsed again with a probe appended that takes sizeof the libstdc++
+// node, block and control block types instantiated for it, so the sizes
+// are the ones the translation unit's headers produce. When the headers
+// aren't libstdc++'s or the probe doesn't compile (an abstract class, a
+// key without std::hash), the same types are modeled from the record's
+// size and alignment and the target's pointer size.
+class ContainerFootprintEstimator {
+public:
+    // layout_cache is optional; it serves the record's own layout
+    explicit ContainerFootprintEstimator(LayoutCache* layout_cache = nullptr);
+
+    FootprintResult Analyze(const FootprintRequest& request);
+
+    // Bytes glibc malloc takes from the heap for a `request` byte block:
+    // the size field plus rounding to its alignment, at least the minimum
+    // chunk, and whole pages once the block is mmapped
+    static uint64_t MallocChunkSize(uint64_t request, uint64_t pointer_size, uint64_t alignment);
+
+private:
+    LayoutCache* layout_cache_;
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_CONTAINER_FOOTPRINT_H
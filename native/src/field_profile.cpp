@@ -0,0 +1,115 @@
+#include "field_profile.h"
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/SHA1.h>
+#include <map>
+#include <mutex>
+
+namespace structsight {
+
+bool FieldProfile::Parse(llvm::StringRef text, std::string& error) {
+    samples_.clear();
+    digest_ = llvm::toHex(llvm::SHA1::hash(llvm::arrayRefFromStringRef(text)), true);
+
+    llvm::SmallVector<llvm::StringRef, 0> lines;
+    text.split(lines, '\n');
+
+    bool first_row = true;
+    for (size_t i = 0; i < lines.size(); i++) {
+        llvm::StringRef line = lines[i].split('#').first.trim();
+        if (line.empty()) {
+            continue;
+        }
+        bool header_allowed = first_row;
+        first_row = false;
+
+        auto columns = line.rsplit(',');
+        llvm::StringRef field = columns.first.trim();
+        llvm::StringRef count = columns.second.trim();
+
+        uint64_t samples = 0;
+        if (count.getAsInteger(10, samples)) {
+            // A header row like "field,samples" is fine; anything later isn't
+            if (header_allowed) {
+                continue;
+            }
+            error = "line " + std::to_string(i + 1) + ": expected Type::field,samples";
+            return false;
+        }
+
+        if (field.rfind("::") == llvm::StringRef::npos) {
+            error = "line " + std::to_string(i + 1) + ": field must be written as Type::field";
+            return false;
+        }
+
+        samples_[field.str()] += samples;
+    }
+
+    return true;
+}
+
+std::shared_ptr<const FieldProfile> FieldProfile::Load(const std::string& path, std::string& error) {
+    struct Loaded {
+        llvm::sys::TimePoint<> mtime;
+        uint64_t size;
+        std::shared_ptr<const FieldProfile> profile;
+    };
+    static std::mutex mutex;
+    static std::map<std::string, Loaded> loaded;
+
+    llvm::sys::fs::file_status status;
+    if (std::error_code ec = llvm::sys::fs::status(path, status)) {
+        error = path + ": " + ec.message();
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = loaded.find(path);
+        if (it != loaded.end() &&
+            it->second.mtime == status.getLastModificationTime() &&
+            it->second.size == status.getSize()) {
+            return it->second.profile;
+        }
+    }
+
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+        error = path + ": " + buffer.getError().message();
+        return nullptr;
+    }
+
+    auto profile = std::make_shared<FieldProfile>();
+    if (!profile->Parse((*buffer)->getBuffer(), error)) {
+        error = path + ": " + error;
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    loaded[path] = Loaded{status.getLastModificationTime(), status.getSize(), profile};
+    return profile;
+}
+
+uint64_t FieldProfile::GetSamples(
+    const std::string& qualified_type,
+    const std::string& type,
+    const std::string& field
+) const {
+    auto it = samples_.find(qualified_type + "::" + field);
+    if (it == samples_.end()) {
+        it = samples_.find(type + "::" + field);
+    }
+    return it != samples_.end() ? it->second : 0;
+}
+
+const std::string& FieldProfile::GetDigest() const {
+    return digest_;
+}
+
+bool FieldProfile::IsEmpty() const {
+    return samples_.empty();
+}
+
+} // namespace structsight
@@ -0,0 +1,43 @@
+#ifndef STRUCTSIGHT_FIELD_PROFILE_H
+#define STRUCTSIGHT_FIELD_PROFILE_H
+
+#include <llvm/ADT/StringRef.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace structsight {
+
+// Measured access counts per field, e.g. perf or pprof samples attributed
+// to member loads and stores. Read from a CSV with one "Type::field,samples"
+// row per line; '#' starts a comment, a non-numeric header row is skipped
+// and repeated rows are summed. Type may be qualified ("ns::Request") or not.
+class FieldProfile {
+public:
+    // Parse CSV text. Returns false and sets `error` on a malformed row.
+    bool Parse(llvm::StringRef text, std::string& error);
+
+    // Load a CSV file, reusing the previous load while the file is unchanged
+    static std::shared_ptr<const FieldProfile> Load(const std::string& path, std::string& error);
+
+    // Samples for a field, trying the qualified type name first
+    uint64_t GetSamples(
+        const std::string& qualified_type,
+        const std::string& type,
+        const std::string& field
+    ) const;
+
+    // Hash of the CSV text, so cached results are tied to one profile
+    const std::string& GetDigest() const;
+
+    bool IsEmpty() const;
+
+private:
+    std::unordered_map<std::string, uint64_t> samples_; // "Type::field" -> samples
+    std::string digest_;
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_FIELD_PROFILE_H
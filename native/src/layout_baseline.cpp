@@ -0,0 +1,292 @@
+#include "layout_baseline.h"
+#include <llvm/Support/JSON.h>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace structsight {
+
+namespace {
+
+const int64_t kBaselineVersion = 1;
+
+// llvm::json stores integers as int64_t
+int64_t ToJSON(uint64_t value) {
+    return static_cast<int64_t>(value);
+}
+
+bool SameLayout(const BaselineRecord& a, const BaselineRecord& b) {
+    auto same_member = [](const BaselineMember& x, const BaselineMember& y) {
+        return x.name == y.name && x.offset == y.offset && x.size == y.size;
+    };
+    return a.total_size == b.total_size && a.alignment == b.alignment &&
+           a.padding == b.padding &&
+           std::equal(a.members.begin(), a.members.end(),
+                      b.members.begin(), b.members.end(), same_member);
+}
+
+uint64_t CacheLines(uint64_t size, uint32_t cache_line_size) {
+    return (size + cache_line_size - 1) / cache_line_size;
+}
+
+bool CrossesLine(const BaselineMember& member, uint32_t cache_line_size) {
+    return member.size > 0 &&
+           member.offset / cache_line_size != (member.offset + member.size - 1) / cache_line_size;
+}
+
+// Reads a non-negative integer field; false if it is missing or negative
+bool GetUnsigned(const llvm::json::Object& object, llvm::StringRef key, uint64_t& value) {
+    llvm::Optional<int64_t> number = object.getInteger(key);
+    if (!number || *number < 0) {
+        return false;
+    }
+    value = static_cast<uint64_t>(*number);
+    return true;
+}
+
+bool ReadRecord(const llvm::json::Value& value, BaselineRecord& record) {
+    const llvm::json::Object* object = value.getAsObject();
+    if (!object) {
+        return false;
+    }
+    llvm::Optional<llvm::StringRef> name = object->getString("qualifiedName");
+    const llvm::json::Array* members = object->getArray("members");
+    if (!name || !members ||
+        !GetUnsigned(*object, "totalSize", record.total_size) ||
+        !GetUnsigned(*object, "alignment", record.alignment) ||
+        !GetUnsigned(*object, "padding", record.padding)) {
+        return false;
+    }
+    record.qualified_name = name->str();
+
+    for (const auto& entry : *members) {
+        const llvm::json::Object* member_object = entry.getAsObject();
+        if (!member_object) {
+            return false;
+        }
+        BaselineMember member;
+        llvm::Optional<llvm::StringRef> member_name = member_object->getString("name");
+        if (!member_name ||
+            !GetUnsigned(*member_object, "offset", member.offset) ||
+            !GetUnsigned(*member_object, "size", member.size)) {
+            return false;
+        }
+        member.name = member_name->str();
+        record.members.push_back(std::move(member));
+    }
+    return true;
+}
+
+bool ByName(const BaselineRecord& a, const BaselineRecord& b) {
+    return a.qualified_name < b.qualified_name;
+}
+
+LayoutChange Summarize(LayoutChange::Kind kind, const BaselineRecord* before,
+                       const BaselineRecord* after, uint32_t cache_line_size) {
+    LayoutChange change;
+    change.kind = kind;
+    change.qualified_name = before ? before->qualified_name : after->qualified_name;
+    if (before) {
+        change.size_before = before->total_size;
+        change.alignment_before = before->alignment;
+        change.padding_before = before->padding;
+        change.lines_before = CacheLines(before->total_size, cache_line_size);
+    }
+    if (after) {
+        change.size_after = after->total_size;
+        change.alignment_after = after->alignment;
+        change.padding_after = after->padding;
+        change.lines_after = CacheLines(after->total_size, cache_line_size);
+    }
+    return change;
+}
+
+} // namespace
+
+bool LayoutChange::IsRegression() const {
+    if (kind != Kind::Changed) {
+        return false;
+    }
+    return size_after > size_before || padding_after > padding_before ||
+           lines_after > lines_before || !new_crossings.empty();
+}
+
+BaselineTarget LayoutBaseline::FromLayouts(
+    const std::vector<StructLayout>& layouts,
+    const std::string& target,
+    uint32_t cache_line_size
+) {
+    BaselineTarget baseline;
+    baseline.target = target;
+    baseline.cache_line_size = cache_line_size;
+
+    // The CLI and project scans can see a header's records more than once
+    std::unordered_set<std::string> seen;
+    for (const auto& layout : layouts) {
+        if (!seen.insert(layout.qualified_name).second) {
+            continue;
+        }
+        BaselineRecord record;
+        record.qualified_name = layout.qualified_name;
+        record.total_size = layout.total_size;
+        record.alignment = layout.alignment;
+        for (const auto& padding : layout.padding) {
+            record.padding += padding.size;
+        }
+        for (const auto& member : layout.members) {
+            record.members.push_back({member.name, member.offset, member.size});
+        }
+        baseline.records.push_back(std::move(record));
+    }
+
+    std::sort(baseline.records.begin(), baseline.records.end(), ByName);
+    return baseline;
+}
+
+void LayoutBaseline::Write(llvm::raw_ostream& out, const std::vector<BaselineTarget>& targets) {
+    llvm::json::OStream json(out, 1);
+
+    json.object([&] {
+        json.attribute("version", kBaselineVersion);
+        json.attributeArray("targets", [&] {
+            for (const auto& target : targets) {
+                json.object([&] {
+                    json.attribute("target", target.target);
+                    json.attribute("cacheLineSize", static_cast<int64_t>(target.cache_line_size));
+                    json.attributeArray("records", [&] {
+                        for (const auto& record : target.records) {
+                            json.object([&] {
+                                json.attribute("qualifiedName", record.qualified_name);
+                                json.attribute("totalSize", ToJSON(record.total_size));
+                                json.attribute("alignment", ToJSON(record.alignment));
+                                json.attribute("padding", ToJSON(record.padding));
+                                json.attributeArray("members", [&] {
+                                    for (const auto& member : record.members) {
+                                        json.object([&] {
+                                            json.attribute("name", member.name);
+                                            json.attribute("offset", ToJSON(member.offset));
+                                            json.attribute("size", ToJSON(member.size));
+                                        });
+                                    }
+                                });
+                            });
+                        }
+                    });
+                });
+            }
+        });
+    });
+
+    out << "\n";
+}
+
+bool LayoutBaseline::Read(
+    llvm::StringRef text,
+    std::vector<BaselineTarget>& targets,
+    std::string& error
+) {
+    targets.clear();
+
+    llvm::Expected<llvm::json::Value> parsed = llvm::json::parse(text);
+    if (!parsed) {
+        error = llvm::toString(parsed.takeError());
+        return false;
+    }
+
+    const llvm::json::Object* root = parsed->getAsObject();
+    if (!root || root->getInteger("version") != kBaselineVersion) {
+        error = "not a version " + std::to_string(kBaselineVersion) + " layout baseline";
+        return false;
+    }
+
+    const llvm::json::Array* target_array = root->getArray("targets");
+    if (!target_array) {
+        error = "baseline has no targets";
+        return false;
+    }
+
+    for (const auto& entry : *target_array) {
+        const llvm::json::Object* object = entry.getAsObject();
+        llvm::Optional<llvm::StringRef> name = object ? object->getString("target") : llvm::None;
+        const llvm::json::Array* records = object ? object->getArray("records") : nullptr;
+        uint64_t cache_line_size = 0;
+        if (!name || !records || !GetUnsigned(*object, "cacheLineSize", cache_line_size)) {
+            error = "malformed target entry";
+            return false;
+        }
+
+        BaselineTarget target;
+        target.target = name->str();
+        target.cache_line_size = static_cast<uint32_t>(cache_line_size);
+        for (const auto& value : *records) {
+            BaselineRecord record;
+            if (!ReadRecord(value, record)) {
+                error = target.target + ": malformed record";
+                return false;
+            }
+            target.records.push_back(std::move(record));
+        }
+
+        // Written sorted, but the file may have been edited by hand
+        if (!std::is_sorted(target.records.begin(), target.records.end(), ByName)) {
+            std::sort(target.records.begin(), target.records.end(), ByName);
+        }
+        targets.push_back(std::move(target));
+    }
+
+    return true;
+}
+
+std::vector<LayoutChange> LayoutBaseline::Compare(
+    const BaselineTarget& before,
+    const BaselineTarget& after,
+    uint32_t cache_line_size
+) {
+    std::vector<LayoutChange> changes;
+
+    auto old_it = before.records.begin();
+    auto new_it = after.records.begin();
+    while (old_it != before.records.end() || new_it != after.records.end()) {
+        if (new_it == after.records.end() ||
+            (old_it != before.records.end() && old_it->qualified_name < new_it->qualified_name)) {
+            changes.push_back(Summarize(LayoutChange::Kind::Removed, &*old_it, nullptr, cache_line_size));
+            ++old_it;
+            continue;
+        }
+        if (old_it == before.records.end() || new_it->qualified_name < old_it->qualified_name) {
+            changes.push_back(Summarize(LayoutChange::Kind::Added, nullptr, &*new_it, cache_line_size));
+            ++new_it;
+            continue;
+        }
+
+        const BaselineRecord& old_record = *old_it++;
+        const BaselineRecord& new_record = *new_it++;
+        if (SameLayout(old_record, new_record)) {
+            continue;
+        }
+
+        LayoutChange change = Summarize(LayoutChange::Kind::Changed, &old_record, &new_record, cache_line_size);
+
+        std::unordered_map<std::string, const BaselineMember*> old_members;
+        for (const auto& member : old_record.members) {
+            old_members.emplace(member.name, &member);
+        }
+        for (const auto& member : new_record.members) {
+            auto it = old_members.find(member.name);
+            const BaselineMember* old_member = it != old_members.end() ? it->second : nullptr;
+            if (old_member && (old_member->offset != member.offset || old_member->size != member.size)) {
+                change.moved_members.push_back(member.name);
+            }
+            if (CrossesLine(member, cache_line_size) &&
+                !(old_member && CrossesLine(*old_member, cache_line_size))) {
+                change.new_crossings.push_back(member.name);
+            }
+        }
+
+        changes.push_back(std::move(change));
+    }
+
+    return changes;
+}
+
+} // namespace structsight
@@ -0,0 +1,93 @@
+#ifndef STRUCTSIGHT_LAYOUT_BASELINE_H
+#define STRUCTSIGHT_LAYOUT_BASELINE_H
+
+#include "types.h"
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace structsight {
+
+// What a baseline keeps of one member: enough to tell that it moved, grew
+// or now straddles a cache line
+struct BaselineMember {
+    std::string name;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+struct BaselineRecord {
+    std::string qualified_name;
+    uint64_t total_size = 0;
+    uint64_t alignment = 0;
+    uint64_t padding = 0;                // Bytes, all regions together
+    std::vector<BaselineMember> members; // Declaration order
+};
+
+// The layouts of one target ("x64-clang", ...), records sorted by
+// qualified name so the file diffs cleanly under version control
+struct BaselineTarget {
+    std::string target;
+    uint32_t cache_line_size = kDefaultCacheLineSize;
+    std::vector<BaselineRecord> records;
+};
+
+// One record that differs between a baseline and the current layouts
+struct LayoutChange {
+    enum class Kind { Added, Removed, Changed };
+
+    Kind kind = Kind::Changed;
+    std::string qualified_name;
+    uint64_t size_before = 0;
+    uint64_t size_after = 0;
+    uint64_t alignment_before = 0;
+    uint64_t alignment_after = 0;
+    uint64_t padding_before = 0;
+    uint64_t padding_after = 0;
+    uint64_t lines_before = 0;   // Cache lines one object spans
+    uint64_t lines_after = 0;
+    std::vector<std::string> new_crossings; // Members that now straddle a cache line boundary
+    std::vector<std::string> moved_members; // Members whose offset or size changed
+
+    // Grew, gained padding, spans more cache lines, or has new crossings
+    bool IsRegression() const;
+};
+
+// Size-regression baselines: a stable JSON form of the layouts of one or
+// more targets, and a diff of current layouts against it.
+//
+//   { "version": 1, "targets": [ { "target": "x64-clang", "cacheLineSize": 64,
+//     "records": [ { "qualifiedName", "totalSize", "alignment", "padding",
+//                    "members": [ { "name", "offset", "size" } ] } ] } ] }
+//
+// Crossings are recomputed from member offsets with the current cache line
+// size, so a baseline stays comparable if the line size setting changes.
+class LayoutBaseline {
+public:
+    // The records of `layouts`, each qualified name once (first wins), sorted
+    static BaselineTarget FromLayouts(
+        const std::vector<StructLayout>& layouts,
+        const std::string& target,
+        uint32_t cache_line_size
+    );
+
+    static void Write(llvm::raw_ostream& out, const std::vector<BaselineTarget>& targets);
+
+    // Returns false and sets `error` if the text isn't a baseline
+    static bool Read(llvm::StringRef text, std::vector<BaselineTarget>& targets, std::string& error);
+
+    // Changed, added and removed records, by qualified name. Both sides are
+    // walked once in name order; records that are identical cost one
+    // comparison of their fields.
+    static std::vector<LayoutChange> Compare(
+        const BaselineTarget& before,
+        const BaselineTarget& after,
+        uint32_t cache_line_size
+    );
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_LAYOUT_BASELINE_H
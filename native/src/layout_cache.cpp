@@ -0,0 +1,283 @@
+#include "layout_cache.h"
+#include "binary_encoder.h"
+#include "field_profile.h"
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FileUtilities.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA1.h>
+#include <chrono>
+#include <cstring>
+
+namespace structsight {
+
+namespace {
+
+// Entries are local to one machine, so they use host byte order:
+//   u32 magic, u32 version, u32 fileCount,
+//   per file: u32 pathLength, path, i64 mtime, u64 size, u8[20] sha1,
+//   u64 payloadSize, payload (BinaryEncoder format)
+const uint32_t kEntryMagic = 0x434c5353; // "SSLC"
+const uint32_t kEntryVersion = 1;
+
+// Bumped when the analysis produces different results for the same input,
+// so entries written by an older engine stop matching
+const uint32_t kResultsVersion = 6;
+
+template <typename T>
+void Append(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Sequential reader over a mapped entry; fails on any overrun
+class EntryReader {
+public:
+    explicit EntryReader(llvm::StringRef data) : data_(data), position_(0), ok_(true) {}
+
+    template <typename T>
+    T Read() {
+        T value{};
+        if (Take(sizeof(T))) {
+            std::memcpy(&value, data_.data() + position_ - sizeof(T), sizeof(T));
+        }
+        return value;
+    }
+
+    llvm::StringRef ReadBytes(uint64_t length) {
+        if (!Take(length)) {
+            return llvm::StringRef();
+        }
+        return data_.substr(position_ - length, length);
+    }
+
+    bool Ok() const {
+        return ok_;
+    }
+
+private:
+    llvm::StringRef data_;
+    uint64_t position_;
+    bool ok_;
+
+    bool Take(uint64_t length) {
+        if (!ok_ || length > data_.size() - position_) {
+            ok_ = false;
+            return false;
+        }
+        position_ += length;
+        return true;
+    }
+};
+
+// Length-prefixed so adjacent fields can't run into each other
+void AppendField(std::string& out, const std::string& field) {
+    Append<uint64_t>(out, field.size());
+    out += field;
+}
+
+} // namespace
+
+LayoutCache::LayoutCache(std::string directory) : directory_(std::move(directory)) {}
+
+void LayoutCache::SetDirectory(std::string directory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    directory_ = std::move(directory);
+}
+
+bool LayoutCache::IsEnabled() const {
+    return !GetDirectory().empty();
+}
+
+std::string LayoutCache::GetDirectory() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return directory_;
+}
+
+std::string LayoutCache::EntryPath(const std::string& directory, const std::string& key) const {
+    // Two-level fan-out keeps directories small
+    llvm::SmallString<256> path(directory);
+    llvm::sys::path::append(path, key.substr(0, 2), key.substr(2) + ".layout");
+    return std::string(path.str());
+}
+
+std::string LayoutCache::ComputeKey(const AnalysisRequest& request) {
+    std::string material;
+    Append<uint32_t>(material, kEntryVersion);
+    Append<uint32_t>(material, BinaryEncoder::kVersion);
+    Append<uint32_t>(material, kResultsVersion);
+    AppendField(material, request.source_code);
+    AppendField(material, request.file_path);
+    Append<uint32_t>(material, static_cast<uint32_t>(request.architecture));
+    Append<uint32_t>(material, static_cast<uint32_t>(request.compiler));
+    AppendField(material, request.target_triple);
+    Append<uint64_t>(material, request.compile_flags.size());
+    for (const auto& flag : request.compile_flags) {
+        AppendField(material, flag);
+    }
+    AppendField(material, request.struct_name);
+    Append<uint32_t>(material, request.target_line);
+    Append<uint32_t>(material, request.target_column);
+    Append<uint8_t>(material, request.include_system_headers ? 1 : 0);
+    Append<uint8_t>(material, request.include_template_instantiations ? 1 : 0);
+    Append<uint64_t>(material, request.path_filter.size());
+    for (const auto& prefix : request.path_filter) {
+        AppendField(material, prefix);
+    }
+    AppendField(material, request.profile ? request.profile->GetDigest() : std::string());
+    Append<uint32_t>(material, request.cache_line_size);
+
+    return llvm::toHex(llvm::SHA1::hash(llvm::arrayRefFromStringRef(material)), true);
+}
+
+bool LayoutCache::StampFile(const std::string& path, FileStamp& stamp) {
+    llvm::sys::fs::file_status status;
+    if (llvm::sys::fs::status(path, status)) {
+        return false;
+    }
+
+    stamp.path = path;
+    stamp.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        status.getLastModificationTime().time_since_epoch()).count();
+    stamp.size = status.getSize();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = stamps_.find(path);
+        if (it != stamps_.end() && it->second.mtime == stamp.mtime && it->second.size == stamp.size) {
+            stamp.hash = it->second.hash;
+            return true;
+        }
+    }
+
+    auto buffer = llvm::MemoryBuffer::getFile(path, false, false);
+    if (!buffer) {
+        return false;
+    }
+    stamp.hash = llvm::SHA1::hash(llvm::arrayRefFromStringRef((*buffer)->getBuffer()));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stamps_[path] = stamp;
+    return true;
+}
+
+bool LayoutCache::IsUnchanged(const FileStamp& recorded) {
+    // Same size and mtime: trust the recorded hash without reading the file
+    llvm::sys::fs::file_status status;
+    if (llvm::sys::fs::status(recorded.path, status)) {
+        return false;
+    }
+    int64_t mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        status.getLastModificationTime().time_since_epoch()).count();
+    if (mtime == recorded.mtime && status.getSize() == recorded.size) {
+        return true;
+    }
+
+    // Touched but possibly identical (checkout, rebuild): compare content
+    FileStamp current;
+    if (!StampFile(recorded.path, current)) {
+        return false;
+    }
+    return current.hash == recorded.hash;
+}
+
+bool LayoutCache::Lookup(const std::string& key, std::vector<StructLayout>& layouts) {
+    std::string directory = GetDirectory();
+    if (directory.empty()) {
+        return false;
+    }
+
+    // Not volatile and no terminator needed, so large entries are mmapped
+    auto buffer = llvm::MemoryBuffer::getFile(EntryPath(directory, key), false, false, false);
+    if (!buffer) {
+        return false;
+    }
+
+    EntryReader reader((*buffer)->getBuffer());
+    if (reader.Read<uint32_t>() != kEntryMagic || reader.Read<uint32_t>() != kEntryVersion) {
+        return false;
+    }
+
+    uint32_t file_count = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < file_count && reader.Ok(); i++) {
+        FileStamp recorded;
+        recorded.path = reader.ReadBytes(reader.Read<uint32_t>()).str();
+        recorded.mtime = reader.Read<int64_t>();
+        recorded.size = reader.Read<uint64_t>();
+        llvm::StringRef hash = reader.ReadBytes(recorded.hash.size());
+        if (!reader.Ok()) {
+            return false;
+        }
+        std::memcpy(recorded.hash.data(), hash.data(), recorded.hash.size());
+
+        if (!IsUnchanged(recorded)) {
+            return false;
+        }
+    }
+
+    uint64_t payload_size = reader.Read<uint64_t>();
+    llvm::StringRef payload = reader.ReadBytes(payload_size);
+    if (!reader.Ok()) {
+        return false;
+    }
+
+    return BinaryEncoder::Decode(
+        reinterpret_cast<const uint8_t*>(payload.data()), payload.size(), layouts);
+}
+
+void LayoutCache::Store(
+    const std::string& key,
+    const std::vector<StructLayout>& layouts,
+    const std::vector<std::string>& included_files
+) {
+    std::string directory = GetDirectory();
+    if (directory.empty()) {
+        return;
+    }
+
+    std::string files;
+    uint32_t file_count = 0;
+    for (const auto& path : included_files) {
+        // Files that only exist in memory (the preamble PCH) have nothing to
+        // stat; the headers they were built from are listed on their own
+        if (!llvm::sys::fs::exists(path)) {
+            continue;
+        }
+        FileStamp stamp;
+        if (!StampFile(path, stamp)) {
+            return; // An entry we can't validate later is useless
+        }
+        Append<uint32_t>(files, static_cast<uint32_t>(path.size()));
+        files += path;
+        Append<int64_t>(files, stamp.mtime);
+        Append<uint64_t>(files, stamp.size);
+        files.append(reinterpret_cast<const char*>(stamp.hash.data()), stamp.hash.size());
+        file_count++;
+    }
+
+    std::string entry;
+    Append<uint32_t>(entry, kEntryMagic);
+    Append<uint32_t>(entry, kEntryVersion);
+    Append<uint32_t>(entry, file_count);
+    entry += files;
+
+    std::vector<uint8_t> payload = BinaryEncoder::Encode(layouts);
+    Append<uint64_t>(entry, payload.size());
+    entry.append(reinterpret_cast<const char*>(payload.data()), payload.size());
+
+    std::string path = EntryPath(directory, key);
+    if (llvm::sys::fs::create_directories(llvm::sys::path::parent_path(path))) {
+        return;
+    }
+
+    // Written to a temporary file and renamed, so readers never see half an entry
+    llvm::Error error = llvm::writeFileAtomically(path + ".%%%%%%%%.tmp", path, entry);
+    llvm::consumeError(std::move(error));
+}
+
+LayoutCache& LayoutCache::Global() {
+    static LayoutCache cache;
+    return cache;
+}
+
+} // namespace structsight
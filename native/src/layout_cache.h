@@ -0,0 +1,80 @@
+#ifndef STRUCTSIGHT_LAYOUT_CACHE_H
+#define STRUCTSIGHT_LAYOUT_CACHE_H
+
+#include "types.h"
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace structsight {
+
+// Persistent, content-addressed store of analysis results, shared by every
+// process that points at the same directory (each VS Code window, the CLI).
+//
+// An entry is found by a hash of everything in the request that affects the
+// result: source text, path, target, compiler, flags, record selection,
+// field profile and cache line size.
+// It also lists every header the parse read, with its size, mtime and
+// content hash; the entry is only used while all of them are unchanged, so
+// a hit returns layouts without running Clang at all.
+//
+// Entries are one file each, memory-mapped on lookup and written atomically,
+// so concurrent readers and writers never see a partial entry.
+class LayoutCache {
+public:
+    // Empty directory = disabled
+    explicit LayoutCache(std::string directory = std::string());
+
+    void SetDirectory(std::string directory);
+    bool IsEnabled() const;
+
+    // Hex digest identifying `request`'s result
+    static std::string ComputeKey(const AnalysisRequest& request);
+
+    // Layouts stored under `key`, if the entry exists and its headers match
+    bool Lookup(const std::string& key, std::vector<StructLayout>& layouts);
+
+    // Store layouts produced from a parse that read `included_files`
+    void Store(
+        const std::string& key,
+        const std::vector<StructLayout>& layouts,
+        const std::vector<std::string>& included_files
+    );
+
+    // Process-wide cache; disabled until the addon or CLI sets a directory
+    static LayoutCache& Global();
+
+private:
+    using Digest = std::array<uint8_t, 20>;
+
+    // A header as it was when an entry was written
+    struct FileStamp {
+        std::string path;
+        int64_t mtime = 0;  // Nanoseconds since the epoch
+        uint64_t size = 0;
+        Digest hash{};
+    };
+
+    mutable std::mutex mutex_;
+    std::string directory_;
+
+    // Hashes of headers already read by this process, so a project scan
+    // hashes each shared header once rather than once per TU
+    std::map<std::string, FileStamp> stamps_;
+
+    std::string GetDirectory() const;
+    std::string EntryPath(const std::string& directory, const std::string& key) const;
+
+    // Current stamp of a file; false if it can't be read
+    bool StampFile(const std::string& path, FileStamp& stamp);
+
+    // Whether a recorded header is still the same file
+    bool IsUnchanged(const FileStamp& recorded);
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_LAYOUT_CACHE_H
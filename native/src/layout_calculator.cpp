@@ -1,11 +1,313 @@
 #include "layout_calculator.h"
+#include "reorder_solver.h"
+#include <clang/AST/Attr.h>
+#include <clang/AST/DeclCXX.h>
+#include <clang/AST/DeclTemplate.h>
+#include <clang/AST/RecordLayout.h>
+#include <clang/Basic/SourceManager.h>
+#include <llvm/Support/MathExtras.h>
 #include <algorithm>
+#include <cstdio>
 #include <map>
+#include <numeric>
 
 namespace structsight {
 
-LayoutCalculator::LayoutCalculator(Compiler compiler, Architecture arch)
-    : compiler_(compiler), arch_(arch) {}
+namespace {
+
+// Members touched on fewer than this share of accesses count as cold
+const double kColdAccessRatio = 0.02;
+
+// Smaller gains aren't worth an extra allocation and indirection
+const double kMinLineImprovement = 0.1;
+
+// A struct of arrays must cut the bytes fetched per iteration by this
+// factor to be worth rewriting the loops
+const double kMinSoaGain = 2;
+
+// Page sizes the array stride is checked against: 4 KiB and 2 MiB
+const uint64_t kPageSize = 4096;
+const uint64_t kHugePageSize = 2 * 1024 * 1024;
+
+// Elements smaller than this share of a cache line are usually scanned
+// in order, where straddling costs nothing; larger ones are looked up
+const double kMinStrideLineShare = 0.5;
+
+// Enums needing more bits than this are left as they are
+const uint32_t kMaxFlagBits = 8;
+
+// Value bounds for integer members: [[clang::annotate("structsight::max=<n>")]],
+// optionally with "structsight::min=<n>" (default 0)
+const llvm::StringLiteral kMaxAnnotation = "structsight::max=";
+const llvm::StringLiteral kMinAnnotation = "structsight::min=";
+
+// A byte range and the chance that an access to the object touches it
+struct TouchedSpan {
+    uint64_t offset;
+    uint64_t size;
+    double chance;
+};
+
+// Direct non-virtual bases of `record`, as the layout's bases list holds
+// them: where each sits and the bytes it holds data in
+std::vector<BaseInfo> NonVirtualBases(const clang::ASTContext& context, const clang::RecordDecl* record) {
+    std::vector<BaseInfo> bases;
+    const auto* cxx_record = llvm::dyn_cast<clang::CXXRecordDecl>(record);
+    if (!cxx_record) {
+        return bases;
+    }
+    const clang::ASTRecordLayout& ast_layout = context.getASTRecordLayout(record);
+    for (const auto& base : cxx_record->bases()) {
+        const auto* base_decl = base.getType()->getAsCXXRecordDecl();
+        if (base.isVirtual() || !base_decl || !base_decl->hasDefinition()) {
+            continue;
+        }
+        const clang::ASTRecordLayout& base_layout = context.getASTRecordLayout(base_decl);
+        BaseInfo info;
+        info.name = base.getType().getAsString();
+        info.offset = ast_layout.getBaseClassOffset(base_decl).getQuantity();
+        info.size = base_decl->isEmpty()
+            ? 0
+            : std::min(base_layout.getDataSize(), base_layout.getNonVirtualSize()).getQuantity();
+        info.alignment = base_layout.getNonVirtualAlignment().getQuantity();
+        info.is_empty = base_decl->isEmpty();
+        info.is_primary = ast_layout.getPrimaryBase() == base_decl && !ast_layout.isPrimaryBaseVirtual();
+        bases.push_back(info);
+    }
+    return bases;
+}
+
+// Expected cache lines touched per access. A line is touched when any of
+// its members is; members on one line are assumed to be accessed together,
+// so the line's chance is that of its hottest member.
+double ExpectedLinesTouched(const std::vector<TouchedSpan>& spans, uint64_t line_size) {
+    std::map<uint64_t, double> lines;
+    for (const auto& span : spans) {
+        if (span.size == 0) {
+            continue;
+        }
+        for (uint64_t line = span.offset / line_size;
+             line <= (span.offset + span.size - 1) / line_size; line++) {
+            lines[line] = std::max(lines[line], span.chance);
+        }
+    }
+    
+    double total = 0;
+    for (const auto& line : lines) {
+        total += line.second;
+    }
+    return total;
+}
+
+// Place items in `order` from `start`; fills offsets (by item index) and
+// returns the end of the last item
+uint64_t PlaceItems(
+    const std::vector<ReorderItem>& items,
+    const std::vector<size_t>& order,
+    uint64_t start,
+    std::vector<uint64_t>& offsets
+) {
+    offsets.assign(items.size(), 0);
+    uint64_t offset = start;
+    for (size_t index : order) {
+        uint64_t alignment = std::max<uint64_t>(items[index].alignment, 1);
+        offset = (offset + alignment - 1) / alignment * alignment;
+        offsets[index] = offset;
+        offset += items[index].size;
+    }
+    return offset;
+}
+
+// A bitfield as the storage unit rules see it
+struct BitfieldSpec {
+    uint64_t width;     // Bits; 0 for a zero-length bitfield
+    uint64_t unit_size; // Size of the declared type
+    uint64_t alignment; // Alignment of the declared type
+};
+
+uint64_t RoundUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Bytes a run of adjacent bitfields spans when it starts at an offset
+// aligned for all of its types. Itanium packs the bits back to back and
+// only moves a field to its type's next boundary when it would straddle
+// one; Microsoft allocates whole units of the declared type and opens a
+// new one whenever the type's size changes or the field doesn't fit.
+uint64_t BitfieldRunSize(const std::vector<BitfieldSpec>& fields, bool microsoft) {
+    if (!microsoft) {
+        uint64_t bit = 0;
+        for (const auto& field : fields) {
+            uint64_t unit_bits = field.unit_size * 8;
+            uint64_t align_bits = field.alignment * 8;
+            if (field.width == 0 || (bit % align_bits) + field.width > unit_bits) {
+                bit = RoundUp(bit, align_bits);
+            }
+            bit += field.width;
+        }
+        return (bit + 7) / 8;
+    }
+    
+    uint64_t end = 0;
+    uint64_t unit_size = 0; // Of the open unit; 0 if none is open
+    uint64_t free_bits = 0;
+    for (const auto& field : fields) {
+        if (field.width == 0) {
+            unit_size = 0;
+            continue;
+        }
+        if (field.unit_size != unit_size || field.width > free_bits) {
+            end = RoundUp(end, field.alignment) + field.unit_size;
+            unit_size = field.unit_size;
+            free_bits = field.unit_size * 8;
+        }
+        free_bits -= std::min(field.width, free_bits);
+    }
+    return end;
+}
+
+// Bits a member of this type needs as a bitfield: 1 for bool, enough for
+// every enumerator of an enum (plus a sign bit if the underlying type is
+// signed). 0 for other types and for enums wider than kMaxFlagBits.
+// An enum with a fixed underlying type may hold values beyond its
+// enumerators; those wouldn't survive the narrower field.
+uint32_t FlagWidth(clang::QualType type) {
+    if (type.isVolatileQualified()) {
+        return 0;
+    }
+    if (type->isBooleanType()) {
+        return 1;
+    }
+    const auto* enum_type = type->getAs<clang::EnumType>();
+    const clang::EnumDecl* decl = enum_type ? enum_type->getDecl()->getDefinition() : nullptr;
+    if (!decl) {
+        return 0;
+    }
+    
+    uint32_t width = decl->getNumPositiveBits();
+    if (decl->getNumNegativeBits() > 0) {
+        width = std::max(width + 1, decl->getNumNegativeBits());
+    } else if (decl->getIntegerType()->isSignedIntegerType()) {
+        width++;
+    }
+    width = std::max(width, 1u);
+    return width <= kMaxFlagBits ? width : 0;
+}
+
+// A smaller integer type a member's values fit in
+struct NarrowType {
+    uint32_t bits = 0; // 8, 16 or 32; 0 if the member can't be narrowed
+    bool is_signed = false;
+};
+
+// Bits an integer type needs for every value in [min, max]
+uint32_t BitsForRange(int64_t min, uint64_t max, bool is_signed) {
+    uint32_t bits = max == 0 ? 0 : llvm::Log2_64(max) + 1;
+    if (!is_signed) {
+        return std::max(bits, 1u);
+    }
+    uint64_t magnitude = min < 0 ? ~static_cast<uint64_t>(min) : 0; // -min - 1
+    uint32_t negative_bits = magnitude == 0 ? 0 : llvm::Log2_64(magnitude) + 1;
+    return std::max(bits, negative_bits) + 1;
+}
+
+// The annotated bounds of an integer member; false if it has no max
+bool AnnotatedBounds(const clang::FieldDecl* field, int64_t& min, uint64_t& max) {
+    bool has_max = false;
+    min = 0;
+    for (const auto* annotation : field->specific_attrs<clang::AnnotateAttr>()) {
+        llvm::StringRef text = annotation->getAnnotation();
+        if (text.consume_front(kMaxAnnotation)) {
+            has_max = !text.trim().getAsInteger(10, max);
+        } else if (text.consume_front(kMinAnnotation) && text.trim().getAsInteger(10, min)) {
+            return false;
+        }
+    }
+    return has_max && (min <= 0 || static_cast<uint64_t>(min) <= max);
+}
+
+// The smallest 8, 16 or 32-bit integer type that holds every enumerator
+// of an enum member, or every value an annotated integer member takes,
+// if that is smaller than the member's type
+NarrowType NarrowTypeFor(
+    const clang::FieldDecl* field,
+    const MemberInfo& member,
+    const clang::ASTContext& context
+) {
+    NarrowType result;
+    clang::QualType type = field->getType();
+    if (member.is_bitfield || type.isVolatileQualified() || type->isBooleanType()) {
+        return result;
+    }
+    
+    uint32_t bits = 0;
+    if (const auto* enum_type = type->getAs<clang::EnumType>()) {
+        // The enum's declaration changes, so it must be the project's own
+        const clang::EnumDecl* decl = enum_type->getDecl()->getDefinition();
+        if (!decl || context.getSourceManager().isInSystemHeader(decl->getLocation())) {
+            return result;
+        }
+        result.is_signed = decl->getNumNegativeBits() > 0;
+        bits = result.is_signed
+            ? std::max(decl->getNumPositiveBits() + 1, decl->getNumNegativeBits())
+            : std::max(decl->getNumPositiveBits(), 1u);
+    } else if (type->isIntegerType()) {
+        int64_t min;
+        uint64_t max;
+        if (!AnnotatedBounds(field, min, max)) {
+            return result;
+        }
+        // Signed members stay signed so their arithmetic doesn't change
+        result.is_signed = type->isSignedIntegerType() || min < 0;
+        if (min < 0 && !type->isSignedIntegerType()) {
+            return result;
+        }
+        bits = BitsForRange(min, max, result.is_signed);
+    } else {
+        return result;
+    }
+    
+    for (uint32_t candidate : {8u, 16u, 32u}) {
+        if (bits <= candidate && candidate / 8 < member.size) {
+            result.bits = candidate;
+            return result;
+        }
+    }
+    return result;
+}
+
+// Fraction of array elements of `size` bytes, back to back from a
+// `boundary`-aligned start, that cross a boundary. Elements start at
+// every multiple of gcd(size, boundary) within a boundary equally often,
+// and one starting at r crosses iff r + size > boundary.
+double StraddleFraction(uint64_t size, uint64_t boundary) {
+    if (size > boundary) {
+        return 1;
+    }
+    return static_cast<double>(size - std::gcd(size, boundary)) / boundary;
+}
+
+// Average number of `line`-sized blocks such an element touches
+double LinesPerElement(uint64_t size, uint64_t line) {
+    return static_cast<double>(size - std::gcd(size, line)) / line + 1;
+}
+
+// Whether some elements touch more lines than their size makes them: more
+// than ceil(size / line) on average (LinesPerElement, kept in integers)
+bool TouchesExtraLines(uint64_t size, uint64_t line) {
+    uint64_t fewest = (size + line - 1) / line;
+    return size - std::gcd(size, line) > (fewest - 1) * line;
+}
+
+std::string IntTypeName(const NarrowType& narrow, bool cplusplus) {
+    return std::string(cplusplus ? "std::" : "") + (narrow.is_signed ? "int" : "uint") +
+           std::to_string(narrow.bits) + "_t";
+}
+
+} // namespace
+
+LayoutCalculator::LayoutCalculator(Compiler compiler, Architecture arch, uint64_t cache_line_size)
+    : compiler_(compiler), arch_(arch), cache_line_size_(cache_line_size) {}
 
 uint64_t LayoutCalculator::GetPointerSize() const {
     return (arch_ == Architecture::X86) ? 4 : 8;
@@ -18,162 +320,1336 @@ void LayoutCalculator::CalculatePadding(
 ) {
     layout.padding.clear();
     
-    if (layout.members.empty()) {
+    // Everything that holds bytes: members, base subobjects and vptrs.
+    // Spans may overlap (a member in a base's reusable tail padding, the
+    // vptr a primary base shares), so gaps are found in their union.
+    struct Span {
+        uint64_t offset;
+        uint64_t size;
+        std::string reason; // Why the bytes before it are padding
+    };
+    std::vector<Span> spans;
+    for (const auto& member : layout.members) {
+        if (member.size > 0) {
+            spans.push_back({member.offset, member.size, "Alignment of next member (" + member.name + ")"});
+        }
+    }
+    for (const auto& base : layout.bases) {
+        if (base.size > 0) {
+            spans.push_back({base.offset, base.size, "Alignment of base (" + base.name + ")"});
+        }
+    }
+    uint64_t pointer_size = GetPointerSize();
+    for (const auto& vptr : layout.vtable.vptrs) {
+        spans.push_back({vptr.offset, pointer_size, "Alignment of vptr"});
+    }
+    if (layout.vtable.vbptr_offset >= 0) {
+        spans.push_back({static_cast<uint64_t>(layout.vtable.vbptr_offset), pointer_size, "Alignment of vbptr"});
+    }
+    if (spans.empty()) {
         return;
     }
     
-    // Find padding between members
-    for (size_t i = 0; i < layout.members.size() - 1; i++) {
-        const auto& current = layout.members[i];
-        const auto& next = layout.members[i + 1];
-        
-        uint64_t current_end = current.offset + current.size;
-        if (next.offset > current_end) {
+    std::stable_sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) {
+        return a.offset < b.offset;
+    });
+    
+    uint64_t end = spans.front().offset;
+    for (const auto& span : spans) {
+        if (span.offset > end) {
             PaddingInfo padding;
-            padding.offset = current_end;
-            padding.size = next.offset - current_end;
-            padding.reason = "Alignment of next member (" + next.name + ")";
+            padding.offset = end;
+            padding.size = span.offset - end;
+            padding.reason = span.reason;
             layout.padding.push_back(padding);
         }
+        end = std::max(end, span.offset + span.size);
     }
     
     // Check for tail padding
-    if (!layout.members.empty()) {
-        const auto& last = layout.members.back();
-        uint64_t last_end = last.offset + last.size;
+    if (layout.total_size > end) {
+        bool reusable = TailPaddingReusable(layout, record);
         
-        if (layout.total_size > last_end) {
-            PaddingInfo padding;
-            padding.offset = last_end;
-            padding.size = layout.total_size - last_end;
-            padding.reason = "Tail padding for struct alignment";
-            layout.padding.push_back(padding);
+        PaddingInfo padding;
+        padding.offset = end;
+        padding.size = layout.total_size - end;
+        padding.reason = reusable
+            ? "Tail padding (derived classes can place members here)"
+            : "Tail padding for struct alignment";
+        layout.padding.push_back(padding);
+    }
+}
+
+std::vector<LayoutCalculator::PlacementUnit> LayoutCalculator::BuildPlacementUnits(
+    const StructLayout& layout,
+    const clang::ASTContext& context,
+    const clang::RecordDecl* record
+) const {
+    std::vector<PlacementUnit> units;
+    std::vector<const clang::FieldDecl*> fields(record->field_begin(), record->field_end());
+    
+    for (size_t i = 0; i < layout.members.size(); i++) {
+        const auto& member = layout.members[i];
+        
+        if (!member.is_bitfield || i >= fields.size()) {
+            units.push_back({i, 1, member.size, std::max<uint64_t>(member.alignment, 1)});
+            continue;
+        }
+        
+        // A run of bitfields shares storage, so it moves as one piece.
+        // Its size is what the storage unit rules give it at an aligned
+        // start; a real position can only do as well or better.
+        std::vector<BitfieldSpec> run;
+        uint64_t alignment = 1;
+        size_t j = i;
+        for (; j < layout.members.size() && j < fields.size() && layout.members[j].is_bitfield; j++) {
+            const auto& field = layout.members[j];
+            uint64_t field_alignment = std::max<uint64_t>(field.alignment, 1);
+            uint64_t unit_size = context.getTypeSizeInChars(fields[j]->getType()).getQuantity();
+            run.push_back({field.bitfield_width, std::max<uint64_t>(unit_size, 1), field_alignment});
+            alignment = std::max(alignment, field_alignment);
         }
+        
+        uint64_t size = BitfieldRunSize(run, compiler_ == Compiler::MSVC);
+        units.push_back({i, j - i, size, alignment});
+        i = j - 1;
     }
+    
+    return units;
+}
+
+uint64_t LayoutCalculator::GetFieldStartOffset(
+    const StructLayout& layout,
+    const clang::ASTContext& context,
+    const clang::RecordDecl* record
+) const {
+    const auto* cxx_record = llvm::dyn_cast<clang::CXXRecordDecl>(record);
+    if (!cxx_record) {
+        return 0;
+    }
+    
+    const clang::ASTRecordLayout& ast_layout = context.getASTRecordLayout(record);
+    uint64_t start = 0;
+    
+    // Own vptr (a primary base supplies it otherwise)
+    if (ast_layout.hasOwnVFPtr()) {
+        start = GetPointerSize();
+    }
+    
+    // Members may reuse the tail padding of non-POD bases, which the
+    // base's data size leaves out; empty bases take no room
+    for (const auto& base : layout.bases) {
+        if (!base.is_virtual) {
+            start = std::max(start, base.offset + base.size);
+        }
+    }
+    
+    // Never start past where the compiler actually put the first member
+    if (!layout.members.empty()) {
+        start = std::min(start, layout.members.front().offset);
+    }
+    
+    return start;
 }
 
-std::vector<std::string> LayoutCalculator::CalculateOptimalOrder(const StructLayout& layout) {
-    // Create a copy of members with their info
-    std::vector<std::pair<std::string, const MemberInfo*>> members;
+bool LayoutCalculator::TailPaddingReusable(const StructLayout& layout, const clang::RecordDecl* record) const {
+    // The Microsoft ABI never lays out a derived class's members in a base
+    const auto* cxx_record = llvm::dyn_cast<clang::CXXRecordDecl>(record);
+    return compiler_ != Compiler::MSVC && cxx_record && !cxx_record->hasAttr<clang::FinalAttr>() &&
+           layout.data_size < layout.total_size;
+}
+
+bool LayoutCalculator::CanReorder(const StructLayout& layout, const clang::RecordDecl* record) const {
+    // Packed layouts and virtual bases are placed by rules the placement
+    // model doesn't follow
+    if (record->hasAttr<clang::PackedAttr>() || record->hasAttr<clang::MaxFieldAlignmentAttr>()) {
+        return false;
+    }
+    if (const auto* cxx_record = llvm::dyn_cast<clang::CXXRecordDecl>(record)) {
+        if (cxx_record->getNumVBases() > 0) {
+            return false;
+        }
+    }
     for (const auto& member : layout.members) {
-        members.push_back({member.name, &member});
+        if (!member.is_bitfield && member.alignment > 0 && member.offset % member.alignment != 0) {
+            return false;
+        }
+        // The next member may sit in its tail padding
+        if (member.is_no_unique_address && member.size > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LayoutCalculator::SuggestReordering(
+    StructLayout& layout,
+    const clang::ASTContext& context,
+    const clang::RecordDecl* record
+) {
+    if (!CanReorder(layout, record)) {
+        return;
+    }
+    
+    std::vector<PlacementUnit> units = BuildPlacementUnits(layout, context, record);
+    if (units.size() < 2) {
+        return;
+    }
+    
+    std::vector<ReorderItem> items;
+    items.reserve(units.size());
+    for (const auto& unit : units) {
+        items.push_back({unit.size, unit.alignment});
+    }
+    
+    uint64_t start_offset = GetFieldStartOffset(layout, context, record);
+    ReorderSolution solution = ReorderSolver::Solve(items, start_offset, layout.alignment);
+    
+    // Derived classes can put their members in the tail padding of a
+    // non-POD record, so a smaller data size helps them even when sizeof
+    // stays the same. Descending alignment from an aligned start leaves no
+    // gaps, which gives the smallest data size.
+    bool tail_reusable = TailPaddingReusable(layout, record);
+    std::vector<uint64_t> offsets;
+    uint64_t data_size = PlaceItems(items, solution.order, start_offset, offsets);
+    if (tail_reusable) {
+        std::vector<size_t> by_alignment(items.size());
+        for (size_t i = 0; i < by_alignment.size(); i++) {
+            by_alignment[i] = i;
+        }
+        std::stable_sort(by_alignment.begin(), by_alignment.end(), [&items](size_t a, size_t b) {
+            return items[a].alignment > items[b].alignment;
+        });
+        
+        uint64_t size = ReorderSolver::SizeWithOrder(items, by_alignment, start_offset, layout.alignment);
+        uint64_t dense = PlaceItems(items, by_alignment, start_offset, offsets);
+        if (size <= solution.size && dense < data_size) {
+            solution.order = by_alignment;
+            solution.size = size;
+            solution.moves = ReorderSolver::CountMoves(by_alignment);
+            data_size = dense;
+        }
+    }
+    
+    bool smaller = solution.size < layout.total_size;
+    bool denser = tail_reusable && solution.size == layout.total_size && data_size < layout.data_size;
+    if ((!smaller && !denser) || solution.moves == 0) {
+        return;
+    }
+    
+    StructLayout::Optimization opt;
+    opt.kind = OptimizationKind::Reorder;
+    opt.bytes_saved = layout.total_size - solution.size;
+    
+    // Expand units back to members; a moved bitfield run counts per field
+    std::vector<size_t> member_order;
+    for (size_t index : solution.order) {
+        const PlacementUnit& unit = units[index];
+        for (size_t m = 0; m < unit.member_count; m++) {
+            member_order.push_back(unit.first_member + m);
+            opt.suggested_order.push_back(layout.members[unit.first_member + m].name);
+        }
+    }
+    opt.members_moved = ReorderSolver::CountMoves(member_order);
+    
+    if (smaller) {
+        opt.description = "Reorder members to reduce padding (" +
+            std::to_string(opt.members_moved) + " of " +
+            std::to_string(layout.members.size()) + " members move)";
+    } else {
+        opt.description = "Reorder members to shrink the data size from " +
+            std::to_string(layout.data_size) + " to " + std::to_string(data_size) +
+            " bytes, leaving more tail padding for derived classes' members (" +
+            std::to_string(opt.members_moved) + " of " +
+            std::to_string(layout.members.size()) + " members move)";
+    }
+    
+    layout.optimizations.push_back(opt);
+}
+
+void LayoutCalculator::SuggestFlagPacking(
+    StructLayout& layout,
+    const clang::ASTContext& context,
+    const clang::RecordDecl* record
+) {
+    if (record->isUnion() || !CanReorder(layout, record)) {
+        return;
+    }
+    
+    std::vector<const clang::FieldDecl*> fields(record->field_begin(), record->field_end());
+    if (fields.size() != layout.members.size()) {
+        return;
+    }
+    
+    // Bitfields can't have default member initializers before C++20, and
+    // C only promises bitfields of int, unsigned and bool
+    const clang::LangOptions& lang = context.getLangOpts();
+    std::vector<uint32_t> widths(fields.size(), 0);
+    std::vector<size_t> flags;
+    for (size_t i = 0; i < fields.size(); i++) {
+        const MemberInfo& member = layout.members[i];
+        if (member.is_bitfield || member.is_thread_shared || member.is_no_unique_address ||
+            (fields[i]->hasInClassInitializer() && !lang.CPlusPlus20)) {
+            continue;
+        }
+        clang::QualType type = fields[i]->getType();
+        if (!lang.CPlusPlus && !type->isBooleanType()) {
+            continue;
+        }
+        widths[i] = FlagWidth(type);
+        if (widths[i] > 0) {
+            flags.push_back(i);
+        }
+    }
+    if (flags.size() < 2) {
+        return;
+    }
+    
+    std::vector<PlacementUnit> units = BuildPlacementUnits(layout, context, record);
+    uint64_t start_offset = GetFieldStartOffset(layout, context, record);
+    
+    // Only the bytes packing saves beyond what reordering alone gets
+    std::vector<ReorderItem> items;
+    for (const auto& unit : units) {
+        items.push_back({unit.size, unit.alignment});
     }
+    uint64_t reordered_size = std::min(
+        ReorderSolver::Solve(items, start_offset, layout.alignment).size, layout.total_size);
     
-    // Sort by alignment (descending), then by size (descending)
-    // This typically minimizes padding
-    std::sort(members.begin(), members.end(),
-        [](const auto& a, const auto& b) {
-            if (a.second->alignment != b.second->alignment) {
-                return a.second->alignment > b.second->alignment;
+    // The flags go after the last existing bitfield run, whose spare bits
+    // they can use, or into a run of their own. Wider types first so
+    // Microsoft's units group by type size, declaration order otherwise.
+    std::stable_sort(flags.begin(), flags.end(), [&](size_t a, size_t b) {
+        return layout.members[a].size > layout.members[b].size;
+    });
+    size_t host = units.size();
+    for (size_t i = 0; i < units.size(); i++) {
+        if (layout.members[units[i].first_member].is_bitfield) {
+            host = i;
+        }
+    }
+    std::vector<size_t> run_members;
+    if (host < units.size()) {
+        for (size_t m = 0; m < units[host].member_count; m++) {
+            run_members.push_back(units[host].first_member + m);
+        }
+    }
+    run_members.insert(run_members.end(), flags.begin(), flags.end());
+    
+    std::vector<BitfieldSpec> run;
+    uint64_t run_alignment = 1;
+    for (size_t index : run_members) {
+        const MemberInfo& member = layout.members[index];
+        uint64_t alignment = std::max<uint64_t>(member.alignment, 1);
+        uint64_t unit_size = context.getTypeSizeInChars(fields[index]->getType()).getQuantity();
+        uint64_t width = member.is_bitfield ? member.bitfield_width : widths[index];
+        run.push_back({width, std::max<uint64_t>(unit_size, 1), alignment});
+        run_alignment = std::max(run_alignment, alignment);
+    }
+    
+    // Every other unit as it is, then the run
+    std::vector<ReorderItem> packed_items;
+    std::vector<std::vector<size_t>> item_members;
+    for (size_t i = 0; i < units.size(); i++) {
+        const PlacementUnit& unit = units[i];
+        if (i == host || (unit.member_count == 1 && widths[unit.first_member] > 0)) {
+            continue;
+        }
+        packed_items.push_back({unit.size, unit.alignment});
+        item_members.emplace_back();
+        for (size_t m = 0; m < unit.member_count; m++) {
+            item_members.back().push_back(unit.first_member + m);
+        }
+    }
+    packed_items.push_back({BitfieldRunSize(run, compiler_ == Compiler::MSVC), run_alignment});
+    item_members.push_back(run_members);
+    
+    ReorderSolution solution = ReorderSolver::Solve(packed_items, start_offset, layout.alignment);
+    if (solution.size >= reordered_size) {
+        return;
+    }
+    
+    StructLayout::Optimization opt;
+    opt.kind = OptimizationKind::PackFlags;
+    opt.bytes_saved = layout.total_size - solution.size;
+    
+    std::vector<size_t> member_order;
+    for (size_t index : solution.order) {
+        for (size_t member : item_members[index]) {
+            member_order.push_back(member);
+            opt.suggested_order.push_back(layout.members[member].name);
+        }
+    }
+    opt.members_moved = ReorderSolver::CountMoves(member_order);
+    for (size_t index : flags) {
+        opt.bitfield_members.push_back(layout.members[index].name);
+        opt.bitfield_widths.push_back(widths[index]);
+    }
+    
+    opt.description = "Pack " + std::to_string(flags.size()) +
+        " bool and enum members into bitfields to shrink the struct from " +
+        std::to_string(layout.total_size) + " to " + std::to_string(solution.size) + " bytes (" +
+        std::to_string(reordered_size - solution.size) +
+        " more than reordering); their addresses can no longer be taken";
+    
+    layout.optimizations.push_back(opt);
+}
+
+void LayoutCalculator::SuggestNarrowing(
+    StructLayout& layout,
+    const clang::ASTContext& context,
+    const clang::RecordDecl* record
+) {
+    if (record->isUnion() || !CanReorder(layout, record)) {
+        return;
+    }
+    
+    std::vector<const clang::FieldDecl*> fields(record->field_begin(), record->field_end());
+    if (fields.size() != layout.members.size()) {
+        return;
+    }
+    
+    std::vector<NarrowType> narrow(fields.size());
+    std::vector<size_t> candidates;
+    for (size_t i = 0; i < fields.size(); i++) {
+        narrow[i] = NarrowTypeFor(fields[i], layout.members[i], context);
+        if (narrow[i].bits > 0) {
+            candidates.push_back(i);
+        }
+    }
+    if (candidates.empty()) {
+        return;
+    }
+    
+    std::vector<PlacementUnit> units = BuildPlacementUnits(layout, context, record);
+    uint64_t start_offset = GetFieldStartOffset(layout, context, record);
+    
+    // Narrowing the most aligned member can lower the struct's alignment,
+    // unless bases, a vptr or alignas set it
+    bool fixed_alignment = start_offset > 0 || record->hasAttr<clang::AlignedAttr>();
+    
+    // The smallest order with the given members narrowed
+    auto solve = [&](const std::vector<bool>& narrowed) {
+        std::vector<ReorderItem> items;
+        uint64_t alignment = 1;
+        for (const auto& unit : units) {
+            ReorderItem item{unit.size, unit.alignment};
+            if (unit.member_count == 1 && narrowed[unit.first_member]) {
+                const NarrowType& type = narrow[unit.first_member];
+                clang::QualType int_type = context.getIntTypeForBitwidth(type.bits, type.is_signed);
+                item.size = context.getTypeSizeInChars(int_type).getQuantity();
+                item.alignment = context.getTypeAlignInChars(int_type).getQuantity();
             }
-            return a.second->size > b.second->size;
+            alignment = std::max(alignment, item.alignment);
+            items.push_back(item);
         }
-    );
+        return ReorderSolver::Solve(items, start_offset, fixed_alignment ? layout.alignment : alignment);
+    };
     
-    std::vector<std::string> order;
-    for (const auto& m : members) {
-        order.push_back(m.first);
+    std::vector<bool> chosen(fields.size(), false);
+    uint64_t reordered_size = std::min(solve(chosen).size, layout.total_size);
+    for (size_t index : candidates) {
+        chosen[index] = true;
+    }
+    uint64_t narrowed_size = solve(chosen).size;
+    if (narrowed_size >= reordered_size) {
+        return;
     }
     
-    return order;
+    // Keep only the type changes the saving depends on, trying to drop the
+    // ones that save least on their own first
+    std::vector<std::pair<uint64_t, size_t>> alone;
+    for (size_t index : candidates) {
+        std::vector<bool> single(fields.size(), false);
+        single[index] = true;
+        alone.push_back({solve(single).size, index});
+    }
+    std::stable_sort(alone.begin(), alone.end(), [](const auto& a, const auto& b) {
+        return a.first > b.first;
+    });
+    for (const auto& entry : alone) {
+        chosen[entry.second] = false;
+        if (solve(chosen).size > narrowed_size) {
+            chosen[entry.second] = true;
+        }
+    }
+    ReorderSolution solution = solve(chosen);
+    
+    StructLayout::Optimization opt;
+    opt.kind = OptimizationKind::NarrowTypes;
+    opt.bytes_saved = layout.total_size - solution.size;
+    
+    std::vector<size_t> member_order;
+    for (size_t index : solution.order) {
+        const PlacementUnit& unit = units[index];
+        for (size_t m = 0; m < unit.member_count; m++) {
+            member_order.push_back(unit.first_member + m);
+            opt.suggested_order.push_back(layout.members[unit.first_member + m].name);
+        }
+    }
+    opt.members_moved = ReorderSolver::CountMoves(member_order);
+    
+    std::string changes;
+    for (size_t index : candidates) {
+        if (!chosen[index]) {
+            continue;
+        }
+        opt.narrowed_members.push_back(layout.members[index].name);
+        opt.narrowed_types.push_back(IntTypeName(narrow[index], context.getLangOpts().CPlusPlus));
+        if (!changes.empty()) {
+            changes += ", ";
+        }
+        changes += layout.members[index].name + " to " + opt.narrowed_types.back();
+        if (fields[index]->getType()->isEnumeralType()) {
+            changes += " (the enum's underlying type)";
+        }
+    }
+    
+    opt.description = "Narrow " + changes + " to shrink the struct from " +
+        std::to_string(layout.total_size) + " to " + std::to_string(solution.size) + " bytes (" +
+        std::to_string(reordered_size - solution.size) + " more than reordering)";
+    uint64_t lines_before = (layout.total_size + cache_line_size_ - 1) / cache_line_size_;
+    uint64_t lines_after = (solution.size + cache_line_size_ - 1) / cache_line_size_;
+    if (lines_after < lines_before) {
+        opt.description += "; it then spans " + std::to_string(lines_after) + " cache line" +
+            (lines_after == 1 ? "" : "s") + " instead of " + std::to_string(lines_before);
+    }
+    
+    layout.optimizations.push_back(opt);
 }
 
-uint64_t LayoutCalculator::CalculateSizeWithOrder(
-    const StructLayout& layout,
-    const std::vector<std::string>& order
+void LayoutCalculator::SuggestNestedReordering(
+    StructLayout& layout,
+    const clang::ASTContext& context,
+    const clang::RecordDecl* record
 ) {
-    // Create a map for quick lookup
-    std::map<std::string, const MemberInfo*> member_map;
-    for (const auto& member : layout.members) {
-        member_map[member.name] = &member;
+    if (record->isUnion() || !CanReorder(layout, record)) {
+        return;
     }
     
-    uint64_t current_offset = 0;
-    uint64_t max_alignment = 1;
+    std::vector<const clang::FieldDecl*> fields(record->field_begin(), record->field_end());
+    if (fields.size() != layout.members.size()) {
+        return;
+    }
     
-    // Account for vtable pointer if polymorphic
-    if (layout.is_polymorphic) {
-        uint64_t ptr_size = GetPointerSize();
-        current_offset = ptr_size;
-        max_alignment = ptr_size;
+    std::vector<PlacementUnit> units = BuildPlacementUnits(layout, context, record);
+    uint64_t start_offset = GetFieldStartOffset(layout, context, record);
+    std::vector<ReorderItem> items;
+    for (const auto& unit : units) {
+        items.push_back({unit.size, unit.alignment});
     }
+    uint64_t reordered_size = std::min(
+        ReorderSolver::Solve(items, start_offset, layout.alignment).size, layout.total_size);
     
-    // Calculate new layout
-    for (const auto& name : order) {
-        auto it = member_map.find(name);
-        if (it == member_map.end()) {
+    const clang::SourceManager& sources = context.getSourceManager();
+    for (size_t u = 0; u < units.size(); u++) {
+        size_t index = units[u].first_member;
+        const MemberInfo& member = layout.members[index];
+        if (units[u].member_count != 1 || member.children.size() < 2) {
             continue;
         }
         
-        const MemberInfo* member = it->second;
+        // Only records the project declares itself, and not template
+        // instantiations, whose order every other instantiation shares
+        clang::QualType element_type = context.getBaseElementType(fields[index]->getType());
+        const auto* nested = element_type->getAsRecordDecl();
+        nested = nested ? nested->getDefinition() : nullptr;
+        const auto* cxx_nested = llvm::dyn_cast_or_null<clang::CXXRecordDecl>(nested);
+        if (!nested || sources.isInSystemHeader(nested->getLocation()) ||
+            (cxx_nested && (llvm::isa<clang::ClassTemplateSpecializationDecl>(cxx_nested) ||
+                            cxx_nested->getTemplateInstantiationPattern()))) {
+            continue;
+        }
+        
+        // The nested record's own best order, as if it were analyzed alone
+        const clang::ASTRecordLayout& nested_ast = context.getASTRecordLayout(nested);
+        StructLayout nested_layout;
+        nested_layout.name = nested->getNameAsString();
+        nested_layout.total_size = nested_ast.getSize().getQuantity();
+        nested_layout.alignment = nested_ast.getAlignment().getQuantity();
+        nested_layout.data_size = nested_ast.getDataSize().getQuantity();
+        nested_layout.members = member.children;
+        // Its members start after its bases and vptr, as they do in it
+        nested_layout.bases = NonVirtualBases(context, nested);
+        SuggestReordering(nested_layout, context, nested);
+        if (nested_layout.optimizations.empty() || nested_layout.optimizations[0].bytes_saved == 0) {
+            continue;
+        }
+        const StructLayout::Optimization& nested_reorder = nested_layout.optimizations[0];
+        
+        uint64_t elements = member.size / std::max<uint64_t>(nested_layout.total_size, 1);
+        uint64_t nested_size = nested_layout.total_size - nested_reorder.bytes_saved;
+        std::vector<ReorderItem> shrunk = items;
+        shrunk[u].size = nested_size * elements;
+        std::vector<size_t> current(units.size());
+        for (size_t i = 0; i < current.size(); i++) {
+            current[i] = i;
+        }
+        uint64_t in_place = ReorderSolver::SizeWithOrder(shrunk, current, start_offset, layout.alignment);
+        uint64_t best = ReorderSolver::Solve(shrunk, start_offset, layout.alignment).size;
+        if (best >= reordered_size && in_place >= layout.total_size) {
+            continue;
+        }
+        uint64_t new_size = std::min(in_place, best);
         
-        // Align current offset to member's alignment
-        uint64_t alignment = member->alignment;
-        if (alignment > 0) {
-            current_offset = (current_offset + alignment - 1) / alignment * alignment;
+        StructLayout::Optimization opt;
+        opt.kind = OptimizationKind::NestedReorder;
+        opt.bytes_saved = layout.total_size - new_size;
+        opt.suggested_order = nested_reorder.suggested_order;
+        opt.members_moved = nested_reorder.members_moved;
+        opt.nested_member = member.name;
+        opt.nested_type = nested->getQualifiedNameAsString();
+        opt.description = "Reorder the members of " + opt.nested_type + " (held in '" + member.name +
+            "') to shrink it from " + std::to_string(nested_layout.total_size) + " to " +
+            std::to_string(nested_size) + " bytes; " + layout.name + " then shrinks from " +
+            std::to_string(layout.total_size) + " to " + std::to_string(new_size) + " bytes";
+        if (in_place > best) {
+            opt.description += " once its own members are reordered too";
         }
         
-        // Place member
-        current_offset += member->size;
-        max_alignment = std::max(max_alignment, alignment);
+        layout.optimizations.push_back(opt);
+    }
+}
+
+void LayoutCalculator::SuggestHotColdSplit(
+    StructLayout& layout,
+    const clang::ASTContext& context,
+    const clang::RecordDecl* record,
+    const FieldProfile& profile
+) {
+    if (!CanReorder(layout, record)) {
+        return;
     }
     
-    // Add tail padding to align to struct alignment
-    if (max_alignment > 0) {
-        current_offset = (current_offset + max_alignment - 1) / max_alignment * max_alignment;
+    std::vector<PlacementUnit> units = BuildPlacementUnits(layout, context, record);
+    
+    // A bitfield run is touched by an access to any of its fields
+    std::vector<uint64_t> samples(units.size(), 0);
+    uint64_t visits = 0;
+    for (size_t u = 0; u < units.size(); u++) {
+        for (size_t m = 0; m < units[u].member_count; m++) {
+            samples[u] += profile.GetSamples(
+                layout.qualified_name, layout.name,
+                layout.members[units[u].first_member + m].name);
+        }
+        visits = std::max(visits, samples[u]);
+    }
+    if (visits == 0) {
+        return; // The profile doesn't cover this type
     }
     
-    return current_offset;
+    // Every access to the object is assumed to touch its hottest member, so
+    // a member's share of that count is the chance an access touches it
+    std::vector<double> chance(units.size());
+    std::vector<size_t> hot;
+    std::vector<size_t> cold;
+    double cold_chance = 0;
+    for (size_t u = 0; u < units.size(); u++) {
+        chance[u] = static_cast<double>(samples[u]) / static_cast<double>(visits);
+        if (chance[u] < kColdAccessRatio) {
+            cold.push_back(u);
+            cold_chance += chance[u];
+        } else {
+            hot.push_back(u);
+        }
+    }
+    if (cold.empty() || hot.empty()) {
+        return;
+    }
+    
+    // Before: the current offsets, with the object starting on a line
+    std::vector<TouchedSpan> before;
+    for (size_t u = 0; u < units.size(); u++) {
+        before.push_back({layout.members[units[u].first_member].offset, units[u].size, chance[u]});
+    }
+    
+    // After, hot part: hot members plus the pointer to the cold part, which
+    // is followed whenever any cold member is accessed
+    uint64_t pointer_size = GetPointerSize();
+    std::vector<ReorderItem> hot_items;
+    std::vector<double> hot_chance;
+    for (size_t u : hot) {
+        hot_items.push_back({units[u].size, units[u].alignment});
+        hot_chance.push_back(chance[u]);
+    }
+    hot_items.push_back({pointer_size, pointer_size});
+    hot_chance.push_back(std::min(1.0, cold_chance));
+    
+    uint64_t start_offset = GetFieldStartOffset(layout, context, record);
+    ReorderSolution hot_layout = ReorderSolver::Solve(
+        hot_items, start_offset, std::max<uint64_t>(layout.alignment, pointer_size));
+    
+    // If the hot part can't fit one line, the hottest members go first
+    std::vector<size_t> hot_order = hot_layout.order;
+    if (hot_layout.size > cache_line_size_) {
+        std::stable_sort(hot_order.begin(), hot_order.end(), [&hot_chance](size_t a, size_t b) {
+            return hot_chance[a] > hot_chance[b];
+        });
+    }
+    
+    std::vector<TouchedSpan> after_hot;
+    uint64_t offset = start_offset;
+    for (size_t index : hot_order) {
+        const ReorderItem& item = hot_items[index];
+        uint64_t alignment = std::max<uint64_t>(item.alignment, 1);
+        offset = (offset + alignment - 1) / alignment * alignment;
+        after_hot.push_back({offset, item.size, hot_chance[index]});
+        offset += item.size;
+    }
+    
+    // After, cold part: its own allocation, smallest order
+    std::vector<ReorderItem> cold_items;
+    for (size_t u : cold) {
+        cold_items.push_back({units[u].size, units[u].alignment});
+    }
+    ReorderSolution cold_layout = ReorderSolver::Solve(cold_items, 0, 1);
+    
+    std::vector<TouchedSpan> after_cold;
+    offset = 0;
+    for (size_t index : cold_layout.order) {
+        const ReorderItem& item = cold_items[index];
+        uint64_t alignment = std::max<uint64_t>(item.alignment, 1);
+        offset = (offset + alignment - 1) / alignment * alignment;
+        after_cold.push_back({offset, item.size, chance[cold[index]]});
+        offset += item.size;
+    }
+    
+    double lines_before = ExpectedLinesTouched(before, cache_line_size_);
+    double lines_after = ExpectedLinesTouched(after_hot, cache_line_size_) + ExpectedLinesTouched(after_cold, cache_line_size_);
+    if (lines_after + kMinLineImprovement > lines_before) {
+        return;
+    }
+    
+    StructLayout::Optimization opt;
+    opt.kind = OptimizationKind::HotColdSplit;
+    opt.bytes_saved = 0; // Trades a pointer for fewer lines touched, not size
+    opt.lines_per_access_before = lines_before;
+    opt.lines_per_access_after = lines_after;
+    
+    for (size_t index : hot_order) {
+        if (index == hot.size()) {
+            continue; // The cold pointer
+        }
+        const PlacementUnit& unit = units[hot[index]];
+        for (size_t m = 0; m < unit.member_count; m++) {
+            opt.suggested_order.push_back(layout.members[unit.first_member + m].name);
+        }
+    }
+    for (size_t index : cold_layout.order) {
+        const PlacementUnit& unit = units[cold[index]];
+        for (size_t m = 0; m < unit.member_count; m++) {
+            opt.cold_members.push_back(layout.members[unit.first_member + m].name);
+        }
+    }
+    opt.members_moved = static_cast<uint32_t>(opt.cold_members.size());
+    
+    char lines[64];
+    std::snprintf(lines, sizeof(lines), "%.2f to %.2f", lines_before, lines_after);
+    opt.description = "Move " + std::to_string(opt.cold_members.size()) +
+        " rarely accessed members out of line: cache lines touched per access " + lines;
+    
+    layout.optimizations.push_back(opt);
 }
 
-void LayoutCalculator::GenerateOptimizations(StructLayout& layout) {
-    layout.optimizations.clear();
+void LayoutCalculator::SuggestCoAccessLayout(
+    StructLayout& layout,
+    const clang::ASTContext& context,
+    const clang::RecordDecl* record,
+    const FieldAccessGraph& accesses
+) {
+    // Everything already shares one line
+    if (layout.total_size <= cache_line_size_ || !CanReorder(layout, record)) {
+        return;
+    }
     
-    // Don't optimize empty structs or single-member structs
-    if (layout.members.size() < 2) {
+    std::vector<PlacementUnit> units = BuildPlacementUnits(layout, context, record);
+    if (units.size() < 3) {
+        return;
+    }
+    
+    // Members are listed one per field, so a field index is a member index
+    std::vector<size_t> unit_of(layout.members.size());
+    std::vector<ReorderItem> items;
+    for (size_t u = 0; u < units.size(); u++) {
+        for (size_t m = 0; m < units[u].member_count; m++) {
+            unit_of[units[u].first_member + m] = u;
+        }
+        items.push_back({units[u].size, units[u].alignment});
+    }
+    
+    struct UnitSite {
+        std::vector<size_t> units;
+        double weight;
+    };
+    std::vector<UnitSite> sites;
+    double total_weight = 0;
+    for (const auto& site : accesses.sites) {
+        UnitSite unit_site{{}, site.weight};
+        for (uint32_t field : site.fields) {
+            if (field < unit_of.size()) {
+                unit_site.units.push_back(unit_of[field]);
+            }
+        }
+        unit_site.units.erase(
+            std::unique(unit_site.units.begin(), unit_site.units.end()), unit_site.units.end());
+        if (!unit_site.units.empty() && unit_site.weight > 0) {
+            total_weight += unit_site.weight;
+            sites.push_back(std::move(unit_site));
+        }
+    }
+    if (sites.empty()) {
+        return;
+    }
+    
+    // Each function access touches every line its fields are on; the
+    // object is assumed to start on a line boundary
+    const uint64_t line = cache_line_size_;
+    auto lines_per_access = [&](const std::vector<uint64_t>& offsets) {
+        double lines = 0;
+        for (const auto& site : sites) {
+            std::vector<uint64_t> touched;
+            for (size_t u : site.units) {
+                if (items[u].size == 0) {
+                    continue;
+                }
+                for (uint64_t l = offsets[u] / line; l <= (offsets[u] + items[u].size - 1) / line; l++) {
+                    touched.push_back(l);
+                }
+            }
+            std::sort(touched.begin(), touched.end());
+            lines += site.weight * static_cast<double>(
+                std::unique(touched.begin(), touched.end()) - touched.begin());
+        }
+        return lines / total_weight;
+    };
+    
+    std::vector<uint64_t> current(units.size());
+    for (size_t u = 0; u < units.size(); u++) {
+        current[u] = layout.members[units[u].first_member].offset;
+    }
+    double lines_before = lines_per_access(current);
+    
+    // Merge along the strongest co-access edges while a cluster still fits
+    // one line
+    std::map<std::pair<size_t, size_t>, double> unit_edges;
+    for (const auto& edge : accesses.edges) {
+        if (edge.first.second >= unit_of.size()) {
+            continue;
+        }
+        size_t a = unit_of[edge.first.first];
+        size_t b = unit_of[edge.first.second];
+        if (a != b) {
+            unit_edges[{std::min(a, b), std::max(a, b)}] += edge.second;
+        }
+    }
+    std::vector<std::pair<std::pair<size_t, size_t>, double>> edges(unit_edges.begin(), unit_edges.end());
+    std::stable_sort(edges.begin(), edges.end(), [](const auto& a, const auto& b) {
+        return a.second > b.second;
+    });
+    
+    auto cluster_order = [&items](const std::vector<size_t>& members, uint64_t& size) {
+        std::vector<ReorderItem> cluster_items;
+        uint64_t alignment = 1;
+        for (size_t u : members) {
+            cluster_items.push_back(items[u]);
+            alignment = std::max(alignment, items[u].alignment);
+        }
+        ReorderSolution solution = ReorderSolver::Solve(cluster_items, 0, alignment);
+        size = solution.size;
+        std::vector<size_t> order;
+        for (size_t index : solution.order) {
+            order.push_back(members[index]);
+        }
+        return order;
+    };
+    
+    std::vector<std::vector<size_t>> clusters(units.size());
+    std::vector<size_t> cluster_of(units.size());
+    for (size_t u = 0; u < units.size(); u++) {
+        clusters[u] = {u};
+        cluster_of[u] = u;
+    }
+    for (const auto& edge : edges) {
+        size_t a = cluster_of[edge.first.first];
+        size_t b = cluster_of[edge.first.second];
+        if (a == b) {
+            continue;
+        }
+        std::vector<size_t> merged = clusters[a];
+        merged.insert(merged.end(), clusters[b].begin(), clusters[b].end());
+        uint64_t merged_size = 0;
+        std::vector<size_t> order = cluster_order(merged, merged_size);
+        if (merged_size > line) {
+            continue;
+        }
+        for (size_t u : clusters[b]) {
+            cluster_of[u] = a;
+        }
+        clusters[a] = std::move(order);
+        clusters[b].clear();
+    }
+    
+    // Hottest cluster first; each line's remainder goes to the hottest
+    // cluster that still fits in it
+    struct Cluster {
+        std::vector<size_t> units;
+        double weight;
+    };
+    std::vector<Cluster> remaining;
+    for (auto& cluster : clusters) {
+        if (cluster.empty()) {
+            continue;
+        }
+        double weight = 0;
+        for (size_t u : cluster) {
+            for (size_t m = 0; m < units[u].member_count; m++) {
+                size_t field = units[u].first_member + m;
+                if (field < accesses.field_weights.size()) {
+                    weight += accesses.field_weights[field];
+                }
+            }
+        }
+        remaining.push_back({std::move(cluster), weight});
+    }
+    std::stable_sort(remaining.begin(), remaining.end(), [](const Cluster& a, const Cluster& b) {
+        return a.weight > b.weight;
+    });
+    
+    uint64_t start_offset = GetFieldStartOffset(layout, context, record);
+    std::vector<size_t> order;
+    std::vector<uint64_t> scratch;
+    uint64_t offset = start_offset;
+    while (!remaining.empty()) {
+        uint64_t line_end = (offset / line + 1) * line;
+        size_t pick = 0;
+        for (size_t c = 0; c < remaining.size(); c++) {
+            if (PlaceItems(items, remaining[c].units, offset, scratch) <= line_end) {
+                pick = c;
+                break;
+            }
+        }
+        offset = PlaceItems(items, remaining[pick].units, offset, scratch);
+        order.insert(order.end(), remaining[pick].units.begin(), remaining[pick].units.end());
+        remaining.erase(remaining.begin() + pick);
+    }
+    
+    std::vector<uint64_t> proposed;
+    PlaceItems(items, order, start_offset, proposed);
+    double lines_after = lines_per_access(proposed);
+    uint64_t new_size = ReorderSolver::SizeWithOrder(items, order, start_offset, layout.alignment);
+    
+    // Locality bought with extra lines per object isn't worth it
+    auto line_count = [line](uint64_t size) { return (size + line - 1) / line; };
+    if (lines_after + kMinLineImprovement > lines_before ||
+        line_count(new_size) > line_count(layout.total_size)) {
+        return;
+    }
+    
+    StructLayout::Optimization opt;
+    opt.kind = OptimizationKind::CoAccess;
+    opt.bytes_saved = new_size < layout.total_size ? layout.total_size - new_size : 0;
+    opt.lines_per_access_before = lines_before;
+    opt.lines_per_access_after = lines_after;
+    
+    std::vector<size_t> member_order;
+    for (size_t u : order) {
+        for (size_t m = 0; m < units[u].member_count; m++) {
+            member_order.push_back(units[u].first_member + m);
+            opt.suggested_order.push_back(layout.members[units[u].first_member + m].name);
+        }
+    }
+    opt.members_moved = ReorderSolver::CountMoves(member_order);
+    
+    char lines[64];
+    std::snprintf(lines, sizeof(lines), "%.2f to %.2f", lines_before, lines_after);
+    opt.description = "Group members used by the same functions: cache lines touched per access " +
+        std::string(lines) + " across " + std::to_string(sites.size()) + " functions";
+    
+    layout.optimizations.push_back(opt);
+}
+
+void LayoutCalculator::SuggestStructOfArrays(
+    StructLayout& layout,
+    const clang::RecordDecl* record,
+    const FieldAccessGraph& accesses
+) {
+    if (accesses.array_uses == 0 || accesses.element_loops.empty() || layout.is_polymorphic) {
         return;
     }
+    if (const auto* cxx_record = llvm::dyn_cast<clang::CXXRecordDecl>(record)) {
+        if (cxx_record->getNumBases() > 0) {
+            return; // Base subobjects don't split into arrays
+        }
+    }
+    
+    // Mostly used through array elements, by weighted access count
+    double all_weight = 0;
+    for (const auto& site : accesses.sites) {
+        all_weight += site.weight;
+    }
+    double loop_weight = 0;
+    for (const auto& loop : accesses.element_loops) {
+        loop_weight += loop.weight;
+    }
+    if (loop_weight * 2 < all_weight) {
+        return;
+    }
+    
+    // Walking an array of structs streams whole elements, unless an element
+    // spans lines the loop never touches; a struct of arrays streams only
+    // the arrays of the fields the loop reads
+    const uint64_t line = cache_line_size_;
+    std::vector<bool> read(layout.members.size(), false);
+    double aos_bytes = 0;
+    double soa_bytes = 0;
+    for (const auto& loop : accesses.element_loops) {
+        std::vector<uint64_t> lines;
+        uint64_t soa = 0;
+        for (uint32_t field : loop.fields) {
+            if (field >= layout.members.size()) {
+                continue;
+            }
+            const MemberInfo& member = layout.members[field];
+            read[field] = true;
+            soa += member.size;
+            for (uint64_t l = member.offset / line;
+                 member.size > 0 && l <= (member.offset + member.size - 1) / line; l++) {
+                lines.push_back(l);
+            }
+        }
+        std::sort(lines.begin(), lines.end());
+        uint64_t touched = std::unique(lines.begin(), lines.end()) - lines.begin();
+        
+        uint64_t aos = layout.total_size;
+        if (layout.total_size > line) {
+            aos = std::min(layout.total_size, touched * line);
+        }
+        aos_bytes += loop.weight * static_cast<double>(aos);
+        soa_bytes += loop.weight * static_cast<double>(soa);
+    }
+    aos_bytes /= loop_weight;
+    soa_bytes /= loop_weight;
     
-    // Calculate optimal ordering
-    std::vector<std::string> optimal_order = CalculateOptimalOrder(layout);
+    if (soa_bytes == 0 || aos_bytes < kMinSoaGain * soa_bytes) {
+        return;
+    }
     
-    // Check if current order matches optimal
-    bool is_optimal = true;
+    StructLayout::Optimization opt;
+    opt.kind = OptimizationKind::AosToSoa;
+    opt.bytes_saved = 0; // Same data, different arrangement
+    opt.members_moved = 0;
+    opt.bytes_per_iteration_before = aos_bytes;
+    opt.bytes_per_iteration_after = soa_bytes;
     for (size_t i = 0; i < layout.members.size(); i++) {
-        if (layout.members[i].name != optimal_order[i]) {
-            is_optimal = false;
-            break;
+        if (read[i]) {
+            opt.loop_members.push_back(layout.members[i].name);
+        }
+    }
+    
+    char bytes[96];
+    std::snprintf(bytes, sizeof(bytes), "%.0f bytes fetched per iteration as an array of structs, %.0f",
+                  aos_bytes, soa_bytes);
+    opt.description = "Stored in arrays (" + std::to_string(accesses.array_uses) +
+        " declarations) whose loops read " + std::to_string(opt.loop_members.size()) + " of " +
+        std::to_string(layout.members.size()) + " members: " + bytes + " as a struct of arrays";
+    
+    layout.optimizations.push_back(opt);
+}
+
+uint64_t LayoutCalculator::SizeWithAlignedMembers(
+    const StructLayout& layout,
+    const clang::ASTContext& context,
+    const clang::RecordDecl* record,
+    const std::vector<bool>& aligned
+) {
+    if (!CanReorder(layout, record)) {
+        return 0;
+    }
+    
+    std::vector<PlacementUnit> units = BuildPlacementUnits(layout, context, record);
+    std::vector<ReorderItem> items;
+    std::vector<size_t> order;
+    for (const auto& unit : units) {
+        uint64_t alignment = unit.alignment;
+        if (aligned[unit.first_member]) {
+            alignment = std::max(alignment, cache_line_size_);
         }
+        order.push_back(items.size());
+        items.push_back({unit.size, alignment});
     }
     
-    if (!is_optimal) {
-        uint64_t optimized_size = CalculateSizeWithOrder(layout, optimal_order);
+    return ReorderSolver::SizeWithOrder(
+        items, order, GetFieldStartOffset(layout, context, record),
+        std::max(layout.alignment, cache_line_size_));
+}
+
+void LayoutCalculator::DetectFalseSharing(
+    StructLayout& layout,
+    const clang::ASTContext& context,
+    const clang::RecordDecl* record
+) {
+    std::vector<size_t> shared;
+    for (size_t i = 0; i < layout.members.size(); i++) {
+        if (layout.members[i].is_thread_shared && layout.members[i].size > 0) {
+            shared.push_back(i);
+        }
+    }
+    if (shared.empty()) {
+        return;
+    }
+    std::stable_sort(shared.begin(), shared.end(), [&layout](size_t a, size_t b) {
+        return layout.members[a].offset < layout.members[b].offset;
+    });
+    
+    const uint64_t line = cache_line_size_;
+    
+    // With line alignment the object starts on a line boundary and lines
+    // are known exactly; otherwise any start the alignment allows is
+    // possible, so two ranges closer than a line may share one
+    bool line_aligned = layout.alignment % line == 0;
+    auto may_share = [&](uint64_t first_end, uint64_t second_offset) {
+        uint64_t first_last = first_end - 1;
+        if (second_offset <= first_last) {
+            return false; // Same bytes (a union): true sharing, not false
+        }
+        if (line_aligned) {
+            return first_last / line == second_offset / line;
+        }
+        return second_offset - first_last < line;
+    };
+    
+    std::vector<bool> contended(layout.members.size(), false);
+    bool found = false;
+    for (size_t a = 0; a < shared.size(); a++) {
+        const MemberInfo& first = layout.members[shared[a]];
+        for (size_t b = a + 1; b < shared.size(); b++) {
+            const MemberInfo& second = layout.members[shared[b]];
+            if (may_share(first.offset + first.size, second.offset)) {
+                contended[shared[a]] = true;
+                contended[shared[b]] = true;
+                found = true;
+            }
+        }
+    }
+    
+    std::string cause;
+    if (found) {
+        cause = "can share a " + std::to_string(line) + "-byte cache line";
+    } else {
+        // Neighbouring objects, e.g. per-core slots in an array: the last
+        // shared member of one and the first of the next. Only records that
+        // are mostly synchronization state are reported, since most records
+        // holding a mutex aren't laid out back to back in hot arrays.
+        uint64_t shared_bytes = 0;
+        for (size_t index : shared) {
+            shared_bytes += layout.members[index].size;
+        }
+        const MemberInfo& first = layout.members[shared.front()];
+        const MemberInfo& last = layout.members[shared.back()];
+        if (line_aligned || shared_bytes * 2 < layout.useful_size ||
+            !may_share(last.offset + last.size, layout.total_size + first.offset)) {
+            return;
+        }
         
-        if (optimized_size < layout.total_size) {
-            StructLayout::Optimization opt;
-            opt.description = "Reorder members by alignment to reduce padding";
-            opt.bytes_saved = layout.total_size - optimized_size;
-            opt.suggested_order = optimal_order;
-            opt.confidence = 0.95; // High confidence for standard struct optimization
-            
-            layout.optimizations.push_back(opt);
+        // Aligning the first shared member aligns the whole record, which
+        // puts every object on lines of its own
+        contended[shared.front()] = true;
+        cause = "can share a " + std::to_string(line) +
+            "-byte cache line with the neighbouring object in an array";
+    }
+    
+    StructLayout::Optimization opt;
+    opt.kind = OptimizationKind::FalseSharing;
+    opt.bytes_saved = 0; // Costs space; reported in the description
+    opt.members_moved = 0;
+    
+    std::string names;
+    for (size_t i = 0; i < layout.members.size(); i++) {
+        if (contended[i]) {
+            opt.contended_members.push_back(layout.members[i].name);
+            names += (names.empty() ? "'" : ", '") + layout.members[i].name + "'";
+        }
+    }
+    
+    opt.description = names + " " + cause +
+        "; writes from different threads will contend for it (false sharing). "
+        "Give " + (opt.contended_members.size() == 1 ? "it" : "each") +
+        " alignas(std::hardware_destructive_interference_size) or pad to a line boundary";
+    
+    uint64_t grown_size = SizeWithAlignedMembers(layout, context, record, contended);
+    if (grown_size > layout.total_size) {
+        opt.description += " (grows the struct from " + std::to_string(layout.total_size) +
+            " to " + std::to_string(grown_size) + " bytes)";
+    }
+    
+    layout.optimizations.push_back(opt);
+}
+
+void LayoutCalculator::CalculateArrayStride(StructLayout& layout) const {
+    ArrayStride& stride = layout.array_stride;
+    stride = ArrayStride();
+    uint64_t size = layout.total_size;
+    uint64_t line = cache_line_size_;
+    if (size == 0) {
+        return;
+    }
+    
+    stride.elements_per_line = static_cast<double>(line) / size;
+    stride.elements_per_page = static_cast<double>(kPageSize) / size;
+    stride.elements_per_huge_page = static_cast<double>(kHugePageSize) / size;
+    stride.lines_per_element = LinesPerElement(size, line);
+    stride.line_straddle = StraddleFraction(size, line);
+    stride.page_straddle = StraddleFraction(size, kPageSize);
+    stride.huge_page_straddle = StraddleFraction(size, kHugePageSize);
+    
+    // A 72-byte element spans two lines wherever it starts; only sizes
+    // that make some elements touch a line more than that are worth fixing
+    if (!TouchesExtraLines(size, line)) {
+        return;
+    }
+    for (uint64_t smaller = size - 1; smaller > 0; smaller--) {
+        if (!TouchesExtraLines(smaller, line)) {
+            stride.shrink_size = smaller;
+            break;
+        }
+    }
+    for (uint64_t alignment = 2; alignment <= line; alignment *= 2) {
+        uint64_t padded = (size + alignment - 1) / alignment * alignment;
+        if (!TouchesExtraLines(padded, line)) {
+            stride.aligned_size = padded;
+            break;
         }
     }
+}
+
+void LayoutCalculator::SuggestArrayStride(StructLayout& layout) {
+    const ArrayStride& stride = layout.array_stride;
+    uint64_t size = layout.total_size;
+    uint64_t line = cache_line_size_;
+    if (stride.aligned_size == 0 || size < kMinStrideLineShare * line) {
+        return;
+    }
+    
+    // What the members themselves take; shrinking below it means
+    // narrowing or removing members, not just padding
+    uint64_t padding = 0;
+    for (const auto& region : layout.padding) {
+        padding += region.size;
+    }
+    uint64_t data_size = size - std::min(padding, size);
+    
+    StructLayout::Optimization opt;
+    opt.kind = OptimizationKind::ArrayStride;
+    opt.bytes_saved = 0; // Informational; the fixes are size trade-offs
+    opt.members_moved = 0;
+    
+    char numbers[160];
+    std::snprintf(numbers, sizeof(numbers),
+                  "%.0f%% of elements cross a cache line (%.2f lines per element, %.1f per 4 KiB page)",
+                  stride.line_straddle * 100, stride.lines_per_element, stride.elements_per_page);
+    opt.description = "In arrays of " + layout.name + " (" + std::to_string(size) + " bytes), " + numbers;
+    if (stride.page_straddle > 0) {
+        std::snprintf(numbers, sizeof(numbers), ", %.1f%% cross a 4 KiB page", stride.page_straddle * 100);
+        opt.description += numbers;
+    }
+    
+    uint64_t shrunk_lines = (stride.shrink_size + line - 1) / line;
+    opt.description += ". Shrinking it to " + std::to_string(stride.shrink_size) + " bytes fits " +
+        (stride.shrink_size <= line
+            ? std::to_string(line / stride.shrink_size) + " per line"
+            : "each in " + std::to_string(shrunk_lines) + " lines");
+    if (stride.shrink_size < data_size) {
+        opt.description += " (its members take " + std::to_string(data_size) + ")";
+    }
+    
+    // The largest power of two dividing the padded size rounds it up the
+    // same way; below a line that is the size itself
+    uint64_t alignment = std::min(stride.aligned_size & (~stride.aligned_size + 1), line);
+    uint64_t padded_lines = (stride.aligned_size + line - 1) / line;
+    opt.description += "; alignas(" + std::to_string(alignment) + ") grows it to " +
+        std::to_string(stride.aligned_size) + " bytes and " +
+        (padded_lines == 1 ? "puts each on one line" : "keeps each to " + std::to_string(padded_lines) + " lines");
+    
+    layout.optimizations.push_back(opt);
+}
+
+void LayoutCalculator::GenerateOptimizations(
+    StructLayout& layout,
+    const clang::ASTContext& context,
+    const clang::RecordDecl* record,
+    const FieldProfile* profile,
+    const FieldAccessGraph* accesses
+) {
+    layout.optimizations.clear();
+    
+    // A single atomic counter can still share lines with its neighbours
+    DetectFalseSharing(layout, context, record);
+    SuggestArrayStride(layout);
+    
+    // Don't optimize empty structs or single-member structs
+    if (layout.members.size() < 2) {
+        return;
+    }
+    
+    SuggestReordering(layout, context, record);
+    SuggestFlagPacking(layout, context, record);
+    SuggestNarrowing(layout, context, record);
+    SuggestNestedReordering(layout, context, record);
+    
+    if (profile && !profile->IsEmpty()) {
+        SuggestHotColdSplit(layout, context, record, *profile);
+    }
+    
+    if (accesses) {
+        SuggestCoAccessLayout(layout, context, record, *accesses);
+        SuggestStructOfArrays(layout, record, *accesses);
+    }
     
     // Check for cache line splitting (if members are large)
-    const uint64_t cache_line_size = 64;
+    const uint64_t cache_line_size = cache_line_size_;
+    
+    // In arrays of table-sized elements the object starts at every
+    // multiple of gcd(size, line) within a line, so members split in some
+    // elements even if they don't in the first
+    bool in_arrays = layout.total_size >= kMinStrideLineShare * cache_line_size &&
+                     layout.total_size % cache_line_size != 0;
+    uint64_t step = std::gcd(layout.total_size, cache_line_size);
+    
     for (const auto& member : layout.members) {
+        if (member.size == 0 || member.size >= cache_line_size) {
+            continue;
+        }
         uint64_t member_end = member.offset + member.size;
         uint64_t start_line = member.offset / cache_line_size;
         uint64_t end_line = (member_end - 1) / cache_line_size;
         
-        if (start_line != end_line && member.size < cache_line_size) {
-            StructLayout::Optimization opt;
+        StructLayout::Optimization opt;
+        opt.kind = OptimizationKind::CacheLineSplit;
+        opt.bytes_saved = 0; // Informational
+        opt.members_moved = 0;
+        opt.suggested_order = {}; // No specific reordering suggested
+        
+        if (start_line != end_line) {
             opt.description = "Member '" + member.name + "' spans multiple cache lines";
-            opt.bytes_saved = 0; // Informational
-            opt.confidence = 0.8;
-            opt.suggested_order = {}; // No specific reordering suggested
-            
+            layout.optimizations.push_back(opt);
+            continue;
+        }
+        if (!in_arrays) {
+            continue;
+        }
+        
+        uint64_t starts = cache_line_size / step;
+        uint64_t splits = 0;
+        for (uint64_t k = 0; k < starts; k++) {
+            if ((member.offset + k * step) % cache_line_size + member.size > cache_line_size) {
+                splits++;
+            }
+        }
+        if (splits > 0) {
+            char share[32];
+            std::snprintf(share, sizeof(share), "%.0f%%", 100.0 * splits / starts);
+            opt.description = "Member '" + member.name + "' spans two cache lines in " + share +
+                              " of array elements";
             layout.optimizations.push_back(opt);
         }
     }
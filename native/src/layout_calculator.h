@@ -2,6 +2,8 @@
 #define STRUCTSIGHT_LAYOUT_CALCULATOR_H
 
 #include "types.h"
+#include "field_profile.h"
+#include "access_analyzer.h"
 #include <clang/AST/ASTContext.h>
 #include <clang/AST/Decl.h>
 
@@ -9,31 +11,145 @@ namespace structsight {
 
 class LayoutCalculator {
 public:
-    LayoutCalculator(Compiler compiler, Architecture arch);
+    LayoutCalculator(
+        Compiler compiler,
+        Architecture arch,
+        uint64_t cache_line_size = kDefaultCacheLineSize
+    );
     
-    // Calculate padding regions
+    // Calculate padding regions: bytes that no member, base subobject or
+    // vptr occupies
     void CalculatePadding(
         StructLayout& layout,
         const clang::ASTContext& context,
         const clang::RecordDecl* record
     );
     
-    // Generate optimization suggestions
-    void GenerateOptimizations(StructLayout& layout);
+    // Fill layout.array_stride from its size and the cache line size
+    void CalculateArrayStride(StructLayout& layout) const;
+    
+    // Generate optimization suggestions; profile (optional) enables the
+    // hot/cold split suggestion, accesses (optional) the co-access layout
+    void GenerateOptimizations(
+        StructLayout& layout,
+        const clang::ASTContext& context,
+        const clang::RecordDecl* record,
+        const FieldProfile* profile = nullptr,
+        const FieldAccessGraph* accesses = nullptr
+    );
     
 private:
     Compiler compiler_;
     Architecture arch_;
+    uint64_t cache_line_size_;
+    
+    // Members grouped into pieces that move as a whole: each ordinary
+    // member on its own, each run of adjacent bitfields together
+    struct PlacementUnit {
+        size_t first_member;
+        size_t member_count;
+        uint64_t size;
+        uint64_t alignment;
+    };
+    std::vector<PlacementUnit> BuildPlacementUnits(
+        const StructLayout& layout,
+        const clang::ASTContext& context,
+        const clang::RecordDecl* record
+    ) const;
+    
+    // Whether a derived class may put its members in the record's tail
+    // padding (Itanium: non-POD and not final)
+    bool TailPaddingReusable(const StructLayout& layout, const clang::RecordDecl* record) const;
+    
+    // Whether members can be moved freely (not packed, no virtual bases)
+    bool CanReorder(const StructLayout& layout, const clang::RecordDecl* record) const;
+    
+    // Suggest the smallest member order, if it beats the current one
+    void SuggestReordering(
+        StructLayout& layout,
+        const clang::ASTContext& context,
+        const clang::RecordDecl* record
+    );
+    
+    // Suggest declaring bool and small enum members as bitfields packed
+    // into one run, if that beats the best reordering of the record
+    void SuggestFlagPacking(
+        StructLayout& layout,
+        const clang::ASTContext& context,
+        const clang::RecordDecl* record
+    );
+    
+    // Suggest narrowing enum members (by their enumerators) and integer
+    // members (by annotated bounds) to smaller integer types, if that
+    // beats the best reordering of the record
+    void SuggestNarrowing(
+        StructLayout& layout,
+        const clang::ASTContext& context,
+        const clang::RecordDecl* record
+    );
     
-    // Calculate optimal member ordering
-    std::vector<std::string> CalculateOptimalOrder(const StructLayout& layout);
+    // Suggest reordering the members of a nested record the project owns
+    // when that shrinks this record beyond what its own reordering does
+    void SuggestNestedReordering(
+        StructLayout& layout,
+        const clang::ASTContext& context,
+        const clang::RecordDecl* record
+    );
+    
+    // Suggest packing the profiled hot members first and moving the cold
+    // ones behind a pointer, if that touches fewer cache lines per access
+    void SuggestHotColdSplit(
+        StructLayout& layout,
+        const clang::ASTContext& context,
+        const clang::RecordDecl* record,
+        const FieldProfile& profile
+    );
+    
+    // Suggest an order that keeps fields used by the same functions on
+    // the same cache line, if that touches fewer lines per access
+    void SuggestCoAccessLayout(
+        StructLayout& layout,
+        const clang::ASTContext& context,
+        const clang::RecordDecl* record,
+        const FieldAccessGraph& accesses
+    );
+    
+    // Suggest a struct of arrays when the record mostly lives in arrays
+    // whose loops read a small part of each element
+    void SuggestStructOfArrays(
+        StructLayout& layout,
+        const clang::RecordDecl* record,
+        const FieldAccessGraph& accesses
+    );
     
-    // Calculate size with given member order
-    uint64_t CalculateSizeWithOrder(
+    // Report how array elements straddle cache lines, with the sizes that
+    // would stop it, for records big enough to be looked up one at a time
+    void SuggestArrayStride(StructLayout& layout);
+    
+    // Report thread-shared members that can land on one cache line, within
+    // an object or across neighbouring objects in an array
+    void DetectFalseSharing(
+        StructLayout& layout,
+        const clang::ASTContext& context,
+        const clang::RecordDecl* record
+    );
+    
+    // Size of the record once the given members get alignas(cache line);
+    // 0 if its layout rules (packing, virtual bases) can't be modelled
+    uint64_t SizeWithAlignedMembers(
         const StructLayout& layout,
-        const std::vector<std::string>& order
+        const clang::ASTContext& context,
+        const clang::RecordDecl* record,
+        const std::vector<bool>& aligned
     );
     
+    // Where the first member may go: after the vptr and non-virtual bases
+    uint64_t GetFieldStartOffset(
+        const StructLayout& layout,
+        const clang::ASTContext& context,
+        const clang::RecordDecl* record
+    ) const;
+    
     // Get pointer size for architecture
     uint64_t GetPointerSize() const;
 };
@@ -0,0 +1,154 @@
+#include "preamble_cache.h"
+#include <clang/Basic/DiagnosticOptions.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Serialization/PCHContainerOperations.h>
+#include <algorithm>
+
+namespace structsight {
+
+namespace {
+
+// Records every file the preamble pulled in, which the PCH itself does not
+// expose. The main file is left out.
+class IncludeRecorder : public clang::PreambleCallbacks {
+public:
+    void AfterExecute(clang::CompilerInstance& compiler) override {
+        const clang::SourceManager& sm = compiler.getSourceManager();
+        const clang::FileEntry* main_file = sm.getFileEntryForID(sm.getMainFileID());
+        for (auto it = sm.fileinfo_begin(); it != sm.fileinfo_end(); ++it) {
+            if (it->first != main_file) {
+                files_.push_back(it->first->getName().str());
+            }
+        }
+    }
+
+    std::vector<std::string> TakeFiles() {
+        return std::move(files_);
+    }
+
+private:
+    std::vector<std::string> files_;
+};
+
+} // namespace
+
+PreambleCache::PreambleCache(size_t max_entries, size_t max_bytes)
+    : max_entries_(std::max<size_t>(max_entries, 1)), max_bytes_(max_bytes), total_bytes_(0) {}
+
+std::shared_ptr<const clang::PrecompiledPreamble> PreambleCache::Get(
+    const std::string& file_path,
+    const std::string& flags_key,
+    const clang::CompilerInvocation& invocation,
+    const llvm::MemoryBuffer& main_buffer,
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> vfs,
+    std::vector<std::string>* included_files,
+    bool* reused
+) {
+    // Find where the include block ends (MaxLines = 0 means no limit)
+    clang::PreambleBounds bounds = clang::ComputePreambleBounds(
+        *invocation.getLangOpts(),
+        main_buffer.getMemBufferRef(),
+        0
+    );
+
+    if (bounds.Size == 0) {
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(file_path);
+
+        // CanReuse checks the preamble text and the stat of every header
+        if (it != entries_.end() &&
+            it->second.flags_key == flags_key &&
+            it->second.preamble->CanReuse(
+                invocation, main_buffer.getMemBufferRef(), bounds, *vfs)) {
+            if (included_files) {
+                *included_files = it->second.included_files;
+            }
+            if (reused) {
+                *reused = true;
+            }
+            recent_.splice(recent_.begin(), recent_, it->second.recent);
+            return it->second.preamble;
+        }
+    }
+
+    // Build outside the lock so other files aren't blocked on this one
+    IncludeRecorder callbacks;
+    llvm::IntrusiveRefCntPtr<clang::DiagnosticsEngine> diagnostics =
+        clang::CompilerInstance::createDiagnostics(
+            new clang::DiagnosticOptions(),
+            new clang::IgnoringDiagConsumer(),
+            true
+        );
+
+    auto built = clang::PrecompiledPreamble::Build(
+        invocation,
+        &main_buffer,
+        bounds,
+        *diagnostics,
+        vfs,
+        std::make_shared<clang::PCHContainerOperations>(),
+        true, // Keep the PCH in memory rather than in a temp file
+        callbacks
+    );
+
+    if (!built) {
+        return nullptr;
+    }
+
+    auto preamble = std::make_shared<const clang::PrecompiledPreamble>(std::move(*built));
+    std::vector<std::string> files = callbacks.TakeFiles();
+    if (included_files) {
+        *included_files = files;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(file_path);
+    if (it != entries_.end()) {
+        Erase(it);
+    }
+    recent_.push_front(file_path);
+    size_t bytes = preamble->getSize();
+    entries_[file_path] = Entry{flags_key, preamble, std::move(files), bytes, recent_.begin()};
+    total_bytes_ += bytes;
+    Evict();
+    return preamble;
+}
+
+void PreambleCache::Erase(std::map<std::string, Entry>::iterator it) {
+    total_bytes_ -= it->second.bytes;
+    recent_.erase(it->second.recent);
+    entries_.erase(it);
+}
+
+void PreambleCache::Evict() {
+    // Analyses still using an evicted preamble keep their own reference
+    while (entries_.size() > 1 && (entries_.size() > max_entries_ || total_bytes_ > max_bytes_)) {
+        Erase(entries_.find(recent_.back()));
+    }
+}
+
+void PreambleCache::Invalidate(const std::string& file_path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(file_path);
+    if (it != entries_.end()) {
+        Erase(it);
+    }
+}
+
+void PreambleCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    recent_.clear();
+    total_bytes_ = 0;
+}
+
+PreambleCache& PreambleCache::Global() {
+    static PreambleCache cache;
+    return cache;
+}
+
+} // namespace structsight
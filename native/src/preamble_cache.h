@@ -0,0 +1,76 @@
+#ifndef STRUCTSIGHT_PREAMBLE_CACHE_H
+#define STRUCTSIGHT_PREAMBLE_CACHE_H
+
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Frontend/PrecompiledPreamble.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace structsight {
+
+// Keeps one precompiled preamble (the #include block at the top of a file)
+// per file path, so repeated analyses of the same file only reparse the
+// code below the includes. An entry is rebuilt when the include block, any
+// header it pulls in, or the compile flags change.
+//
+// A preamble is often tens of megabytes, so the least recently used ones
+// are dropped once there are more than max_entries or they hold more than
+// max_bytes together; the one just built is always kept.
+class PreambleCache {
+public:
+    explicit PreambleCache(size_t max_entries = 32, size_t max_bytes = size_t(512) << 20);
+    
+    // Returns a preamble that can be applied to `main_buffer`, building and
+    // storing a new one if the cached entry is missing or stale.
+    // Returns null if the file has no preamble or it failed to build.
+    // included_files, if given, receives the headers the preamble covers;
+    // reused, if given, whether the stored entry was still valid.
+    std::shared_ptr<const clang::PrecompiledPreamble> Get(
+        const std::string& file_path,
+        const std::string& flags_key,
+        const clang::CompilerInvocation& invocation,
+        const llvm::MemoryBuffer& main_buffer,
+        llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> vfs,
+        std::vector<std::string>* included_files = nullptr,
+        bool* reused = nullptr
+    );
+
+    // Drop the preamble for a single file
+    void Invalidate(const std::string& file_path);
+
+    // Drop all preambles
+    void Clear();
+
+    // Process-wide cache shared by every analysis in the addon
+    static PreambleCache& Global();
+
+private:
+    struct Entry {
+        std::string flags_key;
+        std::shared_ptr<const clang::PrecompiledPreamble> preamble;
+        std::vector<std::string> included_files;
+        size_t bytes;
+        std::list<std::string>::iterator recent; // Position in recent_
+    };
+
+    std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    std::list<std::string> recent_; // File paths, most recently used first
+    size_t max_entries_;
+    size_t max_bytes_;
+    size_t total_bytes_;
+
+    // Callers hold mutex_
+    void Erase(std::map<std::string, Entry>::iterator it);
+    void Evict();
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_PREAMBLE_CACHE_H
@@ -0,0 +1,179 @@
+#include "project_scanner.h"
+#include "analyzer.h"
+#include "thread_pool.h"
+#include <clang/Tooling/ArgumentsAdjusters.h>
+#include <clang/Tooling/JSONCompilationDatabase.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+
+namespace structsight {
+
+// Make a database path absolute against the entry's directory
+static std::string ResolvePath(const std::string& directory, const std::string& path) {
+    if (llvm::sys::path::is_absolute(path)) {
+        return path;
+    }
+    llvm::SmallString<256> absolute(directory);
+    llvm::sys::path::append(absolute, path);
+    llvm::sys::path::remove_dots(absolute, true);
+    return std::string(absolute.str());
+}
+
+ProjectScanner::ProjectScanner(LayoutCache* layout_cache)
+    : layout_cache_(layout_cache) {}
+
+std::vector<std::string> ProjectScanner::ExtractCompileFlags(
+    const clang::tooling::CompileCommand& command
+) {
+    clang::tooling::CommandLineArguments args = command.CommandLine;
+    args = clang::tooling::getClangStripOutputAdjuster()(args, command.Filename);
+    args = clang::tooling::getClangStripDependencyFileAdjuster()(args, command.Filename);
+    
+    std::string input = ResolvePath(command.Directory, command.Filename);
+    
+    // Relative -I paths and the like are resolved against this directory
+    std::vector<std::string> flags = {"-working-directory", command.Directory};
+    
+    // args[0] is the compiler
+    for (size_t i = 1; i < args.size(); i++) {
+        const std::string& arg = args[i];
+        
+        if (arg == "-c") {
+            continue;
+        }
+        
+        // Analyzer appends the input file itself
+        if (!arg.empty() && arg[0] != '-' && ResolvePath(command.Directory, arg) == input) {
+            continue;
+        }
+        
+        flags.push_back(arg);
+    }
+    
+    return flags;
+}
+
+ProjectScanResult ProjectScanner::Scan(const ProjectScanRequest& request) {
+    ProjectScanResult result;
+    
+    std::string database_path = request.compile_commands_path;
+    if (llvm::sys::fs::is_directory(database_path)) {
+        llvm::SmallString<256> path(database_path);
+        llvm::sys::path::append(path, "compile_commands.json");
+        database_path = std::string(path.str());
+    }
+    
+    std::string error;
+    std::unique_ptr<clang::tooling::JSONCompilationDatabase> database =
+        clang::tooling::JSONCompilationDatabase::loadFromFile(
+            database_path,
+            error,
+            clang::tooling::JSONCommandLineSyntax::AutoDetect
+        );
+    
+    if (!database) {
+        result.error_message = "Failed to load " + database_path + ": " + error;
+        return result;
+    }
+    
+    std::mutex results_mutex;
+    std::map<std::string, StructLayout> unique_layouts; // By qualified name
+    
+    // Records some TU has started laying out: a header's records are laid
+    // out by the first TU that reaches them and skipped by the rest
+    std::mutex claimed_mutex;
+    std::set<std::string> claimed;
+    auto claim = [&](const std::string& qualified_name) {
+        std::lock_guard<std::mutex> lock(claimed_mutex);
+        return claimed.insert(qualified_name).second;
+    };
+    std::atomic<uint64_t> files_scanned(0);
+    
+    {
+        ThreadPool pool(request.thread_count);
+        
+        for (const auto& command : database->getAllCompileCommands()) {
+            // The analyzer drives clang in C++ mode, so C sources are skipped;
+            // records they share with C++ code are still found through headers
+            if (llvm::sys::path::extension(command.Filename) == ".c") {
+                continue;
+            }
+            
+            pool.Submit([&, command]() {
+                if (request.cancellation && request.cancellation->load()) {
+                    return;
+                }
+                
+                std::string file_path = ResolvePath(command.Directory, command.Filename);
+                auto buffer = llvm::MemoryBuffer::getFile(file_path);
+                if (!buffer) {
+                    std::lock_guard<std::mutex> lock(results_mutex);
+                    result.failed_files.push_back(file_path);
+                    return;
+                }
+                
+                AnalysisRequest tu;
+                tu.source_code = (*buffer)->getBuffer().str();
+                tu.file_path = file_path;
+                tu.architecture = request.architecture;
+                tu.compiler = request.compiler;
+                tu.compile_flags = ExtractCompileFlags(command);
+                tu.path_filter = request.path_filter;
+                tu.include_system_headers = request.include_system_headers;
+                tu.include_template_instantiations = request.include_template_instantiations;
+                tu.profile = request.profile;
+                tu.cache_line_size = request.cache_line_size;
+                tu.cancellation = request.cancellation;
+                tu.claim_record = claim;
+                
+                // Each TU is parsed once, so a preamble would never be reused
+                Analyzer analyzer(nullptr, layout_cache_);
+                AnalysisResult tu_result = analyzer.Analyze(tu);
+                files_scanned++;
+                
+                std::lock_guard<std::mutex> lock(results_mutex);
+                if (!tu_result.success) {
+                    if (!tu_result.cancelled) {
+                        result.failed_files.push_back(file_path);
+                    }
+                    return;
+                }
+                
+                // A layout cache hit holds records other TUs claimed too;
+                // keep the first layout of each
+                for (auto& layout : tu_result.layouts) {
+                    claim(layout.qualified_name);
+                    unique_layouts.emplace(layout.qualified_name, std::move(layout));
+                }
+            });
+        }
+        
+        pool.Wait();
+    }
+    
+    result.files_scanned = files_scanned.load();
+    
+    if (request.cancellation && request.cancellation->load()) {
+        result.cancelled = true;
+        result.error_message = "Scan cancelled";
+        return result;
+    }
+    
+    result.layouts.reserve(unique_layouts.size());
+    for (auto& entry : unique_layouts) {
+        result.layouts.push_back(std::move(entry.second));
+    }
+    
+    // Each TU only compared the instantiations it saw itself
+    Analyzer::CompareInstantiations(result.layouts);
+    
+    result.success = true;
+    return result;
+}
+
+} // namespace structsight
@@ -0,0 +1,35 @@
+#ifndef STRUCTSIGHT_PROJECT_SCANNER_H
+#define STRUCTSIGHT_PROJECT_SCANNER_H
+
+#include "types.h"
+#include "layout_cache.h"
+#include <clang/Tooling/CompilationDatabase.h>
+#include <string>
+#include <vector>
+
+namespace structsight {
+
+// Analyzes every translation unit listed in a compile_commands.json on a
+// thread pool and merges the layouts of all records; each record is laid
+// out by the first TU that reaches it.
+class ProjectScanner {
+public:
+    // layout_cache is optional; TUs whose results it holds aren't parsed
+    explicit ProjectScanner(LayoutCache* layout_cache = nullptr);
+    
+    ProjectScanResult Scan(const ProjectScanRequest& request);
+    
+    // Turn a compilation database entry into flags for AnalysisRequest:
+    // drops the compiler, the input file and output/dependency options,
+    // and pins the working directory
+    static std::vector<std::string> ExtractCompileFlags(
+        const clang::tooling::CompileCommand& command
+    );
+    
+private:
+    LayoutCache* layout_cache_;
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_PROJECT_SCANNER_H
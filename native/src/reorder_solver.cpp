@@ -0,0 +1,452 @@
+#include "reorder_solver.h"
+#include <algorithm>
+#include <limits>
+
+namespace structsight {
+
+namespace {
+
+const uint64_t kUnreachable = std::numeric_limits<uint64_t>::max();
+
+// Beyond this the residue tables get too large; fall back to a plain
+// descending-alignment order
+const uint64_t kMaxTrackedAlignment = 4096;
+
+// Largest struct for which single-member moves are searched exhaustively
+const size_t kMaxLocalSearchItems = 64;
+
+// Largest table (item subsets x residues x last kept item) searched for
+// the exact answer: 1.5 MB and well under a millisecond, enough for nine
+// members at 8-byte alignment
+const uint64_t kMaxExactStates = uint64_t(1) << 16;
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+// Padding needed at residue r (offset mod struct alignment) for alignment a
+uint64_t PadAt(uint64_t residue, uint64_t alignment) {
+    return (alignment - residue % alignment) % alignment;
+}
+
+// Knapsack trace for one alignment class, used to rebuild the filler set
+struct LevelTrace {
+    bool forced = false;
+    std::vector<uint64_t> entry_from;   // Residue before padding, per residue after
+    std::vector<uint8_t> used;          // Per residue: did the filler use this class
+    // Per item, per (residue, taken-any) state:
+    // 0 = not taken, 1 = taken from "nothing taken yet", 2 = taken after others
+    std::vector<std::vector<uint8_t>> took;
+};
+
+// Order the filler ascending and the rest descending by alignment, keeping
+// declaration order inside each alignment class
+std::vector<size_t> BuildOrder(
+    const std::vector<ReorderItem>& items,
+    const std::vector<bool>& in_filler
+) {
+    std::vector<size_t> filler;
+    std::vector<size_t> rest;
+    for (size_t i = 0; i < items.size(); i++) {
+        (in_filler[i] ? filler : rest).push_back(i);
+    }
+
+    std::stable_sort(filler.begin(), filler.end(), [&items](size_t a, size_t b) {
+        return items[a].alignment < items[b].alignment;
+    });
+    std::stable_sort(rest.begin(), rest.end(), [&items](size_t a, size_t b) {
+        return items[a].alignment > items[b].alignment;
+    });
+
+    filler.insert(filler.end(), rest.begin(), rest.end());
+    return filler;
+}
+
+// Starting from declaration order, repeatedly apply the single move
+// (take one item out, insert it elsewhere) that shrinks the struct most.
+// Structs that are a member or two away from optimal are common, and this
+// finds those with far fewer moves than a full re-sort.
+std::vector<size_t> ImproveByMoves(
+    const std::vector<ReorderItem>& items,
+    uint64_t start_offset,
+    uint64_t struct_alignment,
+    uint64_t target_size
+) {
+    std::vector<size_t> order(items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        order[i] = i;
+    }
+
+    uint64_t size = ReorderSolver::SizeWithOrder(items, order, start_offset, struct_alignment);
+    std::vector<size_t> candidate;
+
+    while (size > target_size) {
+        std::vector<size_t> best_order;
+        uint64_t best_size = size;
+
+        for (size_t from = 0; from < order.size(); from++) {
+            for (size_t to = 0; to < order.size(); to++) {
+                if (to == from) {
+                    continue;
+                }
+                candidate = order;
+                size_t moved = candidate[from];
+                candidate.erase(candidate.begin() + from);
+                candidate.insert(candidate.begin() + to, moved);
+
+                uint64_t candidate_size = ReorderSolver::SizeWithOrder(
+                    items, candidate, start_offset, struct_alignment);
+                if (candidate_size < best_size) {
+                    best_size = candidate_size;
+                    best_order = candidate;
+                }
+            }
+        }
+
+        if (best_order.empty()) {
+            break; // Stuck above the optimum
+        }
+        order.swap(best_order);
+        size = best_size;
+    }
+
+    return order;
+}
+
+// Exact search over every order, for structs small enough to enumerate
+// subsets of. The best way to place a subset of the items only depends on
+// the offset it ends at modulo the struct alignment, and among equal
+// residues the lower offset always wins, so (subset, residue) states find
+// the minimum size for any sizes, bitfield runs included. Tracking the
+// last item kept in declaration order as well finds, among the
+// minimum-size orders, one that keeps the longest such run: the fewest
+// moves. Returns false when the table would be too large.
+bool SolveExactly(
+    const std::vector<ReorderItem>& items,
+    uint64_t start_offset,
+    uint64_t struct_alignment,
+    ReorderSolution& solution
+) {
+    const size_t count = items.size();
+    uint64_t modulus = std::max<uint64_t>(struct_alignment, 1);
+    for (const auto& item : items) {
+        modulus = std::max(modulus, std::max<uint64_t>(item.alignment, 1));
+    }
+    if (count >= 32 || modulus > kMaxExactStates ||
+        (uint64_t(1) << count) * modulus * (count + 1) > kMaxExactStates) {
+        return false;
+    }
+
+    // State (subset, residue, last kept + 1): lowest end offset, then most
+    // items kept in order; with the step that reached it
+    struct State {
+        uint64_t offset = kUnreachable;
+        uint32_t kept = 0;
+        uint32_t from = 0;
+        uint8_t item = 0;
+    };
+    const size_t residues = static_cast<size_t>(modulus);
+    const size_t lasts = count + 1;
+    auto index_of = [&](size_t mask, size_t residue, size_t last) {
+        return (mask * residues + residue) * lasts + last;
+    };
+    std::vector<State> states(static_cast<size_t>((uint64_t(1) << count) * residues * lasts));
+    states[index_of(0, static_cast<size_t>(start_offset % modulus), 0)].offset = start_offset;
+
+    auto relax = [&](size_t to, uint64_t offset, uint32_t kept, size_t from, size_t item) {
+        State& state = states[to];
+        if (offset < state.offset || (offset == state.offset && kept > state.kept)) {
+            state = {offset, kept, static_cast<uint32_t>(from), static_cast<uint8_t>(item)};
+        }
+    };
+
+    const size_t full = (size_t(1) << count) - 1;
+    for (size_t mask = 0; mask < full; mask++) {
+        for (size_t residue = 0; residue < residues; residue++) {
+            for (size_t last = 0; last < lasts; last++) {
+                size_t from = index_of(mask, residue, last);
+                const State& state = states[from];
+                if (state.offset == kUnreachable) {
+                    continue;
+                }
+                for (size_t i = 0; i < count; i++) {
+                    if (mask & (size_t(1) << i)) {
+                        continue;
+                    }
+                    uint64_t offset = AlignUp(state.offset, std::max<uint64_t>(items[i].alignment, 1)) +
+                                      items[i].size;
+                    size_t next_mask = mask | (size_t(1) << i);
+                    size_t next_residue = static_cast<size_t>(offset % modulus);
+                    relax(index_of(next_mask, next_residue, last), offset, state.kept, from, i);
+                    if (i + 1 > last) {
+                        relax(index_of(next_mask, next_residue, i + 1), offset, state.kept + 1, from, i);
+                    }
+                }
+            }
+        }
+    }
+
+    size_t best = states.size();
+    uint64_t best_size = kUnreachable;
+    for (size_t residue = 0; residue < residues; residue++) {
+        for (size_t last = 0; last < lasts; last++) {
+            size_t at = index_of(full, residue, last);
+            if (states[at].offset == kUnreachable) {
+                continue;
+            }
+            uint64_t size = AlignUp(states[at].offset, modulus);
+            if (size < best_size || (size == best_size && states[at].kept > states[best].kept)) {
+                best = at;
+                best_size = size;
+            }
+        }
+    }
+
+    std::vector<size_t> order;
+    for (size_t at = best; order.size() < count; at = states[at].from) {
+        order.push_back(states[at].item);
+    }
+    std::reverse(order.begin(), order.end());
+
+    solution.order = order;
+    solution.size = best_size;
+    solution.moves = ReorderSolver::CountMoves(order);
+    return true;
+}
+
+} // namespace
+
+uint64_t ReorderSolver::SizeWithOrder(
+    const std::vector<ReorderItem>& items,
+    const std::vector<size_t>& order,
+    uint64_t start_offset,
+    uint64_t struct_alignment
+) {
+    uint64_t offset = start_offset;
+    uint64_t max_alignment = std::max<uint64_t>(struct_alignment, 1);
+
+    for (size_t index : order) {
+        const ReorderItem& item = items[index];
+        offset = AlignUp(offset, item.alignment) + item.size;
+        max_alignment = std::max(max_alignment, item.alignment);
+    }
+
+    // Add tail padding to align to struct alignment
+    return AlignUp(offset, max_alignment);
+}
+
+uint32_t ReorderSolver::CountMoves(const std::vector<size_t>& order) {
+    // Longest increasing subsequence of original indices
+    std::vector<size_t> tails;
+    for (size_t index : order) {
+        auto it = std::lower_bound(tails.begin(), tails.end(), index);
+        if (it == tails.end()) {
+            tails.push_back(index);
+        } else {
+            *it = index;
+        }
+    }
+    return static_cast<uint32_t>(order.size() - tails.size());
+}
+
+ReorderSolution ReorderSolver::Solve(
+    const std::vector<ReorderItem>& input,
+    uint64_t start_offset,
+    uint64_t struct_alignment
+) {
+    // Normalize so every size is a multiple of its alignment; the
+    // knapsack is exact only for such items
+    std::vector<ReorderItem> items = input;
+    uint64_t modulus = std::max<uint64_t>(struct_alignment, 1);
+    uint64_t total_size = 0;
+    for (auto& item : items) {
+        item.alignment = std::max<uint64_t>(item.alignment, 1);
+        item.size = AlignUp(item.size, item.alignment);
+        modulus = std::max(modulus, item.alignment);
+        total_size += item.size;
+    }
+
+    ReorderSolution best;
+    best.order.resize(input.size());
+    for (size_t i = 0; i < input.size(); i++) {
+        best.order[i] = i;
+    }
+    best.size = SizeWithOrder(input, best.order, start_offset, struct_alignment);
+    best.moves = 0;
+
+    if (items.size() < 2) {
+        return best;
+    }
+
+    ReorderSolution exact;
+    if (SolveExactly(input, start_offset, struct_alignment, exact)) {
+        return exact;
+    }
+
+    if (modulus > kMaxTrackedAlignment) {
+        std::vector<size_t> order = BuildOrder(items, std::vector<bool>(items.size(), false));
+        uint64_t size = SizeWithOrder(input, order, start_offset, struct_alignment);
+        if (size < best.size) {
+            best = {order, size, CountMoves(order)};
+        }
+        return best;
+    }
+
+    // Alignment classes, ascending
+    std::vector<uint64_t> alignments;
+    for (const auto& item : items) {
+        alignments.push_back(item.alignment);
+    }
+    std::sort(alignments.begin(), alignments.end());
+    alignments.erase(std::unique(alignments.begin(), alignments.end()), alignments.end());
+
+    std::vector<std::vector<size_t>> classes(alignments.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        size_t level = std::lower_bound(alignments.begin(), alignments.end(), items[i].alignment)
+                       - alignments.begin();
+        classes[level].push_back(i);
+    }
+
+    const size_t residues = static_cast<size_t>(modulus);
+
+    // top = largest alignment left for the descending phase (0 = none left);
+    // everything aligned above it has to go into the filler
+    std::vector<uint64_t> tops = {0};
+    tops.insert(tops.end(), alignments.begin(), alignments.end());
+
+    for (uint64_t top : tops) {
+        std::vector<uint64_t> cost(residues, kUnreachable);
+        cost[start_offset % modulus] = 0;
+        std::vector<LevelTrace> traces(alignments.size());
+
+        for (size_t level = 0; level < alignments.size(); level++) {
+            uint64_t alignment = alignments[level];
+            const std::vector<size_t>& members = classes[level];
+            LevelTrace& trace = traces[level];
+            trace.forced = alignment > top;
+
+            // Pad once to this class's alignment before its first filler item
+            std::vector<uint64_t> entry(residues, kUnreachable);
+            trace.entry_from.assign(residues, 0);
+            for (size_t r = 0; r < residues; r++) {
+                if (cost[r] == kUnreachable) {
+                    continue;
+                }
+                uint64_t pad = PadAt(r, alignment);
+                size_t next = static_cast<size_t>((r + pad) % modulus);
+                if (cost[r] + pad < entry[next]) {
+                    entry[next] = cost[r] + pad;
+                    trace.entry_from[next] = r;
+                }
+            }
+
+            // 0/1 knapsack over (residue, taken-any); no padding inside a class
+            std::vector<uint64_t> state(residues * 2, kUnreachable);
+            for (size_t r = 0; r < residues; r++) {
+                state[r * 2] = entry[r];
+            }
+
+            trace.took.assign(members.size(), std::vector<uint8_t>(residues * 2, 0));
+            for (size_t j = 0; j < members.size(); j++) {
+                uint64_t size = items[members[j]].size;
+                std::vector<uint64_t> next(residues * 2, kUnreachable);
+
+                for (size_t r = 0; r < residues; r++) {
+                    for (size_t flag = 0; flag < 2; flag++) {
+                        uint64_t value = state[r * 2 + flag];
+                        if (value == kUnreachable) {
+                            continue;
+                        }
+
+                        // Leave it for the descending phase
+                        if (!trace.forced && value < next[r * 2 + flag]) {
+                            next[r * 2 + flag] = value;
+                            trace.took[j][r * 2 + flag] = 0;
+                        }
+
+                        // Put it in the filler
+                        size_t taken = static_cast<size_t>((r + size) % modulus) * 2 + 1;
+                        if (value < next[taken]) {
+                            next[taken] = value;
+                            trace.took[j][taken] = static_cast<uint8_t>(1 + flag);
+                        }
+                    }
+                }
+                state.swap(next);
+            }
+
+            // Either the class contributes to the filler or it is skipped
+            trace.used.assign(residues, 0);
+            std::vector<uint64_t> after(residues, kUnreachable);
+            for (size_t r = 0; r < residues; r++) {
+                if (!trace.forced || members.empty()) {
+                    after[r] = cost[r];
+                }
+                if (!members.empty() && state[r * 2 + 1] < after[r]) {
+                    after[r] = state[r * 2 + 1];
+                    trace.used[r] = 1;
+                }
+            }
+            cost.swap(after);
+        }
+
+        for (size_t r = 0; r < residues; r++) {
+            if (cost[r] == kUnreachable) {
+                continue;
+            }
+
+            uint64_t tail_pad = top > 0 ? PadAt(r, top) : 0;
+            uint64_t size = AlignUp(start_offset + total_size + cost[r] + tail_pad, modulus);
+            if (size > best.size) {
+                continue;
+            }
+
+            // Rebuild the filler set by walking the traces backwards
+            std::vector<bool> in_filler(items.size(), false);
+            size_t residue = r;
+            for (size_t level = alignments.size(); level-- > 0;) {
+                const LevelTrace& trace = traces[level];
+                if (!trace.used[residue]) {
+                    continue;
+                }
+
+                const std::vector<size_t>& members = classes[level];
+                size_t flag = 1;
+                for (size_t j = members.size(); j-- > 0;) {
+                    uint8_t choice = trace.took[j][residue * 2 + flag];
+                    if (choice == 0) {
+                        continue;
+                    }
+                    in_filler[members[j]] = true;
+                    uint64_t size_j = items[members[j]].size % modulus;
+                    residue = static_cast<size_t>((residue + modulus - size_j) % modulus);
+                    flag = choice - 1;
+                }
+                residue = static_cast<size_t>(trace.entry_from[residue]);
+            }
+
+            std::vector<size_t> order = BuildOrder(items, in_filler);
+            uint64_t actual = SizeWithOrder(input, order, start_offset, struct_alignment);
+            uint32_t moves = CountMoves(order);
+
+            if (actual < best.size || (actual == best.size && moves < best.moves)) {
+                best = {order, actual, moves};
+            }
+        }
+    }
+
+    // The knapsack fixes the size; a short sequence of single moves may
+    // reach the same size while disturbing fewer members
+    if (best.moves > 1 && items.size() <= kMaxLocalSearchItems) {
+        std::vector<size_t> order = ImproveByMoves(input, start_offset, struct_alignment, best.size);
+        uint64_t size = SizeWithOrder(input, order, start_offset, struct_alignment);
+        uint32_t moves = CountMoves(order);
+        if (size == best.size && moves < best.moves) {
+            best = {order, size, moves};
+        }
+    }
+
+    return best;
+}
+
+} // namespace structsight
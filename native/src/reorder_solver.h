@@ -0,0 +1,64 @@
+#ifndef STRUCTSIGHT_REORDER_SOLVER_H
+#define STRUCTSIGHT_REORDER_SOLVER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace structsight {
+
+// Something that is placed as one piece: a member, or a run of bitfields
+struct ReorderItem {
+    uint64_t size;
+    uint64_t alignment; // Power of two
+};
+
+struct ReorderSolution {
+    std::vector<size_t> order; // Indices into the item list
+    uint64_t size;             // Struct size with this order
+    uint32_t moves;            // Items that leave their original relative order
+};
+
+// Minimum-size member ordering.
+//
+// Structs small enough to enumerate item subsets of (about nine members)
+// are searched exactly over (subset, offset modulo the struct alignment),
+// which gives the minimum size for any sizes, bitfield runs smaller than
+// their alignment included, and among those orders the fewest moves.
+//
+// Larger ones rely on this: with power-of-two alignments and sizes that
+// are multiples of their alignment, some optimal order has two phases: a
+// "filler" subset placed in ascending alignment right after the fixed
+// prefix (vptr, bases), then everything else in descending alignment,
+// which needs no padding at all. The solver picks the filler with a
+// knapsack over the offset modulo the struct alignment, so it runs in
+// O(items * alignment) per alignment class and handles structs with
+// hundreds of fields. Items of other sizes are rounded up to their
+// alignment for the search, so with them the size is only an upper bound.
+// The move count is best effort here: the knapsack's order, improved by
+// single-item moves for structs of up to 64 items.
+class ReorderSolver {
+public:
+    // items are in declaration order; start_offset is where the first item
+    // may go; struct_alignment is the alignment of the whole struct
+    static ReorderSolution Solve(
+        const std::vector<ReorderItem>& items,
+        uint64_t start_offset,
+        uint64_t struct_alignment
+    );
+
+    // Size of the struct when items are placed in `order`
+    static uint64_t SizeWithOrder(
+        const std::vector<ReorderItem>& items,
+        const std::vector<size_t>& order,
+        uint64_t start_offset,
+        uint64_t struct_alignment
+    );
+
+    // Number of items not on a longest run kept in original relative order
+    static uint32_t CountMoves(const std::vector<size_t>& order);
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_REORDER_SOLVER_H
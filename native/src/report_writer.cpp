@@ -0,0 +1,607 @@
+#include "report_writer.h"
+#include <llvm/Support/JSON.h>
+#include <algorithm>
+#include <cstdio>
+
+namespace structsight {
+
+// llvm::json stores integers as int64_t
+static int64_t ToJSON(uint64_t value) {
+    return static_cast<int64_t>(value);
+}
+
+static void WritePadding(llvm::json::OStream& json, const std::vector<PaddingInfo>& paddings) {
+    for (const auto& padding : paddings) {
+        json.object([&] {
+            json.attribute("offset", ToJSON(padding.offset));
+            json.attribute("size", ToJSON(padding.size));
+            json.attribute("reason", padding.reason);
+        });
+    }
+}
+
+static void WriteMember(llvm::json::OStream& json, const MemberInfo& member) {
+    json.object([&] {
+        json.attribute("name", member.name);
+        json.attribute("type", member.type);
+        json.attribute("offset", ToJSON(member.offset));
+        json.attribute("size", ToJSON(member.size));
+        json.attribute("alignment", ToJSON(member.alignment));
+        json.attribute("isBitfield", member.is_bitfield);
+        json.attribute("bitfieldWidth", static_cast<int64_t>(member.bitfield_width));
+        json.attribute("bitfieldOffset", static_cast<int64_t>(member.bitfield_offset));
+        json.attribute("isThreadShared", member.is_thread_shared);
+        json.attribute("isNoUniqueAddress", member.is_no_unique_address);
+        json.attribute("nestedPadding", ToJSON(member.nested_padding));
+        if (!member.children.empty()) {
+            json.attributeArray("children", [&] {
+                for (const auto& child : member.children) {
+                    WriteMember(json, child);
+                }
+            });
+            json.attributeArray("padding", [&] {
+                WritePadding(json, member.padding);
+            });
+        }
+    });
+}
+
+static void WriteLayout(llvm::json::OStream& json, const StructLayout& layout) {
+    json.object([&] {
+        json.attribute("name", layout.name);
+        json.attribute("qualifiedName", layout.qualified_name);
+        json.attribute("totalSize", ToJSON(layout.total_size));
+        json.attribute("alignment", ToJSON(layout.alignment));
+        json.attribute("usefulSize", ToJSON(layout.useful_size));
+        json.attribute("dataSize", ToJSON(layout.data_size));
+        json.attribute("nestedPadding", ToJSON(layout.nested_padding));
+        
+        const ArrayStride& stride = layout.array_stride;
+        json.attributeObject("arrayStride", [&] {
+            json.attribute("elementsPerLine", stride.elements_per_line);
+            json.attribute("elementsPerPage", stride.elements_per_page);
+            json.attribute("elementsPerHugePage", stride.elements_per_huge_page);
+            json.attribute("linesPerElement", stride.lines_per_element);
+            json.attribute("lineStraddle", stride.line_straddle);
+            json.attribute("pageStraddle", stride.page_straddle);
+            json.attribute("hugePageStraddle", stride.huge_page_straddle);
+            json.attribute("shrinkSize", ToJSON(stride.shrink_size));
+            json.attribute("alignedSize", ToJSON(stride.aligned_size));
+        });
+        
+        if (!layout.template_name.empty()) {
+            json.attribute("templateName", layout.template_name);
+            json.attribute("templatePaddingExcess", ToJSON(layout.template_padding_excess));
+        }
+        json.attribute("isPolymorphic", layout.is_polymorphic);
+        json.attribute("isStandardLayout", layout.is_standard_layout);
+        
+        json.attributeArray("members", [&] {
+            for (const auto& member : layout.members) {
+                WriteMember(json, member);
+            }
+        });
+        
+        json.attributeArray("bases", [&] {
+            for (const auto& base : layout.bases) {
+                json.object([&] {
+                    json.attribute("name", base.name);
+                    json.attribute("offset", ToJSON(base.offset));
+                    json.attribute("size", ToJSON(base.size));
+                    json.attribute("alignment", ToJSON(base.alignment));
+                    json.attribute("isVirtual", base.is_virtual);
+                    json.attribute("isEmpty", base.is_empty);
+                    json.attribute("isPrimary", base.is_primary);
+                });
+            }
+        });
+        
+        json.attributeArray("padding", [&] {
+            WritePadding(json, layout.padding);
+        });
+        
+        json.attributeObject("vtable", [&] {
+            json.attribute("pointerOffset", ToJSON(layout.vtable.pointer_offset));
+            json.attribute("hasVirtualBase", layout.vtable.has_virtual_base);
+            json.attributeArray("virtualFunctions", [&] {
+                for (const auto& function : layout.vtable.virtual_functions) {
+                    json.value(function);
+                }
+            });
+            json.attributeArray("vptrs", [&] {
+                for (const auto& vptr : layout.vtable.vptrs) {
+                    json.object([&] {
+                        json.attribute("offset", ToJSON(vptr.offset));
+                        json.attribute("subobject", vptr.subobject);
+                        json.attributeArray("slots", [&] {
+                            for (const auto& slot : vptr.slots) {
+                                json.object([&] {
+                                    json.attribute("index", slot.index);
+                                    json.attribute("kind", slot.kind);
+                                    json.attribute("name", slot.name);
+                                    if (!slot.thunk.empty()) {
+                                        json.attribute("thunk", slot.thunk);
+                                    }
+                                });
+                            }
+                        });
+                    });
+                }
+            });
+            json.attributeArray("virtualBases", [&] {
+                for (const auto& base : layout.vtable.virtual_bases) {
+                    json.object([&] {
+                        json.attribute("name", base.name);
+                        json.attribute("offset", ToJSON(base.offset));
+                        json.attribute("offsetSlot", base.offset_slot);
+                    });
+                }
+            });
+            if (layout.vtable.vbptr_offset >= 0) {
+                json.attribute("vbptrOffset", layout.vtable.vbptr_offset);
+            }
+        });
+        
+        json.attributeArray("optimizations", [&] {
+            for (const auto& opt : layout.optimizations) {
+                json.object([&] {
+                    json.attribute("kind", OptimizationKindName(opt.kind));
+                    json.attribute("description", opt.description);
+                    json.attribute("bytesSaved", ToJSON(opt.bytes_saved));
+                    json.attribute("membersMoved", ToJSON(opt.members_moved));
+                    json.attributeArray("suggestedOrder", [&] {
+                        for (const auto& name : opt.suggested_order) {
+                            json.value(name);
+                        }
+                    });
+                    if (opt.kind == OptimizationKind::HotColdSplit ||
+                        opt.kind == OptimizationKind::CoAccess) {
+                        json.attribute("linesPerAccessBefore", opt.lines_per_access_before);
+                        json.attribute("linesPerAccessAfter", opt.lines_per_access_after);
+                    }
+                    if (opt.kind == OptimizationKind::HotColdSplit) {
+                        json.attributeArray("coldMembers", [&] {
+                            for (const auto& name : opt.cold_members) {
+                                json.value(name);
+                            }
+                        });
+                    }
+                    if (opt.kind == OptimizationKind::FalseSharing) {
+                        json.attributeArray("contendedMembers", [&] {
+                            for (const auto& name : opt.contended_members) {
+                                json.value(name);
+                            }
+                        });
+                    }
+                    if (opt.kind == OptimizationKind::AosToSoa) {
+                        json.attributeArray("loopMembers", [&] {
+                            for (const auto& name : opt.loop_members) {
+                                json.value(name);
+                            }
+                        });
+                        json.attribute("bytesPerIterationBefore", opt.bytes_per_iteration_before);
+                        json.attribute("bytesPerIterationAfter", opt.bytes_per_iteration_after);
+                    }
+                    if (opt.kind == OptimizationKind::Devirtualize) {
+                        json.attributeArray("finalMethods", [&] {
+                            for (const auto& name : opt.final_methods) {
+                                json.value(name);
+                            }
+                        });
+                    }
+                    if (opt.kind == OptimizationKind::PackFlags) {
+                        json.attributeArray("bitfieldMembers", [&] {
+                            for (const auto& name : opt.bitfield_members) {
+                                json.value(name);
+                            }
+                        });
+                        json.attributeArray("bitfieldWidths", [&] {
+                            for (uint32_t width : opt.bitfield_widths) {
+                                json.value(static_cast<int64_t>(width));
+                            }
+                        });
+                    }
+                    if (opt.kind == OptimizationKind::NarrowTypes) {
+                        json.attributeArray("narrowedMembers", [&] {
+                            for (const auto& name : opt.narrowed_members) {
+                                json.value(name);
+                            }
+                        });
+                        json.attributeArray("narrowedTypes", [&] {
+                            for (const auto& type : opt.narrowed_types) {
+                                json.value(type);
+                            }
+                        });
+                    }
+                    if (opt.kind == OptimizationKind::NestedReorder) {
+                        json.attribute("nestedMember", opt.nested_member);
+                        json.attribute("nestedType", opt.nested_type);
+                    }
+                });
+            }
+        });
+    });
+}
+
+void ReportWriter::WriteJSON(
+    llvm::raw_ostream& out,
+    const std::vector<StructLayout>& layouts,
+    const std::vector<ReportError>& errors
+) {
+    llvm::json::OStream json(out, 2);
+    
+    json.object([&] {
+        json.attributeArray("layouts", [&] {
+            for (const auto& layout : layouts) {
+                WriteLayout(json, layout);
+            }
+        });
+        
+        json.attributeArray("errors", [&] {
+            for (const auto& error : errors) {
+                json.object([&] {
+                    json.attribute("file", error.file);
+                    json.attribute("message", error.message);
+                });
+            }
+        });
+    });
+    
+    out << "\n";
+}
+
+// Quote a CSV field if it contains a separator, quote or newline
+static std::string CSVField(const std::string& value) {
+    if (value.find_first_of(",\"\n") == std::string::npos) {
+        return value;
+    }
+    
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+static void WriteCSVRow(
+    llvm::raw_ostream& out,
+    const std::string& record,
+    const char* kind,
+    const std::string& name,
+    const std::string& type,
+    uint64_t offset,
+    uint64_t size,
+    uint64_t alignment,
+    const std::string& detail
+) {
+    out << CSVField(record) << ',' << kind << ',' << CSVField(name) << ','
+        << CSVField(type) << ',' << offset << ',' << size << ','
+        << alignment << ',' << CSVField(detail) << '\n';
+}
+
+void ReportWriter::WriteCSV(
+    llvm::raw_ostream& out,
+    const std::vector<StructLayout>& layouts
+) {
+    out << "record,kind,name,type,offset,size,alignment,detail\n";
+    
+    for (const auto& layout : layouts) {
+        const std::string& record = layout.qualified_name;
+        
+        std::string struct_detail = layout.is_polymorphic ? "polymorphic" : "";
+        if (!layout.template_name.empty()) {
+            struct_detail += struct_detail.empty() ? "" : " ";
+            struct_detail += "template:" + layout.template_name +
+                             " paddingExcess:" + std::to_string(layout.template_padding_excess);
+        }
+        if (layout.array_stride.line_straddle > 0) {
+            char stride[64];
+            std::snprintf(stride, sizeof(stride), "linesPerElement:%.3f lineStraddle:%.3f",
+                          layout.array_stride.lines_per_element, layout.array_stride.line_straddle);
+            struct_detail += struct_detail.empty() ? "" : " ";
+            struct_detail += stride;
+        }
+        WriteCSVRow(out, record, "struct", layout.name, "", 0,
+                    layout.total_size, layout.alignment, struct_detail);
+        
+        for (const auto& member : layout.members) {
+            std::string detail = member.is_bitfield
+                ? "bitfield:" + std::to_string(member.bitfield_width)
+                : "";
+            if (member.is_thread_shared) {
+                detail += detail.empty() ? "threadShared" : " threadShared";
+            }
+            if (member.is_no_unique_address) {
+                detail += detail.empty() ? "noUniqueAddress" : " noUniqueAddress";
+            }
+            if (member.nested_padding > 0) {
+                std::string nested = "nestedPadding:" + std::to_string(member.nested_padding);
+                detail += detail.empty() ? nested : " " + nested;
+            }
+            WriteCSVRow(out, record, "member", member.name, member.type,
+                        member.offset, member.size, member.alignment, detail);
+        }
+        
+        for (const auto& base : layout.bases) {
+            std::string detail = base.is_virtual ? "virtual" : "";
+            if (base.is_empty) {
+                detail += detail.empty() ? "empty" : " empty";
+            }
+            if (base.is_primary) {
+                detail += detail.empty() ? "primary" : " primary";
+            }
+            WriteCSVRow(out, record, "base", base.name, base.name, base.offset,
+                        base.size, base.alignment, detail);
+        }
+        
+        for (const auto& padding : layout.padding) {
+            WriteCSVRow(out, record, "padding", "", "", padding.offset,
+                        padding.size, 0, padding.reason);
+        }
+        
+        // Table entries at or after the address point, in slot order
+        for (const auto& vptr : layout.vtable.vptrs) {
+            std::string slots;
+            for (const auto& slot : vptr.slots) {
+                if (slot.index >= 0) {
+                    slots += (slots.empty() ? "" : "; ") + slot.name;
+                }
+            }
+            WriteCSVRow(out, record, "vptr", vptr.subobject, "", vptr.offset, 0, 0, slots);
+        }
+        
+        for (const auto& base : layout.vtable.virtual_bases) {
+            WriteCSVRow(out, record, "virtualBase", base.name, "", base.offset, 0, 0,
+                        "offsetSlot:" + std::to_string(base.offset_slot));
+        }
+        
+        for (const auto& opt : layout.optimizations) {
+            std::string order;
+            for (const auto& name : opt.suggested_order) {
+                order += order.empty() ? name : " " + name;
+            }
+            if (!opt.cold_members.empty()) {
+                // Out-of-line members follow a "|"
+                order += " |";
+                for (const auto& name : opt.cold_members) {
+                    order += " " + name;
+                }
+            }
+            for (const auto& name : opt.contended_members) {
+                order += order.empty() ? name : " " + name;
+            }
+            for (const auto& name : opt.loop_members) {
+                order += order.empty() ? name : " " + name;
+            }
+            // Signatures hold spaces of their own
+            for (const auto& name : opt.final_methods) {
+                order += order.empty() ? name : "; " + name;
+            }
+            if (!opt.bitfield_members.empty()) {
+                // Members that become bitfields follow a "|" as name:width
+                order += " |";
+                for (size_t i = 0; i < opt.bitfield_members.size(); i++) {
+                    order += " " + opt.bitfield_members[i] + ":" +
+                             std::to_string(i < opt.bitfield_widths.size() ? opt.bitfield_widths[i] : 0);
+                }
+            }
+            if (!opt.narrowed_members.empty()) {
+                // Narrowed members follow a "|" as name:type
+                order += " |";
+                for (size_t i = 0; i < opt.narrowed_members.size(); i++) {
+                    order += " " + opt.narrowed_members[i] + ":" +
+                             (i < opt.narrowed_types.size() ? opt.narrowed_types[i] : "");
+                }
+            }
+            WriteCSVRow(out, record, "optimization", opt.description,
+                        OptimizationKindName(opt.kind), 0,
+                        opt.bytes_saved, 0, order);
+        }
+    }
+}
+
+static const char* ChangeKindName(LayoutChange::Kind kind) {
+    switch (kind) {
+        case LayoutChange::Kind::Added:
+            return "added";
+        case LayoutChange::Kind::Removed:
+            return "removed";
+        case LayoutChange::Kind::Changed:
+        default:
+            return "changed";
+    }
+}
+
+void ReportWriter::WriteChangesJSON(
+    llvm::raw_ostream& out,
+    const std::string& target,
+    const std::vector<LayoutChange>& changes,
+    const std::vector<ReportError>& errors
+) {
+    llvm::json::OStream json(out, 2);
+    
+    int64_t regressions = std::count_if(changes.begin(), changes.end(),
+        [](const LayoutChange& change) { return change.IsRegression(); });
+    
+    json.object([&] {
+        json.attribute("target", target);
+        json.attribute("regressions", regressions);
+        json.attributeArray("changes", [&] {
+            for (const auto& change : changes) {
+                json.object([&] {
+                    json.attribute("qualifiedName", change.qualified_name);
+                    json.attribute("change", ChangeKindName(change.kind));
+                    json.attribute("regression", change.IsRegression());
+                    json.attribute("sizeBefore", ToJSON(change.size_before));
+                    json.attribute("sizeAfter", ToJSON(change.size_after));
+                    json.attribute("alignmentBefore", ToJSON(change.alignment_before));
+                    json.attribute("alignmentAfter", ToJSON(change.alignment_after));
+                    json.attribute("paddingBefore", ToJSON(change.padding_before));
+                    json.attribute("paddingAfter", ToJSON(change.padding_after));
+                    json.attribute("cacheLinesBefore", ToJSON(change.lines_before));
+                    json.attribute("cacheLinesAfter", ToJSON(change.lines_after));
+                    json.attributeArray("newCacheLineCrossings", [&] {
+                        for (const auto& name : change.new_crossings) {
+                            json.value(name);
+                        }
+                    });
+                    json.attributeArray("movedMembers", [&] {
+                        for (const auto& name : change.moved_members) {
+                            json.value(name);
+                        }
+                    });
+                });
+            }
+        });
+        
+        json.attributeArray("errors", [&] {
+            for (const auto& error : errors) {
+                json.object([&] {
+                    json.attribute("file", error.file);
+                    json.attribute("message", error.message);
+                });
+            }
+        });
+    });
+    
+    out << "\n";
+}
+
+void ReportWriter::WriteChangesCSV(
+    llvm::raw_ostream& out,
+    const std::vector<LayoutChange>& changes
+) {
+    out << "record,change,regression,sizeBefore,sizeAfter,paddingBefore,paddingAfter,"
+           "cacheLinesBefore,cacheLinesAfter,detail\n";
+    
+    for (const auto& change : changes) {
+        std::string detail;
+        for (const auto& name : change.new_crossings) {
+            detail += detail.empty() ? "" : " ";
+            detail += "crosses:" + name;
+        }
+        for (const auto& name : change.moved_members) {
+            detail += detail.empty() ? "" : " ";
+            detail += "moved:" + name;
+        }
+        out << CSVField(change.qualified_name) << ',' << ChangeKindName(change.kind) << ','
+            << (change.IsRegression() ? "yes" : "no") << ','
+            << change.size_before << ',' << change.size_after << ','
+            << change.padding_before << ',' << change.padding_after << ','
+            << change.lines_before << ',' << change.lines_after << ','
+            << CSVField(detail) << '\n';
+    }
+}
+
+void ReportWriter::WriteMatrixJSON(
+    llvm::raw_ostream& out,
+    const std::vector<std::string>& targets,
+    const std::vector<MatrixRecord>& records,
+    const std::vector<ReportError>& errors
+) {
+    llvm::json::OStream json(out, 2);
+    
+    int64_t divergent = std::count_if(records.begin(), records.end(),
+        [](const MatrixRecord& record) { return record.diverges; });
+    
+    json.object([&] {
+        json.attributeArray("targets", [&] {
+            for (const auto& target : targets) {
+                json.value(target);
+            }
+        });
+        json.attribute("divergent", divergent);
+        json.attributeArray("records", [&] {
+            for (const auto& record : records) {
+                json.object([&] {
+                    json.attribute("qualifiedName", record.qualified_name);
+                    json.attribute("diverges", record.diverges);
+                    json.attributeArray("targets", [&] {
+                        for (const auto& placement : record.targets) {
+                            json.object([&] {
+                                json.attribute("present", placement.present);
+                                json.attribute("size", ToJSON(placement.size));
+                                json.attribute("alignment", ToJSON(placement.alignment));
+                            });
+                        }
+                    });
+                    json.attributeArray("members", [&] {
+                        for (const auto& member : record.members) {
+                            json.object([&] {
+                                json.attribute("name", member.name);
+                                json.attribute("diverges", member.diverges);
+                                json.attributeArray("targets", [&] {
+                                    for (const auto& placement : member.targets) {
+                                        json.object([&] {
+                                            json.attribute("present", placement.present);
+                                            json.attribute("offset", ToJSON(placement.offset));
+                                            json.attribute("bitOffset", static_cast<int64_t>(placement.bit_offset));
+                                            json.attribute("size", ToJSON(placement.size));
+                                        });
+                                    }
+                                });
+                            });
+                        }
+                    });
+                });
+            }
+        });
+        
+        json.attributeArray("errors", [&] {
+            for (const auto& error : errors) {
+                json.object([&] {
+                    json.attribute("file", error.file);
+                    json.attribute("message", error.message);
+                });
+            }
+        });
+    });
+    
+    out << "\n";
+}
+
+void ReportWriter::WriteMatrixCSV(
+    llvm::raw_ostream& out,
+    const std::vector<std::string>& targets,
+    const std::vector<MatrixRecord>& records
+) {
+    out << "record,member,diverges";
+    for (const auto& target : targets) {
+        out << ',' << CSVField(target);
+    }
+    out << '\n';
+    
+    for (const auto& record : records) {
+        out << CSVField(record.qualified_name) << ",," << (record.diverges ? "yes" : "no");
+        for (const auto& placement : record.targets) {
+            out << ',';
+            if (placement.present) {
+                out << placement.size << '/' << placement.alignment;
+            }
+        }
+        out << '\n';
+        
+        for (const auto& member : record.members) {
+            out << CSVField(record.qualified_name) << ',' << CSVField(member.name) << ','
+                << (member.diverges ? "yes" : "no");
+            for (const auto& placement : member.targets) {
+                out << ',';
+                if (!placement.present) {
+                    continue;
+                }
+                out << placement.offset;
+                if (placement.bit_offset) {
+                    out << '.' << placement.bit_offset;
+                }
+                out << ':' << placement.size;
+            }
+            out << '\n';
+        }
+    }
+}
+
+} // namespace structsight
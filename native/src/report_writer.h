@@ -0,0 +1,73 @@
+#ifndef STRUCTSIGHT_REPORT_WRITER_H
+#define STRUCTSIGHT_REPORT_WRITER_H
+
+#include "types.h"
+#include "layout_baseline.h"
+#include <llvm/Support/raw_ostream.h>
+#include <string>
+#include <vector>
+
+namespace structsight {
+
+// A file that could not be analyzed, reported next to the layouts
+struct ReportError {
+    std::string file;
+    std::string message;
+};
+
+// Machine-readable reports for the CLI. Field names match the objects the
+// addon hands to JavaScript, so tooling can consume either.
+class ReportWriter {
+public:
+    // { "layouts": [...], "errors": [...] }
+    static void WriteJSON(
+        llvm::raw_ostream& out,
+        const std::vector<StructLayout>& layouts,
+        const std::vector<ReportError>& errors
+    );
+    
+    // One row per record, member, padding region and optimization:
+    // record,kind,name,type,offset,size,alignment,detail
+    static void WriteCSV(
+        llvm::raw_ostream& out,
+        const std::vector<StructLayout>& layouts
+    );
+    
+    // { "target": ..., "regressions": n, "changes": [...], "errors": [...] }
+    static void WriteChangesJSON(
+        llvm::raw_ostream& out,
+        const std::string& target,
+        const std::vector<LayoutChange>& changes,
+        const std::vector<ReportError>& errors
+    );
+    
+    // One row per changed record:
+    // record,change,regression,sizeBefore,sizeAfter,paddingBefore,
+    // paddingAfter,cacheLinesBefore,cacheLinesAfter,detail
+    static void WriteChangesCSV(
+        llvm::raw_ostream& out,
+        const std::vector<LayoutChange>& changes
+    );
+    
+    // { "targets": [...], "divergent": n, "records": [...], "errors": [...] },
+    // every placement listed by target index
+    static void WriteMatrixJSON(
+        llvm::raw_ostream& out,
+        const std::vector<std::string>& targets,
+        const std::vector<MatrixRecord>& records,
+        const std::vector<ReportError>& errors
+    );
+    
+    // One row per record (size/alignment per target) and member
+    // (offset:size, or offset.bit:size for bitfields; empty if absent):
+    // record,member,diverges,<target>...
+    static void WriteMatrixCSV(
+        llvm::raw_ostream& out,
+        const std::vector<std::string>& targets,
+        const std::vector<MatrixRecord>& records
+    );
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_REPORT_WRITER_H
@@ -0,0 +1,99 @@
+#include "session.h"
+
+namespace structsight {
+
+Session::Session(PreambleCache* preamble_cache, LayoutCache* layout_cache)
+    : preamble_cache_(preamble_cache), analyzer_(preamble_cache, layout_cache), version_(-1) {}
+
+bool Session::NeedsReparse(const AnalysisRequest& request, int64_t version) const {
+    if (version_ < 0 || version != version_) {
+        return true;
+    }
+    
+    // A settings change invalidates the AST even at the same version
+    return request.file_path != document_.file_path ||
+           request.architecture != document_.architecture ||
+           request.compiler != document_.compiler ||
+           request.target_triple != document_.target_triple ||
+           request.compile_flags != document_.compile_flags;
+}
+
+AnalysisResult Session::Update(const AnalysisRequest& request, int64_t version, bool& reparsed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    AnalysisResult result;
+    result.success = true;
+    reparsed = false;
+    
+    if (!NeedsReparse(request, version)) {
+        return result;
+    }
+    
+    // The parse happens on the first query the layout cache misses
+    unit_.reset();
+    document_ = request;
+    document_.cancellation.reset();
+    version_ = version;
+    
+    reparsed = true;
+    return result;
+}
+
+AnalysisResult Session::Query(const AnalysisRequest& request) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto start = std::chrono::steady_clock::now();
+    
+    AnalysisResult result;
+    result.success = false;
+    
+    if (version_ < 0) {
+        result.error_message = "Session has no parsed document";
+        return result;
+    }
+    
+    // Layout options come from the document; the query picks the records
+    AnalysisRequest query = document_;
+    query.struct_name = request.struct_name;
+    query.target_line = request.target_line;
+    query.target_column = request.target_column;
+    query.include_system_headers = request.include_system_headers;
+    query.include_template_instantiations = request.include_template_instantiations;
+    query.path_filter = request.path_filter;
+    query.profile = request.profile;
+    query.cache_line_size = request.cache_line_size;
+    query.collect_stats = request.collect_stats;
+    query.cancellation = request.cancellation;
+    
+    if (!analyzer_.AnalyzeCached(query, result)) {
+        if (!unit_) {
+            unit_ = analyzer_.Parse(query, result);
+        }
+        if (unit_) {
+            result = analyzer_.AnalyzeUnit(*unit_, query);
+            analyzer_.CacheResult(query, *unit_, result);
+        }
+    }
+    
+    if (result.stats) {
+        result.stats->total_ms = MillisecondsSince(start);
+    }
+    return result;
+}
+
+int64_t Session::GetVersion() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return version_;
+}
+
+void Session::Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Analyzer::Parse keys an unnamed document as input.cpp
+    if (preamble_cache_ && version_ >= 0) {
+        preamble_cache_->Invalidate(document_.file_path.empty() ? "input.cpp" : document_.file_path);
+    }
+    unit_.reset();
+    document_ = AnalysisRequest();
+    version_ = -1;
+}
+
+} // namespace structsight
@@ -0,0 +1,51 @@
+#ifndef STRUCTSIGHT_SESSION_H
+#define STRUCTSIGHT_SESSION_H
+
+#include "types.h"
+#include "analyzer.h"
+#include <memory>
+#include <mutex>
+
+namespace structsight {
+
+// Holds the parsed AST of one open document. The document is reparsed only
+// when its version (or the target/flags) changes; every query in between
+// runs against the same AST.
+//
+// Parsing is deferred to the first query that the layout cache (if any)
+// can't answer, so a document whose results are all cached is never parsed.
+class Session {
+public:
+    explicit Session(PreambleCache* preamble_cache = nullptr, LayoutCache* layout_cache = nullptr);
+    
+    // Make the session reflect `request.source_code` at `version`.
+    // `reparsed` is true when the document changed and its AST was dropped.
+    // request.cancellation is not kept: each query brings its own.
+    AnalysisResult Update(const AnalysisRequest& request, int64_t version, bool& reparsed);
+    
+    // Analyze the records selected by request (struct_name, target location
+    // and file filters), from the layout cache or the document's AST.
+    // request.cancellation cancels only this query, including the parse it
+    // triggers; a cancelled parse is retried by the next query.
+    AnalysisResult Query(const AnalysisRequest& request);
+    
+    // Version of the document currently held, -1 if there is none
+    int64_t GetVersion() const;
+    
+    // Release the document, its AST and the file's cached preamble
+    void Close();
+    
+private:
+    mutable std::mutex mutex_;
+    PreambleCache* preamble_cache_;
+    Analyzer analyzer_;
+    std::unique_ptr<ParsedUnit> unit_; // Null until a query needs it
+    AnalysisRequest document_;         // Source and settings of the current version
+    int64_t version_;
+    
+    bool NeedsReparse(const AnalysisRequest& request, int64_t version) const;
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_SESSION_H
@@ -0,0 +1,217 @@
+#include "target_matrix.h"
+#include "analyzer.h"
+#include "thread_pool.h"
+#include <llvm/ADT/Triple.h>
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
+namespace structsight {
+
+namespace {
+
+bool SamePlacement(const TargetPlacement& a, const TargetPlacement& b) {
+    return a.present == b.present && a.offset == b.offset && a.bit_offset == b.bit_offset &&
+           a.size == b.size && a.alignment == b.alignment;
+}
+
+// Whether `placements` differ on any of the analyzed targets (and, for
+// members, on those where the record itself is present)
+bool Diverges(
+    const std::vector<TargetPlacement>& placements,
+    const std::vector<bool>& compared
+) {
+    const TargetPlacement* reference = nullptr;
+    for (size_t i = 0; i < placements.size(); i++) {
+        if (!compared[i]) {
+            continue;
+        }
+        if (!reference) {
+            reference = &placements[i];
+        } else if (!SamePlacement(*reference, placements[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+TargetMatrix::TargetMatrix(LayoutCache* layout_cache)
+    : layout_cache_(layout_cache) {}
+
+bool TargetMatrix::ApplyTriple(const std::string& triple, AnalysisRequest& request) {
+    llvm::Triple parsed(llvm::Triple::normalize(triple));
+    if (parsed.getArch() == llvm::Triple::UnknownArch) {
+        return false;
+    }
+
+    request.target_triple = parsed.str();
+    request.architecture = parsed.isArch64Bit() ? Architecture::X64 : Architecture::X86;
+
+    // The triple decides between the Microsoft and Itanium record layouts
+    if (parsed.isWindowsMSVCEnvironment()) {
+        request.compiler = Compiler::MSVC;
+    } else if (request.compiler == Compiler::MSVC) {
+        request.compiler = Compiler::Clang;
+    }
+    return true;
+}
+
+TargetMatrixResult TargetMatrix::Analyze(const TargetMatrixRequest& request) {
+    TargetMatrixResult result;
+    size_t count = request.targets.size();
+    if (count == 0) {
+        result.error_message = "No targets given";
+        return result;
+    }
+
+    std::vector<AnalysisRequest> requests(count, request.analysis);
+    result.targets.resize(count);
+    result.target_errors.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        if (ApplyTriple(request.targets[i], requests[i])) {
+            result.targets[i] = requests[i].target_triple;
+        } else {
+            result.targets[i] = request.targets[i];
+            result.target_errors[i] = "Unknown target triple";
+        }
+    }
+
+    // Written by one task each, so no locking; char because vector<bool>
+    // packs neighbouring targets into the same word
+    std::vector<std::vector<StructLayout>> layouts(count);
+    std::vector<char> succeeded(count, 0);
+
+    {
+        unsigned threads = request.thread_count;
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        ThreadPool pool(static_cast<unsigned>(std::min<size_t>(threads, count)));
+
+        for (size_t i = 0; i < count; i++) {
+            if (!result.target_errors[i].empty()) {
+                continue;
+            }
+            pool.Submit([&, i]() {
+                // One preamble per file path, so targets would evict each other's
+                Analyzer analyzer(nullptr, layout_cache_);
+                AnalysisResult target_result = analyzer.Analyze(requests[i]);
+                if (target_result.success) {
+                    layouts[i] = std::move(target_result.layouts);
+                    succeeded[i] = 1;
+                } else {
+                    result.target_errors[i] = target_result.error_message;
+                }
+            });
+        }
+
+        pool.Wait();
+    }
+
+    const CancellationFlag& cancellation = request.analysis.cancellation;
+    if (cancellation && cancellation->load()) {
+        result.cancelled = true;
+        result.error_message = "Analysis cancelled";
+        return result;
+    }
+
+    std::vector<bool> analyzed(count);
+    for (size_t i = 0; i < count; i++) {
+        analyzed[i] = succeeded[i] != 0;
+        if (!analyzed[i] && result.target_errors[i].empty()) {
+            result.target_errors[i] = "Analysis failed";
+        }
+    }
+
+    if (std::none_of(analyzed.begin(), analyzed.end(), [](bool ok) { return ok; })) {
+        result.error_message = "No target could be analyzed";
+        return result;
+    }
+
+    result.records = Build(layouts, analyzed);
+    result.success = true;
+    return result;
+}
+
+std::vector<MatrixRecord> TargetMatrix::Build(
+    const std::vector<std::vector<StructLayout>>& layouts,
+    const std::vector<bool>& analyzed
+) {
+    size_t count = layouts.size();
+    std::map<std::string, MatrixRecord> records; // By qualified name
+
+    // Per record: member key -> index into MatrixRecord::members. Unnamed
+    // members (bitfield padding, anonymous unions) are told apart by their
+    // position among members of the same name.
+    std::map<std::string, std::unordered_map<std::string, size_t>> member_indices;
+
+    for (size_t target = 0; target < count; target++) {
+        for (const auto& layout : layouts[target]) {
+            MatrixRecord& record = records[layout.qualified_name];
+            if (record.targets.empty()) {
+                record.qualified_name = layout.qualified_name;
+                record.targets.resize(count);
+            }
+
+            // Headers can yield the same record twice; the first one wins
+            TargetPlacement& placement = record.targets[target];
+            if (placement.present) {
+                continue;
+            }
+            placement.present = true;
+            placement.size = layout.total_size;
+            placement.alignment = layout.alignment;
+
+            auto& indices = member_indices[layout.qualified_name];
+            std::unordered_map<std::string, unsigned> occurrences;
+            for (const auto& member : layout.members) {
+                std::string key = member.name + '#' + std::to_string(occurrences[member.name]++);
+                auto inserted = indices.emplace(key, record.members.size());
+                if (inserted.second) {
+                    MatrixMember matrix_member;
+                    matrix_member.name = member.name;
+                    matrix_member.targets.resize(count);
+                    record.members.push_back(std::move(matrix_member));
+                }
+
+                TargetPlacement& member_placement = record.members[inserted.first->second].targets[target];
+                member_placement.present = true;
+                member_placement.offset = member.offset;
+                member_placement.bit_offset = member.is_bitfield ? member.bitfield_offset : 0;
+                member_placement.size = member.size;
+                member_placement.alignment = member.alignment;
+            }
+        }
+    }
+
+    std::vector<MatrixRecord> result;
+    result.reserve(records.size());
+    for (auto& entry : records) {
+        MatrixRecord& record = entry.second;
+        record.diverges = Diverges(record.targets, analyzed);
+
+        // Members are compared where the record exists at all
+        std::vector<bool> compared(count);
+        for (size_t i = 0; i < count; i++) {
+            compared[i] = analyzed[i] && record.targets[i].present;
+        }
+        for (auto& member : record.members) {
+            // Offsets and sizes decide compatibility; a member's own
+            // alignment may differ (long long on i386) without moving it
+            std::vector<TargetPlacement> placements = member.targets;
+            for (auto& placement : placements) {
+                placement.alignment = 0;
+            }
+            member.diverges = Diverges(placements, compared);
+            record.diverges = record.diverges || member.diverges;
+        }
+
+        result.push_back(std::move(record));
+    }
+    return result;
+}
+
+} // namespace structsight
@@ -0,0 +1,40 @@
+#ifndef STRUCTSIGHT_TARGET_MATRIX_H
+#define STRUCTSIGHT_TARGET_MATRIX_H
+
+#include "types.h"
+#include "layout_cache.h"
+#include <string>
+#include <vector>
+
+namespace structsight {
+
+// Analyzes one source for several target triples in parallel (one parse
+// per target on a thread pool) and lines the layouts up record by record
+// and member by member, so structs shared between e.g. x86-64 and AArch64
+// processes can be checked for ABI differences.
+class TargetMatrix {
+public:
+    // layout_cache is optional; targets whose results it holds aren't parsed
+    explicit TargetMatrix(LayoutCache* layout_cache = nullptr);
+
+    TargetMatrixResult Analyze(const TargetMatrixRequest& request);
+
+    // Set request.target_triple to the normalized `triple`, and the
+    // architecture and layout rules the rest of the engine uses to match
+    // it. Returns false if the triple names no known architecture.
+    static bool ApplyTriple(const std::string& triple, AnalysisRequest& request);
+
+    // The matrix of per-target layouts; `analyzed` says which targets
+    // parsed, and only those are compared
+    static std::vector<MatrixRecord> Build(
+        const std::vector<std::vector<StructLayout>>& layouts,
+        const std::vector<bool>& analyzed
+    );
+
+private:
+    LayoutCache* layout_cache_;
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_TARGET_MATRIX_H
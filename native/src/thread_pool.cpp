@@ -0,0 +1,76 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace structsight {
+
+ThreadPool::ThreadPool(unsigned thread_count)
+    : pending_(0), stopping_(false) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    
+    for (unsigned i = 0; i < thread_count; i++) {
+        threads_.emplace_back([this]() { WorkerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_available_.notify_all();
+    
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+        pending_++;
+    }
+    work_available_.notify_one();
+}
+
+void ThreadPool::Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    all_done_.wait(lock, [this]() { return pending_ == 0; });
+}
+
+unsigned ThreadPool::GetThreadCount() const {
+    return static_cast<unsigned>(threads_.size());
+}
+
+void ThreadPool::WorkerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_available_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+            
+            if (tasks_.empty()) {
+                return; // Stopping and nothing left to do
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        
+        try {
+            task();
+        } catch (...) {
+            // A failing task must not take the pool down
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0) {
+                all_done_.notify_all();
+            }
+        }
+    }
+}
+
+} // namespace structsight
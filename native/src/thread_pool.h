@@ -0,0 +1,52 @@
+#ifndef STRUCTSIGHT_THREAD_POOL_H
+#define STRUCTSIGHT_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace structsight {
+
+// Fixed-size thread pool over one FIFO queue. Tasks (translation units,
+// target triples) are independent and never submit tasks of their own, so
+// workers take the next one and sleep on a condition variable until one is
+// queued.
+class ThreadPool {
+public:
+    // thread_count = 0 uses one thread per hardware thread
+    explicit ThreadPool(unsigned thread_count = 0);
+    
+    // Finishes all queued tasks, then joins the workers
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    // Queue a task. Exceptions thrown by the task are swallowed.
+    void Submit(std::function<void()> task);
+    
+    // Block until every submitted task has finished
+    void Wait();
+    
+    unsigned GetThreadCount() const;
+    
+private:
+    std::vector<std::thread> threads_;
+    
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable all_done_;
+    std::deque<std::function<void()>> tasks_;
+    size_t pending_;     // Tasks queued or running
+    bool stopping_;
+    
+    void WorkerLoop();
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_THREAD_POOL_H
@@ -4,9 +4,16 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
 
 namespace structsight {
 
+class FieldProfile;
+
 // Architecture type
 enum class Architecture {
     X86,    // 32-bit
@@ -20,6 +27,16 @@ enum class Compiler {
     MSVC
 };
 
+// Cache line size assumed unless the request says otherwise
+const uint32_t kDefaultCacheLineSize = 64;
+
+// Padding region
+struct PaddingInfo {
+    uint64_t offset;        // Where padding starts
+    uint64_t size;          // How many bytes of padding
+    std::string reason;     // Why padding exists (alignment, end-padding, etc.)
+};
+
 // Member information
 struct MemberInfo {
     std::string name;
@@ -30,20 +47,162 @@ struct MemberInfo {
     bool is_bitfield;       // Is this a bit field?
     uint32_t bitfield_width; // Width in bits (if bitfield)
     uint32_t bitfield_offset; // Bit offset within byte
+    bool is_thread_shared = false; // Atomic, lock or marked as written by several threads
+    bool is_no_unique_address = false; // [[no_unique_address]]; size 0 if it takes no storage
+    
+    // Members of record type (or arrays of one): the record's own members
+    // and padding, at offsets within the member (within one element for
+    // arrays), expanded a few levels deep
+    std::vector<MemberInfo> children;
+    std::vector<PaddingInfo> padding;
+    // Padding bytes inside the member at every level, all elements counted
+    uint64_t nested_padding = 0;
 };
 
-// Padding region
-struct PaddingInfo {
-    uint64_t offset;        // Where padding starts
-    uint64_t size;          // How many bytes of padding
-    std::string reason;     // Why padding exists (alignment, end-padding, etc.)
+// A base class subobject
+struct BaseInfo {
+    std::string name;
+    uint64_t offset;
+    uint64_t size;       // Bytes it holds data in; members of the record may follow
+                         // inside the rest of its sizeof. 0 for an empty base.
+    uint64_t alignment;
+    bool is_virtual = false;
+    bool is_empty = false;   // Takes no storage (empty base optimization)
+    bool is_primary = false; // Shares the record's vptr
+};
+
+// One entry of a virtual table. Indices count from the address point the
+// vptr holds; the Itanium offset-to-top, RTTI and vcall/vbase offset
+// entries sit in front of it at negative indices.
+struct VTableSlot {
+    int64_t index;
+    std::string kind;  // function, completeDtor, deletingDtor, unusedFunction,
+                       // offsetToTop, rtti, vcallOffset, vbaseOffset
+    std::string name;  // Function ("Base::draw"), RTTI class, or the offset in bytes
+    std::string thunk; // Adjustment made before the call, if the slot holds a thunk
+};
+
+// A vptr stored in the object and the table it points at
+struct VPointerInfo {
+    uint64_t offset;        // Where the vptr is stored
+    std::string subobject;  // Class whose vptr it is (the record itself for the primary one)
+    std::vector<VTableSlot> slots;
+};
+
+// A virtual base and how the object finds it at run time
+struct VirtualBaseInfo {
+    std::string name;
+    uint64_t offset;     // Offset in the complete object
+    int64_t offset_slot; // Itanium: byte offset of its vbase offset entry from the
+                         // primary address point; Microsoft: vbtable index
 };
 
 // Virtual table information
 struct VTableInfo {
-    uint64_t pointer_offset; // Offset of vptr in object
-    std::vector<std::string> virtual_functions; // List of virtual functions
-    bool has_virtual_base;   // Has virtual base classes
+    uint64_t pointer_offset = 0; // Offset of the first vptr in object
+    std::vector<std::string> virtual_functions; // Signatures of virtual functions, in slot order
+    bool has_virtual_base = false; // Has virtual base classes
+    
+    std::vector<VPointerInfo> vptrs;          // By offset
+    std::vector<VirtualBaseInfo> virtual_bases;
+    int64_t vbptr_offset = -1;                // Microsoft ABI virtual base table pointer; -1 = none
+};
+
+// What an optimization suggestion is about
+enum class OptimizationKind {
+    Reorder,        // Reorder members to remove padding
+    CacheLineSplit, // A member straddles a cache line boundary
+    HotColdSplit,   // Move rarely accessed members out of line (needs a profile)
+    FalseSharing,   // Thread-shared members can land on one cache line
+    CoAccess,       // Keep fields used together on one cache line
+    AosToSoa,       // Arrays of the record whose loops read few fields
+    Devirtualize,   // Adding `final` lets virtual calls be devirtualized
+    PackFlags,      // Fold bool and small enum members into bitfields
+    NarrowTypes,    // Enum and bounded integer members fit smaller types
+    NestedReorder,  // Reordering a nested record's members shrinks this one
+    ArrayStride     // Array elements straddle cache lines; a size or alignas fixes it
+};
+
+// Name used for the kind in JS objects and reports
+inline const char* OptimizationKindName(OptimizationKind kind) {
+    switch (kind) {
+        case OptimizationKind::Reorder:
+            return "reorder";
+        case OptimizationKind::CacheLineSplit:
+            return "cacheLineSplit";
+        case OptimizationKind::HotColdSplit:
+            return "hotColdSplit";
+        case OptimizationKind::FalseSharing:
+            return "falseSharing";
+        case OptimizationKind::CoAccess:
+            return "coAccess";
+        case OptimizationKind::AosToSoa:
+            return "aosToSoa";
+        case OptimizationKind::Devirtualize:
+            return "devirtualize";
+        case OptimizationKind::PackFlags:
+            return "packFlags";
+        case OptimizationKind::NarrowTypes:
+            return "narrowTypes";
+        case OptimizationKind::NestedReorder:
+            return "nestedReorder";
+        case OptimizationKind::ArrayStride:
+            return "arrayStride";
+    }
+    return "unknown";
+}
+
+inline OptimizationKind OptimizationKindFromName(const std::string& name) {
+    if (name == "cacheLineSplit") {
+        return OptimizationKind::CacheLineSplit;
+    }
+    if (name == "hotColdSplit") {
+        return OptimizationKind::HotColdSplit;
+    }
+    if (name == "falseSharing") {
+        return OptimizationKind::FalseSharing;
+    }
+    if (name == "coAccess") {
+        return OptimizationKind::CoAccess;
+    }
+    if (name == "aosToSoa") {
+        return OptimizationKind::AosToSoa;
+    }
+    if (name == "devirtualize") {
+        return OptimizationKind::Devirtualize;
+    }
+    if (name == "packFlags") {
+        return OptimizationKind::PackFlags;
+    }
+    if (name == "narrowTypes") {
+        return OptimizationKind::NarrowTypes;
+    }
+    if (name == "nestedReorder") {
+        return OptimizationKind::NestedReorder;
+    }
+    if (name == "arrayStride") {
+        return OptimizationKind::ArrayStride;
+    }
+    return OptimizationKind::Reorder;
+}
+
+// How elements of the record fall on cache lines and pages in an array
+// whose start is line (page) aligned. Element i starts at i * sizeof, so
+// the offsets within a line repeat every line / gcd(sizeof, line) elements.
+struct ArrayStride {
+    double elements_per_line = 0;      // Cache line size / sizeof
+    double elements_per_page = 0;      // Per 4 KiB page
+    double elements_per_huge_page = 0; // Per 2 MiB page
+    double lines_per_element = 0;      // Cache lines one element touches, on average
+    double line_straddle = 0;          // Fraction of elements that cross a cache line boundary
+    double page_straddle = 0;          // ... a 4 KiB page boundary
+    double huge_page_straddle = 0;     // ... a 2 MiB page boundary
+    // Set only when some elements touch more lines than ceil(sizeof / line),
+    // i.e. lines_per_element exceeds it; 0 otherwise
+    uint64_t shrink_size = 0;          // Largest smaller sizeof whose elements touch no
+                                       // more lines than that
+    uint64_t aligned_size = 0;         // Smallest sizeof a power-of-two alignas, up to
+                                       // the line size, rounds up to that does the same
 };
 
 // Complete struct layout analysis
@@ -53,22 +212,76 @@ struct StructLayout {
     uint64_t total_size;              // Total size in bytes
     uint64_t alignment;               // Alignment requirement
     std::vector<MemberInfo> members;  // All members in order
+    std::vector<BaseInfo> bases;      // Direct non-virtual bases, then all virtual bases
     std::vector<PaddingInfo> padding; // All padding regions
     VTableInfo vtable;                // Virtual table info (if polymorphic)
     bool is_polymorphic;              // Has virtual functions
     bool is_standard_layout;          // Is standard layout type
     uint64_t useful_size;             // Size without tail padding
+    uint64_t data_size = 0;           // Size derived classes can't place members in;
+                                      // below total_size when its tail padding is reusable
+    uint64_t nested_padding = 0;      // Padding inside members' own types (the sum
+                                      // of theirs); padding plus this is all waste
+    ArrayStride array_stride;         // Placement of elements in arrays
+    
+    // Instantiations of a class template (or of a member class of one):
+    // the template's qualified name, e.g. "Node" for Node<int, double>;
+    // empty otherwise. name and qualified_name carry the arguments.
+    std::string template_name;
+    // Padding bytes beyond the least-padded instantiation of the same
+    // template in the result; non-zero marks arguments that open holes
+    uint64_t template_padding_excess = 0;
     
     // Optimization suggestions
     struct Optimization {
+        OptimizationKind kind;
         std::string description;
         uint64_t bytes_saved;
         std::vector<std::string> suggested_order; // Suggested member order
-        double confidence;            // 0.0 to 1.0
+        uint32_t members_moved;       // Members that change relative position
+        
+        // HotColdSplit: members moved to the out-of-line struct.
+        // HotColdSplit and CoAccess: estimated cache lines touched per
+        // object access (per function access for CoAccess), before and after.
+        std::vector<std::string> cold_members;
+        double lines_per_access_before = 0;
+        double lines_per_access_after = 0;
+        
+        // FalseSharing: members to put on cache lines of their own
+        std::vector<std::string> contended_members;
+        
+        // AosToSoa: members the element loops read, and the estimated bytes
+        // fetched per loop iteration as an array of structs (before) and
+        // as a struct of arrays (after)
+        std::vector<std::string> loop_members;
+        double bytes_per_iteration_before = 0;
+        double bytes_per_iteration_after = 0;
+        
+        // Devirtualize: signatures of the methods to mark final, such as
+        // "draw(int) const"; empty = mark the class final
+        std::vector<std::string> final_methods;
+        
+        // PackFlags: members to declare as bitfields and the width of each
+        std::vector<std::string> bitfield_members;
+        std::vector<uint32_t> bitfield_widths;
+        
+        // NarrowTypes: members to narrow and the integer type for each
+        // (for an enum member, its enum's new underlying type)
+        std::vector<std::string> narrowed_members;
+        std::vector<std::string> narrowed_types;
+        
+        // NestedReorder: the member holding the nested record and the
+        // record's qualified name; suggested_order is the record's new order
+        std::string nested_member;
+        std::string nested_type;
     };
     std::vector<Optimization> optimizations;
 };
 
+// Cancellation flag shared between the caller and a running analysis.
+// Set it to true to make the analyzer stop parsing as soon as possible.
+using CancellationFlag = std::shared_ptr<std::atomic<bool>>;
+
 // Analysis request
 struct AnalysisRequest {
     std::string source_code;
@@ -77,13 +290,182 @@ struct AnalysisRequest {
     Architecture architecture;
     Compiler compiler;
     std::vector<std::string> compile_flags; // Additional compiler flags
+    CancellationFlag cancellation;   // Optional; null = not cancellable
+    
+    // Clang target triple (aarch64-linux-gnu, x86_64-pc-windows-msvc, ...)
+    // replacing -m32/-m64; architecture and compiler should match it
+    // (see TargetMatrix::ApplyTriple). Empty = the host's.
+    std::string target_triple;
+    
+    // Target by source location instead of name: 1-based line/column of
+    // any point in the record's head ("struct Name") in the main file.
+    // 0 = match by struct_name.
+    uint32_t target_line = 0;
+    uint32_t target_column = 0;
+    
+    // Which records are reported (and which parts of the AST are walked)
+    bool include_system_headers = false;
+    std::vector<std::string> path_filter; // Path prefixes; empty = any file
+    
+    // Also report every implicit instantiation of the file's class
+    // templates (explicit instantiations and specializations always are)
+    bool include_template_instantiations = false;
+    
+    // Optional field access counts; enables hot/cold split suggestions
+    std::shared_ptr<const FieldProfile> profile;
+    
+    // Target cache line size in bytes, a power of two (128 on e.g. Apple
+    // M-series and POWER); used by the cache line and false sharing checks
+    uint32_t cache_line_size = kDefaultCacheLineSize;
+    
+    // Fill AnalysisResult::stats
+    bool collect_stats = false;
+    
+    // Optional; called with each matching record's qualified name before
+    // it is laid out, and the record is skipped when it returns false. A
+    // project scan uses it to lay out a shared header's records once.
+    std::function<bool(const std::string&)> claim_record;
 };
 
+// Where one analysis spent its time, in wall-clock milliseconds, and how
+// much work it did. Phases that didn't run this time (the parse when a
+// session reuses its AST, everything on a layout cache hit) stay 0.
+struct AnalysisStats {
+    double total_ms = 0;        // Analyzer or Session, not counting conversion
+    double preamble_ms = 0;     // Finding, checking or building the preamble
+    double parse_ms = 0;        // Preprocessing, parsing and Sema; Clang interleaves them
+    double traversal_ms = 0;    // Walking the AST for records, minus the two below
+    double layout_ms = 0;       // Per-record layouts, padding and suggestions
+    double access_ms = 0;       // Walking function bodies for field accesses
+    double conversion_ms = 0;   // Handing the layouts to JS (addon only)
+    
+    uint32_t records_visited = 0;  // Complete record definitions the traversal reached
+    uint32_t records_reported = 0; // Of which analyzed and returned
+    uint64_t ast_bytes = 0;        // Memory held by the ASTContext
+    
+    bool layout_cache_hit = false;
+    bool preamble_reused = false;  // Valid preamble found in the PreambleCache
+    bool ast_reused = false;       // A session answered from its parsed AST
+};
+
+// Milliseconds elapsed since `start`, for AnalysisStats
+inline double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
 // Analysis result
 struct AnalysisResult {
     bool success;
     std::string error_message;
     std::vector<StructLayout> layouts; // All analyzed structs
+    bool cancelled = false;            // Stopped early via CancellationFlag
+    bool records_skipped = false;      // Some declined by claim_record; not cached
+    std::optional<AnalysisStats> stats; // Set when the request had collect_stats
+};
+
+// Whole-project scan request
+struct ProjectScanRequest {
+    std::string compile_commands_path; // compile_commands.json or its directory
+    Architecture architecture;
+    Compiler compiler;
+    unsigned thread_count = 0;         // 0 = one per hardware thread
+    CancellationFlag cancellation;     // Optional; null = not cancellable
+    std::vector<std::string> path_filter; // Path prefixes; empty = any non-system file
+    bool include_system_headers = false;
+    bool include_template_instantiations = false;
+    std::shared_ptr<const FieldProfile> profile; // Optional; enables hot/cold split suggestions
+    uint32_t cache_line_size = kDefaultCacheLineSize;
+};
+
+// Whole-project scan result
+struct ProjectScanResult {
+    bool success = false;
+    std::string error_message;
+    bool cancelled = false;
+    std::vector<StructLayout> layouts;      // Each record once, across all TUs
+    uint64_t files_scanned = 0;
+    std::vector<std::string> failed_files;  // TUs that did not compile
+};
+
+// One source analyzed for several targets at once
+struct TargetMatrixRequest {
+    AnalysisRequest analysis;           // Source, flags and record selection; architecture
+                                        // and compiler are taken from each triple
+    std::vector<std::string> targets;   // Clang target triples
+    unsigned thread_count = 0;          // 0 = one per hardware thread, at most one per target
+};
+
+// A record or member as one target lays it out
+struct TargetPlacement {
+    bool present = false;    // False if the target lacks it or failed to parse
+    uint64_t offset = 0;     // Members only
+    uint32_t bit_offset = 0; // Bitfields: first bit within the byte at offset
+    uint64_t size = 0;
+    uint64_t alignment = 0;
+};
+
+struct MatrixMember {
+    std::string name;
+    std::vector<TargetPlacement> targets; // By target index
+    bool diverges = false;
+};
+
+// One record across all targets. Only targets that parsed are compared;
+// a record or member missing on one of them is a divergence.
+struct MatrixRecord {
+    std::string qualified_name;
+    std::vector<TargetPlacement> targets; // Size and alignment by target index
+    std::vector<MatrixMember> members;    // In the first target's declaration order
+    bool diverges = false;                // Size, alignment or any member differs
+};
+
+struct TargetMatrixResult {
+    bool success = false;
+    std::string error_message;
+    bool cancelled = false;
+    std::vector<std::string> targets;       // Normalized triples, in request order
+    std::vector<std::string> target_errors; // By target index; empty = analyzed
+    std::vector<MatrixRecord> records;      // Sorted by qualified name
+};
+
+// One record's footprint in the standard containers and smart pointers
+struct FootprintRequest {
+    AnalysisRequest analysis;           // Must select one record (struct_name or
+                                        // target_line)
+    std::string key_type = "std::size_t"; // Key of the std::map and std::unordered_map rows
+    uint64_t element_count = 1000;      // N for projected_bytes
+};
+
+// How one container holds the record. Node, block and buffer sizes come
+// from the translation unit's own library headers when they are
+// libstdc++'s (measured), otherwise from a model of libstdc++'s layouts;
+// heap blocks are rounded up to glibc malloc chunk sizes.
+struct ContainerFootprint {
+    std::string container;              // "std::vector", "std::list", ...
+    std::string node_type;              // Library type allocated per node or block;
+                                        // empty for vector and unique_ptr
+    uint64_t object_size = 0;           // sizeof the container, or of the pointer
+                                        // (once per element) for smart pointers
+    uint64_t node_size = 0;             // sizeof what one allocation holds
+    uint64_t allocation_size = 0;       // Its malloc chunk, header and rounding included
+    uint64_t elements_per_allocation = 0; // 1 for nodes; deque blocks hold several;
+                                          // 0 = one buffer for all (vector)
+    uint64_t projected_bytes = 0;       // Object plus heap for element_count elements
+    double bytes_per_element = 0;       // Heap bytes (and, for smart pointers, the
+                                        // pointer) per element at element_count
+    bool measured = false;              // Sizes read from the TU's library headers
+};
+
+struct FootprintResult {
+    bool success = false;
+    std::string error_message;
+    bool cancelled = false;
+    std::string qualified_name;
+    uint64_t element_size = 0;          // sizeof the record
+    uint64_t element_alignment = 0;
+    uint64_t element_count = 0;
+    std::string key_type;
+    std::vector<ContainerFootprint> containers;
 };
 
 } // namespace structsight
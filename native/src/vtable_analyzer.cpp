@@ -1,25 +1,363 @@
-#include "types.h"
+#include "vtable_analyzer.h"
+#include <clang/AST/Attr.h>
+#include <clang/AST/RecordLayout.h>
+#include <clang/AST/VTableBuilder.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <algorithm>
+#include <map>
+#include <set>
 
 namespace structsight {
 
-// Virtual table analyzer - simplified for now
-// Full implementation would analyze vtable layout in detail
-
-class VTableAnalyzer {
-public:
-    static void AnalyzeVTable(
-        StructLayout& layout,
-        const void* record,
-        const void* context
-    ) {
-        // Placeholder - full implementation would:
-        // 1. Determine vtable pointer location
-        // 2. Analyze virtual function ordering
-        // 3. Handle multiple inheritance vtable layout
-        // 4. Analyze virtual base class offsets
-        
-        // For now, basic info is gathered in analyzer.cpp
-    }
-};
+namespace {
+
+// "draw(int, const Point &) const": the name with the parameter types and
+// qualifiers that tell overloads apart
+std::string Signature(const clang::CXXMethodDecl* method) {
+    std::string signature = method->getNameAsString() + "(";
+    for (unsigned i = 0; i < method->getNumParams(); i++) {
+        signature += (i > 0 ? ", " : "") + method->getParamDecl(i)->getType().getAsString();
+    }
+    if (method->isVariadic()) {
+        signature += method->getNumParams() > 0 ? ", ..." : "...";
+    }
+    signature += ")";
+    if (method->isConst()) {
+        signature += " const";
+    }
+    if (method->isVolatile()) {
+        signature += " volatile";
+    }
+    if (method->getRefQualifier() == clang::RQ_LValue) {
+        signature += " &";
+    } else if (method->getRefQualifier() == clang::RQ_RValue) {
+        signature += " &&";
+    }
+    return signature;
+}
+
+// "Base::draw(int)", with " (pure)" for pure virtual functions
+std::string FunctionName(const clang::CXXMethodDecl* method) {
+    std::string name = method->getParent()->getNameAsString() + "::" + Signature(method);
+    if (method->isPure()) {
+        name += " (pure)";
+    }
+    return name;
+}
+
+std::string Signed(int64_t value) {
+    return value < 0 ? "- " + std::to_string(-value) : "+ " + std::to_string(value);
+}
+
+// How a thunk adjusts `this` before, and the returned pointer after, the
+// call it forwards to. Virtual adjustments read an offset out of the vtable
+// (Itanium) or the vtordisp/vbtable (Microsoft).
+std::string DescribeThunk(const clang::ThunkInfo& thunk, bool microsoft) {
+    std::vector<std::string> parts;
+
+    if (thunk.This.NonVirtual != 0) {
+        parts.push_back("this " + Signed(thunk.This.NonVirtual));
+    }
+    if (microsoft) {
+        if (thunk.This.Virtual.Microsoft.VtordispOffset != 0) {
+            parts.push_back("this + vtordisp at " +
+                            std::to_string(thunk.This.Virtual.Microsoft.VtordispOffset));
+        }
+    } else if (thunk.This.Virtual.Itanium.VCallOffsetOffset != 0) {
+        parts.push_back("this + vcall offset at vptr " +
+                        Signed(thunk.This.Virtual.Itanium.VCallOffsetOffset));
+    }
+
+    if (microsoft) {
+        if (thunk.Return.Virtual.Microsoft.VBIndex != 0) {
+            parts.push_back("return + vbtable[" +
+                            std::to_string(thunk.Return.Virtual.Microsoft.VBIndex) + "]");
+        }
+    } else if (thunk.Return.Virtual.Itanium.VBaseOffsetOffset != 0) {
+        parts.push_back("return + vbase offset at vptr " +
+                        Signed(thunk.Return.Virtual.Itanium.VBaseOffsetOffset));
+    }
+    if (thunk.Return.NonVirtual != 0) {
+        parts.push_back("return " + Signed(thunk.Return.NonVirtual));
+    }
+
+    std::string description;
+    for (const auto& part : parts) {
+        description += (description.empty() ? "" : ", ") + part;
+    }
+    return description;
+}
+
+VTableSlot MakeSlot(const clang::VTableComponent& component, int64_t index) {
+    VTableSlot slot;
+    slot.index = index;
+
+    switch (component.getKind()) {
+        case clang::VTableComponent::CK_VCallOffset:
+            slot.kind = "vcallOffset";
+            slot.name = std::to_string(component.getVCallOffset().getQuantity());
+            break;
+        case clang::VTableComponent::CK_VBaseOffset:
+            slot.kind = "vbaseOffset";
+            slot.name = std::to_string(component.getVBaseOffset().getQuantity());
+            break;
+        case clang::VTableComponent::CK_OffsetToTop:
+            slot.kind = "offsetToTop";
+            slot.name = std::to_string(component.getOffsetToTop().getQuantity());
+            break;
+        case clang::VTableComponent::CK_RTTI:
+            slot.kind = "rtti";
+            slot.name = component.getRTTIDecl()->getQualifiedNameAsString();
+            break;
+        case clang::VTableComponent::CK_FunctionPointer:
+            slot.kind = "function";
+            slot.name = FunctionName(component.getFunctionDecl());
+            break;
+        case clang::VTableComponent::CK_CompleteDtorPointer:
+            slot.kind = "completeDtor";
+            slot.name = FunctionName(component.getDestructorDecl());
+            break;
+        case clang::VTableComponent::CK_DeletingDtorPointer:
+            slot.kind = "deletingDtor";
+            slot.name = FunctionName(component.getDestructorDecl());
+            break;
+        case clang::VTableComponent::CK_UnusedFunctionPointer:
+            slot.kind = "unusedFunction";
+            slot.name = FunctionName(component.getUnusedFunctionDecl());
+            break;
+    }
+
+    return slot;
+}
+
+// Slots [begin, end) of `vtable_layout`, numbered from `address_point`
+std::vector<VTableSlot> ReadSlots(
+    const clang::VTableLayout& vtable_layout,
+    size_t begin,
+    size_t end,
+    size_t address_point,
+    bool microsoft
+) {
+    llvm::DenseMap<uint64_t, const clang::ThunkInfo*> thunks;
+    for (const auto& thunk : vtable_layout.vtable_thunks()) {
+        thunks[thunk.first] = &thunk.second;
+    }
+
+    std::vector<VTableSlot> slots;
+    auto components = vtable_layout.vtable_components();
+    for (size_t i = begin; i < end && i < components.size(); i++) {
+        VTableSlot slot = MakeSlot(components[i],
+                                   static_cast<int64_t>(i) - static_cast<int64_t>(address_point));
+        auto thunk = thunks.find(i);
+        if (thunk != thunks.end()) {
+            slot.thunk = DescribeThunk(*thunk->second, microsoft);
+        }
+        slots.push_back(std::move(slot));
+    }
+    return slots;
+}
+
+// Itanium: one vtable group per class, made of one table per vptr. Bases
+// that share a vptr (a primary chain) share its table; the most derived of
+// them names it.
+void ReadItaniumVTables(
+    VTableInfo& vtable,
+    const clang::CXXRecordDecl* record,
+    clang::ItaniumVTableContext& vtables
+) {
+    const clang::VTableLayout& vtable_layout = vtables.getVTableLayout(record);
+
+    struct VPointer {
+        const clang::CXXRecordDecl* subobject;
+        clang::VTableLayout::AddressPointLocation location;
+    };
+    std::map<int64_t, VPointer> by_offset;
+    for (const auto& point : vtable_layout.getAddressPoints()) {
+        const clang::CXXRecordDecl* base = point.first.getBase();
+        int64_t offset = point.first.getBaseOffset().getQuantity();
+
+        auto it = by_offset.find(offset);
+        if (it == by_offset.end()) {
+            by_offset[offset] = {base, point.second};
+        } else if (base->isDerivedFrom(it->second.subobject)) {
+            it->second.subobject = base;
+        }
+    }
+
+    for (const auto& entry : by_offset) {
+        size_t table = entry.second.location.VTableIndex;
+        size_t begin = vtable_layout.getVTableOffset(table);
+        size_t end = begin + vtable_layout.getVTableSize(table);
+
+        VPointerInfo vptr;
+        vptr.offset = static_cast<uint64_t>(entry.first);
+        vptr.subobject = entry.second.subobject->getNameAsString();
+        vptr.slots = ReadSlots(vtable_layout, begin, end,
+                               begin + entry.second.location.AddressPointIndex, false);
+        vtable.vptrs.push_back(std::move(vptr));
+    }
+}
+
+// Microsoft: a separate vftable per vfptr, and virtual bases found through
+// the vbptr's vbtable rather than the vftable
+void ReadMicrosoftVTables(
+    VTableInfo& vtable,
+    const clang::CXXRecordDecl* record,
+    const clang::ASTRecordLayout& ast_layout,
+    clang::MicrosoftVTableContext& vtables
+) {
+    for (const auto& info : vtables.getVFPtrOffsets(record)) {
+        const clang::VTableLayout& vtable_layout =
+            vtables.getVFTableLayout(record, info->FullOffsetInMDC);
+
+        VPointerInfo vptr;
+        vptr.offset = static_cast<uint64_t>(info->FullOffsetInMDC.getQuantity());
+        vptr.subobject = info->ObjectWithVPtr->getNameAsString();
+        vptr.slots = ReadSlots(vtable_layout, 0, vtable_layout.vtable_components().size(), 0, true);
+        vtable.vptrs.push_back(std::move(vptr));
+    }
+    std::sort(vtable.vptrs.begin(), vtable.vptrs.end(),
+              [](const VPointerInfo& a, const VPointerInfo& b) { return a.offset < b.offset; });
+
+    if (ast_layout.hasVBPtr()) {
+        vtable.vbptr_offset = ast_layout.getVBPtrOffset().getQuantity();
+    }
+}
+
+} // namespace
+
+void VTableAnalyzer::Analyze(
+    StructLayout& layout,
+    const clang::CXXRecordDecl* record,
+    clang::ASTContext& context
+) {
+    VTableInfo& vtable = layout.vtable;
+    vtable = VTableInfo();
+
+    record = record->getDefinition();
+    if (!record || !record->isDynamicClass() || record->isInvalidDecl()) {
+        return;
+    }
+
+    const clang::ASTRecordLayout& ast_layout = context.getASTRecordLayout(record);
+    vtable.has_virtual_base = record->getNumVBases() > 0;
+
+    clang::VTableContextBase* vtables = context.getVTableContext();
+    auto* microsoft = llvm::dyn_cast<clang::MicrosoftVTableContext>(vtables);
+    auto* itanium = llvm::dyn_cast<clang::ItaniumVTableContext>(vtables);
+    if (microsoft) {
+        ReadMicrosoftVTables(vtable, record, ast_layout, *microsoft);
+    } else if (itanium) {
+        ReadItaniumVTables(vtable, record, *itanium);
+    }
+
+    for (const auto& base : record->vbases()) {
+        const auto* base_decl = base.getType()->getAsCXXRecordDecl();
+        if (!base_decl) {
+            continue;
+        }
+        VirtualBaseInfo info;
+        info.name = base_decl->getNameAsString();
+        info.offset = ast_layout.getVBaseClassOffset(base_decl).getQuantity();
+        info.offset_slot = 0;
+        if (microsoft) {
+            info.offset_slot = microsoft->getVBTableIndex(record, base_decl);
+        } else if (itanium) {
+            info.offset_slot = itanium->getVirtualBaseOffsetOffset(record, base_decl).getQuantity();
+        }
+        vtable.virtual_bases.push_back(info);
+    }
+
+    if (!vtable.vptrs.empty()) {
+        vtable.pointer_offset = vtable.vptrs.front().offset;
+    }
+
+    // Each virtual function once by signature, in the order the tables
+    // hold them; the class qualifier goes, parameter types may keep theirs
+    std::set<std::string> listed;
+    for (const auto& vptr : vtable.vptrs) {
+        for (const auto& slot : vptr.slots) {
+            if (slot.kind != "function" && slot.kind != "completeDtor" && slot.kind != "deletingDtor") {
+                continue;
+            }
+            llvm::StringRef full(slot.name);
+            full.consume_back(" (pure)");
+            size_t parameters = full.find('(');
+            std::string signature = full.substr(0, parameters).rsplit("::").second.str() +
+                                    full.substr(parameters).str();
+            if (listed.insert(signature).second) {
+                vtable.virtual_functions.push_back(signature);
+            }
+        }
+    }
+}
+
+void VTableAnalyzer::SuggestFinal(
+    StructLayout& layout,
+    const clang::CXXRecordDecl* record,
+    AccessAnalyzer& accesses
+) {
+    if (!record->isPolymorphic() || record->hasAttr<clang::FinalAttr>()) {
+        return;
+    }
+
+    const auto* calls = accesses.GetVirtualCalls(record);
+    if (!calls || calls->empty()) {
+        return;
+    }
+
+    StructLayout::Optimization opt;
+    opt.kind = OptimizationKind::Devirtualize;
+    opt.bytes_saved = 0;
+    opt.members_moved = 0;
+
+    uint32_t sites = 0;
+    uint32_t in_loops = 0;
+    if (!accesses.HasDerivedClass(record)) {
+        for (const auto& call : *calls) {
+            sites += call.second.sites;
+            in_loops += call.second.in_loops;
+        }
+        opt.description = "Nothing in this file derives from " + layout.name +
+            "; marking it final lets the compiler devirtualize " + std::to_string(sites) +
+            " virtual call" + (sites == 1 ? "" : "s");
+    } else {
+        // Only methods this class declares can be marked final here
+        std::vector<std::pair<double, const clang::CXXMethodDecl*>> candidates;
+        for (const auto& call : *calls) {
+            const clang::CXXMethodDecl* method = call.first;
+            if (method->getParent()->getCanonicalDecl() != record->getCanonicalDecl() ||
+                llvm::isa<clang::CXXDestructorDecl>(method) ||
+                accesses.IsOverridden(method)) {
+                continue;
+            }
+            candidates.push_back({call.second.weight, method});
+            sites += call.second.sites;
+            in_loops += call.second.in_loops;
+        }
+        if (candidates.empty()) {
+            return;
+        }
+
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const auto& a, const auto& b) { return a.first > b.first; });
+        std::string names;
+        for (const auto& candidate : candidates) {
+            opt.final_methods.push_back(Signature(candidate.second));
+            names += (names.empty() ? "" : ", ") + opt.final_methods.back();
+        }
+        opt.description = "Nothing in this file overrides " + names +
+            "; marking " + (candidates.size() == 1 ? "it" : "them") +
+            " final lets the compiler devirtualize " + std::to_string(sites) +
+            " call" + (sites == 1 ? "" : "s") + " made through " + layout.name;
+    }
+
+    if (in_loops > 0) {
+        opt.description += " (" + std::to_string(in_loops) + " inside loops)";
+    }
+
+    layout.optimizations.push_back(opt);
+}
 
 } // namespace structsight
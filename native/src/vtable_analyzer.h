@@ -0,0 +1,37 @@
+#ifndef STRUCTSIGHT_VTABLE_ANALYZER_H
+#define STRUCTSIGHT_VTABLE_ANALYZER_H
+
+#include "types.h"
+#include "access_analyzer.h"
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/DeclCXX.h>
+
+namespace structsight {
+
+// Reads vtable layouts from Clang's vtable builders, so what is reported is
+// what code generation would emit for the target ABI: Itanium (GCC, Clang)
+// or Microsoft (MSVC, clang-cl).
+class VTableAnalyzer {
+public:
+    // Fill layout.vtable for a dynamic class: every vptr with its offset
+    // and table (slot order, thunks, offset-to-top and RTTI entries), and
+    // each virtual base with its offset and where its offset is looked up
+    static void Analyze(
+        StructLayout& layout,
+        const clang::CXXRecordDecl* record,
+        clang::ASTContext& context
+    );
+    
+    // Suggest `final` where the translation unit makes virtual calls that
+    // it would then let the compiler devirtualize: on the class if nothing
+    // derives from it, otherwise on its methods that nothing overrides
+    static void SuggestFinal(
+        StructLayout& layout,
+        const clang::CXXRecordDecl* record,
+        AccessAnalyzer& accesses
+    );
+};
+
+} // namespace structsight
+
+#endif // STRUCTSIGHT_VTABLE_ANALYZER_H
@@ -0,0 +1,25 @@
+# Runs the structsight CLI against a baseline: recording one, comparing an
+# unchanged source (exit status 0) and one whose record grew (exit status 3).
+# cmake -DSTRUCTSIGHT=<path to structsight> -DWORK_DIR=<dir> -P baseline_cli.cmake
+
+file(MAKE_DIRECTORY "${WORK_DIR}")
+set(baseline "${WORK_DIR}/baseline.json")
+file(REMOVE "${baseline}")
+file(WRITE "${WORK_DIR}/before.cpp" "struct Point { int x; int y; };\n")
+file(WRITE "${WORK_DIR}/after.cpp" "struct Point { int x; int y; int z; };\n")
+
+function(run_structsight expected)
+    execute_process(
+        COMMAND "${STRUCTSIGHT}" ${ARGN}
+        RESULT_VARIABLE status
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE errors
+    )
+    if(NOT status EQUAL expected)
+        message(FATAL_ERROR "structsight ${ARGN}: exit status ${status}, expected ${expected}\n${output}${errors}")
+    endif()
+endfunction()
+
+run_structsight(0 "--write-baseline=${baseline}" "${WORK_DIR}/before.cpp")
+run_structsight(0 "--baseline=${baseline}" "${WORK_DIR}/before.cpp")
+run_structsight(3 "--baseline=${baseline}" "${WORK_DIR}/after.cpp")
@@ -0,0 +1,176 @@
+// layout_baseline_test - LayoutBaseline's JSON round trip and the changes
+// Compare reports: growth, new padding, a member that starts straddling a
+// cache line, and records that stay the same or come and go. The CLI's
+// exit status for a regression is checked by baseline_cli.cmake.
+
+#include "layout_baseline.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace structsight;
+
+namespace {
+
+int failures = 0;
+
+void Check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+BaselineRecord Record(
+    const std::string& name,
+    uint64_t total_size,
+    uint64_t padding,
+    std::vector<BaselineMember> members
+) {
+    BaselineRecord record;
+    record.qualified_name = name;
+    record.total_size = total_size;
+    record.alignment = 8;
+    record.padding = padding;
+    record.members = std::move(members);
+    return record;
+}
+
+BaselineTarget Target(std::vector<BaselineRecord> records) {
+    BaselineTarget target;
+    target.target = "x64-clang";
+    target.records = std::move(records);
+    return target;
+}
+
+const LayoutChange* Find(const std::vector<LayoutChange>& changes, const std::string& name) {
+    for (const auto& change : changes) {
+        if (change.qualified_name == name) {
+            return &change;
+        }
+    }
+    return nullptr;
+}
+
+void TestRoundTrip() {
+    StructLayout layout;
+    layout.qualified_name = "ns::Packet";
+    layout.total_size = 24;
+    layout.alignment = 8;
+    MemberInfo tag;
+    tag.name = "tag";
+    tag.offset = 0;
+    tag.size = 1;
+    MemberInfo length;
+    length.name = "length";
+    length.offset = 8;
+    length.size = 8;
+    layout.members = {tag, length};
+    layout.padding = {{1, 7, "Alignment of length"}, {16, 8, "Tail padding"}};
+
+    std::vector<BaselineTarget> written = {
+        LayoutBaseline::FromLayouts({layout, layout}, "x64-clang", 64),
+        Target({Record("Point", 8, 0, {{"x", 0, 4}, {"y", 4, 4}})}),
+    };
+    written[1].target = "x86-gcc";
+    written[1].cache_line_size = 128;
+
+    std::string text;
+    llvm::raw_string_ostream out(text);
+    LayoutBaseline::Write(out, written);
+    out.flush();
+
+    std::vector<BaselineTarget> read;
+    std::string error;
+    Check(LayoutBaseline::Read(text, read, error), "a written baseline should read back: " + error);
+    Check(read.size() == 2, "both targets should read back");
+    if (read.size() != 2) {
+        return;
+    }
+    Check(read[0].records.size() == 1, "a record seen twice should be written once");
+    for (size_t t = 0; t < read.size(); t++) {
+        Check(read[t].target == written[t].target && read[t].cache_line_size == written[t].cache_line_size,
+              "target " + written[t].target + " should keep its name and cache line size");
+        Check(LayoutBaseline::Compare(written[t], read[t], read[t].cache_line_size).empty(),
+              "target " + written[t].target + " should read back unchanged");
+    }
+    const BaselineRecord& packet = read[0].records[0];
+    Check(packet.qualified_name == "ns::Packet" && packet.total_size == 24 && packet.padding == 15 &&
+          packet.members.size() == 2 && packet.members[1].name == "length" &&
+          packet.members[1].offset == 8 && packet.members[1].size == 8,
+          "ns::Packet should keep its size, padding and members");
+
+    Check(!LayoutBaseline::Read("{\"version\": 2, \"targets\": []}", read, error),
+          "a baseline of another version should be rejected");
+    Check(!LayoutBaseline::Read("not json", read, error), "malformed text should be rejected");
+}
+
+void TestUnchanged() {
+    BaselineTarget target = Target({Record("Point", 8, 0, {{"x", 0, 4}, {"y", 4, 4}})});
+    Check(LayoutBaseline::Compare(target, target, 64).empty(), "an unchanged record should not be reported");
+}
+
+void TestGrowth() {
+    BaselineTarget before = Target({Record("Point", 8, 0, {{"x", 0, 4}, {"y", 4, 4}})});
+    BaselineTarget after = Target({Record("Point", 12, 0, {{"x", 0, 4}, {"y", 4, 4}, {"z", 8, 4}})});
+    std::vector<LayoutChange> changes = LayoutBaseline::Compare(before, after, 64);
+    const LayoutChange* change = Find(changes, "Point");
+    Check(change && change->kind == LayoutChange::Kind::Changed && change->size_before == 8 &&
+          change->size_after == 12 && change->IsRegression(), "growing from 8 to 12 bytes should regress");
+}
+
+void TestNewPadding() {
+    // Same size, but a member moved and left a hole
+    BaselineTarget before = Target({Record("Header", 16, 0, {{"id", 0, 8}, {"flags", 8, 4}, {"kind", 12, 4}})});
+    BaselineTarget after = Target({Record("Header", 16, 4, {{"flags", 0, 4}, {"id", 8, 8}})});
+    std::vector<LayoutChange> changes = LayoutBaseline::Compare(before, after, 64);
+    const LayoutChange* change = Find(changes, "Header");
+    Check(change && change->padding_after == 4 && change->IsRegression(), "new padding should regress");
+    Check(change && change->moved_members.size() == 2, "id and flags should be reported as moved");
+}
+
+void TestNewCrossing() {
+    BaselineTarget before = Target({Record("Wide", 128, 0, {{"head", 0, 56}, {"value", 56, 8}, {"tail", 64, 64}})});
+    BaselineTarget after = Target({Record("Wide", 128, 0, {{"head", 0, 60}, {"value", 60, 8}, {"tail", 68, 60}})});
+    std::vector<LayoutChange> changes = LayoutBaseline::Compare(before, after, 64);
+    const LayoutChange* change = Find(changes, "Wide");
+    Check(change && change->new_crossings.size() == 1 && change->new_crossings[0] == "value" &&
+          change->IsRegression(), "value starting to straddle a cache line should regress");
+
+    // With 128-byte lines nothing straddles
+    changes = LayoutBaseline::Compare(before, after, 128);
+    change = Find(changes, "Wide");
+    Check(change && change->new_crossings.empty() && !change->IsRegression(),
+          "moving members within a 128-byte line should not regress");
+}
+
+void TestAddedAndRemoved() {
+    BaselineTarget before = Target({Record("Gone", 4, 0, {{"x", 0, 4}})});
+    BaselineTarget after = Target({Record("New", 64, 0, {{"x", 0, 64}})});
+    std::vector<LayoutChange> changes = LayoutBaseline::Compare(before, after, 64);
+    const LayoutChange* gone = Find(changes, "Gone");
+    const LayoutChange* added = Find(changes, "New");
+    Check(changes.size() == 2 && gone && gone->kind == LayoutChange::Kind::Removed &&
+          added && added->kind == LayoutChange::Kind::Added,
+          "records should be reported as removed and added");
+    Check(gone && added && !gone->IsRegression() && !added->IsRegression(),
+          "added and removed records are not regressions");
+}
+
+} // namespace
+
+int main() {
+    TestRoundTrip();
+    TestUnchanged();
+    TestGrowth();
+    TestNewPadding();
+    TestNewCrossing();
+    TestAddedAndRemoved();
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d layout baseline checks failed\n", failures);
+        return 1;
+    }
+    std::printf("All layout baseline checks passed\n");
+    return 0;
+}
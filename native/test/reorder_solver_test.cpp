@@ -0,0 +1,171 @@
+// reorder_solver_test - checks ReorderSolver against every permutation of
+// small random structs, bitfield-like items included: the size it finds
+// must be the minimum and its move count the fewest any minimum-size
+// order needs. Larger structs are checked for the minimum size only.
+// Needs no Clang, so it builds without the AST libraries.
+
+#include "reorder_solver.h"
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace structsight;
+
+namespace {
+
+int failures = 0;
+
+void Check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+std::string Describe(const std::vector<ReorderItem>& items, uint64_t start_offset) {
+    std::string text = "start " + std::to_string(start_offset) + ":";
+    for (const auto& item : items) {
+        text += " " + std::to_string(item.size) + "/" + std::to_string(item.alignment);
+    }
+    return text;
+}
+
+// Smallest size over every order, and the fewest moves among orders of
+// that size
+void BruteForce(
+    const std::vector<ReorderItem>& items,
+    uint64_t start_offset,
+    uint64_t struct_alignment,
+    uint64_t& min_size,
+    uint32_t& min_moves
+) {
+    std::vector<size_t> order(items.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    min_size = ReorderSolver::SizeWithOrder(items, order, start_offset, struct_alignment);
+    min_moves = 0;
+    do {
+        uint64_t size = ReorderSolver::SizeWithOrder(items, order, start_offset, struct_alignment);
+        uint32_t moves = ReorderSolver::CountMoves(order);
+        if (size < min_size || (size == min_size && moves < min_moves)) {
+            min_size = size;
+            min_moves = moves;
+        }
+    } while (std::next_permutation(order.begin(), order.end()));
+}
+
+void TestKnownLayouts() {
+    // char, int, char, double: 24 bytes, 16 once a char moves next to the other
+    std::vector<ReorderItem> items = {{1, 1}, {4, 4}, {1, 1}, {8, 8}};
+    ReorderSolution solution = ReorderSolver::Solve(items, 0, 8);
+    Check(solution.size == 16, "char/int/char/double should shrink to 16 bytes");
+    Check(solution.moves == 1, "char/int/char/double needs one member moved");
+
+    // Already optimal: nothing moves
+    items = {{8, 8}, {4, 4}, {2, 2}, {1, 1}};
+    solution = ReorderSolver::Solve(items, 0, 8);
+    Check(solution.size == 16 && solution.moves == 0, "a descending layout should stay as it is");
+
+    // After an 8-byte vptr a 4-byte member fills the gap before a double
+    items = {{1, 1}, {8, 8}, {4, 4}};
+    solution = ReorderSolver::Solve(items, 8, 8);
+    Check(solution.size == 24, "members after a vptr should pack into 24 bytes");
+}
+
+void TestBitfieldUnits() {
+    // A 3-bit run in an unsigned storage unit takes one byte but is
+    // aligned to four; a char may follow it in the same unit
+    std::vector<ReorderItem> items = {{1, 4}, {8, 8}, {1, 1}, {4, 4}};
+    uint64_t min_size = 0;
+    uint32_t min_moves = 0;
+    BruteForce(items, 0, 8, min_size, min_moves);
+    ReorderSolution solution = ReorderSolver::Solve(items, 0, 8);
+    Check(solution.size == min_size, "a bitfield run should be placed as its own size, got " +
+          std::to_string(solution.size) + " instead of " + std::to_string(min_size));
+    Check(ReorderSolver::SizeWithOrder(items, solution.order, 0, 8) == solution.size,
+          "the reported size should be that of the returned order");
+}
+
+void TestRandomLayouts() {
+    std::mt19937 random(1234);
+    const uint64_t alignments[] = {1, 2, 4, 8, 16};
+
+    for (int round = 0; round < 3000; round++) {
+        size_t count = 2 + random() % 6;
+        std::vector<ReorderItem> items;
+        uint64_t struct_alignment = 1;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t alignment = alignments[random() % 5];
+            // Bitfield runs: sizes below their alignment
+            uint64_t size = random() % 4 == 0 ? 1 + random() % alignment
+                                              : alignment * (1 + random() % 3);
+            items.push_back({size, alignment});
+            struct_alignment = std::max(struct_alignment, alignment);
+        }
+        uint64_t start_offset = random() % 3 == 0 ? 8 * (random() % 3) : 0;
+
+        uint64_t min_size = 0;
+        uint32_t min_moves = 0;
+        BruteForce(items, start_offset, struct_alignment, min_size, min_moves);
+        ReorderSolution solution = ReorderSolver::Solve(items, start_offset, struct_alignment);
+
+        std::string name = Describe(items, start_offset);
+        Check(ReorderSolver::SizeWithOrder(items, solution.order, start_offset, struct_alignment) ==
+              solution.size, name + ": reported size differs from the order's");
+        Check(solution.size == min_size, name + ": size " + std::to_string(solution.size) +
+              ", minimum " + std::to_string(min_size));
+        Check(solution.moves == ReorderSolver::CountMoves(solution.order),
+              name + ": reported moves differ from the order's");
+        if (solution.size == min_size) {
+            Check(solution.moves == min_moves, name + ": " + std::to_string(solution.moves) +
+                  " moves, fewest " + std::to_string(min_moves));
+        }
+    }
+}
+
+void TestLargeLayouts() {
+    // Too many members to enumerate: sizes are still exact when each is a
+    // multiple of its alignment, and from offset 0 the optimum has no
+    // padding but the tail
+    std::mt19937 random(99);
+    const uint64_t alignments[] = {1, 2, 4, 8, 16};
+
+    for (int round = 0; round < 200; round++) {
+        size_t count = 12 + random() % 20;
+        std::vector<ReorderItem> items;
+        uint64_t struct_alignment = 1;
+        uint64_t total = 0;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t alignment = alignments[random() % 5];
+            items.push_back({alignment * (1 + random() % 3), alignment});
+            struct_alignment = std::max(struct_alignment, alignment);
+            total += items.back().size;
+        }
+        uint64_t optimum = (total + struct_alignment - 1) / struct_alignment * struct_alignment;
+
+        ReorderSolution solution = ReorderSolver::Solve(items, 0, struct_alignment);
+        Check(solution.size == optimum, Describe(items, 0) + ": size " +
+              std::to_string(solution.size) + ", minimum " + std::to_string(optimum));
+        Check(ReorderSolver::SizeWithOrder(items, solution.order, 0, struct_alignment) == solution.size,
+              Describe(items, 0) + ": reported size differs from the order's");
+    }
+}
+
+} // namespace
+
+int main() {
+    TestKnownLayouts();
+    TestBitfieldUnits();
+    TestRandomLayouts();
+    TestLargeLayouts();
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d reorder solver checks failed\n", failures);
+        return 1;
+    }
+    std::printf("All reorder solver checks passed\n");
+    return 0;
+}
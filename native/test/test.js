@@ -54,8 +54,6 @@ try {
                 }
             });
         }
-
-        console.log('\n✓ All tests passed!');
     } else {
         console.error('✗ Analysis failed:', result.errorMessage);
         process.exit(1);
@@ -65,3 +63,459 @@ try {
     console.error('✗ Test error:', error);
     process.exit(1);
 }
+
+async function testAsync() {
+    console.log('\nAnalyzing TestStruct on a worker thread...');
+    const result = await native.analyzeAsync(request).promise;
+
+    if (!result.success || result.layouts.length !== 1) {
+        throw new Error(`async analysis failed: ${result.errorMessage}`);
+    }
+    console.log(`✓ Async analysis successful (${result.layouts[0].totalSize} bytes)`);
+
+    // Parsing this many standard headers takes far longer than the
+    // cancel() on the next line, so the analysis must stop
+    const heavy = native.analyzeAsync({
+        ...request,
+        sourceCode: [
+            'algorithm', 'chrono', 'functional', 'iostream', 'map', 'memory',
+            'regex', 'sstream', 'string', 'thread', 'unordered_map', 'vector'
+        ].map(header => `#include <${header}>\n`).join('') + testCode,
+        filePath: 'cancelled.cpp'
+    });
+    heavy.cancel();
+    const cancelled = await heavy.promise;
+
+    if (cancelled.cancelled !== true || cancelled.success !== false || cancelled.layouts.length !== 0) {
+        throw new Error(`cancelled analysis should report no layouts, got: ${JSON.stringify(cancelled)}`);
+    }
+    console.log('✓ Cancellation stops the analysis');
+
+    // The trivial struct may finish before cancel() lands: either outcome
+    // is fine, but a cancelled analysis must not report layouts
+    const quick = native.analyzeAsync(request);
+    quick.cancel();
+    const raced = await quick.promise;
+
+    if (raced.cancelled) {
+        if (raced.success || raced.layouts.length !== 0) {
+            throw new Error('cancelled analysis still reported layouts');
+        }
+    } else if (!raced.success || raced.layouts.length !== 1) {
+        throw new Error(`analysis finishing before cancel() failed: ${raced.errorMessage}`);
+    }
+}
+
+async function testSession() {
+    console.log('\nQuerying TestStruct through a session...');
+    const session = native.openSession();
+
+    const first = await session.update(request, 1).promise;
+    const second = await session.update(request, 1).promise;
+    if (!first.success || !first.reparsed || second.reparsed) {
+        throw new Error('session should parse once per document version');
+    }
+
+    const result = await session.query('TestStruct').promise;
+    if (!result.success || result.layouts.length !== 1) {
+        throw new Error(`session query failed: ${result.errorMessage}`);
+    }
+
+    const timed = await session.query('TestStruct', { stats: true }).promise;
+    if (!timed.stats || !timed.stats.astReused || timed.stats.recordsReported !== 1 ||
+        timed.stats.recordsVisited < 1 || timed.stats.parseMs !== 0) {
+        throw new Error(`expected stats for a query on the reused AST, got: ${JSON.stringify(timed.stats)}`);
+    }
+    session.close();
+    console.log('✓ Session reuses its AST for the same version');
+}
+
+async function testSessionCancel() {
+    console.log('\nCancelling a session query...');
+    const session = native.openSession();
+
+    // A hover cancelled after its update resolved, then mid-query
+    const update = session.update(request, 1);
+    await update.promise;
+    update.cancel();
+    const cancelled = session.query('TestStruct');
+    cancelled.cancel();
+    await cancelled.promise;
+
+    // Neither cancellation may outlive its own call at the same version
+    await session.update(request, 1).promise;
+    const result = await session.query('TestStruct').promise;
+    session.close();
+    if (!result.success || result.cancelled || result.layouts.length !== 1) {
+        throw new Error(`a later query at the same version should run, got: ${result.errorMessage}`);
+    }
+    console.log('✓ A cancelled query leaves the session usable');
+}
+
+async function testPreambleRelease() {
+    console.log('\nReleasing a closed document\'s preamble...');
+    const source = { ...request, sourceCode: '#include <cstddef>\n' + testCode, filePath: 'preamble.cpp' };
+    const parse = async () => {
+        const session = native.openSession();
+        await session.update(source, 1).promise;
+        const result = await session.query('TestStruct', { stats: true }).promise;
+        return { session, reused: result.stats.preambleReused };
+    };
+
+    const first = await parse();
+    const second = await parse();
+    if (!second.reused) {
+        throw new Error('a second session on the same file should reuse its preamble');
+    }
+    first.session.close();
+    second.session.close();
+
+    const third = await parse();
+    third.session.close();
+    if (third.reused) {
+        throw new Error('closing the document should drop its preamble');
+    }
+    console.log('✓ Closing a session drops its file\'s preamble');
+}
+
+function testStdHeaders() {
+    console.log('\nAnalyzing a struct that includes <vector> and <atomic>...');
+    const result = native.analyze({
+        ...request,
+        sourceCode: `
+#include <atomic>
+#include <cstddef>
+#include <vector>
+struct Queue {
+    std::vector<int> items;
+    std::atomic<std::size_t> head;
+};
+`,
+        structName: 'Queue'
+    });
+
+    if (!result.success || result.layouts.length !== 1 || result.layouts[0].totalSize !== 32) {
+        throw new Error(`standard headers should parse with Clang's builtin headers, got: ${result.errorMessage}`);
+    }
+    console.log(`✓ Queue is ${result.layouts[0].totalSize} bytes`);
+}
+
+function testBinary() {
+    console.log('\nEncoding TestStruct as a binary buffer...');
+    const result = native.analyze({ ...request, binary: true });
+
+    if (!result.success || !(result.layoutBuffer instanceof ArrayBuffer) || result.layouts) {
+        throw new Error('binary analysis should return layoutBuffer instead of layouts');
+    }
+
+    const view = new DataView(result.layoutBuffer);
+    const magic = view.getUint32(0, true);
+    const layoutCount = view.getUint32(8, true);
+    const totalSize = view.getFloat64(48, true);
+    if (magic !== 0x42535353 || layoutCount !== 1 || totalSize !== 24) {
+        throw new Error('unexpected binary layout header');
+    }
+    console.log(`✓ Binary result is ${result.layoutBuffer.byteLength} bytes`);
+}
+
+function testFalseSharing() {
+    console.log('\nChecking thread-shared counters for false sharing...');
+    const result = native.analyze({
+        ...request,
+        sourceCode: `
+struct Counters {
+    [[clang::annotate("structsight::shared")]] long hits;
+    [[clang::annotate("structsight::shared")]] long misses;
+};
+`,
+        structName: 'Counters',
+        cacheLineSize: 128
+    });
+
+    const opt = result.success &&
+        result.layouts[0].optimizations.find(o => o.kind === 'falseSharing');
+    if (!opt || opt.contendedMembers.join(',') !== 'hits,misses') {
+        throw new Error('hits and misses should be reported as sharing a cache line');
+    }
+    console.log(`✓ ${opt.description}`);
+}
+
+function testVTable() {
+    console.log('\nReading vtables of a class with two polymorphic bases...');
+    const result = native.analyze({
+        ...request,
+        sourceCode: `
+struct Shape { virtual ~Shape(); virtual double area() const = 0; };
+struct Named { virtual const char* name() const = 0; };
+struct Circle : Shape, Named {
+    double area() const override;
+    const char* name() const override;
+    double r;
+};
+double total(const Circle* c, int n) {
+    double sum = 0;
+    for (int i = 0; i < n; i++) sum += c[i].area();
+    return sum;
+}
+`,
+        structName: 'Circle'
+    });
+
+    const layout = result.success && result.layouts[0];
+    const vptrs = layout ? layout.vtable.vptrs : [];
+    if (vptrs.length !== 2 || vptrs[0].offset !== 0 || vptrs[1].offset !== 8) {
+        throw new Error('Circle should have vptrs at +0 and +8');
+    }
+    if (!vptrs[1].slots.some(slot => slot.thunk)) {
+        throw new Error('the Named-in-Circle vtable should hold a this-adjusting thunk');
+    }
+    if (!layout.optimizations.some(o => o.kind === 'devirtualize')) {
+        throw new Error('Circle should be suggested final');
+    }
+    console.log(`✓ vptrs at ${vptrs.map(v => '+' + v.offset).join(', ')}`);
+
+    // Overloads stay apart, so only the one nothing overrides is suggested final
+    const overloads = native.analyze({
+        ...request,
+        sourceCode: `
+struct Canvas { virtual void draw(int); virtual void draw(double); };
+struct Layer : Canvas { void draw(int) override; void draw(double) override; };
+struct Overlay : Layer { void draw(double) override; };
+void paint(Layer* layer) { layer->draw(1); layer->draw(1.0); }
+`,
+        structName: 'Layer'
+    });
+    const layer = overloads.success && overloads.layouts[0];
+    const functions = layer ? layer.vtable.virtualFunctions : [];
+    if (!functions.includes('draw(int)') || !functions.includes('draw(double)')) {
+        throw new Error(`draw(int) and draw(double) should be listed apart, got: ${functions.join(', ')}`);
+    }
+    const final = layer.optimizations.find(o => o.kind === 'devirtualize');
+    if (!final || final.finalMethods.join(',') !== 'draw(int)') {
+        throw new Error('only draw(int) should be suggested final in Layer');
+    }
+    console.log(`✓ ${final.description}`);
+}
+
+function testInstantiations() {
+    console.log('\nAnalyzing every instantiation of a class template...');
+    const result = native.analyze({
+        ...request,
+        sourceCode: `
+template <typename K, typename V>
+struct Node { K key; V value; Node* next; };
+Node<int, int> a;
+Node<char, double> b;
+`,
+        structName: 'Node',
+        templateInstantiations: true
+    });
+
+    const layouts = result.success ? result.layouts : [];
+    const names = layouts.map(l => l.name).sort().join(', ');
+    if (names !== 'Node<char, double>, Node<int, int>' || layouts.some(l => l.templateName !== 'Node')) {
+        throw new Error(`expected both Node instantiations, got: ${names}`);
+    }
+    const padded = layouts.find(l => l.name === 'Node<char, double>');
+    if (padded.templatePaddingExcess !== 7) {
+        throw new Error('Node<char, double> should have 7 more padding bytes than Node<int, int>');
+    }
+    console.log(`✓ ${names}`);
+}
+
+function testBitfields() {
+    console.log('\nPacking bool and enum members into bitfields...');
+    const result = native.analyze({
+        ...request,
+        sourceCode: `
+enum Mode { Idle, Busy, Done };
+struct Flags { int id; bool ready; Mode mode; bool dirty; int count; bool locked; unsigned spare : 3; };
+`,
+        structName: 'Flags'
+    });
+
+    const layout = result.success && result.layouts[0];
+    const spare = layout ? layout.members.find(m => m.name === 'spare') : undefined;
+    if (!spare || spare.size !== 1) {
+        throw new Error('a 3-bit bitfield should take one byte, not its type\'s four');
+    }
+    const opt = layout.optimizations.find(o => o.kind === 'packFlags');
+    if (!opt || opt.bitfieldMembers.join(',') !== 'mode,ready,dirty,locked' ||
+        opt.bitfieldWidths.join(',') !== '2,1,1,1') {
+        throw new Error('mode, ready, dirty and locked should be suggested as bitfields');
+    }
+    console.log(`✓ ${opt.description}`);
+}
+
+function testNarrowing() {
+    console.log('\nNarrowing enum and bounded integer members...');
+    const result = native.analyze({
+        ...request,
+        sourceCode: `
+enum class Kind { Leaf, Branch, Root };
+struct Entry {
+    double weight;
+    Kind kind;
+    [[clang::annotate("structsight::max=4294967295")]] unsigned long index;
+    char tag;
+};
+`,
+        structName: 'Entry'
+    });
+
+    const opt = result.success &&
+        result.layouts[0].optimizations.find(o => o.kind === 'narrowTypes');
+    if (!opt || opt.bytesSaved !== 16 || opt.narrowedMembers.join(',') !== 'kind,index' ||
+        opt.narrowedTypes.join(',') !== 'std::uint8_t,std::uint32_t') {
+        throw new Error('kind and index should be narrowed to shrink Entry from 32 to 16 bytes');
+    }
+    console.log(`✓ ${opt.description}`);
+}
+
+function testNested() {
+    console.log('\nPadding inside nested members...');
+    const result = native.analyze({
+        ...request,
+        sourceCode: `
+struct Inner {
+    char a;
+    double b;
+    char c;
+};
+struct Outer {
+    Inner inner;
+    double weight;
+};
+`,
+        structName: 'Outer'
+    });
+
+    const layout = result.success ? result.layouts[0] : undefined;
+    const inner = layout && layout.members.find(m => m.name === 'inner');
+    if (!inner || layout.nestedPadding !== 14 || !inner.children || inner.children.length !== 3) {
+        throw new Error(`Outer should report Inner's 14 padding bytes, got: ${layout ? layout.nestedPadding : result.errorMessage}`);
+    }
+
+    const opt = layout.optimizations.find(o => o.kind === 'nestedReorder');
+    if (!opt || opt.nestedType !== 'Inner' || opt.nestedMember !== 'inner' || opt.bytesSaved !== 8 ||
+        opt.suggestedOrder.length !== 3) {
+        throw new Error('reordering Inner should shrink Outer from 32 to 24 bytes');
+    }
+    console.log(`✓ ${opt.description}`);
+
+    // D's members can only be reordered after its base's four bytes
+    const derived = native.analyze({
+        ...request,
+        sourceCode: `
+struct B { int x; };
+struct D : B { char c; int i; char d; };
+struct Holder { D d; int tail; };
+`,
+        structName: 'Holder'
+    });
+    const fromBase = derived.success &&
+        derived.layouts[0].optimizations.find(o => o.kind === 'nestedReorder');
+    if (!fromBase || fromBase.bytesSaved !== 4 || fromBase.membersMoved !== 1) {
+        throw new Error(`reordering D should shrink it from 16 to 12 bytes and Holder from 20 to 16, got: ${fromBase ? fromBase.description : derived.errorMessage}`);
+    }
+    console.log(`✓ ${fromBase.description}`);
+}
+
+function testArrayStride() {
+    console.log('\nArray stride of a 100-byte record...');
+    const result = native.analyze({
+        ...request,
+        sourceCode: 'struct Row { float values[25]; };',
+        structName: 'Row'
+    });
+
+    const layout = result.success ? result.layouts[0] : undefined;
+    const stride = layout && layout.arrayStride;
+    if (!stride || stride.linesPerElement !== 2.5 || stride.lineStraddle !== 1 ||
+        stride.shrinkSize !== 96 || stride.alignedSize !== 128) {
+        throw new Error(`Rows should touch 2.5 lines on average until shrunk to 96 or aligned to 128 bytes, got: ${JSON.stringify(stride) || result.errorMessage}`);
+    }
+    const opt = layout.optimizations.find(o => o.kind === 'arrayStride');
+    if (!opt) {
+        throw new Error('Row should get an arrayStride suggestion');
+    }
+    console.log(`✓ ${opt.description}`);
+
+    // 72 bytes span two lines wherever an element starts: nothing to fix
+    const wide = native.analyze({
+        ...request,
+        sourceCode: 'struct Wide { double values[9]; };',
+        structName: 'Wide'
+    });
+    const wideLayout = wide.success ? wide.layouts[0] : undefined;
+    if (!wideLayout || wideLayout.arrayStride.linesPerElement !== 2 || wideLayout.arrayStride.shrinkSize !== 0 ||
+        wideLayout.optimizations.some(o => o.kind === 'arrayStride')) {
+        throw new Error('a 72-byte record touches no more lines than it must and should get no arrayStride suggestion');
+    }
+    console.log('✓ A 72-byte record is left alone');
+}
+
+async function testTargets() {
+    console.log('\nLaying a struct out for several targets...');
+    const result = await native.analyzeTargets({
+        ...request,
+        sourceCode: 'struct Shared { char tag; void* next; int count; };',
+        structName: 'Shared',
+        targets: ['x86_64-linux-gnu', 'i386-linux-gnu', 'aarch64-linux-gnu']
+    }).promise;
+
+    const record = result.success ? result.records.find(r => r.qualifiedName === 'Shared') : undefined;
+    const sizes = record ? record.targets.map(t => t.size).join(', ') : '';
+    if (!record || !record.diverges || sizes !== '24, 12, 24') {
+        throw new Error(`expected Shared to be 24, 12 and 24 bytes, got: ${sizes || result.errorMessage}`);
+    }
+    const tag = record.members.find(m => m.name === 'tag');
+    const next = record.members.find(m => m.name === 'next');
+    if (tag.diverges || !next.diverges) {
+        throw new Error('only members after the pointer should differ between targets');
+    }
+    console.log(`✓ Shared is ${sizes} bytes on ${result.targets.join(', ')}`);
+}
+
+async function testFootprint() {
+    console.log('\nContainer footprint of a record...');
+    const result = await native.estimateFootprint({
+        ...request,
+        sourceCode: 'struct Sample { double value; int id; };',
+        structName: 'Sample',
+        elementCount: 1000
+    }).promise;
+
+    const byName = name => result.success && result.containers.find(c => c.container === name);
+    const list = byName('std::list');
+    const unique = byName('std::unique_ptr');
+    // 16-byte node header + 16-byte Sample = 32, in a 48-byte malloc chunk
+    if (!list || list.nodeSize !== 32 || list.allocationSize !== 48 || list.bytesPerElement !== 48) {
+        throw new Error(`std::list<Sample> should cost 48 bytes per element, got: ${list ? list.bytesPerElement : result.errorMessage}`);
+    }
+    if (!unique || unique.bytesPerElement !== 40) {
+        throw new Error('std::unique_ptr<Sample> should cost an 8-byte pointer plus a 32-byte chunk');
+    }
+    console.log(`✓ Sample: ${result.containers.map(c => `${c.container} ${c.bytesPerElement.toFixed(1)}`).join(', ')}`);
+}
+
+testAsync()
+    .then(testSession)
+    .then(testSessionCancel)
+    .then(testPreambleRelease)
+    .then(testStdHeaders)
+    .then(testBinary)
+    .then(testFalseSharing)
+    .then(testVTable)
+    .then(testInstantiations)
+    .then(testBitfields)
+    .then(testNarrowing)
+    .then(testNested)
+    .then(testArrayStride)
+    .then(testTargets)
+    .then(testFootprint)
+    .then(() => console.log('\n✓ All tests passed!'))
+    .catch(error => {
+        console.error('✗ Test error:', error);
+        process.exit(1);
+    });